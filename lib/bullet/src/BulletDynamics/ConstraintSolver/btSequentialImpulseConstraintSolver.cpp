@@ -34,6 +34,11 @@ subject to the following restrictions:
 #include "LinearMath/btAlignedObjectArray.h"
 #include <string.h> //for memset
 
+// STK: islands are solved by several threads at the same time (see
+// STKDynamicsWorld), so each thread has its own counter.
+#if __cplusplus >= 201103L || defined(_MSC_VER)
+thread_local
+#endif
 int		gNumSplitImpulseRecoveries = 0;
 
 btSequentialImpulseConstraintSolver::btSequentialImpulseConstraintSolver()
@@ -1240,8 +1245,9 @@ void	btSequentialImpulseConstraintSolver::reset()
 
 btRigidBody& btSequentialImpulseConstraintSolver::getFixedBody()
 {
+	// STK: the mass is only set when the body is created, since islands
+	// are solved by several threads at the same time (see STKDynamicsWorld)
 	static btRigidBody s_fixed(0, 0,0);
-	s_fixed.setMassProps(btScalar(0.),btVector3(btScalar(0.),btScalar(0.),btScalar(0.)));
 	return s_fixed;
 }
 
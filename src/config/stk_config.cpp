@@ -157,6 +157,11 @@ void STKConfig::load(const std::string &filename)
     CHECK_NEG(m_no_explosive_items_timeout,"powerup no-explosive-items-timeout"    );
     CHECK_NEG(m_max_moveable_objects,      "network max-moveable-objects");
     CHECK_NEG(m_network_steering_reduction,"network steering-reduction" );
+    CHECK_NEG(m_skip_rewind_position,      "network skip-rewind-position");
+    CHECK_NEG(m_skip_rewind_rotation,      "network skip-rewind-rotation");
+    CHECK_NEG(m_skip_rewind_velocity,      "network skip-rewind-velocity");
+    CHECK_NEG(m_skip_rewind_angular_velocity,
+              "network skip-rewind-angular-velocity");
     CHECK_NEG(m_default_moveable_friction, "physics default-moveable-friction");
     CHECK_NEG(m_solver_iterations,         "physics: solver-iterations"       );
     CHECK_NEG(m_solver_split_impulse_thresh,"physics: solver-split-impulse-threshold");
@@ -212,9 +217,14 @@ void STKConfig::init_defaults()
     m_solver_set_flags           = 0;
     m_solver_reset_flags         = 0;
     m_network_steering_reduction = -100;
+    m_skip_rewind_position       = -100;
+    m_skip_rewind_rotation       = -100;
+    m_skip_rewind_velocity       = -100;
+    m_skip_rewind_angular_velocity = -100;
     m_title_music                = NULL;
     m_default_music              = NULL;
     m_solver_split_impulse       = false;
+    m_physics_broadphase         = "axis-sweep";
     m_smooth_normals             = false;
     m_same_powerup_mode          = POWERUP_MODE_ONLY_IF_SAME;
     m_ai_acceleration            = 1.0f;
@@ -306,6 +316,7 @@ void STKConfig::getAllData(const XMLNode * root)
         physics_node->get("solver-split-impulse",   &m_solver_split_impulse  );
         physics_node->get("solver-split-impulse-threshold",
                                                &m_solver_split_impulse_thresh);
+        physics_node->get("broadphase",             &m_physics_broadphase    );
         std::vector<std::string> solver_modes;
         physics_node->get("solver-mode",            &solver_modes            );
         m_solver_set_flags=0, m_solver_reset_flags = 0;
@@ -460,6 +471,11 @@ void STKConfig::getAllData(const XMLNode * root)
     {
         networking_node->get("max-moveable-objects", &m_max_moveable_objects);
         networking_node->get("steering-reduction", &m_network_steering_reduction);
+        networking_node->get("skip-rewind-position", &m_skip_rewind_position);
+        networking_node->get("skip-rewind-rotation", &m_skip_rewind_rotation);
+        networking_node->get("skip-rewind-velocity", &m_skip_rewind_velocity);
+        networking_node->get("skip-rewind-angular-velocity",
+                             &m_skip_rewind_angular_velocity);
     }
 
     if(const XMLNode *replay_node = root->getNode("replay"))
@@ -97,6 +97,13 @@ public:
      *  steering adjustments. */
     float m_network_steering_reduction;
 
+    /** A client skips a rewind if the states of all karts received from the
+     *  server differ by at most these values from the predicted states:
+     *  position in m, rotation in radians, velocity in m/s and angular
+     *  velocity in radians/s. */
+    float m_skip_rewind_position, m_skip_rewind_rotation,
+          m_skip_rewind_velocity, m_skip_rewind_angular_velocity;
+
     /** If the angle between a normal on a vertex and the normal of the
      *  triangle are more than this value, the physics will use the normal
      *  of the triangle in smoothing normal. */
@@ -121,6 +128,10 @@ public:
      *  added to the solver mode, bits set in reset_flags are removed. */
     int m_solver_set_flags, m_solver_reset_flags;
 
+    /** The broadphase used by the physics (see Physics::init). It can be
+     *  changed for each track in its track.xml file. */
+    std::string m_physics_broadphase;
+
     int   m_max_skidmarks;           /**<Maximum number of skid marks/kart.  */
     float m_skid_fadeout_time;       /**<Time till skidmarks fade away.      */
     float m_near_ground;             /**<Determines when a kart is not near
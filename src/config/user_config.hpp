@@ -1032,6 +1032,13 @@ namespace UserConfigParams
             PARAM_DEFAULT( StringUserConfigParam("system", "language",
                         "Which language to use (language code or 'system')") );
 
+    PARAM_PREFIX IntUserConfigParam         m_physics_threads
+            PARAM_DEFAULT( IntUserConfigParam(1, "physics_threads",
+                        "Number of threads which solve independent groups of "
+                        "objects in the physics in parallel. Use 0 to choose "
+                        "it from the number of CPU cores, or 1 to solve "
+                        "everything in the game thread.") );
+
     PARAM_PREFIX BoolUserConfigParam        m_artist_debug_mode
             PARAM_DEFAULT( BoolUserConfigParam(false, "artist_debug_mode",
                                "Whether to enable track debugging features") );
@@ -247,6 +247,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedBVHDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -723,6 +724,15 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which the collision trees (BVH) of track meshes
+ *  are cached.
+ */
+std::string FileManager::getCachedBVHDir() const
+{
+    return m_cached_bvh_dir;
+}   // getCachedBVHDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -1061,6 +1071,30 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directory for the cached collision trees of track meshes.
+ *  This will set m_cached_bvh_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedBVHDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_bvh_dir = m_user_config_dir + "cached-bvh/";
+#elif defined(__APPLE__)
+    m_cached_bvh_dir = getenv("HOME");
+    m_cached_bvh_dir += "/Library/Application Support/SuperTuxKart/CachedBVH/";
+#else
+    m_cached_bvh_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_bvh_dir += "cached-bvh/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_bvh_dir))
+    {
+        Log::error("FileManager", "Can not create cached BVH directory '%s', "
+            "falling back to '.'.", m_cached_bvh_dir.c_str());
+        m_cached_bvh_dir = "./";
+    }
+}   // checkAndCreateCachedBVHDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -1256,6 +1290,29 @@ std::string FileManager::getUserConfigFile(const std::string &fname) const
     return m_user_config_dir+fname;
 }   // getUserConfigFile
 
+//-----------------------------------------------------------------------------
+/** Returns the full path of a file in the temporary directory of the system
+ *  (or in the config directory if there is none), e.g. for unit tests which
+ *  should not leave files in the data or config directories.
+ *  \param fname Name of the file.
+ */
+std::string FileManager::getTempFile(const std::string &fname) const
+{
+#ifdef WIN32
+    char path[MAX_PATH + 1];
+    const DWORD length = GetTempPathA(MAX_PATH + 1, path);
+    if (length > 0 && length <= MAX_PATH)
+        return std::string(path) + fname;
+#else
+    const char *dir = getenv("TMPDIR");
+    if (dir && dir[0] && isDirectory(dir))
+        return std::string(dir) + "/" + fname;
+    if (isDirectory("/tmp"))
+        return "/tmp/" + fname;
+#endif
+    return getUserConfigFile(fname);
+}   // getTempFile
+
 //-----------------------------------------------------------------------------
 /** Returns the full path of a music file by searching all music search paths.
  *  It throws an exception if the file is not found.
@@ -1378,6 +1435,41 @@ bool FileManager::removeFile(const std::string &name) const
     return false;
 }   // removeFile
 
+// ----------------------------------------------------------------------------
+/** Returns a temporary name for writing a file before it is moved into place
+ *  with replaceFile. The name contains the process id, so that several
+ *  processes (e.g. forked server lobbies) writing the same file at the same
+ *  time don't use the same temporary file.
+ *  \param filename Name of the file that will be replaced.
+ */
+std::string FileManager::getTempName(const std::string &filename)
+{
+#ifdef WIN32
+    const unsigned int pid = (unsigned int)GetCurrentProcessId();
+#else
+    const unsigned int pid = (unsigned int)getpid();
+#endif
+    return filename + "." + StringUtils::toString(pid) + ".tmp";
+}   // getTempName
+
+// ----------------------------------------------------------------------------
+/** Renames a file, replacing the destination if it exists. On POSIX systems
+ *  this is atomic, so that other processes see either the old or the new
+ *  file.
+ *  \param source Name of the file to rename.
+ *  \param dest New name of the file.
+ *  \return True if successful.
+ */
+bool FileManager::replaceFile(const std::string &source,
+                              const std::string &dest)
+{
+#ifdef WIN32
+    // rename doesn't replace an existing file on windows
+    remove(dest.c_str());
+#endif
+    return rename(source.c_str(), dest.c_str()) == 0;
+}   // replaceFile
+
 // ----------------------------------------------------------------------------
 /** Removes a directory (including all files contained). The function could
  *  easily recursively delete further subdirectories, but this is commented
@@ -608,18 +608,18 @@ void Flyable::moveToInfinity()
 }   // moveToInfinity
 
 // ----------------------------------------------------------------------------
-BareNetworkString* Flyable::saveState(std::vector<std::string>* ru)
+bool Flyable::saveState(BareNetworkString* buffer,
+                        std::vector<std::string>* ru)
 {
     if (m_has_hit_something)
-        return NULL;
+        return false;
 
     ru->push_back(getUniqueIdentity());
-    BareNetworkString *buffer = new BareNetworkString();
     CompressNetworkBody::compress(m_body->getWorldTransform(),
         m_body->getLinearVelocity(), m_body->getAngularVelocity(), buffer,
         m_body.get(), m_motion_state.get());
     buffer->addUInt16(m_ticks_since_thrown);
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
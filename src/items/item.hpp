@@ -441,6 +441,10 @@ public:
         return m_distance_from_center;
     }   // getDistanceFromCenter
     // ------------------------------------------------------------------------
+    /** Returns the square of the distance at which this item is collected
+     *  (see hitKart). */
+    float getCollectDistance2() const                  { return m_distance_2; }
+    // ------------------------------------------------------------------------
     /** Returns a point to the left or right of the item which will not trigger
      *  a collection of this item.
      *  \param left If true, return a point to the left, else a point to
@@ -38,6 +38,7 @@
 #include <IMesh.h>
 #include <IAnimatedMesh.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <stdexcept>
 #include <sstream>
@@ -50,6 +51,7 @@ std::vector<video::SColorf>  ItemManager::m_glow_color;
 bool                         ItemManager::m_disable_item_collection = false;
 std::shared_ptr<ItemManager> ItemManager::m_item_manager;
 std::mt19937                 ItemManager::m_random_engine;
+const float                  ItemManager::GRID_CELL_SIZE = 4.0f;
 
 //-----------------------------------------------------------------------------
 /** Creates one instance of the item manager. */
@@ -235,6 +237,7 @@ unsigned int ItemManager::insertItem(Item *item)
         m_all_items[index] = item;
     }
     item->setItemId(index);
+    updateItemGrid(item, /*add*/true);
 
     // Now insert into the appropriate quad list, if there is a quad list
     // (i.e. race mode has a quad graph).
@@ -382,31 +385,31 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
     /** Disable item collection detection for debug purposes. */
     if(m_disable_item_collection) return;
 
     // Spare tire karts don't collect items
     if ( dynamic_cast<SpareTireAI*>(kart->getController()) ) return;
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-                               i!=m_all_items.end();  i++)
+    // Only the items in the grid cell of the kart can be hit. They are
+    // sorted by index, so they are tested in the same order as when testing
+    // all items (which matters if a kart hits more than one item).
+    const Vec3 &xyz = kart->getXYZ();
+    auto cell = m_item_grid.find(getGridKey(getGridCell(xyz.getX()),
+                                            getGridCell(xyz.getZ())));
+    if (cell == m_item_grid.end())
+        return;
+    const std::vector<int> &indices = cell->second;
+    for(unsigned int n = 0; n < indices.size(); n++)
     {
+        ItemState *item = m_all_items[indices[n]];
         // Ignore items that have been collected or are not available atm
-        if ((!*i) || !(*i)->isAvailable() || (*i)->isUsedUp()) continue;
+        if (!item || !item->isAvailable() || item->isUsedUp()) continue;
 
         // Shielded karts can simply drive over bubble gums without any effect
         if ( kart->isShielded() &&
-             ( (*i)->getType() == ItemState::ITEM_BUBBLEGUM      ||
-               (*i)->getType() == ItemState::ITEM_BUBBLEGUM_NOLOK  ) )
+             ( item->getType() == ItemState::ITEM_BUBBLEGUM      ||
+               item->getType() == ItemState::ITEM_BUBBLEGUM_NOLOK  ) )
         {
             continue;
         }
@@ -414,11 +417,11 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
 
         // To allow inlining and avoid including kart.hpp in item.hpp,
         // we pass the kart and the position separately.
-        if((*i)->hitKart(kart->getXYZ(), kart))
+        if(item->hitKart(xyz, kart))
         {
-            collectedItem(*i, kart);
+            collectedItem(item, kart);
         }   // if hit
-    }   // for m_all_items
+    }   // for n < indices.size()
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -534,11 +537,62 @@ void ItemManager::deleteItem(ItemState *item)
         items.erase(it);
     }   // if m_items_in_quads
 
+    updateItemGrid(item, /*add*/false);
     int index = item->getItemId();
     m_all_items[index] = NULL;
     delete item;
 }   // delete item
 
+//-----------------------------------------------------------------------------
+/** Adds an item to or removes it from all cells of the item grid in which a
+ *  kart can collect it. A kart hits an item if the distance, with the
+ *  vertical part halved, is less than the collect distance (see
+ *  Item::hitKart), so the horizontal distance is less than twice the
+ *  collect distance.
+ *  \param item The item, its index and position must not have changed
+ *         since it was added.
+ *  \param add True to add the item, false to remove it.
+ */
+void ItemManager::updateItemGrid(const ItemState *item, bool add)
+{
+    const Item *it = dynamic_cast<const Item*>(item);
+    assert(it);
+    // Add a bit for rounding errors in hitKart
+    const float r = 2.0f * sqrtf(it->getCollectDistance2()) + 0.1f;
+    const Vec3 &xyz = item->getXYZ();
+    const int index = item->getItemId();
+    for (int z = getGridCell(xyz.getZ() - r);
+         z <= getGridCell(xyz.getZ() + r); z++)
+    {
+        for (int x = getGridCell(xyz.getX() - r);
+             x <= getGridCell(xyz.getX() + r); x++)
+        {
+            std::vector<int> &indices = m_item_grid[getGridKey(x, z)];
+            std::vector<int>::iterator i =
+                std::lower_bound(indices.begin(), indices.end(), index);
+            if (add)
+                indices.insert(i, index);
+            else if (i != indices.end() && *i == index)
+                indices.erase(i);
+        }
+    }
+}   // updateItemGrid
+
+//-----------------------------------------------------------------------------
+/** Adds all items to the item grid again, necessary if the index or the
+ *  position of items was changed directly (e.g. when restoring the state
+ *  in a network game).
+ */
+void ItemManager::rebuildItemGrid()
+{
+    m_item_grid.clear();
+    for (unsigned int i = 0; i < m_all_items.size(); i++)
+    {
+        if (m_all_items[i])
+            updateItemGrid(m_all_items[i], /*add*/true);
+    }
+}   // rebuildItemGrid
+
 //-----------------------------------------------------------------------------
 /** Switches all items: boxes become bananas and vice versa for a certain
  *  amount of time (as defined in stk_config.xml).
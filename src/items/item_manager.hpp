@@ -33,6 +33,7 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -97,6 +98,18 @@ public:
 
     // ========================================================================
 protected:
+    /** Returns the grid cell coordinate of a x or z coordinate. */
+    static int getGridCell(float v)
+    {
+        return (int)floorf(v / GRID_CELL_SIZE);
+    }   // getGridCell
+    // ------------------------------------------------------------------------
+    /** Returns the key of a grid cell in m_item_grid. */
+    static uint64_t getGridKey(int x, int z)
+    {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+    }   // getGridKey
+
     /** The vector of all items of the current track. */
     typedef std::vector<ItemState*> AllItemTypes;
     AllItemTypes m_all_items;
@@ -110,6 +123,15 @@ private:
      *  field is undefined if no Graph exist, e.g. arena without navmesh. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** A spatial hash of all items, so that checkItemHit only needs to test
+     *  the items close to a kart. Each cell (a square of GRID_CELL_SIZE on
+     *  the x/z plane) stores the sorted indices of all items which can be
+     *  collected by a kart in this cell. Items must be (re)added if their
+     *  index or position changes. */
+    std::unordered_map<uint64_t, std::vector<int> > m_item_grid;
+
+    static const float GRID_CELL_SIZE;
+
     /** Stores all item models. */
     static std::vector<scene::IMesh *> m_item_mesh;
 
@@ -123,6 +145,8 @@ protected:
 
     void deleteItem(ItemState *item);
     virtual unsigned int insertItem(Item *item);
+    void updateItemGrid(const ItemState *item, bool add);
+    void rebuildItemGrid();
     void switchItemsInternal(std::vector < ItemState*> &all_items);
     void setSwitchItems(const std::vector<int> &switch_items);
 
@@ -47,12 +47,14 @@ void NetworkItemManager::create()
  *  "I" which is less than "Kx" (kart rewinder with id x)
  */
 NetworkItemManager::NetworkItemManager()
-                  : Rewinder("I"), ItemManager()
+                  : Rewinder("I"), ItemManager(), m_peer_confirmations(1024)
 {
     m_confirmed_switch_ticks = -1;
     m_last_confirmed_item_ticks.clear();
+    m_has_confirmations_overflow.store(false);
 
-    if (NetworkConfig::get()->isServer())
+    // There is no host when a recorded race is simulated offline
+    if (NetworkConfig::get()->isServer() && STKHost::existHost())
     {
         auto peers = STKHost::get()->getPeers();
         for (auto& p : peers)
@@ -115,12 +117,9 @@ void NetworkItemManager::collectedItem(ItemState *item, AbstractKart *kart)
     {
         ItemManager::collectedItem(item, kart);
         // The server saves the collected item as item event info
-        m_item_events.lock();
-        m_item_events.getData().emplace_back(World::getWorld()->getTicksSinceStart(),
-                                             item->getItemId(),
-                                             kart->getWorldKartId(),
-                                             item->getTicksTillReturn());
-        m_item_events.unlock();
+        m_item_events.emplace_back(World::getWorld()->getTicksSinceStart(),
+                                   item->getItemId(), kart->getWorldKartId(),
+                                   item->getTicksTillReturn());
     }
     else
     {
@@ -138,12 +137,9 @@ void NetworkItemManager::switchItems()
     if (NetworkConfig::get()->isServer())
     {
         // The server saves the collected item as item event info
-        m_item_events.lock();
         // Create a switch event - the constructor called determines
         // the type of the event automatically.
-        m_item_events.getData()
-                     .emplace_back(World::getWorld()->getTicksSinceStart());
-        m_item_events.unlock();
+        m_item_events.emplace_back(World::getWorld()->getTicksSinceStart());
     }
     ItemManager::switchItems();
 }   // switchItems
@@ -170,20 +166,18 @@ Item* NetworkItemManager::dropNewItem(ItemState::ItemType type,
 
     assert(!server_xyz);
     // Server: store the data for this event:
-    m_item_events.lock();
-    m_item_events.getData().emplace_back(World::getWorld()->getTicksSinceStart(),
-                                         type, item->getItemId(),
-                                         kart->getWorldKartId(),
-                                         item->getXYZ(),
-                                         item->getNormal());
-    m_item_events.unlock();
+    m_item_events.emplace_back(World::getWorld()->getTicksSinceStart(),
+                               type, item->getItemId(),
+                               kart->getWorldKartId(), item->getXYZ(),
+                               item->getNormal());
     return item;
 }   // dropNewItem
 
 // ----------------------------------------------------------------------------
 /** Called by the GameProtocol when a confirmation for an item event is
  *  received by the server. Once all hosts have confirmed an event, it can be
- *  deleted and won't be sent to any clients again.
+ *  deleted and won't be sent to any clients again. The confirmation is only
+ *  queued here, it is applied by the main thread in saveState.
  *  \param peer Peer confirming the latest event time received.
  *  \param ticks Time at which the last event was received.
  */
@@ -191,8 +185,77 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
                                                  int ticks)
 {
     assert(NetworkConfig::get()->isServer());
-    if (ticks > m_last_confirmed_item_ticks.at(peer))
-        m_last_confirmed_item_ticks.at(peer) = ticks;
+    addPeerConfirmation(peer, ticks);
+}   // setItemConfirmationTime
+
+// ----------------------------------------------------------------------------
+/** Queues a change of m_last_confirmed_item_ticks, which can be done from
+ *  any thread. It never gets lost, since a live join or erased peer which
+ *  is not applied would keep item events forever or free them too early.
+ *  \param peer The peer.
+ *  \param ticks The confirmed ticks, or CONFIRMATION_ADD_PEER or
+ *         CONFIRMATION_ERASE_PEER.
+ */
+void NetworkItemManager::addPeerConfirmation(std::weak_ptr<STKPeer> peer,
+                                             int ticks)
+{
+    // Once the queue overflowed, keep adding to the overflow list so the
+    // order of the confirmations is kept
+    if (!m_has_confirmations_overflow.load() &&
+        m_peer_confirmations.push(std::make_pair(peer, ticks)))
+        return;
+    m_confirmations_overflow.lock();
+    m_confirmations_overflow.getData().push_back(std::make_pair(peer, ticks));
+    m_has_confirmations_overflow.store(true);
+    m_confirmations_overflow.unlock();
+}   // addPeerConfirmation
+
+// ----------------------------------------------------------------------------
+/** Applies all queued confirmations, and then discards all events which
+ *  were confirmed by all clients. Must be called from the main thread.
+ */
+void NetworkItemManager::applyPeerConfirmations()
+{
+    bool confirmed = false;
+    auto apply = [this, &confirmed](const PeerConfirmation& confirmation)
+    {
+        const std::weak_ptr<STKPeer>& peer = confirmation.first;
+        int ticks = confirmation.second;
+        if (ticks == CONFIRMATION_ADD_PEER)
+        {
+            m_last_confirmed_item_ticks[peer] = 0;
+            return;
+        }
+        if (ticks == CONFIRMATION_ERASE_PEER)
+        {
+            m_last_confirmed_item_ticks.erase(peer);
+            return;
+        }
+        auto it = m_last_confirmed_item_ticks.find(peer);
+        if (it == m_last_confirmed_item_ticks.end())
+            return;
+        if (ticks > it->second)
+            it->second = ticks;
+        confirmed = true;
+    };
+
+    PeerConfirmation confirmation;
+    while (m_peer_confirmations.pop(&confirmation))
+        apply(confirmation);
+    // The overflow data was added after the data in the queue
+    if (m_has_confirmations_overflow.load())
+    {
+        m_confirmations_overflow.lock();
+        std::vector<PeerConfirmation>& overflow =
+            m_confirmations_overflow.getData();
+        for (const PeerConfirmation& c : overflow)
+            apply(c);
+        overflow.clear();
+        m_has_confirmations_overflow.store(false);
+        m_confirmations_overflow.unlock();
+    }
+    if (!confirmed)
+        return;
 
     // Now discard unneeded events and expired (disconnected) peer, i.e. all
     // events that have been confirmed by all clients:
@@ -214,14 +277,11 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
     // Find the last entry before the minimal confirmed time.
     // Since the event list is sorted, all events up to this
     // entry can be deleted.
-    m_item_events.lock();
-    auto p = m_item_events.getData().begin();
-    while (p != m_item_events.getData().end() && p->getTicks() < min_time)
+    auto p = m_item_events.begin();
+    while (p != m_item_events.end() && p->getTicks() < min_time)
         p++;
-    m_item_events.getData().erase(m_item_events.getData().begin(), p);
-    m_item_events.unlock();
-
-}   // setItemConfirmationTime
+    m_item_events.erase(m_item_events.begin(), p);
+}   // applyPeerConfirmations
 
 //-----------------------------------------------------------------------------
 /** Saves the state of all items. This is done by using a state that has
@@ -233,29 +293,18 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
  *  to save the initial state, which is the first confirmed state by all
  *  clients.
  */
-BareNetworkString* NetworkItemManager::saveState(std::vector<std::string>* ru)
+bool NetworkItemManager::saveState(BareNetworkString* buffer,
+                                   std::vector<std::string>* ru)
 {
     ru->push_back(getUniqueIdentity());
     // On the server:
     // ==============
-    m_item_events.lock();
-    uint16_t n = (uint16_t)m_item_events.getData().size();
-    if(n==0)
+    applyPeerConfirmations();
+    for (auto p : m_item_events)
     {
-        BareNetworkString *s = new BareNetworkString();
-        m_item_events.unlock();
-        return s;
+        p.saveState(buffer);
     }
-
-    BareNetworkString *s =
-        new BareNetworkString(n * (  sizeof(int) + sizeof(uint16_t)
-                                   + sizeof(uint8_t)              ) );
-    for (auto p : m_item_events.getData())
-    {
-        p.saveState(s);
-    }
-    m_item_events.unlock();
-    return s;
+    return true;
 }   // saveState
 
 //-----------------------------------------------------------------------------
@@ -531,6 +580,9 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
         }
     }   // for i < max_index
 
+    // Items can have been moved to a different index or position
+    rebuildItemGrid();
+
     // Now set the clock back to the 'rewindto' time:
     world->setTicksForRewind(rewind_to_time);
 
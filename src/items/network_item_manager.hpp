@@ -23,10 +23,13 @@
 #include "items/item_manager.hpp"
 #include "network/rewinder.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/mpsc_queue.hpp"
 #include "utils/synchronised.hpp"
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <utility>
 
 class STKPeer;
 
@@ -58,10 +61,30 @@ private:
     std::map<std::weak_ptr<STKPeer>, int32_t,
         std::owner_less<std::weak_ptr<STKPeer> > > m_last_confirmed_item_ticks;
 
-    /** List of all items events. */
-    Synchronised< std::vector<ItemEventInfo> > m_item_events;
+    /** Special values for the ticks in m_peer_confirmations. */
+    enum { CONFIRMATION_ADD_PEER = -1, CONFIRMATION_ERASE_PEER = -2 };
+
+    typedef std::pair<std::weak_ptr<STKPeer>, int> PeerConfirmation;
+
+    /** Confirmed ticks, live join and disconnected peers from the protocol
+     *  thread. They are applied to m_last_confirmed_item_ticks in the main
+     *  thread, so the item events are never locked. */
+    MPSCQueue<PeerConfirmation> m_peer_confirmations;
+
+    /** Confirmations which did not fit into m_peer_confirmations, which can
+     *  only happen if the main thread stalls (e.g. while loading). */
+    Synchronised<std::vector<PeerConfirmation> > m_confirmations_overflow;
+
+    /** True if m_confirmations_overflow contains data, so the main thread
+     *  only has to lock it in this case. */
+    std::atomic<bool> m_has_confirmations_overflow;
+
+    /** List of all items events, only used in the main thread. */
+    std::vector<ItemEventInfo> m_item_events;
 
     void forwardTime(int ticks);
+    void addPeerConfirmation(std::weak_ptr<STKPeer> peer, int ticks);
+    void applyPeerConfirmations();
 
     NetworkItemManager();
 
@@ -84,8 +107,8 @@ public:
                               const AbstractKart *kart,
                               const Vec3 *server_xyz = NULL,
                               const Vec3 *server_normal = NULL) OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) OVERRIDE;
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void rewindToEvent(BareNetworkString *bns) OVERRIDE {};
@@ -98,11 +121,18 @@ public:
     // ------------------------------------------------------------------------
     virtual void undoEvent(BareNetworkString*) OVERRIDE {};
     // ------------------------------------------------------------------------
+    /** A state without item events does not change anything that was not
+     *  predicted, otherwise the events must be confirmed (see
+     *  restoreState). */
+    virtual bool hasDiverged(BareNetworkString *buffer, int count,
+                             const BareNetworkString *predicted) OVERRIDE
+                                                         { return count > 0; }
+    // ------------------------------------------------------------------------
     void addLiveJoinPeer(std::weak_ptr<STKPeer> peer)
-                                     { m_last_confirmed_item_ticks[peer] = 0; }
+                           { addPeerConfirmation(peer, CONFIRMATION_ADD_PEER); }
     // ------------------------------------------------------------------------
     void erasePeerInGame(std::weak_ptr<STKPeer> peer)
-                                   { m_last_confirmed_item_ticks.erase(peer); }
+                         { addPeerConfirmation(peer, CONFIRMATION_ERASE_PEER); }
     // ------------------------------------------------------------------------
     void saveCompleteState(BareNetworkString* buffer) const;
     // ------------------------------------------------------------------------
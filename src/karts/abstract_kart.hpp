@@ -477,6 +477,11 @@ public:
     /** Returns the terrain info oject. */
     virtual const TerrainInfo *getTerrainInfo() const = 0;
     // ------------------------------------------------------------------------
+    /** Does the terrain raycast of the next update in advance. This must
+     *  only read the kart and the static track, since it is called for all
+     *  karts in parallel (see World::update). */
+    virtual void prefetchTerrainInfo() = 0;
+    // ------------------------------------------------------------------------
     /** Called when the kart crashes against another kart.
      *  \param k The kart that was hit.
      *  \param update_attachments If true the attachment of this kart and the
@@ -19,12 +19,14 @@
 #include "graphics/camera_fps.hpp"
 #include "karts/controller/ghost_controller.hpp"
 #include "karts/controller/kart_control.hpp"
+#include "karts/ghost_kart.hpp"
 #include "modes/world.hpp"
 
-GhostController::GhostController(AbstractKart *kart, core::stringw display_name)
+GhostController::GhostController(GhostKart *kart, core::stringw display_name)
                 : Controller(kart)
 {
     m_display_name = display_name;
+    m_events       = &kart->getReplayEvents();
 }   // GhostController
 
 //-----------------------------------------------------------------------------
@@ -41,11 +43,24 @@ void GhostController::update(int ticks)
     // Find (if necessary) the next index to use
     if (m_current_time != 0.0f)
     {
-        while (m_current_index + 1 < m_all_times.size() &&
-               m_current_time >= m_all_times[m_current_index + 1])
+        const unsigned int num_events = m_events->getNumEvents();
+        unsigned int steps = 0;
+        while (m_current_index + 1 < num_events &&
+               m_current_time >= m_events->getTime(m_current_index + 1))
         {
             m_current_index++;
+            // For larger jumps use the time index instead of decoding
+            // all events in between
+            if (++steps > ReplayBinary::EVENTS_PER_CHUNK)
+            {
+                m_current_index = m_events->findEvent(m_current_time);
+                break;
+            }
         }
+        // The world time can also go backwards (e.g. rewind)
+        if (m_current_index > 0 &&
+            m_current_time < m_events->getTime(m_current_index))
+            m_current_index = m_events->findEvent(m_current_time);
     }
 
     // Watching replay use only
@@ -69,18 +84,6 @@ void GhostController::update(int ticks)
 
 }   // update
 
-//-----------------------------------------------------------------------------
-void GhostController::addReplayTime(float time)
-{
-    // FIXME: for now avoid that transforms for the same time are set
-    // twice (to avoid division by zero in update). This should be
-    // done when saving in replay
-    if (m_all_times.size() > 0 && m_all_times.back() == time)
-        return;
-    m_all_times.push_back(time);
-
-}   // addReplayTime
-
 //-----------------------------------------------------------------------------
 bool GhostController::action(PlayerAction action, int value, bool dry_run)
 {
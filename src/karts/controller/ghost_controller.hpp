@@ -20,9 +20,10 @@
 #define HEADER_GHOST_CONTROLLER_HPP
 
 #include "karts/controller/controller.hpp"
+#include "replay/replay_stream.hpp"
 #include "states_screens/state_manager.hpp"
 
-#include <vector>
+class GhostKart;
 
 /** A class for Ghost controller.
  * \ingroup controller
@@ -30,7 +31,7 @@
 class GhostController : public Controller
 {
 private:
-    /** Pointer to the last index in m_all_times that is smaller than
+    /** Pointer to the last event of the kart whose time is smaller than
      *  the current world time. */
     unsigned int m_current_index;
 
@@ -40,11 +41,12 @@ private:
     /** Player name of the ghost kart. */
     core::stringw m_display_name;
 
-    /** The list of the times at which the events of kart were reached. */
-    std::vector<float> m_all_times;
+    /** The recorded events of the kart, which contain the time of each
+     *  event. */
+    const ReplayStream *m_events;
 
 public:
-             GhostController(AbstractKart *kart, core::stringw display_name);
+             GhostController(GhostKart *kart, core::stringw display_name);
     virtual ~GhostController() {};
     virtual void reset() OVERRIDE;
     virtual void update (int ticks) OVERRIDE;
@@ -65,16 +67,18 @@ public:
     virtual void saveState(BareNetworkString *buffer) const OVERRIDE {}
     virtual void rewindTo(BareNetworkString *buffer) OVERRIDE {}
 
-    void         addReplayTime(float time);
-    // ------------------------------------------------------------------------
     bool         isReplayEnd() const
-                         { return m_current_index + 1 >= m_all_times.size(); }
+                   { return m_current_index + 1 >= m_events->getNumEvents(); }
     // ------------------------------------------------------------------------
     float        getReplayDelta() const
     {
-        assert(m_current_index < m_all_times.size());
-        return ((m_current_time - m_all_times[m_current_index]) /
-            (m_all_times[m_current_index + 1] - m_all_times[m_current_index]));
+        if (isReplayEnd())
+            return 0.0f;
+        const float t0 = m_events->getTime(m_current_index);
+        const float t1 = m_events->getTime(m_current_index + 1);
+        if (t1 <= t0)
+            return 0.0f;
+        return (m_current_time - t0) / (t1 - t0);
     }
     // ------------------------------------------------------------------------
     unsigned int getCurrentReplayIndex() const
@@ -83,8 +87,7 @@ public:
     // ------------------------------------------------------------------------
     float        getTimeAtIndex(unsigned int index) const
     {
-        assert(index < m_all_times.size());
-        return m_all_times[index];
+        return m_events->getTime(index);
     }
 
     // ------------------------------------------------------------------------
@@ -49,6 +49,7 @@ void GhostKart::reset()
     update(0);
     updateGraphics(0);
     m_last_egg_idx = 0;
+    m_last_egg_value = 0;
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -58,26 +59,42 @@ void GhostKart::addReplayEvent(float time,
                                const ReplayBase::BonusInfo &bi,
                                const ReplayBase::KartReplayEvent &kre)
 {
-    GhostController* gc = dynamic_cast<GhostController*>(getController());
-    gc->addReplayTime(time);
-
-    m_all_transform.push_back(trans);
-    m_all_physic_info.push_back(pi);
-    m_all_bonus_info.push_back(bi);
-    m_all_replay_events.push_back(kre);
+    ReplayBase::TransformEvent t;
+    t.m_time      = time;
+    t.m_transform = trans;
+    m_replay_events.addEvent(t, pi, bi, kre);
 
     // Use first frame of replay to calculate default suspension
-    if (m_all_physic_info.size() == 1)
-    {
-        float f = 0;
-        for (int i = 0; i < 4; i++)
-            f += m_all_physic_info[0].m_suspension_length[i];
-        m_graphical_y_offset = -f / 4 + getKartModel()->getLowestPoint();
-        m_kart_model->setDefaultSuspension();
-    }
-
+    if (m_replay_events.getNumEvents() == 1)
+        setDefaultSuspension();
 }   // addReplayEvent
 
+// ----------------------------------------------------------------------------
+/** Streams the events of this kart from a binary replay file, instead of
+ *  adding all events with addReplayEvent.
+ *  \param file The replay file.
+ *  \param kart Index of this kart in the replay file.
+ */
+void GhostKart::setReplayFile(std::shared_ptr<ReplayStream::File> file,
+                              unsigned int kart)
+{
+    m_replay_events.init(file, kart);
+    if (m_replay_events.getNumEvents() > 0)
+        setDefaultSuspension();
+}   // setReplayFile
+
+// ----------------------------------------------------------------------------
+/** Uses the first event of the replay to compute the default suspension. */
+void GhostKart::setDefaultSuspension()
+{
+    const ReplayBase::PhysicInfo pi = m_replay_events.getPhysicInfo(0);
+    float f = 0;
+    for (int i = 0; i < 4; i++)
+        f += pi.m_suspension_length[i];
+    m_graphical_y_offset = -f / 4 + getKartModel()->getLowestPoint();
+    m_kart_model->setDefaultSuspension();
+}   // setDefaultSuspension
+
 // ----------------------------------------------------------------------------
 /** Called once per rendered frame. It is used to only update any graphical
  *  effects.
@@ -127,20 +144,28 @@ void GhostKart::update(int ticks)
         }
     }
 
+    assert(idx + 1 < m_replay_events.getNumEvents());
+    // Decode the events ahead of the current one if necessary
+    m_replay_events.update(idx);
     const float rd         = gc->getReplayDelta();
-    assert(idx < m_all_transform.size());
 
-    setXYZ((1- rd)*m_all_transform[idx    ].getOrigin()
-           +  rd  *m_all_transform[idx + 1].getOrigin() );
+    const btTransform t0 = m_replay_events.getTransform(idx);
+    const btTransform t1 = m_replay_events.getTransform(idx + 1);
+    const ReplayBase::PhysicInfo      pi  = m_replay_events.getPhysicInfo(idx);
+    const ReplayBase::BonusInfo       bi0 = m_replay_events.getBonusInfo(idx);
+    const ReplayBase::BonusInfo       bi1 =
+                                       m_replay_events.getBonusInfo(idx + 1);
+    const ReplayBase::KartReplayEvent kre =
+                                       m_replay_events.getKartReplayEvent(idx);
+
+    setXYZ((1- rd)*t0.getOrigin() + rd*t1.getOrigin());
 
-    const btQuaternion q = m_all_transform[idx].getRotation()
-        .slerp(m_all_transform[idx + 1].getRotation(), rd);
+    const btQuaternion q = t0.getRotation().slerp(t1.getRotation(), rd);
     setRotation(q);
 
     Moveable::updatePosition();
     float dt = stk_config->ticks2Time(ticks);
-    getKartModel()->update(dt, dt*(m_all_physic_info[idx].m_speed),
-        m_all_physic_info[idx].m_steer, m_all_physic_info[idx].m_speed,
+    getKartModel()->update(dt, dt*(pi.m_speed), pi.m_steer, pi.m_speed,
         /*lean*/0.0f, idx);
 
     // Attachment management
@@ -151,7 +176,7 @@ void GhostKart::update(int ticks)
     // graphical effect only.
 
     Attachment::AttachmentType attach_type =
-        ReplayRecorder::codeToEnumAttach(m_all_bonus_info[idx].m_attachment);
+        ReplayRecorder::codeToEnumAttach(bi0.m_attachment);
     int16_t attach_ticks = 0;
     if (attach_type == Attachment::ATTACH_BUBBLEGUM_SHIELD)
         attach_ticks = (int16_t)stk_config->time2Ticks(10);
@@ -181,42 +206,40 @@ void GhostKart::update(int ticks)
 
     // Update item amount and type
     PowerupManager::PowerupType item_type =
-        ReplayRecorder::codeToEnumItem(m_all_bonus_info[idx].m_item_type); 
-    m_powerup->set(item_type, m_all_bonus_info[idx].m_item_amount);
+        ReplayRecorder::codeToEnumItem(bi0.m_item_type);
+    m_powerup->set(item_type, bi0.m_item_amount);
 
     // Update special values in easter egg and battle modes
     if (race_manager->isEggHuntMode())
     {
-        if (idx > m_last_egg_idx &&
-            m_all_bonus_info[idx].m_special_value >
-            m_all_bonus_info[m_last_egg_idx].m_special_value)
+        if (idx > m_last_egg_idx && bi0.m_special_value > m_last_egg_value)
         {
             EasterEggHunt *world = dynamic_cast<EasterEggHunt*>(World::getWorld());
             assert(world);
             world->collectedEasterEggGhost(getWorldKartId());
             m_last_egg_idx = idx;
+            m_last_egg_value = bi0.m_special_value;
         }
     }
 
-    m_collected_energy = (1- rd)*m_all_bonus_info[idx    ].m_nitro_amount
-                         +  rd  *m_all_bonus_info[idx + 1].m_nitro_amount;
+    m_collected_energy = (1- rd)*bi0.m_nitro_amount
+                         +  rd  *bi1.m_nitro_amount;
 
     // Graphical effects for nitro, zipper and skidding
-    getKartGFX()->setGFXFromReplay(m_all_replay_events[idx].m_nitro_usage,
-                                   m_all_replay_events[idx].m_zipper_usage,
-                                   m_all_replay_events[idx].m_skidding_effect,
-                                   m_all_replay_events[idx].m_red_skidding);
+    getKartGFX()->setGFXFromReplay(kre.m_nitro_usage, kre.m_zipper_usage,
+                                   kre.m_skidding_effect,
+                                   kre.m_red_skidding);
     getKartGFX()->update(dt);
 
     Vec3 front(0, 0, getKartLength()*0.5f);
     m_xyz_front = getTrans()(front);
 
-    if (m_all_replay_events[idx].m_jumping && !m_is_jumping)
+    if (kre.m_jumping && !m_is_jumping)
     {
         m_is_jumping = true;
         getKartModel()->setAnimation(KartModel::AF_JUMP_START);
     }
-    else if (!m_all_replay_events[idx].m_jumping && m_is_jumping)
+    else if (!kre.m_jumping && m_is_jumping)
     {
         m_is_jumping = false;
         getKartModel()->setAnimation(KartModel::AF_DEFAULT);
@@ -234,13 +257,13 @@ float GhostKart::getSpeed() const
     unsigned int current_index = gc->getCurrentReplayIndex();
     const float rd             = gc->getReplayDelta();
 
-    assert(gc->getCurrentReplayIndex() < m_all_physic_info.size());
+    assert(current_index < m_replay_events.getNumEvents());
 
-    if (current_index == m_all_physic_info.size())
-        return m_all_physic_info[current_index].m_speed;
+    if (current_index + 1 >= m_replay_events.getNumEvents())
+        return m_replay_events.getPhysicInfo(current_index).m_speed;
 
-    return (1-rd)*m_all_physic_info[current_index    ].m_speed
-           +  rd *m_all_physic_info[current_index + 1].m_speed;
+    return (1-rd)*m_replay_events.getPhysicInfo(current_index    ).m_speed
+           +  rd *m_replay_events.getPhysicInfo(current_index + 1).m_speed;
 }   // getSpeed
 
 // ----------------------------------------------------------------------------
@@ -274,7 +297,8 @@ float GhostKart::getTimeForDistance(float distance)
     int current_index = gc->getCurrentReplayIndex();
 
     // Second, get the current distance
-    float current_distance = m_all_replay_events[current_index].m_distance;
+    float current_distance =
+        m_replay_events.getKartReplayEvent(current_index).m_distance;
 
     // This determines in which direction we will search a matching frame
     bool search_forward = (current_distance < distance);
@@ -296,18 +320,19 @@ float GhostKart::getTimeForDistance(float distance)
     {
         // If we have reached the end of the replay file without finding the
         // searched distance, break
-        if (upper_frame_index >= m_all_replay_events.size() ||
+        if (upper_frame_index >= m_replay_events.getNumEvents() ||
             lower_frame_index < 0 )
             break;
 
         // The target distance was reached between those two frames
-        if (m_all_replay_events[lower_frame_index].m_distance <= distance &&
-            m_all_replay_events[upper_frame_index].m_distance >= distance )
+        const float lower_distance =
+            m_replay_events.getKartReplayEvent(lower_frame_index).m_distance;
+        const float upper_distance =
+            m_replay_events.getKartReplayEvent(upper_frame_index).m_distance;
+        if (lower_distance <= distance && upper_distance >= distance)
         {
-            float lower_diff =
-                distance - m_all_replay_events[lower_frame_index].m_distance;
-            float upper_diff =
-                m_all_replay_events[upper_frame_index].m_distance - distance;
+            float lower_diff = distance - lower_distance;
+            float upper_diff = upper_distance - distance;
 
             if ((lower_diff + upper_diff) == 0)
                 upper_ratio = 0.0f;
@@ -331,7 +356,7 @@ float GhostKart::getTimeForDistance(float distance)
 
     float ghost_time;
 
-    if (upper_frame_index >= m_all_replay_events.size() ||
+    if (upper_frame_index >= m_replay_events.getNumEvents() ||
         lower_frame_index < 0 )
         ghost_time = -1.0f;
     else
@@ -352,7 +377,8 @@ float GhostKart::getTimeForEggs(int egg_number)
     int current_index = gc->getCurrentReplayIndex();
 
     // Second, get the current egg number
-    int current_eggs = m_all_bonus_info[current_index].m_special_value;
+    int current_eggs =
+        m_replay_events.getBonusInfo(current_index).m_special_value;
 
     // This determines in which direction we will search a matching frame
     bool search_forward = (current_eggs < egg_number);
@@ -367,13 +393,15 @@ float GhostKart::getTimeForEggs(int egg_number)
     {
         // If we have reached the end of the replay file without finding the
         // searched distance, break
-        if (upper_frame_index >= m_all_bonus_info.size() ||
+        if (upper_frame_index >= m_replay_events.getNumEvents() ||
             lower_frame_index < 0 )
             break;
 
         // The target distance was reached between those two frames
-        if (m_all_bonus_info[lower_frame_index].m_special_value <  egg_number &&
-            m_all_bonus_info[upper_frame_index].m_special_value == egg_number)
+        if (m_replay_events.getBonusInfo(lower_frame_index).m_special_value
+                                                               <  egg_number &&
+            m_replay_events.getBonusInfo(upper_frame_index).m_special_value
+                                                               == egg_number)
         {
             break;
         }
@@ -392,7 +420,7 @@ float GhostKart::getTimeForEggs(int egg_number)
 
     float ghost_time;
 
-    if (upper_frame_index >= m_all_bonus_info.size() ||
+    if (upper_frame_index >= m_replay_events.getNumEvents() ||
         lower_frame_index < 0 )
         ghost_time = -1.0f;
     else
@@ -21,11 +21,12 @@
 
 #include "karts/kart.hpp"
 #include "replay/replay_base.hpp"
+#include "replay/replay_stream.hpp"
 #include "utils/cpp2011.hpp"
 
 #include "LinearMath/btTransform.h"
 
-#include <vector>
+#include <memory>
 
 /** \defgroup karts */
 
@@ -37,16 +38,16 @@
 class GhostKart : public Kart
 {
 private:
-    /** The transforms to assume at the corresponding time in m_all_times. */
-    std::vector<btTransform>                 m_all_transform;
+    /** The recorded events of this kart. */
+    ReplayStream                             m_replay_events;
 
-    std::vector<ReplayBase::PhysicInfo>      m_all_physic_info;
-
-    std::vector<ReplayBase::BonusInfo>       m_all_bonus_info;
+    unsigned int                             m_last_egg_idx = 0;
 
-    std::vector<ReplayBase::KartReplayEvent> m_all_replay_events;
+    /** Number of eggs at m_last_egg_idx. This is stored, since the event
+     *  might not be decoded anymore. */
+    int                                      m_last_egg_value = 0;
 
-    unsigned int                             m_last_egg_idx = 0;
+    void          setDefaultSuspension();
 
     // ----------------------------------------------------------------------------
     /** Compute the time at which the ghost finished the race */
@@ -56,6 +57,9 @@ public:
                   GhostKart(const std::string& ident, unsigned int world_kart_id,
                             int position, float color_hue);
     virtual void  update(int ticks) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** Ghost karts don't use the terrain information. */
+    virtual void  prefetchTerrainInfo() OVERRIDE {}
     virtual void  updateGraphics(float dt) OVERRIDE;
     virtual void  reset() OVERRIDE;
     // ------------------------------------------------------------------------
@@ -66,7 +70,10 @@ public:
     virtual void  createPhysics() OVERRIDE {};
     // ------------------------------------------------------------------------
     const float   getSuspensionLength(int index, int wheel) const
-               { return m_all_physic_info[index].m_suspension_length[wheel]; }
+    {
+        return m_replay_events.getPhysicInfo(index)
+                                                .m_suspension_length[wheel];
+    }
     // ------------------------------------------------------------------------
     void          addReplayEvent(float time,
                                  const btTransform &trans,
@@ -74,6 +81,12 @@ public:
                                  const ReplayBase::BonusInfo &bi,
                                  const ReplayBase::KartReplayEvent &kre);
     // ------------------------------------------------------------------------
+    void          setReplayFile(std::shared_ptr<ReplayStream::File> file,
+                                unsigned int kart);
+    // ------------------------------------------------------------------------
+    /** Returns the recorded events of this kart. */
+    const ReplayStream& getReplayEvents() const { return m_replay_events; }
+    // ------------------------------------------------------------------------
     /** Returns whether this kart is a ghost (replay) kart. */
     virtual bool  isGhostKart() const OVERRIDE { return true; }
     // ------------------------------------------------------------------------
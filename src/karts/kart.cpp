@@ -85,6 +85,7 @@
 #include "utils/log.hpp" //TODO: remove after debugging is done
 #include "utils/vs.hpp"
 #include "utils/profiler.hpp"
+#include "utils/subsystem_timer.hpp"
 
 #include <ICameraSceneNode.h>
 #include <ISceneManager.h>
@@ -1441,7 +1442,10 @@ void Kart::update(int ticks)
     // based on the collision speed.
     m_body->setRestitution(m_kart_properties->getRestitution(fabsf(m_speed)));
 
-    m_controller->update(ticks);
+    {
+        SUBSYSTEM_TIMER(AI);
+        m_controller->update(ticks);
+    }
 
 #ifndef SERVER_ONLY
 #undef DEBUG_CAMERA_SHAKE
@@ -1523,48 +1527,11 @@ void Kart::update(int ticks)
 
     m_attachment->update(ticks);
 
-    // Make sure that the ray doesn't hit the kart. This is done by
-    // resetting the collision filter group, so that this collision
-    // object is ignored during raycasting.
-    short int old_group = 0;
-    if (m_body->getBroadphaseHandle())
-    {
-        old_group = m_body->getBroadphaseHandle()->m_collisionFilterGroup;
-        m_body->getBroadphaseHandle()->m_collisionFilterGroup = 0;
-    }
-
-    // After the physics step was done, the position of the wheels (as stored
-    // in wheelInfo) is actually outdated, since the chassis was moved
-    // according to the force acting from the wheels. So the center of the
-    // chassis is not at the center of the wheels anymore, it is somewhat
-    // moved forward (depending on speed and fps). In very extreme cases
-    // (see bug 2246) the center of the chassis can actually be ahead of the
-    // front wheels. So if we do a raycast to detect the terrain from the
-    // current chassis, that raycast might be ahead of the wheels - which
-    // results in incorrect rescues (the wheels are still on the ground,
-    // but the raycast happens ahead of the front wheels and are over
-    // a rescue texture).
-    // To avoid this problem, we do the raycast for terrain detection from
-    // the center of the 4 wheel positions (in world coordinates).
-
-    Vec3 from(0.0f, 0.0f, 0.0f);
-    for (unsigned int i = 0; i < 4; i++)
-        from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
-
-    // Add a certain epsilon (0.3) to the height of the kart. This avoids
-    // problems of the ray being cast from under the track (which happened
-    // e.g. on tux tollway when jumping down from the ramp, when the chassis
-    // partly tunnels through the track). While tunneling should not be
-    // happening (since Z velocity is clamped), the epsilon is left in place
-    // just to be on the safe side (it will not hit the chassis itself).
-    from = from/4 + (getTrans().getBasis() * Vec3(0.0f, 0.3f, 0.0f));
-
-    m_terrain_info->update(getTrans().getBasis(), from);
-
-    if (m_body->getBroadphaseHandle())
-    {
-        m_body->getBroadphaseHandle()->m_collisionFilterGroup = old_group;
-    }
+    // The raycast only tests the track and the track objects, so it can't
+    // hit the kart itself. This uses the result of prefetchTerrainInfo if
+    // the kart was not moved since then.
+    m_terrain_info->update(getTrans().getBasis(),
+                           getTerrainRayStart(getTrans().getBasis()));
 
     // Check if a kart is (nearly) upside down and not moving much -->
     // automatic rescue
@@ -1723,7 +1690,10 @@ void Kart::update(int ticks)
     }   // if there is material
     PROFILER_POP_CPU_MARKER();
 
-    ItemManager::get()->checkItemHit(this);
+    {
+        SUBSYSTEM_TIMER(ITEMS);
+        ItemManager::get()->checkItemHit(this);
+    }
 
     const bool emergency = has_animation_before;
 
@@ -2571,6 +2541,59 @@ bool Kart::playCustomSFX(unsigned int type)
     return ret;
      */
 }
+
+// ----------------------------------------------------------------------------
+/** Returns the start point of the raycast that detects the terrain under the
+ *  kart.
+ *  \param rotation The rotation of the kart.
+ */
+Vec3 Kart::getTerrainRayStart(const btMatrix3x3 &rotation) const
+{
+    // After the physics step was done, the position of the wheels (as stored
+    // in wheelInfo) is actually outdated, since the chassis was moved
+    // according to the force acting from the wheels. So the center of the
+    // chassis is not at the center of the wheels anymore, it is somewhat
+    // moved forward (depending on speed and fps). In very extreme cases
+    // (see bug 2246) the center of the chassis can actually be ahead of the
+    // front wheels. So if we do a raycast to detect the terrain from the
+    // current chassis, that raycast might be ahead of the wheels - which
+    // results in incorrect rescues (the wheels are still on the ground,
+    // but the raycast happens ahead of the front wheels and are over
+    // a rescue texture).
+    // To avoid this problem, we do the raycast for terrain detection from
+    // the center of the 4 wheel positions (in world coordinates).
+
+    Vec3 from(0.0f, 0.0f, 0.0f);
+    for (unsigned int i = 0; i < 4; i++)
+        from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
+
+    // Add a certain epsilon (0.3) to the height of the kart. This avoids
+    // problems of the ray being cast from under the track (which happened
+    // e.g. on tux tollway when jumping down from the ramp, when the chassis
+    // partly tunnels through the track). While tunneling should not be
+    // happening (since Z velocity is clamped), the epsilon is left in place
+    // just to be on the safe side (it will not hit the chassis itself).
+    return from/4 + (rotation * Vec3(0.0f, 0.3f, 0.0f));
+}   // getTerrainRayStart
+
+// ----------------------------------------------------------------------------
+/** Does the terrain raycast of update() in advance, based on the position
+ *  the kart will have after Moveable::update. If the kart is not moved
+ *  differently before the raycast in update() (e.g. by an animation), the
+ *  result is used there. Since the raycast only tests the track and the
+ *  track objects (not the karts), this can be done for all karts in
+ *  parallel.
+ */
+void Kart::prefetchTerrainInfo()
+{
+    // Same as in Moveable::update
+    btTransform trans = getTrans();
+    if (m_body->getInvMass() != 0)
+        m_motion_state->getWorldTransform(trans);
+    m_terrain_info->prefetch(trans.getBasis(),
+                             getTerrainRayStart(trans.getBasis()));
+}   // prefetchTerrainInfo
+
 // ----------------------------------------------------------------------------
 /** Updates the physics for this kart: computing the driving force, set
  *  steering, handles skidding, terrain impact on kart, ...
@@ -285,6 +285,7 @@ protected:
     void          playCrashSFX(const Material* m, AbstractKart *k);
     void          loadData(RaceManager::KartType type, bool animatedModel);
     void          updateWeight();
+    Vec3          getTerrainRayStart(const btMatrix3x3 &rotation) const;
 public:
                    Kart(const std::string& ident, unsigned int world_kart_id,
                         int position, const btTransform& init_transform,
@@ -538,6 +539,8 @@ public:
         return m_terrain_info;
     }
     // ------------------------------------------------------------------------
+    virtual void prefetchTerrainInfo() OVERRIDE;
+    // ------------------------------------------------------------------------
     virtual void setOnScreenText(const wchar_t *text) OVERRIDE;
     // ------------------------------------------------------------------------
     /** Returns the normal of the terrain the kart is over atm. This is
@@ -36,6 +36,8 @@
 #include "physics/btKart.hpp"
 #include "utils/vec3.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <string.h>
 
 KartRewinder::KartRewinder(const std::string& ident,
@@ -146,21 +148,18 @@ void KartRewinder::computeError()
 }   // computeError
 
 // ----------------------------------------------------------------------------
-/** Saves all state information for a kart in a memory buffer. The memory
- *  is allocated here and the address returned. It will then be managed
- *  by the RewindManager.
+/** Saves all state information for a kart in a memory buffer.
+ *  \param buffer The buffer to append the state to.
  *  \param[out] ru The unique identity of rewinder writing to.
- *  \return The address of the memory buffer with the state.
+ *  \return False if the kart is eliminated and no state is saved.
  */
-BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
+bool KartRewinder::saveState(BareNetworkString* buffer,
+                             std::vector<std::string>* ru)
 {
     if (m_eliminated)
-        return nullptr;
+        return false;
 
     ru->push_back(getUniqueIdentity());
-    const int MEMSIZE = 17*sizeof(float) + 9+3;
-
-    BareNetworkString *buffer = new BareNetworkString(MEMSIZE);
 
     // 1) Firing and related handling
     // -----------
@@ -227,7 +226,7 @@ BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
     // -----------
     m_skidding->saveState(buffer);
 
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -358,6 +357,55 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
 
 }   // restoreState
 
+// ----------------------------------------------------------------------------
+/** Checks if the state from the server differs from the state this client
+ *  predicted. The transform and velocities are allowed to differ by a small
+ *  amount (see stk_config), everything else must be identical.
+ *  \param buffer The buffer with the state from the server.
+ *  \param count Number of bytes of the state.
+ *  \param predicted The state saved by this client, or NULL.
+ */
+bool KartRewinder::hasDiverged(BareNetworkString *buffer, int count,
+                               const BareNetworkString *predicted)
+{
+    if (!predicted || (int)predicted->size() != count)
+        return true;
+
+    // 1) Firing and related handling. A kart animation is not predicted
+    // exactly, so always rewind in this case
+    // -----------
+    if (buffer->getUInt16() != predicted->getUInt16())
+        return true;
+    uint16_t fire_and_invulnerable = buffer->getUInt16();
+    if (fire_and_invulnerable != predicted->getUInt16() ||
+        ((fire_and_invulnerable >> 14) & 1) == 1)
+        return true;
+    if (((fire_and_invulnerable >> 13) & 1) == 1 &&
+        buffer->getUInt16() != predicted->getUInt16())
+        return true;
+
+    // 2) Transform and velocities
+    // -----------
+    if ((buffer->getVec3() - predicted->getVec3()).length() >
+        stk_config->m_skip_rewind_position)
+        return true;
+    // The angle between two rotations is 2*acos(|q1.q2|)
+    float dot = fabsf(buffer->getQuat().dot(predicted->getQuat()));
+    if (2.0f * acosf(std::min(dot, 1.0f)) > stk_config->m_skip_rewind_rotation)
+        return true;
+    if ((buffer->getVec3() - predicted->getVec3()).length() >
+        stk_config->m_skip_rewind_velocity)
+        return true;
+    if ((buffer->getVec3() - predicted->getVec3()).length() >
+        stk_config->m_skip_rewind_angular_velocity)
+        return true;
+
+    // 3) All other values
+    // -----------
+    return memcmp(buffer->getCurrentData(), predicted->getCurrentData(),
+                  predicted->size()) != 0;
+}   // hasDiverged
+
 // ----------------------------------------------------------------------------
 /** Called once a frame. It will add a new kart control event to the rewind
  *  manager if any control values have changed.
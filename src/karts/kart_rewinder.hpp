@@ -43,10 +43,12 @@ public:
     ~KartRewinder() {}
     virtual void saveTransform() OVERRIDE;
     virtual void computeError() OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) OVERRIDE;
     void reset() OVERRIDE;
     virtual void restoreState(BareNetworkString *p, int count) OVERRIDE;
+    virtual bool hasDiverged(BareNetworkString *buffer, int count,
+                             const BareNetworkString *predicted) OVERRIDE;
     virtual void rewindToEvent(BareNetworkString *p) OVERRIDE {}
     virtual void update(int ticks) OVERRIDE;
     // -------------------------------------------------------------------------
@@ -76,6 +78,14 @@ public:
     virtual void undoEvent(BareNetworkString *p) OVERRIDE {}
     // ------------------------------------------------------------------------
     virtual std::function<void()> getLocalStateRestoreFunction() OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual bool getRelevancePosition(Vec3* xyz) const OVERRIDE
+    {
+        if (m_eliminated)
+            return false;
+        *xyz = getXYZ();
+        return true;
+    }
 
 
 };   // Rewinder
@@ -158,9 +158,11 @@
 #  endif
 #else
 #  include <signal.h>
+#  include <sys/wait.h>
 #  include <unistd.h>
 #endif
 #include <stdexcept>
+#include <cerrno>
 #include <cstdio>
 #include <string>
 #include <cstring>
@@ -224,6 +226,7 @@
 #include "network/server.hpp"
 #include "network/server_config.hpp"
 #include "network/servers_manager.hpp"
+#include "network/state_delta.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "online/profile_manager.hpp"
@@ -231,9 +234,13 @@
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
+#include "race/history_log.hpp"
+#include "race/history_simulation.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_binary.hpp"
 #include "replay/replay_play.hpp"
 #include "replay/replay_recorder.hpp"
+#include "replay/replay_stream.hpp"
 #include "states_screens/main_menu_screen.hpp"
 #include "states_screens/online/networking_lobby.hpp"
 #include "states_screens/online/register_screen.hpp"
@@ -247,16 +254,32 @@
 #include "utils/command_line.hpp"
 #include "utils/constants.hpp"
 #include "utils/crash_reporting.hpp"
+#include "utils/histogram.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
+#include "utils/memory_pool.hpp"
 #include "utils/mini_glm.hpp"
+#include "utils/mpsc_queue.hpp"
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
+#include "utils/worker_pool.hpp"
 
 static void cleanSuperTuxKart();
 static void cleanUserConfig();
 void runUnitTests();
 
+/** Server configs of the additional lobbies (see forkLobbies). */
+static std::vector<std::string> g_lobby_configs;
+
+/** True in a lobby forked from the original process. */
+static bool g_forked_lobby = false;
+
+#ifndef WIN32
+/** Process ids of the forked lobbies, which are reaped in the original
+ *  process when they exit (see reapLobbies). */
+static std::vector<pid_t> g_lobby_pids;
+#endif
+
 // ============================================================================
 //                        gamepad visualisation screen
 // ============================================================================
@@ -584,6 +607,10 @@ void cmdLineHelp()
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --profile-ticks=n  Enable automatic driven profile mode for n "
+                              "ticks and write\n"
+    "                          the timings of the simulation as JSON (use with\n"
+    "                          --no-graphics and --seed for a benchmark).\n"
     "       --unlock-all       Permanently unlock all karts and tracks for testing.\n"
     "       --no-unlock-all    Disable unlock-all (i.e. base unlocking on player achievement).\n"
     "       --no-graphics      Do not display the actual race.\n"
@@ -594,6 +621,13 @@ void cmdLineHelp()
     "                          spaces are allowed in the track names.\n"
     "       --demo-laps=n      Number of laps to use in a demo.\n"
     "       --demo-karts=n     Number of karts to use in a demo.\n"
+    "       --convert-replay=in,out Convert the text replay file 'in' into a\n"
+    "                          binary replay 'out' (or a binary one into text)\n"
+    "                          and exit.\n"
+    "       --simulate-history=file Simulate a race recorded by a server (see\n"
+    "                          record-history) as fast as possible, compare it\n"
+    "                          with the recorded states and exit (use with\n"
+    "                          --no-graphics).\n"
     // "       --history          Replay history file 'history.dat'.\n"
     // "       --test-ai=n        Use the test-ai for every n-th AI kart.\n"
     // "                          (so n=1 means all Ais will be the test ai)\n"
@@ -603,7 +637,15 @@ void cmdLineHelp()
     // "    --network-item-debugging Print item handling debug information.\n"
     "       --server-config=file Specify the server_config.xml for server hosting, it will create\n"
     "                            one if not found.\n"
+    "       --lobby-configs=f1,f2 Host an additional server for each of the given\n"
+    "                            server configs, sharing the loaded data (with --server-config).\n"
+    "                            Server options like --port must be set in the configs.\n"
     "       --network-console  Enable network console.\n"
+    "       --rewind-stats     Write statistics of all rewinds of a client at the\n"
+    "                          end of a race.\n"
+    "       --queue-benchmark  Measure the thread handoff of network data and exit.\n"
+    "       --send-benchmark   Measure the parallel encryption of packets for many\n"
+    "                          peers and exit.\n"
     "       --wan-server=name  Start a Wan server (not a playing client).\n"
     "       --public-server    Allow direct connection to the server (without stk server)\n"
     "       --lan-server=name  Start a LAN server (not a playing client).\n"
@@ -946,6 +988,26 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     if (CommandLine::has("--unit-testing"))
         UserConfigParams::m_unit_testing = true;
+    if (CommandLine::has("--queue-benchmark"))
+    {
+        MPSCQueueTest::benchmark();
+        exit(0);
+    }
+    if (CommandLine::has("--send-benchmark"))
+    {
+        STKHost::sendBenchmark();
+        exit(0);
+    }
+    if (CommandLine::has("--convert-replay", &s))
+    {
+        std::vector<std::string> files = StringUtils::split(s, ',');
+        if (files.size() != 2)
+        {
+            Log::error("main", "Use --convert-replay=in,out");
+            exit(1);
+        }
+        exit(ReplayPlay::get()->convertReplayFile(files[0], files[1]) ? 0 : 1);
+    }
     if (CommandLine::has("--gamepad-debug"))
         UserConfigParams::m_gamepad_debug=true;
     if (CommandLine::has("--keyboard-debug"))
@@ -1176,7 +1238,8 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         }
     }
 
-    if (CommandLine::has("--network-console"))
+    // Only the original process reads from the console
+    if (CommandLine::has("--network-console") && !g_forked_lobby)
     {
         ServerConfig::m_enable_console = true;
         STKHost::m_enable_console = true;
@@ -1192,6 +1255,9 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     if (CommandLine::has("--network-item-debugging"))
         NetworkItemManager::m_network_item_debugging = true;
+
+    if (CommandLine::has("--rewind-stats"))
+        RewindManager::setWriteStatistics(true);
     
     std::string server_password;
     if (CommandLine::has("--server-password", &s))
@@ -1563,6 +1629,19 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--profile-ticks",  &n))
+    {
+        if (n <= 0)
+        {
+            Log::error("main", "Invalid number of profile-ticks: %i.", n );
+            return 0;
+        }
+        Log::verbose("main", "Profiling %d ticks.", n);
+        UserConfigParams::m_no_start_screen = true;
+        ProfileWorld::setProfileModeTicks(n);
+        race_manager->setNumLaps(999999); // profile end depends on ticks
+    }   // --profile-ticks
+
     if(CommandLine::has("--history"))
     {
         history->setReplayHistory(true);
@@ -1572,6 +1651,12 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
             UserConfigParams::m_no_start_screen = true;
     }   // --history
 
+    if (CommandLine::has("--simulate-history"))
+    {
+        // Like --history, this skips the menu screens
+        UserConfigParams::m_no_start_screen = true;
+    }   // --simulate-history
+
     // Demo mode
     if(CommandLine::has("--demo-mode", &s))
     {
@@ -1697,7 +1782,9 @@ void initRest()
     // The rest will be read later (since the rest needs the unlock- and
     // achievement managers to be created, which can only be created later).
     PlayerManager::create();
-    Online::RequestManager::get()->startNetworkThread();
+    // Threads do not survive forking lobbies, so it is started afterwards
+    if (g_lobby_configs.empty())
+        Online::RequestManager::get()->startNetworkThread();
 #ifndef SERVER_ONLY
     if (!ProfileWorld::isNoGraphics())
         NewsManager::get();   // this will create the news manager
@@ -1838,6 +1925,80 @@ void main_abort()
 }
 #endif
 
+// ----------------------------------------------------------------------------
+#ifndef WIN32
+/** SIGCHLD handler of the original process, which reaps lobbies that have
+ *  exited (see forkLobbies). */
+static void reapLobbies(int signum)
+{
+    const int saved_errno = errno;
+    // Reaped pids are set to 0, since they can be reused by the system
+    for (pid_t& pid : g_lobby_pids)
+    {
+        if (pid > 0 && waitpid(pid, NULL, WNOHANG) == pid)
+            pid = 0;
+    }
+    errno = saved_errno;
+}   // reapLobbies
+#endif
+
+// ----------------------------------------------------------------------------
+/** Starts a server process for each config given with --lobby-configs. The
+ *  processes are forked after karts, materials and models are loaded, so
+ *  this data is shared (copy on write) by all lobbies instead of being
+ *  loaded by each server. Only the forking thread exists in the child
+ *  processes, so this must be called before any thread is started: it is
+ *  only supported for servers without graphics (which have no sound thread),
+ *  and the network thread is started afterwards.
+ *  \return True in a forked lobby, false in the original process.
+ */
+bool forkLobbies()
+{
+#ifndef WIN32
+    if (!ProfileWorld::isNoGraphics() || UserConfigParams::m_enable_sound)
+    {
+        Log::error("main", "Lobbies can only be forked by a server without "
+                   "graphics and sound.");
+        return false;
+    }
+    Log::flushBuffers();
+    const unsigned parent_pid = (unsigned)getpid();
+    for (const std::string& config : g_lobby_configs)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            Log::error("main", "Could not start lobby for '%s'.",
+                       config.c_str());
+            continue;
+        }
+        if (pid > 0)
+        {
+            Log::info("main", "Started lobby for '%s' with pid %d.",
+                      config.c_str(), pid);
+            g_lobby_pids.push_back(pid);
+            continue;
+        }
+        g_lobby_pids.clear();
+        Log::closeOutputFiles();
+        FileManager::setStdoutName(StringUtils::removeExtension(
+            StringUtils::getBasename(config)) + ".log");
+        file_manager->redirectOutput();
+        ServerConfig::loadServerConfig(config);
+        // Exit when the original process exits
+        main_loop->setParentPid(parent_pid);
+        g_forked_lobby = true;
+        return true;
+    }
+    // Only the lobbies are waited for, so waitpid can still be used for
+    // other child processes (e.g. in SeparateProcess), which SIG_IGN for
+    // SIGCHLD would break. Lobbies which exited already are reaped now.
+    signal(SIGCHLD, reapLobbies);
+    reapLobbies(SIGCHLD);
+#endif
+    return false;
+}   // forkLobbies
+
 // ----------------------------------------------------------------------------
 int main(int argc, char *argv[] )
 {
@@ -1869,6 +2030,18 @@ int main(int argc, char *argv[] )
             }
         }
 
+        if (CommandLine::has("--lobby-configs", &s))
+        {
+#ifdef WIN32
+            Log::error("main", "--lobby-configs is not supported on Windows.");
+#else
+            if (server_config.empty())
+                Log::error("main", "--lobby-configs needs --server-config.");
+            else
+                g_lobby_configs = StringUtils::split(s, ',');
+#endif
+        }
+
         if(CommandLine::has("--root", &s))
             FileManager::addRootDirs(s);
         if (CommandLine::has("--stdout", &s))
@@ -1893,6 +2066,34 @@ int main(int argc, char *argv[] )
         // ServerConfig will use stk_config for server version testing
         stk_config->load(file_manager->getAsset("stk_config.xml"));
         bool no_graphics = !CommandLine::has("--graphical-server");
+        // Graphics and sound start threads, which do not survive forking
+        if (!no_graphics && !g_lobby_configs.empty())
+        {
+            Log::error("main", "--lobby-configs is not supported with "
+                       "--graphical-server.");
+            g_lobby_configs.clear();
+        }
+        // These options are handled after forking, so they would override
+        // the configs of all lobbies (e.g. all of them would use one port)
+        static const char* const server_options[] =
+        {
+            "--difficulty", "--mode", "--soccer-timed", "--soccer-goals",
+            "--network-gp", "--battle-mode", "--server-password", "--motd",
+            "--team-choosing", "--no-team-choosing", "--ranked",
+            "--no-ranked", "--auto-end", "--no-auto-end", "--owner-less",
+            "--no-owner-less", "--firewalled-server",
+            "--no-firewalled-server", "--server-id-file", "--max-players",
+            "--min-players", "--port"
+        };
+        for (const char* option : server_options)
+        {
+            if (!g_lobby_configs.empty() && CommandLine::contains(option))
+            {
+                Log::error("main", "--lobby-configs can't be used with %s, "
+                           "set it in the server configs instead.", option);
+                g_lobby_configs.clear();
+            }
+        }
         // Load current server config first, if any option is specified than
         // override it later
         // Disable sound if found server-config or wan/lan server name
@@ -2012,6 +2213,13 @@ int main(int argc, char *argv[] )
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                           "banana.png")    );
 
+        if (!g_lobby_configs.empty())
+        {
+            if (forkLobbies())
+                has_parent_process = true;
+            Online::RequestManager::get()->startNetworkThread();
+        }
+
         //handleCmdLine() needs InitTuxkart() so it can't be called first
         if (!handleCmdLine(!server_config.empty(), has_parent_process))
             exit(0);
@@ -2190,6 +2398,16 @@ int main(int argc, char *argv[] )
         }
 #endif
 
+        // Simulate a race recorded by a server
+        // =====================================
+        if (CommandLine::has("--simulate-history", &s))
+        {
+            HistorySimulation simulation;
+            bool ok = simulation.run(s);
+            Log::flushBuffers();
+            exit(ok ? 0 : 1);
+        }
+
         // Replay a race
         // =============
         if(history->replayHistory())
@@ -2415,12 +2633,28 @@ void runUnitTests()
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "MiniGLM");
     MiniGLM::unitTesting();
+    Log::info("UnitTest", "MemoryPool");
+    MemoryPool::unitTesting();
+    Log::info("UnitTest", "Histogram");
+    Histogram::unitTesting();
+    Log::info("UnitTest", "WorkerPool");
+    WorkerPool::unitTesting();
+    Log::info("UnitTest", "MPSCQueue");
+    MPSCQueueTest::unitTesting();
     Log::info("UnitTest", "GraphicsRestrictions");
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
     Log::info("UnitTest", "TransportAddress");
     TransportAddress::unitTesting();
+    Log::info("UnitTest", "StateDelta");
+    StateDelta::unitTesting();
+    Log::info("UnitTest", "HistoryLog");
+    HistoryLog::unitTesting();
+    Log::info("UnitTest", "ReplayBinary");
+    ReplayBinary::unitTesting();
+    Log::info("UnitTest", "ReplayStream");
+    ReplayStream::unitTesting();
 
     Log::info("UnitTest", "Easter detection");
     // Test easter mode: in 2015 Easter is 5th of April - check with 0 days
@@ -2462,6 +2696,9 @@ void runUnitTests()
     Log::info("UnitTest", "Arena Graph");
     ArenaGraph::unitTesting();
 
+    Log::info("UnitTest", "Graph spatial index");
+    Graph::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
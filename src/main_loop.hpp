@@ -65,6 +65,9 @@ public:
     // ------------------------------------------------------------------------
     void setFrameBeforeLoadingWorld()  { m_frame_before_loading_world = true; }
     // ------------------------------------------------------------------------
+    /** Sets the process which, when it exits, stops this process as well. */
+    void setParentPid(unsigned parent_pid)      { m_parent_pid = parent_pid; }
+    // ------------------------------------------------------------------------
     void setTicksAdjustment(int ticks)
     {
         m_ticks_adjustment.lock();
@@ -28,11 +28,11 @@
 // Position offset to attach in kart model
 const Vec3 g_kart_flag_offset(0.0, 0.2f, -0.5f);
 // ============================================================================
-BareNetworkString* CTFFlag::saveState(std::vector<std::string>* ru)
+bool CTFFlag::saveState(BareNetworkString* buffer,
+                        std::vector<std::string>* ru)
 {
     using namespace MiniGLM;
     ru->push_back(getUniqueIdentity());
-    BareNetworkString* buffer = new BareNetworkString();
     buffer->addUInt8(m_flag_status);
     if (m_flag_status == OFF_BASE)
     {
@@ -43,7 +43,7 @@ BareNetworkString* CTFFlag::saveState(std::vector<std::string>* ru)
             compressVector3(Vec3(normal.normalize()).toIrrVector()));
         buffer->addUInt16(m_ticks_since_off_base);
     }
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
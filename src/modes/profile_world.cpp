@@ -23,16 +23,20 @@
 #include "graphics/irr_driver.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "io/file_manager.hpp"
 #include "tracks/track.hpp"
+#include "utils/subsystem_timer.hpp"
 
 #include <ISceneManager.h>
 
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
+int   ProfileWorld::m_num_ticks   = 0;
 bool  ProfileWorld::m_no_graphics = false;
 
 //-----------------------------------------------------------------------------
@@ -49,6 +53,7 @@ ProfileWorld::ProfileWorld()
     race_manager->setNumLaps(m_num_laps);
     setPhase(RACE_PHASE);
     m_frame_count      = 0;
+    m_ticks            = 0;
     m_start_time       = irr_driver->getRealTime();
     m_num_triangles    = 0;
     m_num_culls        = 0;
@@ -66,6 +71,7 @@ ProfileWorld::ProfileWorld()
 ProfileWorld::~ProfileWorld()
 {
     m_profile_mode = PROFILE_NONE;
+    SubsystemTimer::setEnabled(false);
 }
 
 //-----------------------------------------------------------------------------
@@ -92,6 +98,20 @@ void ProfileWorld::setProfileModeLaps(int laps)
     m_num_laps     = laps;
 }   // setProfileModeLaps
 
+//-----------------------------------------------------------------------------
+/** Enables profiling for a fixed number of ticks, which (together with
+ *  --no-graphics and --seed) gives reproducible results that can be used
+ *  as a benchmark of the simulation. The time spent in the various
+ *  subsystems is measured and written as JSON at the end.
+ *  \param ticks Number of ticks to simulate.
+ */
+void ProfileWorld::setProfileModeTicks(int ticks)
+{
+    m_profile_mode = PROFILE_TICKS;
+    m_num_laps     = 99999;
+    m_num_ticks    = ticks;
+}   // setProfileModeTicks
+
 //-----------------------------------------------------------------------------
 /** Creates a kart, having a certain position, starting location, and local
  *  and global player id (if applicable).
@@ -136,6 +156,9 @@ bool ProfileWorld::isRaceOver()
     if(m_profile_mode==PROFILE_TIME)
         return getTime()>m_time;
 
+    if(m_profile_mode==PROFILE_TICKS)
+        return m_ticks>=m_num_ticks;
+
     if(m_profile_mode == PROFILE_LAPS )
     {
         // Now it must be laps based profiling:
@@ -152,7 +175,17 @@ bool ProfileWorld::isRaceOver()
  */
 void ProfileWorld::update(int ticks)
 {
-    StandardRace::update(ticks);
+    if (m_profile_mode == PROFILE_TICKS && m_ticks == 0)
+    {
+        // Only measure the race, not the loading of the world
+        SubsystemTimer::reset();
+        SubsystemTimer::setEnabled(true);
+    }
+    {
+        SUBSYSTEM_TIMER(WORLD_UPDATE);
+        StandardRace::update(ticks);
+    }
+    m_ticks += ticks;
 
     m_frame_count++;
     video::IVideoDriver *driver = irr_driver->getVideoDriver();
@@ -167,6 +200,42 @@ void ProfileWorld::update(int ticks)
 
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Writes the timings of a ticks based profile run to
+ *  <stdout name>.benchmark.json in the config directory.
+ */
+void ProfileWorld::writeBenchmark() const
+{
+    SubsystemTimer::setEnabled(false);
+    double update_time =
+        SubsystemTimer::getTime(SubsystemTimer::ST_WORLD_UPDATE);
+    double ticks_per_second = update_time > 0 ? m_ticks / update_time : 0;
+
+    std::string name =
+        file_manager->getUserConfigFile(file_manager->getStdoutName()) +
+        ".benchmark.json";
+    std::ofstream json(name);
+    json << "{\n  \"track\": \"" << Track::getCurrentTrack()->getIdent()
+         << "\",\n  \"karts\": " << m_karts.size()
+         << ",\n  \"ticks\": " << m_ticks
+         << ",\n  \"ticks-per-second\": " << ticks_per_second << ",\n";
+    SubsystemTimer::writeJSON(json, m_ticks);
+    json << "\n}\n";
+    json.close();
+
+    if (SubsystemTimer::countsAllocations())
+    {
+        Log::info("profile", "%d ticks, %f ticks per second, %d allocations, "
+                  "written to '%s'.", m_ticks, ticks_per_second,
+                  (int)SubsystemTimer::getAllocations(), name.c_str());
+    }
+    else
+    {
+        Log::info("profile", "%d ticks, %f ticks per second, written to "
+                  "'%s'.", m_ticks, ticks_per_second, name.c_str());
+    }
+}   // writeBenchmark
+
 //-----------------------------------------------------------------------------
 /** This function is called when the race is finished, but end-of-race
  *  animations have still to be played. In the case of profiling,
@@ -178,7 +247,7 @@ void ProfileWorld::enterRaceOverState()
     // aborting too early). So in this case determine the maximum number
     // of laps and set this +1 as the number of laps to get more meaningful
     // time estimations.
-    if(m_profile_mode==PROFILE_TIME)
+    if(m_profile_mode==PROFILE_TIME || m_profile_mode==PROFILE_TICKS)
     {
         int max_laps = -2;
         for(unsigned int i=0; i<race_manager->getNumberOfKarts(); i++)
@@ -204,6 +273,9 @@ void ProfileWorld::enterRaceOverState()
     Log::verbose("profile", "Number of frames: %d time %f, Average FPS: %f",
                  m_frame_count, runtime, (float)m_frame_count/runtime);
 
+    if (m_profile_mode == PROFILE_TICKS)
+        writeBenchmark();
+
     // Print geometry statistics if we're not in no-graphics mode
     if(!m_no_graphics)
     {
@@ -31,7 +31,8 @@ class ProfileWorld : public StandardRace
 {
 private:
     /** Profiling modes. */
-    enum        ProfileType {PROFILE_NONE, PROFILE_TIME, PROFILE_LAPS};
+    enum        ProfileType {PROFILE_NONE, PROFILE_TIME, PROFILE_LAPS,
+                             PROFILE_TICKS};
 
     /** If profiling is done, and if so, which mode. */
     static ProfileType m_profile_mode;
@@ -43,6 +44,12 @@ private:
     /** In time based profiling only: time to run. */
     static float m_time;
 
+    /** In ticks based profiling only: number of ticks to run. */
+    static int   m_num_ticks;
+
+    /** Number of ticks simulated. */
+    int          m_ticks;
+
     /** Return value of real time at start of race. */
     unsigned int m_start_time;
 
@@ -67,6 +74,8 @@ private:
     /** Number of calls to draw. */
     long long    m_num_calls;
 
+    void writeBenchmark() const;
+
 protected:
     /** In laps based profiling: number of laps to run. Also
      *  used by DemoWorld. */
@@ -88,6 +97,7 @@ public:
 
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
+    static   void setProfileModeTicks(int ticks);
     // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
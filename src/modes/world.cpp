@@ -79,6 +79,8 @@
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/subsystem_timer.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <algorithm>
 #include <assert.h>
@@ -141,6 +143,10 @@ World::World() : WorldStatus()
 
     m_stop_music_when_dialog_open = true;
 
+    unsigned workers = WorkerPool::getDefaultThreads(/*max_threads*/3);
+    if (workers > 0)
+        m_kart_workers.reset(new WorkerPool(workers, "KartUpdate"));
+
     WorldStatus::setClockMode(CLOCK_CHRONO);
 
 }   // World
@@ -1089,7 +1095,11 @@ void World::update(int ticks)
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (Track object manager)", 0x20, 0x7F, 0x40);
-    Track::getCurrentTrack()->getTrackObjectManager()->update(stk_config->ticks2Time(ticks));
+    {
+        SUBSYSTEM_TIMER(TRACK_OBJECTS);
+        Track::getCurrentTrack()->getTrackObjectManager()
+                                ->update(stk_config->ticks2Time(ticks));
+    }
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
@@ -1098,21 +1108,39 @@ void World::update(int ticks)
     // which causes all AI steering commands set. So in the following 
     // physics update the new steering is taken into account.
     const int kart_amount = (int)m_karts.size();
-    for (int i = 0 ; i < kart_amount; ++i)
-    {
-        SpareTireAI* sta =
-            dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
-        // Update all karts that are not eliminated
-        if(!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
-            m_karts[i]->update(ticks);
-        if (isStartPhase())
-            m_karts[i]->makeKartRest();
+    {
+        SUBSYSTEM_TIMER(KART_UPDATE);
+        // Do the terrain raycasts of all karts in parallel first. Each kart
+        // uses the result of its raycast in the (sequential) update if it
+        // didn't move before its raycast, otherwise the raycast is repeated,
+        // so the result is the same as without this.
+        if (m_kart_workers)
+        {
+            m_kart_workers->parallelFor(kart_amount, [this](unsigned i)
+                {
+                    if (!m_karts[i]->isEliminated())
+                        m_karts[i]->prefetchTerrainInfo();
+                });
+        }
+        for (int i = 0 ; i < kart_amount; ++i)
+        {
+            SpareTireAI* sta =
+                dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
+            // Update all karts that are not eliminated
+            if(!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
+                m_karts[i]->update(ticks);
+            if (isStartPhase())
+                m_karts[i]->makeKartRest();
+        }
     }
     PROFILER_POP_CPU_MARKER();
     if(race_manager->isRecordingRace()) ReplayRecorder::get()->update(ticks);
 
     PROFILER_PUSH_CPU_MARKER("World::update (projectiles)", 0xa0, 0x7F, 0x00);
-    projectile_manager->update(ticks);
+    {
+        SUBSYSTEM_TIMER(PROJECTILES);
+        projectile_manager->update(ticks);
+    }
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (physics)", 0xa0, 0x7F, 0x00);
@@ -46,6 +46,7 @@ class btRigidBody;
 class Controller;
 class ItemState;
 class PhysicalObject;
+class WorkerPool;
 
 namespace Scripting
 {
@@ -112,6 +113,10 @@ protected:
     KartList                  m_karts;
     RandomGenerator           m_random;
 
+    /** Threads which do the terrain raycasts of all karts in parallel before
+     *  the karts are updated. */
+    std::unique_ptr<WorkerPool> m_kart_workers;
+
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
     int         m_eliminated_karts;
@@ -19,6 +19,7 @@
 #ifdef ENABLE_CRYPTO_NETTLE
 
 #include "network/crypto_nettle.hpp"
+#include "network/network.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
 
@@ -101,10 +102,8 @@ bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 {
     // 4 bytes counter and 4 bytes tag
-    ENetPacket* p = enet_packet_create(NULL, ns.m_buffer.size() + 8,
-        (reliable ? ENET_PACKET_FLAG_RELIABLE :
-        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT))
-        );
+    ENetPacket* p = Network::createPacket(NULL, ns.m_buffer.size() + 8,
+        reliable);
     if (p == NULL)
         return NULL;
 
@@ -23,6 +23,7 @@
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "network/transport_address.hpp"
+#include "utils/memory_pool.hpp"
 #include "utils/time.hpp"
 
 #include <string.h>
@@ -189,6 +190,53 @@ void Network::broadcastPacket(NetworkString *data, bool reliable)
     enet_host_broadcast(m_host, 0, packet);
 }   // broadcastPacket
 
+// ----------------------------------------------------------------------------
+namespace
+{
+    /** Returns the pool for the data of sent packets, which saves one
+     *  allocation per packet. It is never freed, since enet can destroy
+     *  packets after the network is shut down. */
+    MemoryPool* getPacketDataPool()
+    {
+        static MemoryPool* pool = new MemoryPool(/*granularity*/256,
+            /*num_size_classes*/16, /*max_free_blocks*/1024);
+        return pool;
+    }   // getPacketDataPool
+
+    // ------------------------------------------------------------------------
+    /** Called by enet when a packet created by createPacket is destroyed. */
+    void freePacketData(ENetPacket* packet)
+    {
+        getPacketDataPool()->deallocate(packet->data, packet->dataLength);
+    }   // freePacketData
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Creates a packet to send, with its data taken from a pool of reused
+ *  buffers. This can be called from any thread.
+ *  \param data The data to copy into the packet, or NULL to only allocate
+ *         the data (which the caller then fills in).
+ *  \param size Size of the data.
+ *  \param reliable If the packet is sent reliable.
+ */
+ENetPacket* Network::createPacket(const uint8_t* data, size_t size,
+                                  bool reliable)
+{
+    void* buffer = getPacketDataPool()->allocate(size);
+    ENetPacket* packet = enet_packet_create(buffer, size,
+        ENET_PACKET_FLAG_NO_ALLOCATE | (reliable ? ENET_PACKET_FLAG_RELIABLE :
+        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
+    if (!packet)
+    {
+        getPacketDataPool()->deallocate(buffer, size);
+        return NULL;
+    }
+    packet->freeCallback = freePacketData;
+    if (data)
+        memcpy(packet->data, data, size);
+    return packet;
+}   // createPacket
+
 // ----------------------------------------------------------------------------
 void Network::openLog()
 {
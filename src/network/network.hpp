@@ -70,6 +70,8 @@ public:
                          TransportAddress* sender, int max_tries = -1);
     void     broadcastPacket(NetworkString *data,
                              bool reliable = true);
+    static ENetPacket* createPacket(const uint8_t* data, size_t size,
+                                    bool reliable);
 
     // ------------------------------------------------------------------------
     /** Returns a pointer to the ENet host object. */
@@ -21,6 +21,7 @@
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
+#include "network/protocols/game_protocol.hpp"
 #include "network/protocols/server_lobby.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
@@ -135,6 +136,11 @@ void mainLoop(STKHost* host)
                 (float)host->getUploadSpeed() / 1024.0f <<
                 "   Download speed (KBps): " <<
                 (float)host->getDownloadSpeed() / 1024.0f  << std::endl;
+            if (auto gp = GameProtocol::lock())
+            {
+                std::cout << "Saved by delta states (KBps): " <<
+                    (float)gp->getDeltaSavedSpeed() / 1024.0f << std::endl;
+            }
         }
         else
         {
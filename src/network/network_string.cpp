@@ -20,9 +20,110 @@
 #include "utils/string_utils.hpp"
 
 #include <algorithm>   // for std::min
+#include <atomic>
 #include <iomanip>
+#include <mutex>
 #include <ostream>
 
+namespace
+{
+    /** Buffers of deleted network strings, which are reused by new network
+     *  strings to avoid a memory allocation for each of them. */
+    struct RecycledBuffers
+    {
+        std::mutex m_mutex;
+        std::vector<std::vector<uint8_t> > m_buffers;
+        std::atomic<int> m_allocations;
+        std::atomic<int> m_reuses;
+    };
+    /** Maximum number of buffers kept. */
+    const unsigned MAX_RECYCLED_BUFFERS = 512;
+    /** Larger buffers (e.g. full game states) are freed, to avoid keeping a
+     *  lot of memory for small strings. */
+    const unsigned MAX_RECYCLED_CAPACITY = 2048;
+
+    // ------------------------------------------------------------------------
+    /** Network strings can be deleted during static destruction, so the
+     *  buffers are never freed. */
+    RecycledBuffers* getRecycledBuffers()
+    {
+        static RecycledBuffers* rb = new RecycledBuffers();
+        return rb;
+    }   // getRecycledBuffers
+}   // namespace
+
+// ============================================================================
+/** Returns the memory pool used to allocate all network strings. It is never
+ *  freed, since network strings can be deleted during static destruction. */
+MemoryPool* BareNetworkString::getMemoryPool()
+{
+    static MemoryPool* pool = new MemoryPool();
+    return pool;
+}   // getMemoryPool
+
+// ----------------------------------------------------------------------------
+/** Sets the (empty) buffer of a new network string to a buffer of a deleted
+ *  network string, if one is available.
+ *  \param buffer The buffer of the new network string.
+ *  \param capacity The capacity which the new buffer should have.
+ */
+void BareNetworkString::getRecycledBuffer(std::vector<uint8_t>* buffer,
+                                          unsigned capacity)
+{
+    // Callers which swap in their own buffer don't need one
+    if (capacity == 0)
+        return;
+    RecycledBuffers* rb = getRecycledBuffers();
+    std::unique_lock<std::mutex> ul(rb->m_mutex);
+    if (!rb->m_buffers.empty())
+    {
+        std::swap(*buffer, rb->m_buffers.back());
+        rb->m_buffers.pop_back();
+    }
+    ul.unlock();
+
+    if (buffer->capacity() >= capacity)
+    {
+        rb->m_reuses.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    rb->m_allocations.fetch_add(1, std::memory_order_relaxed);
+    buffer->reserve(capacity);
+}   // getRecycledBuffer
+
+// ----------------------------------------------------------------------------
+/** Keeps the buffer of a deleted network string for reuse.
+ *  \param buffer The buffer of the network string.
+ */
+void BareNetworkString::recycleBuffer(std::vector<uint8_t>* buffer)
+{
+    if (buffer->capacity() == 0 || buffer->capacity() > MAX_RECYCLED_CAPACITY)
+        return;
+    buffer->clear();
+    RecycledBuffers* rb = getRecycledBuffers();
+    std::lock_guard<std::mutex> lock(rb->m_mutex);
+    if (rb->m_buffers.size() < MAX_RECYCLED_BUFFERS)
+    {
+        rb->m_buffers.emplace_back();
+        std::swap(*buffer, rb->m_buffers.back());
+    }
+}   // recycleBuffer
+
+// ----------------------------------------------------------------------------
+/** Returns the number of memory allocations for network strings (objects
+ *  and buffers) since the last call, and the number of allocations that
+ *  were avoided by reusing memory of deleted network strings.
+ *  \param[out] allocated Number of memory allocations.
+ *  \param[out] reused Number of reused objects and buffers.
+ */
+void BareNetworkString::getAllocations(int* allocated, int* reused)
+{
+    RecycledBuffers* rb = getRecycledBuffers();
+    *allocated = rb->m_allocations.exchange(0) +
+                 getMemoryPool()->getAndResetAllocations();
+    *reused = rb->m_reuses.exchange(0) + getMemoryPool()->getAndResetReuses();
+}   // getAllocations
+
 // ============================================================================
 /** Unit testing function.
  */
@@ -44,6 +145,44 @@ void NetworkString::unitTesting()
     std::string log = slog.getLogMessage();
     assert(log=="0x000 | 00 01 02 03 04 05 06 07  08 09 0a 0b 0c 0d 0e 0f   | ................\n"
                 "0x010 | 10 11 12 13 14 15 16 17  18 19 1a 1b               | ............\n");
+
+    // Check variable length integers
+    BareNetworkString svar;
+    svar.addVarUInt32(0).addVarUInt32(127).addVarUInt32(128)
+        .addVarUInt32(300).addVarUInt32(0xffffffff);
+    assert(svar.size() == 1 + 1 + 2 + 2 + 5);
+    const uint32_t expected[] = { 0, 127, 128, 300, 0xffffffff };
+    for (uint32_t value : expected)
+    {
+        const bool equal = svar.getVarUInt32() == value;
+        assert(equal);
+        (void)equal;
+    }
+    assert(svar.size() == 0);
+
+    // Buffers of deleted strings are reused, and start empty
+    int allocated, reused;
+    getAllocations(&allocated, &reused);
+    BareNetworkString* s1 = new BareNetworkString(100);
+    s1->addUInt32(1234);
+    delete s1;
+    getAllocations(&allocated, &reused);
+    BareNetworkString* s2 = new BareNetworkString(50);
+    assert(s2->size() == 0);
+    s2->addUInt8(1);
+    uint8_t value = s2->getUInt8();
+    assert(value == 1);
+    (void)value;
+    delete s2;
+    getAllocations(&allocated, &reused);
+    assert(allocated == 0 && reused == 2);
+
+    // Copies do not share the buffer
+    BareNetworkString s3(8);
+    s3.addUInt16(7);
+    BareNetworkString s4(s3);
+    s3.addUInt8(1);
+    assert(s4.size() == 2 && s4.getUInt16() == 7);
 }   // unitTesting
 
 // ============================================================================
@@ -25,6 +25,7 @@
 
 #include "network/protocol.hpp"
 #include "utils/leak_check.hpp"
+#include "utils/memory_pool.hpp"
 #include "utils/types.hpp"
 #include "utils/vec3.hpp"
 
@@ -117,19 +118,34 @@ protected:
     {
         return m_buffer.at(m_current_offset++);
     }   // get
+    // ------------------------------------------------------------------------
+    static void getRecycledBuffer(std::vector<uint8_t>* buffer,
+                                  unsigned capacity);
+    static void recycleBuffer(std::vector<uint8_t>* buffer);
+    static MemoryPool* getMemoryPool();
 
 public:
-
+    static void getAllocations(int* allocated, int* reused);
+    // ------------------------------------------------------------------------
+    /** Network strings are created and deleted very often, so they are
+     *  allocated from a memory pool. */
+    static void* operator new(size_t size)
+                                    { return getMemoryPool()->allocate(size); }
+    // ------------------------------------------------------------------------
+    static void operator delete(void* p, size_t size)
+                                       { getMemoryPool()->deallocate(p, size); }
+    // ------------------------------------------------------------------------
     /** Constructor, sets the protocol type of this message. */
     BareNetworkString(int capacity=16)
     {
-        m_buffer.reserve(capacity);
+        getRecycledBuffer(&m_buffer, capacity);
         m_current_offset = 0;
     }   // BareNetworkString
 
     // ------------------------------------------------------------------------
     BareNetworkString(const std::string &s)
     {
+        getRecycledBuffer(&m_buffer, (unsigned)s.size() + 1);
         m_current_offset = 0;
         encodeString(s);
     }   // BareNetworkString
@@ -137,10 +153,23 @@ public:
     /** Initialises the string with a sequence of characters. */
     BareNetworkString(const char *data, int len)
     {
+        getRecycledBuffer(&m_buffer, len);
         m_current_offset = 0;
         m_buffer.resize(len);
         memcpy(m_buffer.data(), data, len);
     }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    BareNetworkString(const BareNetworkString& other)
+    {
+        getRecycledBuffer(&m_buffer, (unsigned)other.m_buffer.size());
+        m_buffer = other.m_buffer;
+        m_current_offset = other.m_current_offset;
+    }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    BareNetworkString& operator=(const BareNetworkString&) = default;
+    // ------------------------------------------------------------------------
+    /** Keeps the buffer for the next network string. */
+    ~BareNetworkString()                         { recycleBuffer(&m_buffer); }
 
     // ------------------------------------------------------------------------
     /** Allows to read a buffer from the beginning again. */
@@ -320,6 +349,21 @@ public:
         return addUInt32(ticks);
     }   // addTime
 
+    // ------------------------------------------------------------------------
+    /** Adds an unsigned 32 bit integer using a variable length encoding:
+     *  7 bits per byte, the highest bit set if more bytes follow. Small
+     *  values (< 128) only use a single byte. */
+    BareNetworkString& addVarUInt32(uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_buffer.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        m_buffer.push_back((uint8_t)value);
+        return *this;
+    }   // addVarUInt32
+
     // Functions related to getting data from a network string
     // ------------------------------------------------------------------------
     /** Returns a unsigned 64 bit integer. */
@@ -337,6 +381,20 @@ public:
     /** Returns an unsigned 16 bit integer. */
     inline int16_t getInt16() const { return get<int16_t, 2>(); }
     // ------------------------------------------------------------------------
+    /** Returns an unsigned 32 bit integer added with addVarUInt32. */
+    uint32_t getVarUInt32() const
+    {
+        uint32_t result = 0;
+        for (unsigned shift = 0; shift < 35; shift += 7)
+        {
+            uint8_t byte = m_buffer.at(m_current_offset++);
+            result |= (uint32_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return result;
+        }
+        throw std::out_of_range("getVarUInt32 too many bytes.");
+    }   // getVarUInt32
+    // ------------------------------------------------------------------------
     /** Returns an unsigned 8-bit integer. */
     inline uint8_t getUInt8() const
     {
@@ -30,12 +30,18 @@
 #include "network/protocol_manager.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
+#include "network/server_config.hpp"
+#include "network/state_delta.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
+#include "race/history.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 #include "main_loop.hpp"
 
+#include <algorithm>
+
 // ============================================================================
 std::weak_ptr<GameProtocol> GameProtocol::m_game_protocol;
 // ============================================================================
@@ -57,7 +63,12 @@ GameProtocol::GameProtocol()
             : Protocol( PROTOCOL_CONTROLLER_EVENTS)
 {
     m_data_to_send = getNetworkString();
-
+    m_state_ticks = 0;
+    m_state_count = 0;
+    m_state_chunks_start = 0;
+    m_delta_saved_bytes = 0;
+    m_delta_saved_time = StkTime::getRealTimeMs();
+    m_delta_saved_speed.store(0);
 }   // GameProtocol
 
 //-----------------------------------------------------------------------------
@@ -126,6 +137,8 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_STATE_DELTA:       handleStateDelta(event);       break;
+    case GP_STATE_ACK:         handleStateAck(event);         break;
     case GP_ADJUST_TIME:       handleAdjustTime(event);       break;
     //case GP_ITEM_UPDATE:       handleItemUpdate(event);       break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
@@ -347,21 +360,44 @@ void GameProtocol::handleItemEventConfirmation(Event *event)
 void GameProtocol::startNewState()
 {
     assert(NetworkConfig::get()->isServer());
+    m_state_ticks = World::getWorld()->getTicksSinceStart();
+    m_state_count++;
+    m_state_chunks.clear();
     m_data_to_send->clear();
-    m_data_to_send->addUInt8(GP_STATE)
-        .addUInt32(World::getWorld()->getTicksSinceStart());
+    m_data_to_send->addUInt8(GP_STATE).addUInt32(m_state_ticks);
 }   // startNewState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to add data to the current state. The data in buffer
- *  is copied, so the data can be freed after this call/.
- *  \param buffer Adds the data in the buffer to the current state.
+/** Called by a server to add the state of a rewinder to the current state.
+ *  The rewinder writes directly into the state message, and the size of
+ *  its state is stored in front of it.
+ *  \param rewinder The rewinder whose state is added.
+ *  \param[out] ru The unique identity of rewinder using.
+ *  \return Size of the state of the rewinder, 0 if it saved no state.
  */
-void GameProtocol::addState(BareNetworkString *buffer)
+unsigned GameProtocol::addState(Rewinder* rewinder,
+                                std::vector<std::string>* ru)
 {
     assert(NetworkConfig::get()->isServer());
-    m_data_to_send->addUInt16(buffer->size());
-    (*m_data_to_send) += *buffer;
+    std::vector<uint8_t>& buffer = m_data_to_send->getBuffer();
+    const size_t size_pos = buffer.size();
+    m_data_to_send->addUInt16(0);
+    if (!rewinder->saveState(m_data_to_send, ru))
+    {
+        buffer.resize(size_pos);
+        return 0;
+    }
+    const size_t size = buffer.size() - size_pos - 2;
+    assert(size < 65536);
+    buffer[size_pos] = (uint8_t)((size >> 8) & 0xff);
+    buffer[size_pos + 1] = (uint8_t)(size & 0xff);
+
+    StateChunk chunk;
+    chunk.m_offset = (unsigned)size_pos - (1 + 1 + 4);
+    chunk.m_size = (unsigned)size + 2;
+    chunk.m_has_position = rewinder->getRelevancePosition(&chunk.m_xyz);
+    m_state_chunks.push_back(chunk);
+    return (unsigned)size;
 }   // addState
 
 // ----------------------------------------------------------------------------
@@ -386,16 +422,210 @@ void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
         names.insert(names.end(), rewinder.begin(), rewinder.end());
     }
     buffer.insert(pos, names.begin(), names.end());
+    assert(cur_rewinder.size() == m_state_chunks.size());
+    m_state_rewinders = cur_rewinder;
+    m_state_chunks_start = 1 + 1 + 4 + (unsigned)names.size();
+    if (history->isRecordingServer())
+    {
+        history->addServerState(m_state_ticks, buffer.data() + 1 + 1 + 4,
+                                (unsigned)buffer.size() - (1 + 1 + 4));
+    }
 }   // finalizeState
 
+// ----------------------------------------------------------------------------
+/** Determines which rewinder states of the current state are relevant for
+ *  a peer: states of objects far away from all karts of the peer are only
+ *  sent in every state-relevance-interval state. Spectators get all states.
+ *  \param peer The peer.
+ *  \return For each rewinder state if it should be sent.
+ */
+std::vector<bool> GameProtocol::getRelevantStates(const STKPeer* peer) const
+{
+    std::vector<bool> relevant(m_state_chunks.size(), true);
+    const float distance = ServerConfig::m_state_relevance_distance;
+    const int interval = ServerConfig::m_state_relevance_interval;
+    if (distance <= 0.0f || interval <= 1)
+        return relevant;
+
+    World* world = World::getWorld();
+    std::vector<Vec3> peer_xyz;
+    for (unsigned kart_id : peer->getAvailableKartIDs())
+    {
+        if (kart_id < world->getNumKarts())
+            peer_xyz.push_back(world->getKart(kart_id)->getXYZ());
+    }
+    if (peer_xyz.empty())
+        return relevant;
+
+    for (unsigned i = 0; i < m_state_chunks.size(); i++)
+    {
+        const StateChunk& chunk = m_state_chunks[i];
+        // Spread the states of far away objects over all states
+        if (!chunk.m_has_position || (m_state_count + i) % interval == 0)
+            continue;
+        bool is_near = false;
+        for (const Vec3& xyz : peer_xyz)
+        {
+            if ((xyz - chunk.m_xyz).length2() < distance * distance)
+            {
+                is_near = true;
+                break;
+            }
+        }
+        relevant[i] = is_near;
+    }
+    return relevant;
+}   // getRelevantStates
+
+// ----------------------------------------------------------------------------
+/** Returns the current state message with only the given rewinder states.
+ *  \param relevant For each rewinder state if it is included.
+ *  \return The state message, the caller must delete it unless it is the
+ *          full state m_data_to_send.
+ */
+NetworkString* GameProtocol::getRelevantState(const std::vector<bool>& relevant)
+{
+    if (std::find(relevant.begin(), relevant.end(), false) == relevant.end())
+        return m_data_to_send;
+
+    const std::vector<uint8_t>& full = m_data_to_send->getBuffer();
+    NetworkString* ns = getNetworkString(full.size());
+    ns->addUInt8(GP_STATE).addUInt32(m_state_ticks);
+    uint8_t count = (uint8_t)std::count(relevant.begin(), relevant.end(),
+        true);
+    ns->addUInt8(count);
+    for (unsigned i = 0; i < relevant.size(); i++)
+    {
+        if (relevant[i])
+            ns->encodeString(m_state_rewinders[i]);
+    }
+    std::vector<uint8_t>& buffer = ns->getBuffer();
+    for (unsigned i = 0; i < relevant.size(); i++)
+    {
+        if (!relevant[i])
+            continue;
+        auto start = full.begin() + m_state_chunks_start +
+            m_state_chunks[i].m_offset;
+        buffer.insert(buffer.end(), start, start + m_state_chunks[i].m_size);
+    }
+    return ns;
+}   // getRelevantState
+
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
- *  can be sent to the clients.
+ *  can be sent to the clients. Each client gets only the rewinder states
+ *  relevant to it, and if enabled, each client which acknowledged a recent
+ *  state gets the state as delta against that state instead.
  */
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    const bool delta_state = ServerConfig::m_delta_state;
+    // Skip protocol type, GP_STATE and time, which are not part of the delta
+    const unsigned header_size = 1 + 1 + 4;
+
+    std::map<uint32_t, int> acks;
+    if (delta_state)
+    {
+        std::lock_guard<std::mutex> lock(m_state_acks_mutex);
+        acks = m_state_acks;
+    }
+    SentStates& sent = m_sent_states[m_state_ticks];
+    sent.m_states.clear();
+    sent.m_peer_states.clear();
+
+    // Peers with the same relevant states share the state message, and
+    // peers which also acknowledged the same state share the encoded delta
+    std::map<std::vector<bool>, unsigned> all_relevant;
+    std::vector<NetworkString*> states;
+    std::map<std::pair<unsigned, const std::vector<uint8_t>*>,
+        NetworkString*> deltas;
+    auto peers = STKHost::get()->getPeers();
+    std::vector<std::pair<STKPeer*, NetworkString*> > packets;
+    for (auto& peer : peers)
+    {
+        if (!peer->isValidated() || peer->isWaitingForGame())
+            continue;
+        std::vector<bool> relevant = getRelevantStates(peer.get());
+        auto it = all_relevant.find(relevant);
+        unsigned index;
+        if (it == all_relevant.end())
+        {
+            index = (unsigned)states.size();
+            all_relevant[relevant] = index;
+            states.push_back(getRelevantState(relevant));
+            if (delta_state)
+            {
+                const std::vector<uint8_t>& full =
+                    states.back()->getBuffer();
+                sent.m_states.emplace_back(full.begin() + header_size,
+                    full.end());
+            }
+        }
+        else
+            index = it->second;
+
+        NetworkString* ns = states[index];
+        if (delta_state)
+        {
+            sent.m_peer_states[peer->getHostId()] = index;
+            const std::vector<uint8_t>* base = NULL;
+            auto ack = acks.find(peer->getHostId());
+            auto base_states = ack == acks.end() ? m_sent_states.end() :
+                m_sent_states.find(ack->second);
+            if (base_states != m_sent_states.end())
+            {
+                auto peer_state =
+                    base_states->second.m_peer_states.find(peer->getHostId());
+                if (peer_state != base_states->second.m_peer_states.end())
+                    base = &base_states->second.m_states[peer_state->second];
+            }
+            if (base)
+            {
+                const std::vector<uint8_t>& state = sent.m_states[index];
+                NetworkString*& delta = deltas[std::make_pair(index, base)];
+                if (!delta)
+                {
+                    delta = getNetworkString(ns->getTotalSize());
+                    delta->addUInt8(GP_STATE_DELTA).addUInt32(m_state_ticks)
+                        .addUInt32(base_states->first)
+                        .addUInt32((uint32_t)state.size());
+                    StateDelta::encode(*base, state.data(),
+                        (unsigned)state.size(), delta);
+                }
+                if (delta->getTotalSize() < ns->getTotalSize())
+                {
+                    m_delta_saved_bytes +=
+                        ns->getTotalSize() - delta->getTotalSize();
+                    ns = delta;
+                }
+            }
+        }
+        packets.emplace_back(peer.get(), ns);
+    }
+    // Encrypt the packets for all peers in parallel
+    STKHost::get()->sendPackets(packets, /*reliable*/false);
+    for (NetworkString* ns : states)
+    {
+        if (ns != m_data_to_send)
+            delete ns;
+    }
+    for (auto& delta : deltas)
+        delete delta.second;
+
+    if (!delta_state)
+        m_sent_states.clear();
+    while (m_sent_states.size() > MAX_DELTA_BASE_STATES)
+        m_sent_states.erase(m_sent_states.begin());
+
+    uint64_t now = StkTime::getRealTimeMs();
+    if (now >= m_delta_saved_time + 1000)
+    {
+        m_delta_saved_speed.store(
+            (uint32_t)(m_delta_saved_bytes * 1000 / (now - m_delta_saved_time)));
+        m_delta_saved_bytes = 0;
+        m_delta_saved_time = now;
+    }
 }   // sendState
 
 // ----------------------------------------------------------------------------
@@ -406,22 +636,93 @@ void GameProtocol::handleState(Event *event)
     assert(NetworkConfig::get()->isClient());
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
+    std::vector<uint8_t> state(data.getBuffer().begin() +
+        data.getCurrentOffset(), data.getBuffer().end());
+    addReceivedState(ticks, state);
+}   // handleState
+
+// ----------------------------------------------------------------------------
+/** Called when a new state encoded as delta against a previous state is
+ *  received form the server. If the base state is not available anymore
+ *  the state is ignored, the server will send a full state once it receives
+ *  no acknowledgement for the base state anymore.
+ */
+void GameProtocol::handleStateDelta(Event *event)
+{
+    assert(NetworkConfig::get()->isClient());
+    NetworkString &data = event->data();
+    int ticks = data.getUInt32();
+    int base_ticks = data.getUInt32();
+    unsigned state_size = data.getUInt32();
+
+    auto base = m_delta_base_states.find(base_ticks);
+    if (base == m_delta_base_states.end())
+    {
+        Log::warn("GameProtocol", "Missing base state %d for state %d.",
+            base_ticks, ticks);
+        return;
+    }
+    std::vector<uint8_t> state;
+    if (!StateDelta::decode(base->second, data, state_size, &state))
+    {
+        Log::warn("GameProtocol", "Invalid delta state %d.", ticks);
+        return;
+    }
+    addReceivedState(ticks, state);
+}   // handleStateDelta
+
+// ----------------------------------------------------------------------------
+/** Adds a (reconstructed) full state to the rewind manager, keeps a copy of
+ *  it as base for future delta states and acknowledges it to the server.
+ *  \param ticks Time of the state.
+ *  \param state The state (without message header), which is moved into
+ *         the RewindInfoState.
+ */
+void GameProtocol::addReceivedState(int ticks, std::vector<uint8_t>& state)
+{
+    m_delta_base_states[ticks] = state;
+    while (m_delta_base_states.size() > MAX_DELTA_BASE_STATES)
+        m_delta_base_states.erase(m_delta_base_states.begin());
+
+    NetworkString* ack = getNetworkString(5);
+    ack->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+    sendToServer(ack, /*reliable*/false);
+    delete ack;
+
+    BareNetworkString bns;
+    std::swap(bns.getBuffer(), state);
 
     // Check for updated rewinder using
-    unsigned rewinder_size = data.getUInt8();
+    unsigned rewinder_size = bns.getUInt8();
     std::vector<std::string> rewinder_using;
     for (unsigned i = 0; i < rewinder_size; i++)
     {
         std::string name;
-        data.decodeString(&name);
+        bns.decodeString(&name);
         rewinder_using.push_back(name);
     }
 
     // The memory for bns will be handled in the RewindInfoState object
-    RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
-        rewinder_using, data.getBuffer());
+    RewindInfoState* ris = new RewindInfoState(ticks, bns.getCurrentOffset(),
+        rewinder_using, bns.getBuffer());
     RewindManager::get()->addNetworkRewindInfo(ris);
-}   // handleState
+}   // addReceivedState
+
+// ----------------------------------------------------------------------------
+/** Called on the server when a client acknowledges a state, which can then
+ *  be used as base for delta states sent to this client.
+ */
+void GameProtocol::handleStateAck(Event *event)
+{
+    assert(NetworkConfig::get()->isServer());
+    int ticks = event->data().getUInt32();
+    std::lock_guard<std::mutex> lock(m_state_acks_mutex);
+    auto it = m_state_acks.find(event->getPeer()->getHostId());
+    if (it == m_state_acks.end())
+        m_state_acks[event->getPeer()->getHostId()] = ticks;
+    else if (ticks > it->second)
+        it->second = ticks;
+}   // handleStateAck
 
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
@@ -438,6 +739,23 @@ void GameProtocol::undo(BareNetworkString *buffer)
  *  \param buffer Pointer to the saved state information.
  */
 void GameProtocol::rewind(BareNetworkString *buffer)
+{
+    // The server never rewinds, so this is the final time of the action
+    if (NetworkConfig::get()->isServer() && history->isRecordingServer())
+    {
+        history->addServerAction(World::getWorld()->getTicksSinceStart(),
+                                 (const uint8_t*)buffer->getCurrentData(),
+                                 (unsigned)buffer->size());
+    }
+    applyAction(buffer);
+}   // rewind
+
+// ----------------------------------------------------------------------------
+/** Executes a player action, as sent by a client in a controller action
+ *  message (kart id and compressed action).
+ *  \param buffer The action.
+ */
+void GameProtocol::applyAction(BareNetworkString *buffer)
 {
     int kart_id = buffer->getUInt8();
     uint8_t w = buffer->getUInt8();
@@ -453,7 +771,7 @@ void GameProtocol::rewind(BareNetworkString *buffer)
         pc->actionFromNetwork(std::get<0>(a), std::get<1>(a), std::get<2>(a),
             std::get<3>(a));
     }
-}   // rewind
+}   // applyAction
 
 // ----------------------------------------------------------------------------
 void GameProtocol::addInitialTicks(STKPeer* p, int ticks)
@@ -25,15 +25,19 @@
 #include "input/input.hpp"                // for PlayerAction
 #include "utils/cpp2011.hpp"
 #include "utils/singleton.hpp"
+#include "utils/vec3.hpp"
 
+#include <atomic>
 #include <cstdlib>
 #include <map>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <tuple>
 
 class BareNetworkString;
 class NetworkString;
+class Rewinder;
 class STKPeer;
 
 class GameProtocol : public Protocol
@@ -49,13 +53,81 @@ private:
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_STATE_DELTA,
+           GP_STATE_ACK
     };
 
+    /** Maximum number of full states kept to be used as base of a delta
+     *  state, i.e. states older than this can't be acknowledged. */
+    static const unsigned MAX_DELTA_BASE_STATES = 32;
+
     /** A network string that collects all information from the server to be sent
      *  next. */
     NetworkString *m_data_to_send;
 
+    /** The ticks of the state currently being assembled (server only). */
+    int m_state_ticks;
+
+    /** Number of states assembled so far (server only). */
+    unsigned m_state_count;
+
+    /** Server only: where the state of each rewinder is stored in the
+     *  current state message, used to leave out states which are not
+     *  relevant for a peer. */
+    struct StateChunk
+    {
+        /** Offset of the size of this state from the first state. */
+        unsigned m_offset;
+        /** Size including the 2 bytes used to store the size. */
+        unsigned m_size;
+        /** If the state is only relevant for peers near m_xyz. */
+        bool m_has_position;
+        Vec3 m_xyz;
+    };
+    std::vector<StateChunk> m_state_chunks;
+
+    /** Names of the rewinders in the current state message. */
+    std::vector<std::string> m_state_rewinders;
+
+    /** Offset of the first rewinder state in the current state message. */
+    unsigned m_state_chunks_start;
+
+    /** Server only: the states sent at one time. Peers with different
+     *  relevant rewinders get different states. */
+    struct SentStates
+    {
+        /** The different states sent, without message header. */
+        std::vector<std::vector<uint8_t> > m_states;
+        /** Index into m_states of the state sent to each peer, indexed by
+         *  host id. */
+        std::map<uint32_t, unsigned> m_peer_states;
+    };
+
+    /** Server only: the last states sent, which can be used as base for a
+     *  delta state. */
+    std::map<int, SentStates> m_sent_states;
+
+    /** Client only: the last full states received, without message header,
+     *  which can be used as base for a delta state. */
+    std::map<int, std::vector<uint8_t> > m_delta_base_states;
+
+    /** Server only: latest state ticks acknowledged by each peer, indexed by
+     *  host id. Written by the network thread. */
+    std::map<uint32_t, int> m_state_acks;
+
+    std::mutex m_state_acks_mutex;
+
+    /** Number of bytes saved by sending delta states since
+     *  m_delta_saved_time. */
+    uint32_t m_delta_saved_bytes;
+
+    /** Real time in ms when m_delta_saved_speed was last updated. */
+    uint64_t m_delta_saved_time;
+
+    /** Bytes per second saved by sending delta instead of full states. */
+    std::atomic<uint32_t> m_delta_saved_speed;
+
     /** The server might request that the world clock of a client is adjusted
      *  to reduce number of rollbacks. */
     std::vector<int8_t> m_adjust_time;
@@ -74,8 +146,13 @@ private:
     // List of all kart actions to send to the server
     std::vector<Action> m_all_actions;
 
+    std::vector<bool> getRelevantStates(const STKPeer* peer) const;
+    NetworkString* getRelevantState(const std::vector<bool>& relevant);
     void handleControllerAction(Event *event);
     void handleState(Event *event);
+    void handleStateDelta(Event *event);
+    void handleStateAck(Event *event);
+    void addReceivedState(int ticks, std::vector<uint8_t>& state);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
     static std::weak_ptr<GameProtocol> m_game_protocol;
@@ -92,7 +169,7 @@ private:
         uint16_t z = (uint16_t)std::abs(a.m_value_r);
         return std::make_tuple(w, x, y, z);
     }
-    std::tuple<PlayerAction, int, int, int>
+    static std::tuple<PlayerAction, int, int, int>
                decompressAction(uint8_t w, uint16_t x, uint16_t y , uint16_t z)
     {
         PlayerAction a = (PlayerAction)(w & 63);
@@ -113,7 +190,7 @@ public:
     void controllerAction(int kart_id, PlayerAction action,
                           int value, int val_l, int val_r);
     void startNewState();
-    void addState(BareNetworkString *buffer);
+    unsigned addState(Rewinder* rewinder, std::vector<std::string>* ru);
     void sendState();
     void finalizeState(std::vector<std::string>& cur_rewinder);
     void adjustTimeForClient(STKPeer *peer, int ticks);
@@ -121,6 +198,7 @@ public:
 
     virtual void undo(BareNetworkString *buffer) OVERRIDE;
     virtual void rewind(BareNetworkString *buffer) OVERRIDE;
+    static void applyAction(BareNetworkString *buffer);
     // ------------------------------------------------------------------------
     virtual void setup() OVERRIDE {};
     // ------------------------------------------------------------------------
@@ -143,6 +221,10 @@ public:
     // ------------------------------------------------------------------------
     void addInitialTicks(STKPeer* p, int ticks);
     // ------------------------------------------------------------------------
+    /** Returns the number of bytes per second saved by sending delta instead
+     *  of full states. */
+    uint32_t getDeltaSavedSpeed() const   { return m_delta_saved_speed.load(); }
+    // ------------------------------------------------------------------------
     std::unique_lock<std::mutex> acquireWorldDeletingMutex() const
                { return std::unique_lock<std::mutex>(m_world_deleting_mutex); }
 
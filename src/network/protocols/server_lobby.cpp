@@ -43,6 +43,7 @@
 #include "network/stk_peer.hpp"
 #include "online/online_profile.hpp"
 #include "online/request_manager.hpp"
+#include "race/history.hpp"
 #include "race/race_manager.hpp"
 #include "states_screens/online/networking_lobby.hpp"
 #include "states_screens/race_result_gui.hpp"
@@ -248,6 +249,7 @@ void ServerLobby::setup()
     m_battle_hit_capture_limit = 0;
     m_battle_time_limit = 0.0f;
     m_item_seed = 0;
+    m_race_recording_started = false;
     m_winner_peer_id = 0;
     m_client_starting_time = 0;
     auto players = STKHost::get()->getPlayersForNewGame();
@@ -1101,12 +1103,19 @@ void ServerLobby::update(int ticks)
         Log::info("ServerLobbyRoom", "Starting the race loading.");
         // This will create the world instance, i.e. load track and karts
         loadWorld();
+        m_race_recording_started = false;
         m_state = WAIT_FOR_WORLD_LOADED;
         break;
     case RACING:
         if (World::getWorld() &&
             RaceEventManager::getInstance<RaceEventManager>()->isRunning())
         {
+            // The powerup seed is only set when the start time is known
+            if (ServerConfig::m_record_history && !m_race_recording_started)
+            {
+                history->startServerRecording(m_item_seed);
+                m_race_recording_started = true;
+            }
             checkRaceFinished();
         }
         break;
@@ -1115,6 +1124,7 @@ void ServerLobby::update(int ticks)
             !GameProtocol::emptyInstance())
             return;
 
+        history->stopServerRecording();
         // This will go back to lobby in server (and exit the current race)
         RaceResultGUI::getInstance()->backToLobby();
         // Reset for next state usage
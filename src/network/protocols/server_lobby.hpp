@@ -170,6 +170,10 @@ private:
 
     unsigned m_item_seed;
 
+    /** True once the recording of the current race was started (see
+     *  ServerConfig::m_record_history). */
+    bool m_race_recording_started;
+
     uint32_t m_winner_peer_id;
 
     uint64_t m_client_starting_time;
@@ -33,6 +33,27 @@ RewindInfo::RewindInfo(int ticks, bool is_confirmed)
     m_is_confirmed = is_confirmed;
 }   // RewindInfo
 
+// ----------------------------------------------------------------------------
+/** Returns the memory pool used to allocate all rewind infos. It is never
+ *  freed, since rewind infos can be deleted during static destruction. */
+MemoryPool* RewindInfo::getMemoryPool()
+{
+    static MemoryPool* pool = new MemoryPool();
+    return pool;
+}   // getMemoryPool
+
+// ----------------------------------------------------------------------------
+/** Returns the number of memory allocations for rewind infos since the last
+ *  call, and the number of allocations avoided by reusing memory.
+ *  \param[out] allocated Number of memory allocations.
+ *  \param[out] reused Number of reused objects.
+ */
+void RewindInfo::getAllocations(int* allocated, int* reused)
+{
+    *allocated = getMemoryPool()->getAndResetAllocations();
+    *reused = getMemoryPool()->getAndResetReuses();
+}   // getAllocations
+
 // ----------------------------------------------------------------------------
 /** Adjusts the time of this RewindInfo. This is only called on the server
  *  in case that an event is received in the past - in this case the server
@@ -53,7 +74,8 @@ RewindInfoState::RewindInfoState(int ticks, int start_offset,
 {
     std::swap(m_rewinder_using, rewinder_using);
     m_start_offset = start_offset;
-    m_buffer = new BareNetworkString();
+    // No buffer needed, it is swapped with the received one
+    m_buffer = new BareNetworkString(0);
     std::swap(m_buffer->getBuffer(), buffer);
 }   // RewindInfoState
 
@@ -120,6 +142,61 @@ void RewindInfoState::restore()
     }   // for all rewinder
 }   // restore
 
+// ------------------------------------------------------------------------
+/** Checks if this state differs from the state predicted by the client at
+ *  the same time, i.e. if a rewind to this state is needed (see
+ *  Rewinder::hasDiverged). A rewinder that does not exist on the client
+ *  (e.g. a projectile that was not predicted) always needs a rewind.
+ *  \param predicted The states saved by the client at the ticks of this
+ *         state indexed by rewinder name, or NULL if there are none.
+ */
+bool RewindInfoState::hasDiverged(
+                    std::map<std::string, std::vector<uint8_t> >* predicted)
+{
+    m_buffer->reset();
+    m_buffer->skip(m_start_offset);
+    for (const std::string& name : m_rewinder_using)
+    {
+        const uint16_t data_size = m_buffer->getUInt16();
+        const unsigned current_offset_now = m_buffer->getCurrentOffset();
+        std::shared_ptr<Rewinder> r =
+            RewindManager::get()->getRewinder(name);
+        if (!r)
+            return true;
+
+        // The predicted state is swapped in and out to avoid a copy
+        std::vector<uint8_t>* predicted_buffer = NULL;
+        if (predicted)
+        {
+            auto it = predicted->find(name);
+            if (it != predicted->end())
+                predicted_buffer = &it->second;
+        }
+        BareNetworkString predicted_state(0);
+        if (predicted_buffer)
+            std::swap(predicted_state.getBuffer(), *predicted_buffer);
+        bool diverged = true;
+        try
+        {
+            diverged = r->hasDiverged(m_buffer, data_size,
+                predicted_buffer ? &predicted_state : NULL);
+        }
+        catch (std::exception& e)
+        {
+            Log::error("RewindInfoState", "Compare state error: %s",
+                e.what());
+        }
+        if (predicted_buffer)
+            std::swap(predicted_state.getBuffer(), *predicted_buffer);
+        if (diverged)
+            return true;
+
+        m_buffer->reset();
+        m_buffer->skip(current_offset_now + data_size);
+    }   // for all rewinder
+    return false;
+}   // hasDiverged
+
 // ============================================================================
 RewindInfoEvent::RewindInfoEvent(int ticks, EventRewinder *event_rewinder,
                                  BareNetworkString *buffer, bool is_confirmed)
@@ -23,10 +23,12 @@
 #include "network/network_string.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/leak_check.hpp"
+#include "utils/memory_pool.hpp"
 #include "utils/ptr_vector.hpp"
 
 #include <assert.h>
 #include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -54,7 +56,19 @@ private:
      *  object.  */
     bool m_is_confirmed;
 
+    static MemoryPool* getMemoryPool();
+
 public:
+    static void getAllocations(int* allocated, int* reused);
+    // ------------------------------------------------------------------------
+    /** Rewind infos are created for each event and state, so they are
+     *  allocated from a memory pool. */
+    static void* operator new(size_t size)
+                                    { return getMemoryPool()->allocate(size); }
+    // ------------------------------------------------------------------------
+    static void operator delete(void* p, size_t size)
+                                       { getMemoryPool()->deallocate(p, size); }
+    // ------------------------------------------------------------------------
     RewindInfo(int ticks, bool is_confirmed);
 
     void setTicks(int ticks);
@@ -111,9 +125,21 @@ public:
     // ------------------------------------------------------------------------
     virtual void restore();
     // ------------------------------------------------------------------------
+    bool hasDiverged(std::map<std::string, std::vector<uint8_t> >* predicted);
+    // ------------------------------------------------------------------------
     /** Returns a pointer to the state buffer. */
     BareNetworkString *getBuffer() const { return m_buffer; }
     // ------------------------------------------------------------------------
+    /** Returns the size of the states of all rewinders in bytes. */
+    unsigned getStateSize() const
+    {
+        return m_buffer ? m_buffer->getTotalSize() - m_start_offset : 0;
+    }   // getStateSize
+    // ------------------------------------------------------------------------
+    /** Returns the names of the rewinders which have a state in this. */
+    const std::vector<std::string>& getRewinderUsing() const
+                                                   { return m_rewinder_using; }
+    // ------------------------------------------------------------------------
     virtual bool isState() const { return true; }
     // ------------------------------------------------------------------------
     /** Called when going back in time to undo any rewind information.
@@ -19,6 +19,7 @@
 #include "network/rewind_manager.hpp"
 
 #include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
 #include "modes/world.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
@@ -30,11 +31,15 @@
 #include "race/history.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
+#include "utils/vec3.hpp"
 
 #include <algorithm>
+#include <fstream>
 
 RewindManager* RewindManager::m_rewind_manager = NULL;
 bool           RewindManager::m_enable_rewind_manager = false;
+bool           RewindManager::m_write_statistics = false;
 
 /** Creates the singleton. */
 RewindManager *RewindManager::create()
@@ -58,6 +63,7 @@ void RewindManager::destroy()
  */
 RewindManager::RewindManager()
 {
+    m_skipped_rewinds.store(0);
     reset();
 }   // RewindManager
 
@@ -67,6 +73,8 @@ RewindManager::RewindManager()
  */
 RewindManager::~RewindManager()
 {
+    if (m_write_statistics)
+        writeStatistics();
     for (RewindInfoEventFunction* rief : m_pending_rief)
         delete rief;
     m_pending_rief.clear();
@@ -157,22 +165,51 @@ void RewindManager::saveState()
 
     for (auto& p : m_all_rewinder)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
-        BareNetworkString* buffer = NULL;
         if (auto r = p.second.lock())
-            buffer = r->saveState(&rewinder_using);
-        if (buffer != NULL)
-        {
-            m_overall_state_size += buffer->size();
-            gp->addState(buffer);
-        }
-        delete buffer;    // buffer can be freed
+            m_overall_state_size += gp->addState(r.get(), &rewinder_using);
     }
     gp->finalizeState(rewinder_using);
     PROFILER_POP_CPU_MARKER();
 }   // saveState
 
+// ----------------------------------------------------------------------------
+/** Saves the state of all rewinders without sending it, e.g. to compare it
+ *  with a state recorded by a server (see HistorySimulation).
+ *  \param states The states, indexed by the unique identity of the rewinder.
+ */
+void RewindManager::saveAllStates(
+                       std::map<std::string, std::vector<uint8_t> >* states)
+{
+    states->clear();
+    clearExpiredRewinder();
+    for (auto& p : m_all_rewinder)
+    {
+        std::shared_ptr<Rewinder> r = p.second.lock();
+        if (!r)
+            continue;
+        BareNetworkString buffer;
+        std::vector<std::string> ru;
+        if (r->saveState(&buffer, &ru) && !ru.empty())
+            std::swap((*states)[ru.back()], buffer.getBuffer());
+    }
+}   // saveAllStates
+
+// ----------------------------------------------------------------------------
+/** Adds the number of memory allocations for network strings and rewind
+ *  infos to the profiler, together with the number of allocations that were
+ *  avoided by reusing memory (i.e. the number of allocations without it).
+ */
+void RewindManager::reportAllocations()
+{
+    int allocated, reused, info_allocated, info_reused;
+    BareNetworkString::getAllocations(&allocated, &reused);
+    RewindInfo::getAllocations(&info_allocated, &info_reused);
+    PROFILER_ADD_TO_COUNTER("Network allocations",
+                            allocated + info_allocated);
+    PROFILER_ADD_TO_COUNTER("Network allocations reused",
+                            reused + info_reused);
+}   // reportAllocations
+
 // ----------------------------------------------------------------------------
 /** Determines if a new state snapshot should be taken, and if so calls all
  *  rewinder to do so.
@@ -181,11 +218,18 @@ void RewindManager::saveState()
 void RewindManager::update(int ticks_not_used)
 {
     // FIXME: rename ticks_not_used
+    reportAllocations();
     if (!m_enable_rewind_manager ||
-        m_all_rewinder.size() == 0 ||
-        m_is_rewinding)  return;
+        m_all_rewinder.size() == 0) return;
 
     int ticks = World::getWorld()->getTicksSinceStart();
+    if (m_is_rewinding)
+    {
+        // The states predicted before the rewind are outdated now
+        if (NetworkConfig::get()->isClient() && shouldSaveState(ticks))
+            saveLocalFullState(ticks);
+        return;
+    }
 
     m_not_rewound_ticks.store(ticks, std::memory_order_relaxed);
 
@@ -202,6 +246,7 @@ void RewindManager::update(int ticks_not_used)
             if (auto r = p.second.lock())
                 ret.push_back(r->getLocalStateRestoreFunction());
         }
+        saveLocalFullState(ticks);
     }
     else
     {
@@ -213,6 +258,29 @@ void RewindManager::update(int ticks_not_used)
     PROFILER_POP_CPU_MARKER();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Client only: saves the full state of all rewinders which the server
+ *  might leave out of a state (see Rewinder::getRelevancePosition). They are
+ *  used in place of the missing server states, and to check if a server
+ *  state differs from the predicted state at all.
+ *  \param ticks The current world time.
+ */
+void RewindManager::saveLocalFullState(int ticks)
+{
+    auto& full_state = m_local_full_state[ticks];
+    for (auto& p : m_all_rewinder)
+    {
+        std::shared_ptr<Rewinder> r = p.second.lock();
+        Vec3 xyz;
+        if (!r || !r->getRelevancePosition(&xyz))
+            continue;
+        BareNetworkString buffer;
+        std::vector<std::string> ru;
+        if (r->saveState(&buffer, &ru))
+            std::swap(full_state[p.first], buffer.getBuffer());
+    }
+}   // saveLocalFullState
+
 // ----------------------------------------------------------------------------
 /** Replays all events from the last event played till the specified time.
  *  \param world_ticks Up to (and inclusive) which time events will be replayed.
@@ -233,7 +301,14 @@ void RewindManager::playEventsTill(int world_ticks, int *ticks)
     // be getTime()+dt - world time has not been updated yet).
     m_rewind_queue.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
 
-    if (needs_rewind)
+    if (needs_rewind && !isRewindNeeded(rewind_ticks))
+    {
+        // All states were predicted correctly, keep the current state
+        skipRewind(rewind_ticks, world_ticks);
+        m_skipped_rewinds.fetch_add(1, std::memory_order_relaxed);
+        PROFILER_ADD_TO_COUNTER("Rewinds skipped", 1);
+    }
+    else if (needs_rewind)
     {
         Log::setPrefix("Rewind");
         PROFILER_PUSH_CPU_MARKER("Rewind", 128, 128, 128);
@@ -257,6 +332,38 @@ void RewindManager::playEventsTill(int world_ticks, int *ticks)
     m_is_rewinding = false;
 }   // playEventsTill
 
+// ----------------------------------------------------------------------------
+/** Checks if a rewind to the server states at the given time is necessary:
+ *  this is the case if any object in the states differs from the state
+ *  predicted by this client, or if a network event after that time has not
+ *  been played yet. Since a rewind re-simulates the whole world, it can
+ *  only be skipped if nothing at all needs to be corrected.
+ *  \param rewind_ticks Time of the latest received states.
+ */
+bool RewindManager::isRewindNeeded(int rewind_ticks)
+{
+    if (m_rewind_queue.getLatestUnplayedEvent() >= rewind_ticks)
+        return true;
+    auto full_state = m_local_full_state.find(rewind_ticks);
+    return m_rewind_queue.hasDivergedState(rewind_ticks,
+        full_state != m_local_full_state.end() ? &full_state->second : NULL);
+}   // isRewindNeeded
+
+// ----------------------------------------------------------------------------
+/** Used instead of rewindTo if the server states were predicted correctly.
+ *  It only removes the data which would have been used by the rewind.
+ *  \param rewind_ticks Time of the latest received states.
+ *  \param now_ticks The current world time.
+ */
+void RewindManager::skipRewind(int rewind_ticks, int now_ticks)
+{
+    m_rewind_queue.skipUntil(now_ticks);
+    m_local_state.erase(m_local_state.begin(),
+        m_local_state.upper_bound(rewind_ticks));
+    m_local_full_state.erase(m_local_full_state.begin(),
+        m_local_full_state.upper_bound(rewind_ticks));
+}   // skipRewind
+
 // ----------------------------------------------------------------------------
 /** Adds a Rewinder to the list of all rewinders.
  *  \return true If successfully added, false otherwise.
@@ -283,6 +390,7 @@ bool RewindManager::addRewinder(std::shared_ptr<Rewinder> rewinder)
 void RewindManager::rewindTo(int rewind_ticks, int now_ticks)
 {
     assert(!m_is_rewinding);
+    const double start_time = StkTime::getRealTime();
     bool is_history = history->replayHistory();
     history->setReplayHistory(false);
 
@@ -342,14 +450,40 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks)
     }
 
     // A loop in case that we should split states into several smaller ones:
+    std::set<std::string> restored;
+    unsigned state_size = 0;
     while (current && current->getTicks() == exact_rewind_ticks && 
            current->isState()                                        )
     {
         current->restore();
+        RewindInfoState* ris = static_cast<RewindInfoState*>(current);
+        const std::vector<std::string>& ru = ris->getRewinderUsing();
+        restored.insert(ru.begin(), ru.end());
+        state_size += ris->getStateSize();
         m_rewind_queue.next();
         current = m_rewind_queue.getCurrent();
     }
 
+    // Rewinders left out of the state by the server (e.g. karts far away)
+    // are restored to the state saved by the client itself
+    unsigned local_restored = 0;
+    auto full_state = m_local_full_state.find(exact_rewind_ticks);
+    if (full_state != m_local_full_state.end())
+    {
+        for (auto& state : full_state->second)
+        {
+            std::shared_ptr<Rewinder> r = getRewinder(state.first);
+            if (!r || restored.find(state.first) != restored.end())
+                continue;
+            BareNetworkString buffer(0);
+            std::swap(buffer.getBuffer(), state.second);
+            r->restoreState(&buffer, buffer.size());
+            local_restored++;
+        }
+    }
+    m_local_full_state.erase(m_local_full_state.begin(),
+        m_local_full_state.upper_bound(exact_rewind_ticks));
+
     // Now go forward through the list of rewind infos till we reach 'now':
     while (world->getTicksSinceStart() < now_ticks)
     { 
@@ -375,8 +509,60 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks)
     history->setReplayHistory(is_history);
     m_is_rewinding = false;
     mergeRewindInfoEventFunction();
+
+    const int ticks = now_ticks - exact_rewind_ticks;
+    const int time = (int)((StkTime::getRealTime() - start_time) * 1000000.0);
+    const int rewinders = (int)restored.size() + local_restored;
+    m_rewind_ticks.add(ticks);
+    m_rewind_time.add(time);
+    m_rewinders_restored.add(rewinders);
+    m_rewind_state_size.add(state_size);
+    PROFILER_ADD_TO_COUNTER("Rewind ticks", ticks);
+    PROFILER_ADD_TO_COUNTER("Rewind time (us)", time);
+    PROFILER_ADD_TO_COUNTER("Rewinders restored", rewinders);
+    PROFILER_ADD_TO_COUNTER("Rewind state size", state_size);
 }   // rewindTo
 
+// ----------------------------------------------------------------------------
+/** Writes the rewind statistics of this race as CSV and JSON files, which are
+ *  named after the stdout file (with .rewind-stats.csv/json appended).
+ */
+void RewindManager::writeStatistics() const
+{
+    if (m_rewind_ticks.getCount() == 0 && m_skipped_rewinds.load() == 0)
+        return;
+    std::string base_name =
+        file_manager->getUserConfigFile(file_manager->getStdoutName());
+
+    std::ofstream csv(base_name + ".rewind-stats.csv");
+    csv << "# skipped rewinds: " << m_skipped_rewinds.load() << "\n"
+        << "histogram,start,end,count\n";
+    m_rewind_ticks.writeCSV(csv, "ticks");
+    m_rewind_time.writeCSV(csv, "time-us");
+    m_rewinders_restored.writeCSV(csv, "rewinders");
+    m_rewind_state_size.writeCSV(csv, "state-size");
+    csv.close();
+
+    std::ofstream json(base_name + ".rewind-stats.json");
+    json << "{\n  \"skipped\": " << m_skipped_rewinds.load()
+         << ",\n  \"ticks\": ";
+    m_rewind_ticks.writeJSON(json);
+    json << ",\n  \"time-us\": ";
+    m_rewind_time.writeJSON(json);
+    json << ",\n  \"rewinders\": ";
+    m_rewinders_restored.writeJSON(json);
+    json << ",\n  \"state-size\": ";
+    m_rewind_state_size.writeJSON(json);
+    json << "\n}\n";
+    json.close();
+
+    Log::info("RewindManager", "%d rewinds (%d skipped), average %f ticks "
+        "and %f us, written to '%s.rewind-stats.csv/json'.",
+        (int)m_rewind_ticks.getCount(), (int)m_skipped_rewinds.load(),
+        m_rewind_ticks.getAverage(), m_rewind_time.getAverage(),
+        base_name.c_str());
+}   // writeStatistics
+
 // ----------------------------------------------------------------------------
 bool RewindManager::useLocalEvent() const
 {
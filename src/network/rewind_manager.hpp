@@ -20,6 +20,7 @@
 #define HEADER_REWIND_MANAGER_HPP
 
 #include "network/rewind_queue.hpp"
+#include "utils/histogram.hpp"
 #include "utils/ptr_vector.hpp"
 #include "utils/synchronised.hpp"
 
@@ -92,8 +93,18 @@ private:
      *  rewind data in case of local races only. */
     static bool           m_enable_rewind_manager;
 
+    /** If the rewind statistics are written at the end of a race. */
+    static bool           m_write_statistics;
+
     std::map<int, std::vector<std::function<void()> > > m_local_state;
 
+    /** Client only: states saved by the client itself for rewinders which
+     *  the server might leave out of a state (see
+     *  Rewinder::getRelevancePosition), indexed by ticks and rewinder name.
+     *  They are also compared with the server states to skip rewinds. */
+    std::map<int, std::map<std::string, std::vector<uint8_t> > >
+                                                          m_local_full_state;
+
     /** A list of all objects that can be rewound. */
     std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
 
@@ -116,8 +127,23 @@ private:
 
     std::vector<RewindInfoEventFunction*> m_pending_rief;
 
+    /** Client only: statistics of all rewinds in this race. The number of
+     *  ticks that were re-simulated, the time it took in microseconds, the
+     *  number of rewinders restored and the size of the restored states in
+     *  bytes. */
+    Histogram m_rewind_ticks, m_rewind_time, m_rewinders_restored,
+              m_rewind_state_size;
+
+    /** Client only: number of rewinds skipped in this race, because the
+     *  server states were predicted correctly. */
+    std::atomic<uint32_t> m_skipped_rewinds;
+
     RewindManager();
    ~RewindManager();
+    void saveLocalFullState(int ticks);
+    bool isRewindNeeded(int rewind_ticks);
+    void skipRewind(int rewind_ticks, int now_ticks);
+    void writeStatistics() const;
     // ------------------------------------------------------------------------
     void clearExpiredRewinder()
     {
@@ -146,6 +172,9 @@ public:
     /** Returns if rewinding is enabled or not. */
     static bool isEnabled() { return m_enable_rewind_manager; }
     // ------------------------------------------------------------------------
+    /** Enables writing rewind statistics when a race ends. */
+    static void setWriteStatistics(bool s)          { m_write_statistics = s; }
+    // ------------------------------------------------------------------------
     /** Returns the singleton. This function will not automatically create
      *  the singleton. */
     static RewindManager *get()
@@ -166,6 +195,8 @@ public:
                          BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
     void saveState();
+    void saveAllStates(std::map<std::string, std::vector<uint8_t> >* states);
+    void reportAllocations();
     // ------------------------------------------------------------------------
     std::shared_ptr<Rewinder> getRewinder(const std::string& name)
     {
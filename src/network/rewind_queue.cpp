@@ -28,11 +28,14 @@
 
 #include <algorithm>
 
+const unsigned RewindQueue::MAX_RING_SIZE = 65536;
+const float RewindQueue::MAX_EVENT_AHEAD_TIME = 5.0f;
+
 /** The RewindQueue stores one TimeStepInfo for each time step done.
  *  The TimeStepInfo stores all states and events to be used at the
  *  given timestep. 
  *  All network events (i.e. new states or client events) are stored in a
- *  separate list m_network_events. At the very start of a new time step
+ *  separate lock-free queue m_network_queue. At the very start of a new time step
  *  a new TimeStepInfo object is added. Then all network events that are
  *  supposed to happen between t and t+dt are added to this newly added
  *  TimeStep (see mergeNetworkData), and are then being executed.
@@ -42,8 +45,9 @@
  *  then the rewind manager re-executes the time steps (using the events
  *  stored at each timestep).
  */
-RewindQueue::RewindQueue()
+RewindQueue::RewindQueue() : m_network_queue(1024)
 {
+    m_has_network_overflow.store(false);
     reset();
 }   // RewindQueue
 
@@ -62,54 +66,139 @@ RewindQueue::~RewindQueue()
  */
 void RewindQueue::reset()
 {
-    m_network_events.lock();
+    fetchNetworkRewindInfo();
+    for (RewindInfo* ri : m_network_events)
+        delete ri;
+    m_network_events.clear();
 
-    AllNetworkRewindInfo &info = m_network_events.getData();
-    for (AllNetworkRewindInfo::const_iterator i  = info.begin(); 
-                                              i != info.end(); ++i)
+    for (TickRewindInfo& tri : m_all_rewind_info)
     {
-        delete *i;
+        for (RewindInfo* ri : tri)
+            delete ri;
+        tri.clear();
     }
-    m_network_events.getData().clear();
-    m_network_events.unlock();
-
-    AllRewindInfo::const_iterator i;
-    for (i = m_all_rewind_info.begin(); i != m_all_rewind_info.end(); ++i)
-        delete *i;
 
-    m_all_rewind_info.clear();
-    m_current = m_all_rewind_info.end();
+    // The ring needs to hold the ticks between the latest confirmed state
+    // and now, which is one state interval plus the network latency. Use
+    // one second for the latter, the ring will grow if it is not enough.
+    int state_interval = stk_config->getPhysicsFPS() /
+        NetworkConfig::get()->getStateFrequency();
+    unsigned capacity = 1;
+    while (capacity < (unsigned)(stk_config->getPhysicsFPS() +
+        2 * state_interval))
+        capacity *= 2;
+    if (m_all_rewind_info.size() < capacity)
+        m_all_rewind_info.resize(capacity);
+
+    m_first_ticks = 0;
+    m_last_ticks = -1;
+    m_current.m_ticks = END_TICKS;
+    m_current.m_index = 0;
     m_latest_confirmed_state_time = -1;
+    m_latest_unplayed_event_time = -1;
 }   // reset
 
+// ----------------------------------------------------------------------------
+/** Makes sure that all ticks from first_ticks to last_ticks can be stored
+ *  in the ring buffer, and grows it if necessary.
+ *  \param first_ticks The oldest ticks to be stored.
+ *  \param last_ticks The latest ticks to be stored.
+ *  \return False if more than MAX_RING_SIZE ticks would be needed.
+ */
+bool RewindQueue::reserveTicks(int first_ticks, int last_ticks)
+{
+    const int64_t span = (int64_t)last_ticks - first_ticks;
+    if (span >= (int64_t)MAX_RING_SIZE)
+        return false;
+    unsigned capacity = (unsigned)m_all_rewind_info.size();
+    if (span < (int64_t)capacity)
+        return true;
+    while (span >= (int64_t)capacity)
+        capacity *= 2;
+
+    std::vector<TickRewindInfo> ring(capacity);
+    for (int t = m_first_ticks; t <= m_last_ticks; t++)
+        std::swap(ring[t & (capacity - 1)], getTickRewindInfo(t));
+    std::swap(m_all_rewind_info, ring);
+    return true;
+}   // reserveTicks
+
+// ----------------------------------------------------------------------------
+/** Moves m_current forward to the next existing RewindInfo if it points
+ *  after the end of its bucket, or sets it to the end if there is none.
+ */
+void RewindQueue::skipEmptyTicks()
+{
+    while (m_current.m_ticks <= m_last_ticks &&
+           m_current.m_index >= getTickRewindInfo(m_current.m_ticks).size())
+    {
+        m_current.m_ticks++;
+        m_current.m_index = 0;
+    }
+    if (m_current.m_ticks > m_last_ticks)
+    {
+        m_current.m_ticks = END_TICKS;
+        m_current.m_index = 0;
+    }
+}   // skipEmptyTicks
+
 // ----------------------------------------------------------------------------
 /** Inserts a RewindInfo object in the list of all events at the correct time.
  *  If there are several RewindInfo at the exact same time, state RewindInfo
  *  will be insert at the front, and event info at the end of the RewindInfo
- *  with the same time.
+ *  with the same time. A RewindInfo which can't be stored (its time is
+ *  END_TICKS, or too far away from the other stored ticks) is deleted.
  *  \param ri The RewindInfo object to insert.
- *  \param update_current If set, the current pointer will be updated if
- *         necessary to point to the new event
+ *  \return False if the RewindInfo was deleted.
  */
-void RewindQueue::insertRewindInfo(RewindInfo *ri)
+bool RewindQueue::insertRewindInfo(RewindInfo *ri)
 {
-    AllRewindInfo::iterator i = m_all_rewind_info.end();
+    const int ticks = ri->getTicks();
+    bool fits = ticks != END_TICKS;
+    if (fits && m_first_ticks <= m_last_ticks)
+    {
+        if (ticks < m_first_ticks)
+            fits = reserveTicks(ticks, m_last_ticks);
+        else if (ticks > m_last_ticks)
+            fits = reserveTicks(m_first_ticks, ticks);
+    }
+    if (!fits)
+    {
+        Log::warn("RewindQueue", "Discarding %s at %d, stored are %d to %d.",
+                  ri->isEvent() ? "event" : "state", ticks, m_first_ticks,
+                  m_last_ticks);
+        delete ri;
+        return false;
+    }
 
-    while (i != m_all_rewind_info.begin())
+    if (m_first_ticks > m_last_ticks)
+        m_first_ticks = m_last_ticks = ticks;
+    else if (ticks < m_first_ticks)
+        m_first_ticks = ticks;
+    else if (ticks > m_last_ticks)
+        m_last_ticks = ticks;
+
+    TickRewindInfo& tri = getTickRewindInfo(ticks);
+    unsigned index = 0;
+    if (ri->isEvent())
     {
-        AllRewindInfo::iterator i_prev = i;
-        i_prev--;
-        // Now test if 'ri' needs to be inserted after the
-        // previous element, i.e. before the current element:
-        if ((*i_prev)->getTicks() < ri->getTicks()) break;
-        if ((*i_prev)->getTicks() == ri->getTicks() &&
-            ri->isEvent()                              ) break;
-        i = i_prev;
+        index = (unsigned)tri.size();
+        tri.push_back(ri);
     }
-    if(m_current == m_all_rewind_info.end())
-        m_current = m_all_rewind_info.insert(i, ri);
     else
-        m_all_rewind_info.insert(i, ri);  
+        tri.insert(tri.begin(), ri);
+
+    if (m_current.m_ticks == END_TICKS)
+    {
+        m_current.m_ticks = ticks;
+        m_current.m_index = index;
+    }
+    else if (m_current.m_ticks == ticks && index <= m_current.m_index)
+    {
+        // Keep m_current pointing to the same RewindInfo
+        m_current.m_index++;
+    }
+    return true;
 }   // insertRewindInfo
 
 // ----------------------------------------------------------------------------
@@ -143,8 +232,8 @@ void RewindQueue::addLocalState(BareNetworkString *buffer,
 {
     RewindInfo *ri = new RewindInfoState(ticks, buffer, confirmed);
     assert(ri);
-    insertRewindInfo(ri);
-    if (confirmed && m_latest_confirmed_state_time < ticks)
+    if (insertRewindInfo(ri) && confirmed &&
+        m_latest_confirmed_state_time < ticks)
     {
         cleanupOldRewindInfo(ticks);
     }
@@ -163,10 +252,7 @@ void RewindQueue::addNetworkEvent(EventRewinder *event_rewinder,
 {
     RewindInfo *ri = new RewindInfoEvent(ticks, event_rewinder,
                                          buffer, /*confirmed*/true);
-
-    m_network_events.lock();
-    m_network_events.getData().push_back(ri);
-    m_network_events.unlock();
+    addNetworkRewindInfo(ri);
 }   // addNetworkEvent
 
 // ----------------------------------------------------------------------------
@@ -180,12 +266,48 @@ void RewindQueue::addNetworkEvent(EventRewinder *event_rewinder,
 void RewindQueue::addNetworkState(BareNetworkString *buffer, int ticks)
 {
     RewindInfo *ri = new RewindInfoState(ticks, buffer, /*confirmed*/true);
-
-    m_network_events.lock();
-    m_network_events.getData().push_back(ri);
-    m_network_events.unlock();
+    addNetworkRewindInfo(ri);
 }   // addNetworkState
 
+// ----------------------------------------------------------------------------
+/** Adds a RewindInfo received from the network. This function is
+ *  threadsafe and does not block the main thread.
+ *  \param ri The RewindInfo, which is freed by the queue.
+ */
+void RewindQueue::addNetworkRewindInfo(RewindInfo* ri)
+{
+    // Once the queue overflowed, keep adding to the overflow list so the
+    // order of the data is kept
+    if (!m_has_network_overflow.load() && m_network_queue.push(ri))
+        return;
+    m_network_overflow.lock();
+    m_network_overflow.getData().push_back(ri);
+    m_has_network_overflow.store(true);
+    m_network_overflow.unlock();
+}   // addNetworkRewindInfo
+
+// ----------------------------------------------------------------------------
+/** Moves all RewindInfo received from the network so far into
+ *  m_network_events. Must only be called from the main thread.
+ */
+void RewindQueue::fetchNetworkRewindInfo()
+{
+    RewindInfo* ri;
+    while (m_network_queue.pop(&ri))
+        m_network_events.push_back(ri);
+    // The overflow data was received after the data in the queue
+    if (m_has_network_overflow.load())
+    {
+        m_network_overflow.lock();
+        AllNetworkRewindInfo& overflow = m_network_overflow.getData();
+        m_network_events.insert(m_network_events.end(), overflow.begin(),
+                                overflow.end());
+        overflow.clear();
+        m_has_network_overflow.store(false);
+        m_network_overflow.unlock();
+    }
+}   // fetchNetworkRewindInfo
+
 // ----------------------------------------------------------------------------
 /** Merges thread-safe all data received from the network up to and including
  *  the current time (tick) with the current local rewind information.
@@ -201,12 +323,9 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
                                    int *rewind_ticks)
 {
     *needs_rewind = false;
-    m_network_events.lock();
-    if(m_network_events.getData().empty())
-    {
-        m_network_events.unlock();
+    fetchNetworkRewindInfo();
+    if(m_network_events.empty())
         return;
-    }
 
     // Merge all newly received network events into the main event list.
     // Only a client ever rewinds. So the rewind time should be the latest
@@ -216,9 +335,22 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
     // FIXME: making m_network_events sorted would prevent the need to 
     // go through the whole list of events
     int latest_confirmed_state = -1;
-    AllNetworkRewindInfo::iterator i = m_network_events.getData().begin();
-    while (i != m_network_events.getData().end())
+    const int max_ahead_ticks = stk_config->time2Ticks(MAX_EVENT_AHEAD_TIME);
+    AllNetworkRewindInfo::iterator i = m_network_events.begin();
+    while (i != m_network_events.end())
     {
+        // The time of an event is set by the client that sent it, so the
+        // server discards events too far in the future instead of keeping
+        // them until then.
+        if (NetworkConfig::get()->isServer() &&
+            (int64_t)(*i)->getTicks() - world_ticks > max_ahead_ticks)
+        {
+            Log::warn("RewindQueue", "Server discarded at %d message from %d",
+                      world_ticks, (*i)->getTicks());
+            delete *i;
+            i = m_network_events.erase(i);
+            continue;
+        }
         // Ignore any events that will happen in the future. The current
         // time step is world_ticks.
         if ((*i)->getTicks() > world_ticks)
@@ -236,7 +368,7 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
                       (*i)->getTicks(),
                       m_latest_confirmed_state_time);
             delete *i;
-            i = m_network_events.getData().erase(i);
+            i = m_network_events.erase(i);
             continue;
         }
 
@@ -254,7 +386,11 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
             (*i)->setTicks(world_ticks);
         }
 
-        insertRewindInfo(*i);
+        if (!insertRewindInfo(*i))
+        {
+            i = m_network_events.erase(i);
+            continue;
+        }
 
         // Check if a rewind is necessary, i.e. a message is received in the
         // past of client (server never rewinds). Even if
@@ -277,6 +413,13 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
             if ((*i)->getTicks() > *rewind_ticks)
                 *rewind_ticks = (*i)->getTicks();
         }   // if client and ticks < world_ticks
+        else if (NetworkConfig::get()->isClient() &&
+                 (*i)->getTicks() < world_ticks && (*i)->isEvent() &&
+                 (*i)->getTicks() > m_latest_unplayed_event_time)
+        {
+            // This event will only be played in the next rewind
+            m_latest_unplayed_event_time = (*i)->getTicks();
+        }
 
         if ((*i)->isState() && (*i)->getTicks() > latest_confirmed_state &&
             (*i)->isConfirmed())
@@ -284,11 +427,9 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
             latest_confirmed_state = (*i)->getTicks();
         }
 
-        i = m_network_events.getData().erase(i);
+        i = m_network_events.erase(i);
     }   // for i in m_network_events
 
-    m_network_events.unlock();
-
     if (latest_confirmed_state > m_latest_confirmed_state_time)
     {
         cleanupOldRewindInfo(latest_confirmed_state);
@@ -319,21 +460,31 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
  */
 void RewindQueue::cleanupOldRewindInfo(int ticks)
 {
-    auto i = m_all_rewind_info.begin();
-
-    while ( (*i)->getTicks() < ticks)
+    const int end_ticks = std::min(ticks, m_last_ticks + 1);
+    for (int t = m_first_ticks; t < end_ticks; t++)
     {
-        if (m_current == i) next();
-        delete *i;
-        i = m_all_rewind_info.erase(i);
+        TickRewindInfo& tri = getTickRewindInfo(t);
+        for (RewindInfo* ri : tri)
+            delete ri;
+        tri.clear();
     }
+    if (end_ticks <= m_first_ticks)
+        return;
+    m_first_ticks = end_ticks;
 
+    // Move m_current to the first remaining RewindInfo if it was deleted
+    if (m_current.m_ticks != END_TICKS && m_current.m_ticks < m_first_ticks)
+    {
+        m_current.m_ticks = m_first_ticks;
+        m_current.m_index = 0;
+        skipEmptyTicks();
+    }
 }   // cleanupOldRewindInfo
 
 // ----------------------------------------------------------------------------
 bool RewindQueue::isEmpty() const
 {
-    return m_current == m_all_rewind_info.end();
+    return m_current.m_ticks == END_TICKS;
 }   // isEmpty
 
 // ----------------------------------------------------------------------------
@@ -341,9 +492,23 @@ bool RewindQueue::isEmpty() const
  */
 bool RewindQueue::hasMoreRewindInfo() const
 {
-    return m_current != m_all_rewind_info.end();
+    return m_current.m_ticks != END_TICKS;
 }   // hasMoreRewindInfo
 
+// ----------------------------------------------------------------------------
+/** Returns all RewindInfo in the queue in order, used in unit testing.
+ */
+std::vector<RewindInfo*> RewindQueue::getAllRewindInfo() const
+{
+    std::vector<RewindInfo*> all;
+    for (int t = m_first_ticks; t <= m_last_ticks; t++)
+    {
+        const TickRewindInfo& tri = getTickRewindInfo(t);
+        all.insert(all.end(), tri.begin(), tri.end());
+    }
+    return all;
+}   // getAllRewindInfo
+
 // ----------------------------------------------------------------------------
 /** Rewinds the rewind queue and undos all events/states stored. It stops
  *  when the first confirmed state is reached that was recorded before the
@@ -355,41 +520,100 @@ int RewindQueue::undoUntil(int undo_ticks)
 {
     // A rewind is done after a state in the past is inserted. This function
     // makes sure that m_current is not end()
-    //assert(m_current != m_all_rewind_info.end());
-    assert(!m_all_rewind_info.empty());
-    m_current = m_all_rewind_info.end();
-    m_current--;
-    while((*m_current)->getTicks() > undo_ticks ||
-        (*m_current)->isEvent() || !(*m_current)->isConfirmed())
+    assert(m_first_ticks <= m_last_ticks);
+    // All events after the state will be replayed
+    m_latest_unplayed_event_time = -1;
+    m_current.m_ticks = m_last_ticks;
+    m_current.m_index = (unsigned)getTickRewindInfo(m_last_ticks).size();
+    while (true)
     {
-        // Undo all events and states from the current time
-        (*m_current)->undo();
-        if(m_current == m_all_rewind_info.begin())
+        if (m_current.m_index == 0)
         {
-            // This shouldn't happen, but add some debug info just in case
-            Log::error("undoUntil",
-                       "At %d rewinding to %d current = %d = begin",
-                       World::getWorld()->getTicksSinceStart(), undo_ticks, 
-                       (*m_current)->getTicks());
+            if (m_current.m_ticks == m_first_ticks)
+            {
+                // This shouldn't happen, but add some debug info just in case
+                Log::error("undoUntil",
+                           "At %d rewinding to %d current = %d = begin",
+                           World::getWorld()->getTicksSinceStart(),
+                           undo_ticks, m_current.m_ticks);
+                skipEmptyTicks();
+                break;
+            }
+            m_current.m_ticks--;
+            m_current.m_index =
+                (unsigned)getTickRewindInfo(m_current.m_ticks).size();
+            continue;
         }
-        m_current--;
+        m_current.m_index--;
+        RewindInfo* ri = getCurrent();
+        if (ri->getTicks() <= undo_ticks && ri->isState() &&
+            ri->isConfirmed())
+            break;
+        // Undo all events and states from the current time
+        ri->undo();
     }
 
-    return (*m_current)->getTicks();
+    return m_current.m_ticks;
 }   // undoUntil
 
+// ----------------------------------------------------------------------------
+/** Used instead of a rewind if the received states were predicted
+ *  correctly: the states are kept in the queue, but the current pointer is
+ *  moved forward to the given time, as if the rewind had been done.
+ *  \param ticks The current world time.
+ */
+void RewindQueue::skipUntil(int ticks)
+{
+    if (m_current.m_ticks == END_TICKS || m_current.m_ticks >= ticks)
+        return;
+    m_current.m_ticks = ticks;
+    m_current.m_index = 0;
+    skipEmptyTicks();
+}   // skipUntil
+
+// ----------------------------------------------------------------------------
+/** Returns true if any of the states at the given time differs from the
+ *  states predicted by the client (see RewindInfoState::hasDiverged), or
+ *  if there is no state at that time.
+ *  \param ticks Time of the states.
+ *  \param predicted The states saved by the client at that time, or NULL.
+ */
+bool RewindQueue::hasDivergedState(int ticks,
+                    std::map<std::string, std::vector<uint8_t> >* predicted)
+{
+    if (ticks < m_first_ticks || ticks > m_last_ticks)
+        return true;
+    bool has_state = false;
+    for (RewindInfo* ri : getTickRewindInfo(ticks))
+    {
+        // States are always at the front
+        if (!ri->isState())
+            break;
+        has_state = true;
+        if (static_cast<RewindInfoState*>(ri)->hasDiverged(predicted))
+            return true;
+    }
+    return !has_state;
+}   // hasDivergedState
+
 // ----------------------------------------------------------------------------
 /** Replays all events (not states) that happened at the specified time.
  *  \param ticks Time in ticks.
  */
 void RewindQueue::replayAllEvents(int ticks)
 {
+    // A server never rewinds, so everything before the current time step
+    // can be freed
+    if (NetworkConfig::get()->isServer())
+        cleanupOldRewindInfo(ticks);
+
     // Replay all events that happened at the current time step
-    while ( hasMoreRewindInfo() && (*m_current)->getTicks() == ticks )
+    while (hasMoreRewindInfo() && m_current.m_ticks == ticks)
     {
-        if ((*m_current)->isEvent())
-            (*m_current)->replay();
-        m_current++;
+        RewindInfo* ri = getCurrent();
+        if (ri->isEvent())
+            ri->replay();
+        next();
     }   // while current->getTIcks == ticks
 
 }   // replayAllEvents
@@ -415,57 +639,53 @@ void RewindQueue::unitTesting()
     assert(!q0.hasMoreRewindInfo());
 
     q0.addLocalState(NULL, /*confirmed*/true, 0);
-    assert(q0.m_all_rewind_info.front()->isState());
-    assert(!q0.m_all_rewind_info.front()->isEvent());
+    std::vector<RewindInfo*> all = q0.getAllRewindInfo();
+    assert(all.front()->isState());
+    assert(!all.front()->isEvent());
     assert(q0.hasMoreRewindInfo());
     assert(q0.undoUntil(0) == 0);
 
     q0.addNetworkEvent(dummy_rewinder.get(), NULL, 0);
     // Network events are not immediately merged
-    assert(q0.m_all_rewind_info.size() == 1);
+    assert(q0.getAllRewindInfo().size() == 1);
 
     bool needs_rewind;
     int rewind_ticks;
     int world_ticks = 0;
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
     assert(q0.hasMoreRewindInfo());
-    assert(q0.m_all_rewind_info.size() == 2);
-    AllRewindInfo::iterator rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    all = q0.getAllRewindInfo();
+    assert(all.size() == 2);
+    assert(all[0]->isState());
+    assert(all[1]->isEvent());
 
     // Another state must be sorted before the event:
     q0.addNetworkState(NULL, 0);
     assert(q0.hasMoreRewindInfo());
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
-    assert(q0.m_all_rewind_info.size() == 3);
-    rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    all = q0.getAllRewindInfo();
+    assert(all.size() == 3);
+    assert(all[0]->isState());
+    assert(all[1]->isState());
+    assert(all[2]->isEvent());
 
     // Test time base comparisons: adding an event to the end
     q0.addLocalEvent(dummy_rewinder.get(), NULL, true, 4);
     // Then adding an earlier event
     q0.addLocalEvent(dummy_rewinder.get(), NULL, false, 1);
-    // rii points to the 3rd element, the ones added just now
-    // should be elements4 and 5:
-    rii++;
-    assert((*rii)->getTicks()==1);
-    rii++;
-    assert((*rii)->getTicks()==4);
+    // The ones added just now should be elements 4 and 5:
+    all = q0.getAllRewindInfo();
+    assert(all.size() == 5);
+    assert(all[3]->getTicks()==1);
+    assert(all[4]->getTicks()==4);
 
     // Now test inserting an event first, then the state
     RewindQueue q1;
     q1.addLocalEvent(NULL, NULL, true, 5);
     q1.addLocalState(NULL, true, 5);
-    rii = q1.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    all = q1.getAllRewindInfo();
+    assert(all[0]->isState());
+    assert(all[1]->isEvent());
 
     // Bugs seen before
     // ----------------
@@ -484,7 +704,7 @@ void RewindQueue::unitTesting()
     //    event, that m_current pooints to the first event, otherwise
     //    events with same time stamp will not be handled correctly.
     //    At this stage current points to the event at time 2 from above
-    AllRewindInfo::iterator current_old = b1.m_current;
+    Position current_old = b1.m_current;
     b1.addLocalEvent(NULL, NULL, true, 2);
     // Make sure that current was not modified, i.e. the new event at time
     // 2 was added at the end of the list:
@@ -497,7 +717,7 @@ void RewindQueue::unitTesting()
     assert(ri->getTicks() == 2);
     assert(ri->isEvent());
     b1.next();
-    assert(b1.m_current == b1.m_all_rewind_info.end());
+    assert(!b1.hasMoreRewindInfo());
 
     // 3) Test that if cleanupOldRewindInfo is called, it will if necessary
     //    adjust m_current to point to the latest confirmed state.
@@ -506,7 +726,60 @@ void RewindQueue::unitTesting()
     b2.addNetworkState(NULL, 2);
     b2.addNetworkState(NULL, 3);
     b2.mergeNetworkData(4, &needs_rewind, &rewind_ticks);
-    assert((*b2.m_current)->getTicks() == 3);
-
+    assert(b2.getCurrent()->getTicks() == 3);
+    assert(b2.getAllRewindInfo().size() == 1);
+
+    // Ring buffer: storing more ticks than its size must grow it and keep
+    // the order, and undoing must find the confirmed state
+    RewindQueue r1;
+    const int ring_size = (int)r1.m_all_rewind_info.size();
+    r1.addLocalState(NULL, true, 3);
+    for (int t = 3; t < 3 + 3 * ring_size; t += 7)
+        r1.addLocalEvent(NULL, NULL, true, t);
+    assert((int)r1.m_all_rewind_info.size() > ring_size);
+    all = r1.getAllRewindInfo();
+    assert(all[0]->isState());
+    for (unsigned i = 1; i < all.size(); i++)
+        assert(all[i - 1]->getTicks() <= all[i]->getTicks());
+    while (r1.hasMoreRewindInfo())
+        r1.next();
+    r1.addLocalState(NULL, true, 3 + 2 * ring_size);
+    assert(r1.getCurrent()->getTicks() == 3 + 2 * ring_size);
+    r1.cleanupOldRewindInfo(3 + 2 * ring_size);
+    assert(r1.getAllRewindInfo().front()->isState());
+
+    // Skipping a rewind moves current past the ticks that would have been
+    // replayed
+    RewindQueue s1;
+    s1.addLocalState(NULL, true, 5);
+    s1.addLocalEvent(NULL, NULL, true, 6);
+    s1.addLocalEvent(NULL, NULL, true, 9);
+    assert(s1.getCurrent()->getTicks() == 5);
+    s1.skipUntil(8);
+    assert(s1.getCurrent()->getTicks() == 9);
+    s1.skipUntil(10);
+    assert(!s1.hasMoreRewindInfo());
+
+    // Ticks which can't be stored are discarded instead of growing the ring
+    RewindQueue l1;
+    l1.addLocalEvent(NULL, NULL, true, 1);
+    l1.addLocalEvent(NULL, NULL, true, END_TICKS);
+    l1.addLocalEvent(NULL, NULL, true, 1 + (int)MAX_RING_SIZE);
+    l1.addLocalEvent(NULL, NULL, true, std::numeric_limits<int>::min());
+    assert(l1.getAllRewindInfo().size() == 1);
+    assert(l1.m_all_rewind_info.size() <= MAX_RING_SIZE);
+
+    // A server discards events from too far in the future
+    const bool is_server = NetworkConfig::get()->isServer();
+    NetworkConfig::get()->setIsServer(true);
+    RewindQueue l2;
+    l2.addNetworkEvent(NULL, NULL, std::numeric_limits<int>::max());
+    l2.addNetworkEvent(NULL, NULL, 12);
+    l2.mergeNetworkData(10, &needs_rewind, &rewind_ticks);
+    assert(l2.m_network_events.size() == 1);
+    l2.mergeNetworkData(12, &needs_rewind, &rewind_ticks);
+    assert(l2.m_network_events.empty());
+    assert(l2.getCurrent()->getTicks() == 12);
+    NetworkConfig::get()->setIsServer(is_server);
 
 }   // unitTesting
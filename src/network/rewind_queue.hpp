@@ -19,10 +19,14 @@
 #ifndef HEADER_REWIND_QUEUE_HPP
 #define HEADER_REWIND_QUEUE_HPP
 
+#include "utils/mpsc_queue.hpp"
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
-#include <list>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <string>
 #include <vector>
 
 class BareNetworkString;
@@ -31,32 +35,105 @@ class RewindInfo;
 class TimeStepInfo;
 
 /** \ingroup network
+ *  Stores all RewindInfo sorted by time. The RewindInfo are kept in a ring
+ *  buffer with one bucket per tick (the bucket index is the tick modulo
+ *  the ring size), so inserting at a given tick and removing all old ticks
+ *  is done without searching, and the buckets keep their memory when they
+ *  are reused. Inside a bucket all states come before all events. The ring
+ *  grows if more ticks need to be stored than it can hold.
  */
 
 class RewindQueue
 {
 private:
+    /** All RewindInfo at the same tick: states first, then events. */
+    typedef std::vector<RewindInfo*> TickRewindInfo;
 
-    typedef std::list<RewindInfo*> AllRewindInfo;
+    /** The ring buffer, its size is always a power of 2. Only the buckets
+     *  between m_first_ticks and m_last_ticks contain data. */
+    std::vector<TickRewindInfo> m_all_rewind_info;
 
-    AllRewindInfo m_all_rewind_info;
+    /** The oldest tick stored in the ring buffer. */
+    int m_first_ticks;
 
-    /** The list of all events received from the network. They are stored
-     *  in a separate thread (so this data structure is thread-save), and
-     *  merged into m_rewind_info from the main thread. This design (as
-     *  opposed to locking m_rewind_info) reduces the synchronisation
-     *  between main thread and network thread. */
+    /** The latest tick stored in the ring buffer. If it is smaller than
+     *  m_first_ticks the queue is empty. */
+    int m_last_ticks;
+
+    /** All events and states received from the network. They are added
+     *  by the network thread to this lock-free queue, and merged into
+     *  m_all_rewind_info from the main thread. This design (as opposed to
+     *  locking m_all_rewind_info) avoids that the main thread and the
+     *  network thread have to wait for each other. */
+    MPSCQueue<RewindInfo*> m_network_queue;
+
+    /** Network data which did not fit into m_network_queue. This should
+     *  only happen if the main thread stalls (e.g. while loading). */
     typedef std::vector<RewindInfo*> AllNetworkRewindInfo;
-    Synchronised<AllNetworkRewindInfo> m_network_events;
+    Synchronised<AllNetworkRewindInfo> m_network_overflow;
 
-    /** Iterator to the curren time step info to be handled. */
-    AllRewindInfo::iterator m_current;
+    /** True if m_network_overflow contains data, so the main thread only
+     *  has to lock it in this case. */
+    std::atomic<bool> m_has_network_overflow;
+
+    /** Network data taken from the queues which is in the future of the
+     *  current world time, so it is not merged yet. Only used by the main
+     *  thread. */
+    AllNetworkRewindInfo m_network_events;
+
+    /** A position in the queue: the tick and the index in the bucket. */
+    struct Position
+    {
+        int m_ticks;
+        unsigned m_index;
+        // --------------------------------------------------------------------
+        bool operator==(const Position& p) const
+        {
+            return m_ticks == p.m_ticks && m_index == p.m_index;
+        }
+        // --------------------------------------------------------------------
+        bool operator!=(const Position& p) const      { return !(*this == p); }
+    };   // struct Position
+
+    /** Ticks used for m_current if there is no more RewindInfo to handle. */
+    static const int END_TICKS = std::numeric_limits<int>::max();
+
+    /** The ring buffer never grows beyond this number of ticks. */
+    static const unsigned MAX_RING_SIZE;
+
+    /** Server only: network events which are more than this many seconds
+     *  after the current world time are discarded. */
+    static const float MAX_EVENT_AHEAD_TIME;
+
+    /** The current RewindInfo to be handled. */
+    Position m_current;
 
     /** Time at which the latest confirmed state is at. */
     int m_latest_confirmed_state_time;
 
+    /** Client only: latest time of a network event which was received
+     *  after its time had passed, so it was not played yet. A rewind to a
+     *  state at or before this time is needed to play it. */
+    int m_latest_unplayed_event_time;
 
     void cleanupOldRewindInfo(int ticks);
+    bool reserveTicks(int first_ticks, int last_ticks);
+    void skipEmptyTicks();
+    void fetchNetworkRewindInfo();
+    std::vector<RewindInfo*> getAllRewindInfo() const;
+
+    // ------------------------------------------------------------------------
+    /** Returns the bucket for the given ticks, which must be between
+     *  m_first_ticks and m_last_ticks. */
+    TickRewindInfo& getTickRewindInfo(int ticks)
+    {
+        return m_all_rewind_info[ticks & (m_all_rewind_info.size() - 1)];
+    }   // getTickRewindInfo
+    // ------------------------------------------------------------------------
+    const TickRewindInfo& getTickRewindInfo(int ticks) const
+    {
+        return m_all_rewind_info[ticks & (m_all_rewind_info.size() - 1)];
+    }   // getTickRewindInfo
 
 public:
         static void unitTesting();
@@ -70,19 +147,17 @@ public:
     void addNetworkEvent(EventRewinder *event_rewinder,
                          BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
-    void addNetworkRewindInfo(RewindInfo* ri)
-    {
-        m_network_events.lock();
-        m_network_events.getData().push_back(ri);
-        m_network_events.unlock();
-    }
+    void addNetworkRewindInfo(RewindInfo* ri);
     void mergeNetworkData(int world_ticks,  bool *needs_rewind, 
                           int *rewind_ticks);
     void replayAllEvents(int ticks);
     bool isEmpty() const;
     bool hasMoreRewindInfo() const;
     int  undoUntil(int undo_ticks);
-    void insertRewindInfo(RewindInfo *ri);
+    void skipUntil(int ticks);
+    bool insertRewindInfo(RewindInfo *ri);
+    bool hasDivergedState(int ticks,
+                 std::map<std::string, std::vector<uint8_t> >* predicted);
 
     // ------------------------------------------------------------------------
     /** Returns the time of the latest confirmed state. */
@@ -91,13 +166,17 @@ public:
         return m_latest_confirmed_state_time;
     }
     // ------------------------------------------------------------------------
+    /** Returns the latest time of a network event that was not played yet,
+     *  or -1. */
+    int getLatestUnplayedEvent() const { return m_latest_unplayed_event_time; }
+    // ------------------------------------------------------------------------
     /** Sets the current element to be the next one and returns the next
      *  RewindInfo element. */
     void next()
     {
-        assert(m_current != m_all_rewind_info.end());
-        m_current++;
-        return;
+        assert(m_current.m_ticks != END_TICKS);
+        m_current.m_index++;
+        skipEmptyTicks();
     }   // operator++
 
     // ------------------------------------------------------------------------
@@ -105,7 +184,8 @@ public:
      *  least one more RewindInfo (see hasMoreRewindInfo()). */
     RewindInfo* getCurrent()
     {
-        return (m_current != m_all_rewind_info.end() ) ? *m_current : NULL;
+        return m_current.m_ticks != END_TICKS ?
+            getTickRewindInfo(m_current.m_ticks)[m_current.m_index] : NULL;
     }   // getNext
 
 };   // RewindQueue
@@ -26,6 +26,7 @@
 #include <vector>
 
 class BareNetworkString;
+class Vec3;
 
 class Rewinder : public std::enable_shared_from_this<Rewinder>
 {
@@ -57,12 +58,15 @@ public:
      *  caused by the rewind (which is then visually smoothed over time). */
     virtual void computeError() = 0;
 
-    /** Provides a copy of the state of the object in one memory buffer.
-     *  The memory is managed by the RewindManager.
+    /** Appends the state of the object to a buffer, which is the state
+     *  message sent to the clients.
+     *  \param buffer The buffer to append the state to.
      *  \param[out] ru The unique identity of rewinder writing to.
-     *  \return The address of the memory buffer with the state.
+     *  \return False if no state is saved, in which case nothing must be
+     *          added to the buffer or ru.
      */
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru) = 0;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) = 0;
 
     /** Called when an event needs to be undone. This is called while going
      *  backwards for rewinding - all stored events will get an 'undo' call.
@@ -93,6 +97,28 @@ public:
     virtual std::function<void()> getLocalStateRestoreFunction()
                                                              { return nullptr; }
     // -------------------------------------------------------------------------
+    /** Returns the position of this object, which the server uses to send
+     *  its state less often to players far away. In that case the client
+     *  uses a state it saved itself (see RewindManager::update). Objects
+     *  without a position (the default) are included in every state.
+     *  \param[out] xyz The position of the object.
+     */
+    virtual bool getRelevancePosition(Vec3* xyz) const        { return false; }
+    // -------------------------------------------------------------------------
+    /** Called on a client to check if a state received from the server
+     *  differs from the state this client predicted for the same time. If
+     *  no object in a state has diverged the rewind is skipped. By default
+     *  a rewind is always done.
+     *  \param buffer The state from the server.
+     *  \param count Number of bytes of the state in buffer, not all of them
+     *         need to be read.
+     *  \param predicted The state saved by this client itself at the same
+     *         time (see RewindManager::update), or NULL if there is none.
+     */
+    virtual bool hasDiverged(BareNetworkString *buffer, int count,
+                             const BareNetworkString *predicted)
+                                                              { return true; }
+    // -------------------------------------------------------------------------
     const std::string& getUniqueIdentity() const
     {
         assert(!m_unique_identity.empty() && m_unique_identity.size() < 255);
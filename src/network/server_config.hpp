@@ -311,6 +311,39 @@ namespace ServerConfig
         "more rewind, which clients with slow device may have problem playing "
         "this server, use the default value is recommended."));
 
+    SERVER_CFG_PREFIX BoolServerConfigParam m_delta_state
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(true, "delta-state",
+        "Send each state as the difference to the last state acknowledged "
+        "by a player instead of the full state, which reduces the upload "
+        "bandwidth required by the server."));
+
+    SERVER_CFG_PREFIX FloatServerConfigParam m_state_relevance_distance
+        SERVER_CFG_DEFAULT(FloatServerConfigParam(100.0f,
+        "state-relevance-distance",
+        "Karts further away than this distance (in meters) from all karts of "
+        "a player are only sent in every state-relevance-interval state to "
+        "this player, which reduces the bandwidth for servers with many "
+        "players. Use 0 to always send all karts."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_state_relevance_interval
+        SERVER_CFG_DEFAULT(IntServerConfigParam(4,
+        "state-relevance-interval",
+        "See state-relevance-distance."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_send_threads
+        SERVER_CFG_DEFAULT(IntServerConfigParam(0,
+        "send-threads",
+        "Number of threads which encrypt the packets sent to players in "
+        "parallel. Use 0 to choose it from the number of CPU cores (at most "
+        "4), or 1 to send all packets from the game thread."));
+
+    SERVER_CFG_PREFIX BoolServerConfigParam m_record_history
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "record-history",
+        "Record the actions of all players and the states of each race in a "
+        "compressed file (server-history-<port>-<date>.dat) in the config "
+        "directory, which allows simulating the race again for debugging "
+        "with --simulate-history=file (linear races only)."));
+
     SERVER_CFG_PREFIX StringToUIntServerConfigParam m_server_ip_ban_list
         SERVER_CFG_DEFAULT(StringToUIntServerConfigParam("server-ip-ban-list",
         "ip: IP in X.X.X.X/Y (CIDR) format for banning, use Y of 32 for a "
@@ -329,7 +362,7 @@ namespace ServerConfig
 
     // ========================================================================
     /** Server version, will be advanced if there are protocol changes. */
-    static const uint32_t m_server_version = 5;
+    static const uint32_t m_server_version = 7;
     // ========================================================================
     void loadServerConfig(const std::string& path = "");
     // ------------------------------------------------------------------------
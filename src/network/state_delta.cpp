@@ -0,0 +1,173 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/state_delta.hpp"
+
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+
+#include <stdexcept>
+
+namespace StateDelta
+{
+    /** Minimum number of unchanged bytes that end a run of changed bytes.
+     *  Shorter runs of unchanged bytes are cheaper to send as part of the
+     *  changed bytes than to start a new triplet. */
+    const unsigned MIN_UNCHANGED_RUN = 4;
+    // ------------------------------------------------------------------------
+    /** Returns the byte of the base state at the given position, or 0 if
+     *  the base state is shorter. */
+    inline uint8_t baseAt(const std::vector<uint8_t>& base, unsigned i)
+    {
+        return i < base.size() ? base[i] : 0;
+    }   // baseAt
+
+    // ------------------------------------------------------------------------
+    /** Encodes a state as a delta against a base state.
+     *  \param base The base state that the receiver has.
+     *  \param state Pointer to the new state.
+     *  \param state_size Size of the new state.
+     *  \param out The network string to which the delta is appended.
+     */
+    void encode(const std::vector<uint8_t>& base,
+                const uint8_t* state, unsigned state_size,
+                BareNetworkString* out)
+    {
+        unsigned i = 0;
+        while (i < state_size)
+        {
+            unsigned changed = i;
+            while (changed < state_size &&
+                   state[changed] == baseAt(base, changed))
+                changed++;
+
+            unsigned end = changed;
+            while (end < state_size)
+            {
+                unsigned same = 0;
+                while (end + same < state_size && same < MIN_UNCHANGED_RUN &&
+                       state[end + same] == baseAt(base, end + same))
+                    same++;
+                if (same == MIN_UNCHANGED_RUN || end + same == state_size)
+                    break;
+                // Include the short unchanged run and the changed byte
+                // following it
+                end += same + 1;
+            }
+
+            out->addVarUInt32(changed - i).addVarUInt32(end - changed);
+            for (unsigned j = changed; j < end; j++)
+                out->addUInt8(state[j] ^ baseAt(base, j));
+            i = end;
+        }
+    }   // encode
+
+    // ------------------------------------------------------------------------
+    /** Reconstructs a state from a delta created with encode().
+     *  \param base The base state the delta was encoded against.
+     *  \param in The network string containing (only) the delta, starting at
+     *         its current read offset.
+     *  \param state_size Size of the reconstructed state.
+     *  \param out Stores the reconstructed state.
+     *  \return False if the delta is malformed.
+     */
+    bool decode(const std::vector<uint8_t>& base, const BareNetworkString& in,
+                unsigned state_size, std::vector<uint8_t>* out)
+    {
+        out->resize(state_size);
+        unsigned i = 0;
+        try
+        {
+            while (in.size() > 0)
+            {
+                uint32_t unchanged = in.getVarUInt32();
+                uint32_t changed = in.getVarUInt32();
+                if ((uint64_t)i + unchanged + changed > state_size)
+                    return false;
+                for (unsigned j = 0; j < unchanged; j++, i++)
+                    (*out)[i] = baseAt(base, i);
+                for (unsigned j = 0; j < changed; j++, i++)
+                    (*out)[i] = in.getUInt8() ^ baseAt(base, i);
+            }
+        }
+        catch (std::exception& e)
+        {
+            Log::warn("StateDelta", "Failed to decode state: %s", e.what());
+            return false;
+        }
+        return i == state_size;
+    }   // decode
+
+    // ------------------------------------------------------------------------
+    void unitTesting()
+    {
+        std::vector<uint8_t> base;
+        for (unsigned i = 0; i < 100; i++)
+            base.push_back((uint8_t)i);
+
+        // Same size, with changes at the beginning, middle (with a short
+        // unchanged gap) and end
+        std::vector<uint8_t> state = base;
+        state[0] = 200;
+        state[40] = 201;
+        state[42] = 202;
+        state[99] = 203;
+        BareNetworkString delta;
+        encode(base, state.data(), (unsigned)state.size(), &delta);
+        assert(delta.size() < state.size());
+        std::vector<uint8_t> result;
+        bool ok = decode(base, delta, (unsigned)state.size(), &result);
+        assert(ok && result == state);
+
+        // Identical states
+        BareNetworkString same;
+        encode(base, base.data(), (unsigned)base.size(), &same);
+        assert(same.size() == 2);
+        ok = decode(base, same, (unsigned)base.size(), &result);
+        assert(ok && result == base);
+
+        // Longer and shorter states than the base
+        std::vector<uint8_t> longer = base;
+        longer.push_back(0);
+        longer.push_back(7);
+        BareNetworkString grow;
+        encode(base, longer.data(), (unsigned)longer.size(), &grow);
+        ok = decode(base, grow, (unsigned)longer.size(), &result);
+        assert(ok && result == longer);
+
+        std::vector<uint8_t> shorter(base.begin(), base.begin() + 50);
+        BareNetworkString shrink;
+        encode(base, shorter.data(), (unsigned)shorter.size(), &shrink);
+        ok = decode(base, shrink, (unsigned)shorter.size(), &result);
+        assert(ok && result == shorter);
+
+        // Empty base state
+        std::vector<uint8_t> empty;
+        BareNetworkString full;
+        encode(empty, state.data(), (unsigned)state.size(), &full);
+        ok = decode(empty, full, (unsigned)state.size(), &result);
+        assert(ok && result == state);
+
+        // Wrong size must be detected
+        delta.reset();
+        ok = decode(base, delta, (unsigned)state.size() - 1, &result);
+        assert(!ok);
+        (void)ok;
+    }   // unitTesting
+
+}   // namespace StateDelta
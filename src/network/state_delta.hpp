@@ -0,0 +1,49 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_STATE_DELTA_HPP
+#define HEADER_STATE_DELTA_HPP
+
+#include <cstdint>
+#include <vector>
+
+class BareNetworkString;
+
+/** \ingroup network
+ *  Functions to encode a game state as a delta against an older state
+ *  which the receiver is known to have. Both states are XOR'ed byte by
+ *  byte (the shorter one padded with 0), and the result is stored as a
+ *  sequence of (number of unchanged bytes, number of changed bytes,
+ *  changed bytes) triplets, with both numbers as variable length integers.
+ *  Since most objects (items, resting karts, rewinder names) do not change
+ *  between two states, this is usually a lot smaller than the full state.
+ */
+namespace StateDelta
+{
+    // ------------------------------------------------------------------------
+    void encode(const std::vector<uint8_t>& base,
+                const uint8_t* state, unsigned state_size,
+                BareNetworkString* out);
+    // ------------------------------------------------------------------------
+    bool decode(const std::vector<uint8_t>& base, const BareNetworkString& in,
+                unsigned state_size, std::vector<uint8_t>* out);
+    // ------------------------------------------------------------------------
+    void unitTesting();
+}   // namespace StateDelta
+
+#endif
@@ -21,6 +21,7 @@
 #include "config/stk_config.hpp"
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
+#include "network/crypto.hpp"
 #include "network/event.hpp"
 #include "network/game_setup.hpp"
 #include "network/network_config.hpp"
@@ -39,6 +40,7 @@
 #include "utils/separate_process.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <string.h>
 #if defined(WIN32)
@@ -64,6 +66,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <random>
@@ -282,7 +285,18 @@ STKHost::STKHost(bool server)
     }
     setPrivatePort();
     if (server)
+    {
         Log::info("STKHost", "Server port is %d", m_private_port);
+        int threads = ServerConfig::m_send_threads;
+        unsigned workers = threads <= 0 ?
+            WorkerPool::getDefaultThreads(/*max_threads*/3) : threads - 1;
+        if (workers > 0)
+        {
+            m_send_workers.reset(new WorkerPool(workers, "STKHostSend"));
+            Log::info("STKHost", "Using %d threads to send packets.",
+                workers + 1);
+        }
+    }
 }   // STKHost
 
 // ----------------------------------------------------------------------------
@@ -865,12 +879,11 @@ void STKHost::mainLoop()
                 enet_packet_destroy(packet);
         }
 
-        std::list<std::tuple<ENetPeer*, ENetPacket*, uint32_t,
-            ENetCommandType> > copied_list;
+        // Execute all commands added since the last iteration as one batch
         std::unique_lock<std::mutex> lock(m_enet_cmd_mutex);
-        std::swap(copied_list, m_enet_cmd);
+        std::swap(m_enet_cmd_batch, m_enet_cmd);
         lock.unlock();
-        for (auto& p : copied_list)
+        for (auto& p : m_enet_cmd_batch)
         {
             switch (std::get<3>(p))
             {
@@ -891,6 +904,7 @@ void STKHost::mainLoop()
                 break;
             }
         }
+        m_enet_cmd_batch.clear();
 
         bool need_ping_update = false;
         while (enet_host_service(host, &event, 10) != 0)
@@ -1200,11 +1214,13 @@ bool STKHost::isConnectedTo(const TransportAddress& peer)
 void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > packets;
     for (auto p : m_peers)
     {
         if (p.second->isValidated())
-            p.second->sendPacket(data, reliable);
+            packets.emplace_back(p.second.get(), data);
     }
+    sendPackets(packets, reliable);
 }   // sendPacketToAllPeersInServer
 
 //-----------------------------------------------------------------------------
@@ -1215,11 +1231,13 @@ void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > packets;
     for (auto p : m_peers)
     {
         if (p.second->isValidated() && !p.second->isWaitingForGame())
-            p.second->sendPacket(data, reliable);
+            packets.emplace_back(p.second.get(), data);
     }
+    sendPackets(packets, reliable);
 }   // sendPacketToAllPeers
 
 //-----------------------------------------------------------------------------
@@ -1232,15 +1250,17 @@ void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
                                bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > packets;
     for (auto p : m_peers)
     {
         STKPeer* stk_peer = p.second.get();
         if (!stk_peer->isSamePeer(peer) && p.second->isValidated() &&
             !p.second->isWaitingForGame())
         {
-            stk_peer->sendPacket(data, reliable);
+            packets.emplace_back(stk_peer, data);
         }
     }
+    sendPackets(packets, reliable);
 }   // sendPacketExcept
 
 //-----------------------------------------------------------------------------
@@ -1253,14 +1273,124 @@ void STKHost::sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                        NetworkString* data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > packets;
     for (auto p : m_peers)
     {
         STKPeer* stk_peer = p.second.get();
         if (predicate(stk_peer))
-            stk_peer->sendPacket(data, reliable);
+            packets.emplace_back(stk_peer, data);
     }
+    sendPackets(packets, reliable);
 }   // sendPacketToAllPeersWith
 
+//-----------------------------------------------------------------------------
+/** Sends (encrypted) data to several peers. The packets for all peers are
+ *  created and encrypted in parallel by the send workers, and then added
+ *  to the enet commands at once. The caller must make sure that the peers
+ *  are not deleted during this call, and each peer must appear only once.
+ *  \param packets The peers and the data to send to each of them.
+ *  \param reliable If the data should be sent reliable or now.
+ */
+void STKHost::sendPackets(
+    const std::vector<std::pair<STKPeer*, NetworkString*> >& packets,
+    bool reliable)
+{
+    std::vector<ENetPacket*> enet_packets(packets.size());
+    auto create_packet = [&packets, &enet_packets, reliable](unsigned i)
+        {
+            enet_packets[i] = packets[i].first->createPacket(
+                packets[i].second, reliable, /*encrypted*/true);
+        };
+    // If another thread is using the workers, create the packets in this
+    // thread instead of waiting
+    std::unique_lock<std::mutex> workers_lock(m_send_workers_mutex,
+                                              std::try_to_lock);
+    if (m_send_workers && workers_lock.owns_lock())
+        m_send_workers->parallelFor((unsigned)packets.size(), create_packet);
+    else
+    {
+        for (unsigned i = 0; i < packets.size(); i++)
+            create_packet(i);
+    }
+    if (workers_lock.owns_lock())
+        workers_lock.unlock();
+
+    std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+    for (unsigned i = 0; i < packets.size(); i++)
+    {
+        if (enet_packets[i])
+        {
+            m_enet_cmd.emplace_back(packets[i].first->getENetPeer(),
+                enet_packets[i], EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET);
+        }
+    }
+}   // sendPackets
+
+//-----------------------------------------------------------------------------
+/** Measures how long it takes to create and encrypt a game state packet for
+ *  many peers (which is what sendPackets does in parallel) with different
+ *  numbers of threads, and prints the results.
+ */
+void STKHost::sendBenchmark()
+{
+    const unsigned rounds = 2000;
+    // About the size of a state of a race with 8 karts
+    BareNetworkString data(1024);
+    for (unsigned i = 0; i < 1024; i++)
+        data.addUInt8((uint8_t)i);
+    std::vector<uint8_t> key(16), iv(12);
+    std::mt19937 g(0);
+    for (uint8_t& k : key)
+        k = (uint8_t)g();
+    for (uint8_t& v : iv)
+        v = (uint8_t)g();
+
+    const unsigned max_threads = std::max(std::thread::hardware_concurrency(),
+                                          1u);
+    Log::info("STKHost", "Send benchmark with %d cores.", max_threads);
+    for (unsigned peers = 8; peers <= 64; peers *= 2)
+    {
+        std::vector<std::unique_ptr<Crypto> > crypto;
+        for (unsigned i = 0; i < peers; i++)
+            crypto.emplace_back(new Crypto(key, iv));
+        std::vector<ENetPacket*> packets(peers);
+        auto create_packet = [&crypto, &packets, &data](unsigned i)
+            {
+                packets[i] = crypto[i]->encryptSend(data, /*reliable*/false);
+            };
+
+        double single_time = 0.0;
+        for (unsigned threads = 1; threads <= std::max(max_threads, 4u);
+             threads *= 2)
+        {
+            std::unique_ptr<WorkerPool> workers;
+            if (threads > 1)
+                workers.reset(new WorkerPool(threads - 1, "SendBenchmark"));
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned r = 0; r < rounds; r++)
+            {
+                if (workers)
+                    workers->parallelFor(peers, create_packet);
+                else
+                {
+                    for (unsigned i = 0; i < peers; i++)
+                        create_packet(i);
+                }
+                for (ENetPacket* packet : packets)
+                    enet_packet_destroy(packet);
+            }
+            double time = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            if (threads == 1)
+                single_time = time;
+            Log::info("STKHost", "%d peers, %d threads: %.1f us per state, "
+                      "%.0f peers per second, speedup %.2f", peers, threads,
+                      time * 1.0e6 / rounds, peers * rounds / time,
+                      single_time / time);
+        }
+    }
+}   // sendBenchmark
+
 //-----------------------------------------------------------------------------
 /** Sends a message from a client to the server. */
 void STKHost::sendToServer(NetworkString *data, bool reliable)
@@ -52,6 +52,7 @@ class NetworkTimerSynchronizer;
 class Server;
 class ServerLobby;
 class SeparateProcess;
+class WorkerPool;
 
 enum ENetCommandType : unsigned int
 {
@@ -89,11 +90,25 @@ private:
     /** Make sure the removing or adding a peer is thread-safe. */
     mutable std::mutex m_peers_mutex;
 
+    typedef std::tuple</*peer receive*/ENetPeer*,
+        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
+        ENetCommandType> ENetCommand;
+
     /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
      *  thread. */
-    std::list<std::tuple</*peer receive*/ENetPeer*,
-        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
-        ENetCommandType> > m_enet_cmd;
+    std::vector<ENetCommand> m_enet_cmd;
+
+    /** The commands executed in the current iteration of the listening
+     *  thread, swapped with \ref m_enet_cmd so its memory is reused. */
+    std::vector<ENetCommand> m_enet_cmd_batch;
+
+    /** Server only: threads which create and encrypt the packets for many
+     *  peers in parallel (see sendPackets). */
+    std::unique_ptr<WorkerPool> m_send_workers;
+
+    /** The send workers can only run one loop at a time, but packets are
+     *  sent from the main thread and the protocol thread. */
+    std::mutex m_send_workers_mutex;
 
     /** Protect \ref m_enet_cmd from multiple threads usage. */
     std::mutex m_enet_cmd_mutex;
@@ -230,6 +245,11 @@ public:
     void sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                   NetworkString* data, bool reliable = true);
     // ------------------------------------------------------------------------
+    void sendPackets(const std::vector<std::pair<STKPeer*, NetworkString*> >&
+                     packets, bool reliable);
+    // ------------------------------------------------------------------------
+    static void sendBenchmark();
+    // ------------------------------------------------------------------------
     /** Returns true if this client instance is allowed to control the server.
      *  It will auto transfer ownership if previous server owner disconnected.
      */
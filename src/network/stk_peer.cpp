@@ -101,15 +101,36 @@ void STKPeer::reset()
  *  \param encrypted If the data is sent encrypted or not.
  */
 void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
+{
+    ENetPacket* packet = createPacket(data, reliable, encrypted);
+    if (packet)
+    {
+        m_host->addEnetCommand(m_enet_peer, packet,
+                encrypted ? EVENT_CHANNEL_NORMAL : EVENT_CHANNEL_UNENCRYPTED,
+                ECT_SEND_PACKET);
+    }
+}   // sendPacket
+
+//-----------------------------------------------------------------------------
+/** Creates (and encrypts if needed) the enet packet to send data to this
+ *  host. Packets for different peers can be created in parallel (see
+ *  STKHost::sendPackets).
+ *  \param data The data to send.
+ *  \param reliable If the data is sent reliable or not.
+ *  \param encrypted If the data is sent encrypted or not.
+ *  \return The packet, or NULL if this peer is disconnected.
+ */
+ENetPacket* STKPeer::createPacket(NetworkString *data, bool reliable,
+                                  bool encrypted)
 {
     if (m_disconnected.load())
-        return;
+        return NULL;
     TransportAddress a(m_enet_peer->address);
     // Enet will reuse a disconnected peer so we check here to avoid sending
     // to wrong peer
     if (m_enet_peer->state != ENET_PEER_STATE_CONNECTED ||
         a != m_peer_address)
-        return;
+        return NULL;
 
     ENetPacket* packet = NULL;
     if (m_crypto && encrypted)
@@ -118,26 +139,18 @@ void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
     }
     else
     {
-        packet = enet_packet_create(data->getData(),
-            data->getTotalSize(), (reliable ?
-            ENET_PACKET_FLAG_RELIABLE :
-            (ENET_PACKET_FLAG_UNSEQUENCED |
-            ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
+        packet = Network::createPacket((const uint8_t*)data->getData(),
+            data->getTotalSize(), reliable);
     }
 
-    if (packet)
+    if (packet && Network::m_connection_debug)
     {
-        if (Network::m_connection_debug)
-        {
-            Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
-                packet->dataLength, a.toString().c_str(),
-                StkTime::getRealTime());
-        }
-        m_host->addEnetCommand(m_enet_peer, packet,
-                encrypted ? EVENT_CHANNEL_NORMAL : EVENT_CHANNEL_UNENCRYPTED,
-                ECT_SEND_PACKET);
+        Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
+            packet->dataLength, a.toString().c_str(),
+            StkTime::getRealTime());
     }
-}   // sendPacket
+    return packet;
+}   // createPacket
 
 //-----------------------------------------------------------------------------
 /** Returns if the peer is connected or not.
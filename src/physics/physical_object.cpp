@@ -31,6 +31,7 @@
 #include "network/protocols/lobby_protocol.hpp"
 #include "network/compress_network_body.hpp"
 #include "network/rewind_manager.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/constants.hpp"
@@ -165,6 +166,9 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_reset_height       = settings.m_reset_height;
     m_on_kart_collision  = settings.m_on_kart_collision;
     m_on_item_collision  = settings.m_on_item_collision;
+    m_on_kart_collision_script  = NULL;
+    m_on_item_collision_script  = NULL;
+    m_collision_scripts_resolved = false;
     m_current_transform.setOrigin(Vec3());
     m_current_transform.setRotation(
         btQuaternion(0.0f, 0.0f, 0.0f, 1.0f));
@@ -673,6 +677,44 @@ bool PhysicalObject::castRay(const btVector3 &from, const btVector3 &to,
     return result;
 }   // castRay
 
+// ----------------------------------------------------------------------------
+/** Looks up the script functions to call when a kart or an item hits this
+ *  object. This is only done once, since it is too slow to do for each
+ *  collision. The functions are owned by the cache of the script engine,
+ *  which is only cleaned up after all objects of a track are deleted.
+ */
+void PhysicalObject::resolveCollisionScripts()
+{
+    Scripting::ScriptEngine *script_engine =
+        Scripting::ScriptEngine::getInstance();
+    if (m_on_kart_collision.size() > 0)
+    {
+        m_on_kart_collision_script = script_engine->getFunction(
+            "void " + m_on_kart_collision + "(int, const string, const string)",
+            /*warn_if_not_found*/true);
+    }
+    if (m_on_item_collision.size() > 0)
+    {
+        m_on_item_collision_script = script_engine->getFunction(
+            "void " + m_on_item_collision + "(int, int, const string)",
+            /*warn_if_not_found*/true);
+    }
+    m_collision_scripts_resolved = true;
+}   // resolveCollisionScripts
+
+// ----------------------------------------------------------------------------
+/** Returns the bounding box in world coordinates of the mesh that castRay
+ *  tests. A ray that does not cross this box can't hit this object.
+ *  \param min, max On return the corners of the bounding box.
+ *  \return False if castRay is not supported for this object.
+ */
+bool PhysicalObject::getRaycastAabb(btVector3 *min, btVector3 *max) const
+{
+    if(m_body_type!=MP_EXACT || !m_triangle_mesh)
+        return false;
+    return m_triangle_mesh->getWorldAabb(min, max);
+}   // getRaycastAabb
+
 // ----------------------------------------------------------------------------
 void PhysicalObject::reset()
 {
@@ -802,7 +844,8 @@ void PhysicalObject::computeError()
 }   // computeError
 
 // ----------------------------------------------------------------------------
-BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
+bool PhysicalObject::saveState(BareNetworkString* buffer,
+                               std::vector<std::string>* ru)
 {
     bool has_live_join = false;
 
@@ -815,16 +858,15 @@ BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
         (m_body->getLinearVelocity() - m_last_lv).length() < 0.01f &&
         (m_body->getLinearVelocity() - m_last_av).length() < 0.01f &&
         !has_live_join)
-        return nullptr;
+        return false;
 
     ru->push_back(getUniqueIdentity());
-    BareNetworkString *buffer = new BareNetworkString();
     m_last_transform = cur_transform;
     m_last_lv = m_body->getLinearVelocity();
     m_last_av = m_body->getAngularVelocity();
     CompressNetworkBody::compress(m_last_transform, m_last_lv, m_last_av,
         buffer, m_body, m_motion_state);
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -843,6 +885,18 @@ void PhysicalObject::restoreState(BareNetworkString *buffer, int count)
     m_body->setInterpolationAngularVelocity(m_last_av);
 }   // restoreState
 
+// ----------------------------------------------------------------------------
+/** Uses the current transform and velocities as the last saved state, so
+ *  that saveState only saves this object again once it moves. This is
+ *  used when starting from a state which didn't include this object.
+ */
+void PhysicalObject::setLastStateToCurrent()
+{
+    m_last_transform = m_body->getWorldTransform();
+    m_last_lv = m_body->getLinearVelocity();
+    m_last_av = m_body->getAngularVelocity();
+}   // setLastStateToCurrent
+
 // ----------------------------------------------------------------------------
 std::function<void()> PhysicalObject::getLocalStateRestoreFunction()
 {
@@ -30,6 +30,7 @@
 #include "utils/leak_check.hpp"
 
 
+class asIScriptFunction;
 class Material;
 class TrackObject;
 class XMLNode;
@@ -180,6 +181,14 @@ private:
     * when a (flyable) item collides with this object
     */
     std::string           m_on_item_collision;
+
+    /** The script functions of m_on_kart_collision and m_on_item_collision,
+     *  or NULL if not defined. They are looked up when a collision happens
+     *  for the first time, see resolveCollisionScripts. */
+    asIScriptFunction    *m_on_kart_collision_script;
+    asIScriptFunction    *m_on_item_collision_script;
+    bool                  m_collision_scripts_resolved;
+
     /** If this body is a bullet dynamic body, i.e. affected by physics
      *  or not (static (not moving) or kinematic (animated outside
      *  of physics). */
@@ -193,6 +202,8 @@ private:
     Vec3                  m_last_av;
     bool                  m_no_server_state;
 
+    void resolveCollisionScripts();
+
 public:
                     PhysicalObject(bool is_dynamic, const Settings& settings,
                                    TrackObject* object);
@@ -213,6 +224,7 @@ public:
                  const btVector3 &to, btVector3 *hit_point,
                  const Material **material, btVector3 *normal,
                  bool interpolate_normal) const;
+    bool getRaycastAabb(btVector3 *min, btVector3 *max) const;
 
     // ------------------------------------------------------------------------
     bool isDynamic() const { return m_is_dynamic; }
@@ -247,6 +259,24 @@ public:
     // ------------------------------------------------------------------------
     const std::string& getOnItemCollisionFunction() const { return m_on_item_collision; }
     // ------------------------------------------------------------------------
+    /** Returns the script function to call when a kart hits this object,
+     *  or NULL if there is none. */
+    asIScriptFunction* getOnKartCollisionScript()
+    {
+        if (!m_collision_scripts_resolved)
+            resolveCollisionScripts();
+        return m_on_kart_collision_script;
+    }   // getOnKartCollisionScript
+    // ------------------------------------------------------------------------
+    /** Returns the script function to call when an item hits this object,
+     *  or NULL if there is none. */
+    asIScriptFunction* getOnItemCollisionScript()
+    {
+        if (!m_collision_scripts_resolved)
+            resolveCollisionScripts();
+        return m_on_item_collision_script;
+    }   // getOnItemCollisionScript
+    // ------------------------------------------------------------------------
     TrackObject* getTrackObject() { return m_object; }
 
     // Methods usable by scripts
@@ -280,12 +310,14 @@ public:
     void addForRewind();
     virtual void saveTransform();
     virtual void computeError();
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru);
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru);
     virtual void undoEvent(BareNetworkString *buffer) {}
     virtual void rewindToEvent(BareNetworkString *buffer) {}
     virtual void restoreState(BareNetworkString *buffer, int count);
     virtual void undoState(BareNetworkString *buffer) {}
     virtual std::function<void()> getLocalStateRestoreFunction();
+    void setLastStateToCurrent();
     LEAK_CHECK()
 };  // PhysicalObject
 
@@ -42,7 +42,10 @@
 #include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
+#include "tracks/track_object_manager.hpp"
 #include "utils/profiler.hpp"
+#include "utils/subsystem_timer.hpp"
+#include "utils/worker_pool.hpp"
 
 // ----------------------------------------------------------------------------
 /** Initialise physics.
@@ -57,16 +60,47 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 //-----------------------------------------------------------------------------
 /** The actual initialisation of the physics, which is called after the track
  *  model is loaded. This allows the physics to use the actual track dimension
- *  for the axis sweep.
+ *  for the axis sweep. The broadphase is selected by the track (default
+ *  from stk_config):
+ *  - "axis-sweep": sweep and prune with 16 bit quantisation of the track
+ *    bounds. Good for tracks of normal size with few moving objects.
+ *  - "axis-sweep-32": the same with 32 bit quantisation, which results in
+ *    fewer false overlaps on very large tracks.
+ *  - "dbvt": dynamic bounding volume trees. Adding and removing objects
+ *    (e.g. flyables) is cheaper, and it does not depend on the track size.
  */
 void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
 {
     m_physics_loop_active = false;
-    m_axis_sweep          = new btAxisSweep3(world_min, world_max);
+    const std::string &broadphase =
+        Track::getCurrentTrack()->getPhysicsBroadphase();
+    if (broadphase == "dbvt")
+        m_broadphase = new btDbvtBroadphase();
+    else if (broadphase == "axis-sweep-32")
+        m_broadphase = new bt32BitAxisSweep3(world_min, world_max);
+    else
+    {
+        if (broadphase != "axis-sweep")
+        {
+            Log::warn("Physics", "Unknown broadphase '%s', using axis-sweep.",
+                      broadphase.c_str());
+        }
+        m_broadphase = new btAxisSweep3(world_min, world_max);
+    }
+    // 0 means to choose the number of threads from the number of cores,
+    // 1 to solve everything in this thread
+    int threads = UserConfigParams::m_physics_threads;
+    unsigned workers = threads <= 0 ?
+        WorkerPool::getDefaultThreads(/*max_threads*/3) : threads - 1;
+    // The solvers of all threads use the same static fixed body (for
+    // contacts with static objects), so it is created here before any
+    // thread uses it.
+    getFixedBody();
     m_dynamics_world      = new STKDynamicsWorld(m_dispatcher,
-                                                 m_axis_sweep,
+                                                 m_broadphase,
                                                  this,
-                                                 m_collision_conf);
+                                                 m_collision_conf,
+                                                 workers);
     m_karts_to_delete.clear();
     m_dynamics_world->setGravity(
         btVector3(0.0f,
@@ -92,7 +126,7 @@ Physics::~Physics()
 {
     delete m_debug_drawer;
     delete m_dynamics_world;
-    delete m_axis_sweep;
+    delete m_broadphase;
     delete m_dispatcher;
     delete m_collision_conf;
 }   // ~Physics
@@ -165,11 +199,17 @@ void Physics::update(int ticks)
     // Since the world update (which calls physics update) is called at the
     // fixed frequency necessary for the physics update, we need to do exactly
     // one physic step only.
-    double start;
+    double start = 0;
     if(UserConfigParams::m_physics_debug) start = StkTime::getRealTime();
 
-    m_dynamics_world->stepSimulation(stk_config->ticks2Time(1), 1,
-                                     stk_config->ticks2Time(1)      );
+    {
+        SUBSYSTEM_TIMER(PHYSICS_STEP);
+        m_dynamics_world->stepSimulation(stk_config->ticks2Time(1), 1,
+                                         stk_config->ticks2Time(1)      );
+    }
+    // The step might have moved driveable track objects, which are
+    // raycast against by e.g. the collision handling below.
+    Track::getCurrentTrack()->getTrackObjectManager()->updateDriveableTree();
     if (UserConfigParams::m_physics_debug)
     {
         Log::verbose("Physics", "At %d physics duration %12.8f",
@@ -181,6 +221,7 @@ void Physics::update(int ticks)
     // inside of this loop, since the same flyables might hit more than one
     // other object. So only a flag is set in the flyables, the actual
     // clean up is then done later in the projectile manager.
+    SUBSYSTEM_TIMER(COLLISIONS);
     std::vector<CollisionPair>::iterator p;
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
@@ -196,7 +237,8 @@ void Physics::update(int ticks)
                                             Scripting::ScriptEngine::getInstance();
             int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
             int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
-            script_engine->runFunction(false, "void onKartKartCollision(int, int)",
+            script_engine->runCallback(script_engine->getCallback(
+                Scripting::ScriptEngine::CB_KART_KART_COLLISION),
                 [=](asIScriptContext* ctx) {
                     ctx->SetArgDWord(0, kartid1);
                     ctx->SetArgDWord(1, kartid2);
@@ -212,20 +254,21 @@ void Physics::update(int ticks)
             AbstractKart *kart = p->getUserPointer(1)->getPointerKart();
             int kartId = kart->getWorldKartId();
             PhysicalObject* obj = p->getUserPointer(0)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnKartCollisionFunction();
-
-            TrackObject* to = obj->getTrackObject();
-            TrackObject* library = to->getParentLibrary();
-            std::string lib_id;
-            std::string* lib_id_ptr = NULL;
-            if (library != NULL)
-                lib_id = library->getID();
-            lib_id_ptr = &lib_id;
-
-            if (scripting_function.size() > 0)
+            asIScriptFunction* scripting_function =
+                                             obj->getOnKartCollisionScript();
+
+            if (scripting_function != NULL)
             {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, const string, const string)",
+                std::string obj_id = obj->getID();
+                TrackObject* to = obj->getTrackObject();
+                TrackObject* library = to->getParentLibrary();
+                std::string lib_id;
+                std::string* lib_id_ptr = NULL;
+                if (library != NULL)
+                    lib_id = library->getID();
+                lib_id_ptr = &lib_id;
+
+                script_engine->runCallback(scripting_function,
                     [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, kartId);
                         ctx->SetArgObject(1, lib_id_ptr);
@@ -314,11 +357,12 @@ void Physics::update(int ticks)
             Scripting::ScriptEngine* script_engine = Scripting::ScriptEngine::getInstance();
             Flyable* flyable = p->getUserPointer(0)->getPointerFlyable();
             PhysicalObject* obj = p->getUserPointer(1)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnItemCollisionFunction();
-            if (scripting_function.size() > 0)
+            asIScriptFunction* scripting_function =
+                                             obj->getOnItemCollisionScript();
+            if (scripting_function != NULL)
             {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, int, const string)",
+                std::string obj_id = obj->getID();
+                script_engine->runCallback(scripting_function,
                         [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, (int)flyable->getType());
                         ctx->SetArgDWord(1, flyable->getOwnerId());
@@ -554,6 +598,17 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                                                         debugDrawer,
                                                         stackAlloc,
                                                         dispatcher);
+    collectCollisions();
+    return returnValue;
+}   // solveGroup
+
+//-----------------------------------------------------------------------------
+/** Adds all collisions of the contact manifolds to the list of collisions
+ *  (see solveGroup). Called from solveGroup, or by STKDynamicsWorld after
+ *  solving the simulation islands in parallel.
+ */
+void Physics::collectCollisions()
+{
     int currentNumManifolds = m_dispatcher->getNumManifolds();
     // We can't explode a rocket in a loop, since a rocket might collide with
     // more than one object, and/or more than once with each object (if there
@@ -725,9 +780,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
         else
             assert("Unknown user pointer");           // 4) Should never happen
     }   // for i<numManifolds
-
-    return returnValue;
-}   // solveGroup
+}   // collectCollisions
 
 // ----------------------------------------------------------------------------
 /** A debug draw function to show the track and all karts.
@@ -145,7 +145,7 @@ private:
     IrrDebugDrawer                  *m_debug_drawer;
 
     btCollisionDispatcher           *m_dispatcher;
-    btBroadphaseInterface           *m_axis_sweep;
+    btBroadphaseInterface           *m_broadphase;
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
@@ -183,6 +183,7 @@ public:
                                 const btContactSolverInfo& info,
                                 btIDebugDraw* debugDrawer, btStackAlloc* stackAlloc,
                                 btDispatcher* dispatcher);
+    void  collectCollisions();
 };
 
 #endif // HEADER_PHYSICS_HPP
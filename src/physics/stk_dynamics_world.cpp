@@ -0,0 +1,299 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/stk_dynamics_world.hpp"
+
+#include "physics/physics.hpp"
+#include "utils/log.hpp"
+#include "utils/worker_pool.hpp"
+
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+
+namespace
+{
+    /** Returns the island of a constraint, same as bullet does. */
+    int getConstraintIslandId(const btTypedConstraint *constraint)
+    {
+        const btCollisionObject &body0 = constraint->getRigidBodyA();
+        const btCollisionObject &body1 = constraint->getRigidBodyB();
+        return body0.getIslandTag() >= 0 ? body0.getIslandTag()
+                                         : body1.getIslandTag();
+    }   // getConstraintIslandId
+
+    // ------------------------------------------------------------------------
+    /** Sorts constraints by island, same as bullet does. */
+    class SortConstraintOnIsland
+    {
+    public:
+        bool operator()(const btTypedConstraint *lhs,
+                        const btTypedConstraint *rhs) const
+        {
+            return getConstraintIslandId(lhs) < getConstraintIslandId(rhs);
+        }
+    };   // SortConstraintOnIsland
+}   // namespace
+
+// ============================================================================
+/** Stores the islands reported by bullet's island manager in the world
+ *  instead of solving them. Bullet combines islands into batches (until
+ *  m_minimumSolverBatchSize manifolds and constraints are reached) and only
+ *  solves a batch if it contains any manifold or constraint. Solving a
+ *  batch also updates the bodies of islands without any contact in it,
+ *  so this collector keeps all islands of batches which bullet would solve
+ *  and drops the others, which gives exactly the same result.
+ */
+class STKDynamicsWorld::IslandCollector
+                     : public btSimulationIslandManager::IslandCallback
+{
+private:
+    STKDynamicsWorld *m_world;
+
+    int m_batch_size;
+
+    /** Index of the first island of the current batch. */
+    unsigned m_batch_start;
+
+    /** Number of manifolds and constraints in the current batch. */
+    int m_batch_work;
+
+public:
+    IslandCollector(STKDynamicsWorld *world, int batch_size)
+        : m_world(world), m_batch_size(batch_size), m_batch_start(0),
+          m_batch_work(0)
+    {
+    }   // IslandCollector
+    // ------------------------------------------------------------------------
+    virtual void ProcessIsland(btCollisionObject **bodies, int num_bodies,
+                               btPersistentManifold **manifolds,
+                               int num_manifolds, int island_id)
+    {
+        btAlignedObjectArray<btTypedConstraint*> &sorted =
+            m_world->m_sorted_constraints;
+        int first_constraint = 0;
+        int num_constraints = 0;
+        if (island_id < 0)
+        {
+            // Islands are not split, all constraints belong to this call
+            num_constraints = sorted.size();
+        }
+        else
+        {
+            while (first_constraint < sorted.size() &&
+                   getConstraintIslandId(sorted[first_constraint]) != island_id)
+                first_constraint++;
+            for (int i = first_constraint; i < sorted.size(); i++)
+            {
+                if (getConstraintIslandId(sorted[i]) == island_id)
+                    num_constraints++;
+            }
+        }
+
+        Island island;
+        island.m_first_body       = m_world->m_island_bodies.size();
+        island.m_first_manifold   = m_world->m_island_manifolds.size();
+        island.m_first_constraint = m_world->m_island_constraints.size();
+        island.m_work             = num_manifolds + num_constraints;
+        m_world->m_islands.push_back(island);
+        for (int i = 0; i < num_bodies; i++)
+            m_world->m_island_bodies.push_back(bodies[i]);
+        for (int i = 0; i < num_manifolds; i++)
+            m_world->m_island_manifolds.push_back(manifolds[i]);
+        for (int i = 0; i < num_constraints; i++)
+        {
+            m_world->m_island_constraints
+                .push_back(sorted[first_constraint + i]);
+        }
+
+        m_batch_work += island.m_work;
+        if (island_id < 0 || m_batch_size <= 1 || m_batch_work > m_batch_size)
+            closeBatch();
+    }   // ProcessIsland
+    // ------------------------------------------------------------------------
+    /** Ends the current batch, and removes its islands again if bullet
+     *  wouldn't solve it. */
+    void closeBatch()
+    {
+        std::vector<Island> &islands = m_world->m_islands;
+        if (m_batch_work == 0 && m_batch_start < islands.size())
+        {
+            const Island &first = islands[m_batch_start];
+            m_world->m_island_bodies.resize(first.m_first_body);
+            m_world->m_island_manifolds.resize(first.m_first_manifold);
+            m_world->m_island_constraints.resize(first.m_first_constraint);
+            islands.resize(m_batch_start);
+        }
+        m_batch_start = (unsigned)islands.size();
+        m_batch_work = 0;
+    }   // closeBatch
+};   // IslandCollector
+
+// ============================================================================
+/** The standard constructor which just creates a btDiscreteDynamicsWorld
+ *  with the physics as constraint solver.
+ *  \param num_workers Number of additional threads which solve islands,
+ *         0 to solve everything in the calling thread.
+ */
+STKDynamicsWorld::STKDynamicsWorld(btDispatcher*             dispatcher,
+                                   btBroadphaseInterface*    pairCache,
+                                   Physics*                  physics,
+                                   btCollisionConfiguration* collisionConfiguration,
+                                   unsigned                  num_workers)
+                : btDiscreteDynamicsWorld(dispatcher, pairCache, physics,
+                                          collisionConfiguration),
+                  m_physics(physics)
+{
+    if (num_workers == 0)
+        return;
+    m_island_workers.reset(new WorkerPool(num_workers, "PhysicsIslands"));
+    for (unsigned i = 0; i < m_island_workers->getNumThreads(); i++)
+    {
+        m_island_solvers.emplace_back(
+            new btSequentialImpulseConstraintSolver());
+    }
+    Log::info("STKDynamicsWorld", "Using %d threads to solve the physics.",
+              m_island_workers->getNumThreads());
+}   // STKDynamicsWorld
+
+// ----------------------------------------------------------------------------
+STKDynamicsWorld::~STKDynamicsWorld()
+{
+}   // ~STKDynamicsWorld
+
+// ----------------------------------------------------------------------------
+/** Solves the contacts and constraints of all simulation islands. If worker
+ *  threads are used, the islands are split into contiguous chunks which are
+ *  solved in parallel, each with its own solver. Islands don't share any
+ *  non-static body, and the solver handles each island independently of
+ *  the others solved with it, so the result is the same as solving all
+ *  islands sequentially, independent of the number of threads. The
+ *  collisions for Physics::update are then collected once in the main
+ *  thread, in the order of the manifolds in the dispatcher.
+ */
+void STKDynamicsWorld::solveConstraints(btContactSolverInfo &solver_info)
+{
+    // With a random order the result would depend on which islands are
+    // solved together
+    if (!m_island_workers ||
+        (solver_info.m_solverMode & SOLVER_RANDMIZE_ORDER) != 0)
+    {
+        btDiscreteDynamicsWorld::solveConstraints(solver_info);
+        return;
+    }
+
+    // Sort the constraints the same way as bullet, so the constraints of
+    // each island are solved in the same order
+    m_sorted_constraints.resize(m_constraints.size());
+    for (int i = 0; i < m_constraints.size(); i++)
+        m_sorted_constraints[i] = m_constraints[i];
+    m_sorted_constraints.quickSort(SortConstraintOnIsland());
+
+    m_islands.clear();
+    m_island_bodies.resize(0);
+    m_island_manifolds.resize(0);
+    m_island_constraints.resize(0);
+
+    m_constraintSolver->prepareSolve(getNumCollisionObjects(),
+                                     getDispatcher()->getNumManifolds());
+    IslandCollector collector(this, solver_info.m_minimumSolverBatchSize);
+    m_islandManager->buildAndProcessIslands(getDispatcher(), this,
+                                            &collector);
+    collector.closeBatch();
+
+    if (!m_islands.empty())
+    {
+        int total_work = 0;
+        for (const Island &island : m_islands)
+            total_work += island.m_work;
+
+        // Give each thread about the same number of manifolds and
+        // constraints. Each chunk must contain some work, otherwise the
+        // solver would not update the bodies in it.
+        const unsigned num_chunks = m_island_workers->getNumThreads();
+        m_chunk_start.clear();
+        m_chunk_start.push_back(0);
+        int done = 0, chunk_work = 0;
+        for (unsigned i = 0; i + 1 < m_islands.size(); i++)
+        {
+            done       += m_islands[i].m_work;
+            chunk_work += m_islands[i].m_work;
+            if (m_chunk_start.size() < num_chunks && chunk_work > 0 &&
+                done < total_work &&
+                done * num_chunks >= total_work * m_chunk_start.size())
+            {
+                m_chunk_start.push_back(i + 1);
+                chunk_work = 0;
+            }
+        }
+        m_chunk_start.push_back((int)m_islands.size());
+
+        unsigned chunks = (unsigned)m_chunk_start.size() - 1;
+        if (chunks == 1)
+        {
+            solveChunk(0, solver_info);
+        }
+        else
+        {
+            m_island_workers->parallelFor(chunks,
+                [this, &solver_info](unsigned chunk)
+                {
+                    solveChunk(chunk, solver_info);
+                });
+        }
+        m_physics->collectCollisions();
+    }
+
+    m_constraintSolver->allSolved(solver_info, m_debugDrawer, m_stackAlloc);
+}   // solveConstraints
+
+// ----------------------------------------------------------------------------
+/** Solves the islands of one chunk with the solver of that chunk.
+ *  \param chunk Index of the chunk.
+ *  \param solver_info The solver settings.
+ */
+void STKDynamicsWorld::solveChunk(unsigned chunk,
+                                  const btContactSolverInfo &solver_info)
+{
+    const Island &first = m_islands[m_chunk_start[chunk]];
+    int end = m_chunk_start[chunk + 1];
+    int end_body, end_manifold, end_constraint;
+    if (end < (int)m_islands.size())
+    {
+        end_body       = m_islands[end].m_first_body;
+        end_manifold   = m_islands[end].m_first_manifold;
+        end_constraint = m_islands[end].m_first_constraint;
+    }
+    else
+    {
+        end_body       = m_island_bodies.size();
+        end_manifold   = m_island_manifolds.size();
+        end_constraint = m_island_constraints.size();
+    }
+    int num_bodies      = end_body       - first.m_first_body;
+    int num_manifolds   = end_manifold   - first.m_first_manifold;
+    int num_constraints = end_constraint - first.m_first_constraint;
+
+    m_island_solvers[chunk]->solveGroup(
+        num_bodies ? &m_island_bodies[first.m_first_body] : NULL,
+        num_bodies,
+        num_manifolds ? &m_island_manifolds[first.m_first_manifold] : NULL,
+        num_manifolds,
+        num_constraints ? &m_island_constraints[first.m_first_constraint]
+                        : NULL,
+        num_constraints, solver_info, m_debugDrawer, m_stackAlloc,
+        m_dispatcher1);
+}   // solveChunk
@@ -21,24 +21,69 @@
 
 #include "btBulletDynamicsCommon.h"
 
+#include <memory>
+#include <vector>
+
+class Physics;
+class WorkerPool;
+
 /** A thin wrapper around bullet's btDiscreteDynamicsWorld. Used to
  *  be able to query and set the 'left over' time from a previous
  *  time step, which is needed for more precise rewind/replays.
+ *  Optionally the independent simulation islands (e.g. karts that don't
+ *  touch each other) are solved in parallel, see solveConstraints.
  */
 class STKDynamicsWorld : public btDiscreteDynamicsWorld
 {
-public:
-    /** The standard constructor which just created a btDiscreteDynamicsWorld. */
-    STKDynamicsWorld(btDispatcher*             dispatcher,
-                     btBroadphaseInterface*    pairCache,
-                     btConstraintSolver*       constraintSolver,
-                     btCollisionConfiguration* collisionConfiguration)
-
-                   : btDiscreteDynamicsWorld(dispatcher, pairCache,
-                                             constraintSolver,
-                                             collisionConfiguration)
+private:
+    class IslandCollector;
+
+    /** The bodies, manifolds and constraints of one island are stored as
+     *  ranges of the arrays below. */
+    struct Island
     {
-    }
+        int m_first_body, m_first_manifold, m_first_constraint;
+        /** Number of manifolds and constraints, i.e. the work to do. */
+        int m_work;
+    };
+
+    /** The physics, which is also the constraint solver used if the
+     *  islands are not solved in parallel. */
+    Physics *m_physics;
+
+    /** The threads which solve the islands, NULL if not done in parallel. */
+    std::unique_ptr<WorkerPool> m_island_workers;
+
+    /** One solver for each thread, since a solver stores temporary data
+     *  of the group it solves. */
+    std::vector<std::unique_ptr<btSequentialImpulseConstraintSolver> >
+                                              m_island_solvers;
+
+    /** All islands to solve in the current substep, in the order bullet
+     *  would solve them. */
+    std::vector<Island> m_islands;
+
+    /** Index of the first island solved by each thread, plus the number of
+     *  islands at the end. */
+    std::vector<int> m_chunk_start;
+
+    btAlignedObjectArray<btCollisionObject*>    m_island_bodies;
+    btAlignedObjectArray<btPersistentManifold*> m_island_manifolds;
+    btAlignedObjectArray<btTypedConstraint*>    m_island_constraints;
+    btAlignedObjectArray<btTypedConstraint*>    m_sorted_constraints;
+
+    void solveChunk(unsigned chunk, const btContactSolverInfo &solver_info);
+
+protected:
+    virtual void solveConstraints(btContactSolverInfo &solver_info);
+
+public:
+             STKDynamicsWorld(btDispatcher*             dispatcher,
+                              btBroadphaseInterface*    pairCache,
+                              Physics*                  physics,
+                              btCollisionConfiguration* collisionConfiguration,
+                              unsigned                  num_workers);
+    virtual ~STKDynamicsWorld();
 
     /** Resets m_localTime to 0. This allows more precise replay of
      *  physics, which is important for replaying histories. */
@@ -52,4 +97,3 @@ public:
 };   // STKDynamicsWorld
 #endif
 /* EOF */
-
@@ -19,6 +19,7 @@
 #include "physics/triangle_mesh.hpp"
 
 #include "config/stk_config.hpp"
+#include "io/file_manager.hpp"
 #include "main_loop.hpp"
 #include "physics/physics.hpp"
 #include "utils/constants.hpp"
@@ -26,7 +27,49 @@
 
 #include "btBulletDynamicsCommon.h"
 
-#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+/** The header of a bvh cache file. The bvh is stored after it as serialized
+ *  by bullet, in the byte order of the machine which wrote it. */
+struct BVHCacheHeader
+{
+    char     m_magic[8];
+    uint32_t m_byte_order;
+    uint32_t m_bullet_version;
+    uint32_t m_scalar_size;
+    uint32_t m_size;
+    uint64_t m_mesh_key;
+    uint64_t m_data_key;
+};   // BVHCacheHeader
+
+static const char BVH_CACHE_MAGIC[8] = "STKBVH1";
+static const uint64_t BVH_CACHE_HASH_START = 14695981039346656037ULL;
+
+// -----------------------------------------------------------------------------
+/** Adds data to a hash. This is FNV-1a, but applied to 64 bit words instead
+ *  of bytes, since the serialized bvh of a big track has many megabytes.
+ *  \param hash The hash so far (BVH_CACHE_HASH_START to start a new hash).
+ *  \return The new hash.
+ */
+static uint64_t hashBVHData(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t*)data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}   // hashBVHData
 
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
@@ -44,6 +87,8 @@ TriangleMesh::TriangleMesh(bool can_be_transformed) : m_mesh()
     // (and m_mesh->m_weldingThreshold at m_normals
     m_collision_shape  = NULL;
     m_collision_object = NULL;
+    m_bvh_buffer       = NULL;
+    m_cached_bvh       = NULL;
     m_user_pointer.set(this);
 }   // TriangleMesh
 
@@ -89,10 +134,12 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
 // -----------------------------------------------------------------------------
 /** Creates a collision body only, which can be used for raycasting, but
  *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+ *  \param bvh_cache_file If not empty, the bvh is loaded from this file if
+ *         it was saved for the same mesh, otherwise it is computed and saved
+ *         in this file to speed up loading this mesh the next time.
  */
-void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
+void TriangleMesh::createCollisionShape(bool create_collision_object,
+                                        const std::string &bvh_cache_file)
 {
     if(m_triangleIndex2Material.size()==0)
     {
@@ -103,55 +150,39 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
         return;
     }
     // Now convert the triangle mesh into a static rigid body
-    btBvhTriangleMeshShape* bhv_triangle_mesh;
+    btBvhTriangleMeshShape* bhv_triangle_mesh = NULL;
 
-    if (serialized_bhv != NULL)
+    if (!bvh_cache_file.empty())
     {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
-
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
-
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
+        double start = StkTime::getRealTime();
+        const uint64_t mesh_key = getMeshKey();
+        btOptimizedBvh *bvh = loadBVH(bvh_cache_file, mesh_key);
+        if (bvh)
         {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
+            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+                                  false /* useQuantizedAabbCompression */,
+                                  false /* buildBvh */);
+            bhv_triangle_mesh->setOptimizedBvh(bvh);
+            m_cached_bvh = bvh;
+            Log::info("TriangleMesh", "Loaded bvh of %d triangles from "
+                      "'%s' in %.1f ms.", (int)m_triangleIndex2Material.size(),
+                      bvh_cache_file.c_str(),
+                      (StkTime::getRealTime() - start) * 1000.0);
         }
         else
         {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
+            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+                                  false /* useQuantizedAabbCompression */);
+            Log::info("TriangleMesh", "Computed bvh of %d triangles in "
+                      "%.1f ms.", (int)m_triangleIndex2Material.size(),
+                      (StkTime::getRealTime() - start) * 1000.0);
+            saveBVH(bvh_cache_file, mesh_key,
+                    bhv_triangle_mesh->getOptimizedBvh());
         }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
-
     }
     else
     {
         bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
-
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
-
-        btAlignedFree(buffer);
-         */
     }
 
     m_collision_shape = bhv_triangle_mesh;
@@ -167,6 +198,123 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
 
 }   // createCollisionShape
 
+// -----------------------------------------------------------------------------
+/** Returns a hash of the vertices and triangles of the mesh, which is used to
+ *  detect if a cached bvh belongs to this mesh.
+ */
+uint64_t TriangleMesh::getMeshKey() const
+{
+    const unsigned char *vertex_base, *index_base;
+    int num_vertices, vertex_stride, index_stride, num_faces;
+    PHY_ScalarType vertex_type, index_type;
+    m_mesh.getLockedReadOnlyVertexIndexBase(&vertex_base, num_vertices,
+                                            vertex_type, vertex_stride,
+                                            &index_base, index_stride,
+                                            num_faces, index_type);
+    uint64_t key = BVH_CACHE_HASH_START;
+    key = hashBVHData(key, &num_vertices, sizeof(num_vertices));
+    key = hashBVHData(key, &num_faces, sizeof(num_faces));
+    // Only the coordinates are hashed, the stride can include padding
+    for (int i = 0; i < num_vertices; i++)
+        key = hashBVHData(key, vertex_base + i * vertex_stride,
+                          3 * sizeof(btScalar));
+    key = hashBVHData(key, index_base, (size_t)num_faces * index_stride);
+    m_mesh.unLockReadOnlyVertexBase(0);
+    return key;
+}   // getMeshKey
+
+// -----------------------------------------------------------------------------
+/** Loads a bvh saved by saveBVH. The bvh is created in place in the buffer it
+ *  is read into, which is freed in freeCachedBVH.
+ *  \param filename Name of the cache file.
+ *  \param mesh_key Hash of the mesh as returned by getMeshKey.
+ *  \return The bvh, or NULL if the file does not exist or was saved for a
+ *          different mesh or bullet version.
+ */
+btOptimizedBvh *TriangleMesh::loadBVH(const std::string &filename,
+                                      uint64_t mesh_key)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if (!fd)
+        return NULL;
+
+    BVHCacheHeader header;
+    btOptimizedBvh *bvh = NULL;
+    if (fread(&header, sizeof(header), 1, fd) == 1 &&
+        memcmp(header.m_magic, BVH_CACHE_MAGIC, 8) == 0 &&
+        header.m_byte_order     == 0x01020304          &&
+        header.m_bullet_version == BT_BULLET_VERSION    &&
+        header.m_scalar_size    == sizeof(btScalar)     &&
+        header.m_mesh_key       == mesh_key             &&
+        header.m_size > 0)
+    {
+        void *buffer = btAlignedAlloc(header.m_size, 16);
+        // The data hash protects against truncated or partially written
+        // files, which would otherwise result in invalid node indices.
+        if (fread(buffer, header.m_size, 1, fd) == 1 &&
+            hashBVHData(BVH_CACHE_HASH_START, buffer, header.m_size) ==
+                                                          header.m_data_key)
+        {
+            bvh = btOptimizedBvh::deSerializeInPlace(buffer, header.m_size,
+                                                     /*swap endian*/false);
+        }
+        if (bvh)
+            m_bvh_buffer = buffer;
+        else
+            btAlignedFree(buffer);
+    }
+    fclose(fd);
+    if (!bvh)
+        Log::info("TriangleMesh", "No valid cached bvh in '%s'.",
+                  filename.c_str());
+    return bvh;
+}   // loadBVH
+
+// -----------------------------------------------------------------------------
+/** Saves a bvh so that it can be loaded by loadBVH. The file is first
+ *  written under a temporary name and then renamed, so that a concurrently
+ *  loading process never sees a partially written file.
+ *  \param filename Name of the cache file.
+ *  \param mesh_key Hash of the mesh as returned by getMeshKey.
+ *  \param bvh The bvh to save.
+ */
+void TriangleMesh::saveBVH(const std::string &filename, uint64_t mesh_key,
+                           const btOptimizedBvh *bvh) const
+{
+    BVHCacheHeader header;
+    memcpy(header.m_magic, BVH_CACHE_MAGIC, 8);
+    header.m_byte_order     = 0x01020304;
+    header.m_bullet_version = BT_BULLET_VERSION;
+    header.m_scalar_size    = sizeof(btScalar);
+    header.m_size           = bvh->calculateSerializeBufferSize();
+    header.m_mesh_key       = mesh_key;
+
+    void *buffer = btAlignedAlloc(header.m_size, 16);
+    if (!bvh->serialize(buffer, header.m_size, /*swap endian*/false))
+    {
+        btAlignedFree(buffer);
+        return;
+    }
+    header.m_data_key = hashBVHData(BVH_CACHE_HASH_START, buffer,
+                                    header.m_size);
+
+    const std::string tmp_name = FileManager::getTempName(filename);
+    FILE *fd = fopen(tmp_name.c_str(), "wb");
+    bool ok = fd != NULL;
+    if (fd)
+    {
+        ok = fwrite(&header, sizeof(header), 1, fd) == 1 &&
+             fwrite(buffer, header.m_size, 1, fd) == 1;
+        ok = fclose(fd) == 0 && ok;
+    }
+    btAlignedFree(buffer);
+
+    if (ok && FileManager::replaceFile(tmp_name, filename))
+        return;
+    remove(tmp_name.c_str());
+    Log::warn("TriangleMesh", "Can not save bvh to '%s'.", filename.c_str());
+}   // saveBVH
+
 // -----------------------------------------------------------------------------
 /** Creates the physics body for this triangle mesh. If the body already
  *  exists (because it was created by a previous call to createBody)
@@ -178,16 +326,16 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  for height of terrain detection).
  *  \param friction Friction to be used for this TriangleMesh.
  *  \param flags Additional collision flags (default 0).
- *  \param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
+ *  \param bvh_cache_file If not empty, the file the bvh is cached in (see
+ *         createCollisionShape).
  */
 void TriangleMesh::createPhysicalBody(float friction,
                                       btCollisionObject::CollisionFlags flags,
-                                      const char* serializedBhv)
+                                      const std::string &bvh_cache_file)
 {
     // We need the collision shape, but not the collision object (since
     // this will be created when the dynamics body is anyway).
-    createCollisionShape(/*create_collision_object*/false, serializedBhv);
+    createCollisionShape(/*create_collision_object*/false, bvh_cache_file);
     main_loop->renderGUI(5583);
 
     btTransform startTransform;
@@ -232,8 +380,24 @@ void TriangleMesh::removeAll()
     }
     delete m_collision_shape;
     m_collision_shape = NULL;
+    freeCachedBVH();
 }   // removeAll
 
+// ----------------------------------------------------------------------------
+/** Frees a bvh loaded from a cache file. This must be done after deleting
+ *  the collision shape, which does not own the bvh in this case.
+ */
+void TriangleMesh::freeCachedBVH()
+{
+    if (!m_cached_bvh)
+        return;
+    // The bvh was created in place in the buffer, and doesn't own its arrays
+    m_cached_bvh->~btOptimizedBvh();
+    btAlignedFree(m_bvh_buffer);
+    m_cached_bvh = NULL;
+    m_bvh_buffer = NULL;
+}   // freeCachedBVH
+
 // -----------------------------------------------------------------------------
 /** Interpolates the normal at the given position for the triangle with
  *  a given index. The position must be inside of the given triangle.
@@ -407,3 +571,24 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     return ray_callback.hasHit();
 
 }   // castRay
+
+// ----------------------------------------------------------------------------
+/** Computes the axis aligned bounding box of this mesh in world coordinates,
+ *  using the same transform as castRay.
+ *  \param min, max On return the corners of the bounding box.
+ *  \return False if there is no collision shape (so a raycast can never
+ *          hit this mesh), true otherwise.
+ */
+bool TriangleMesh::getWorldAabb(btVector3 *min, btVector3 *max) const
+{
+    if(!m_collision_shape)
+        return false;
+
+    btTransform world_trans;
+    if(m_body)
+        world_trans = m_body->getWorldTransform();
+    else
+        world_trans.setIdentity();
+    m_collision_shape->getAabb(world_trans, *min, *max);
+    return true;
+}   // getWorldAabb
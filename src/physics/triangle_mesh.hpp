@@ -19,6 +19,8 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <cstdint>
+#include <string>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
@@ -46,6 +48,13 @@ private:
     btDefaultMotionState        *m_motion_state;
     btCollisionShape            *m_collision_shape;
 
+    /** If the bvh of the collision shape was loaded from a cache file, the
+     *  buffer it was loaded into (the bvh is stored in place in it). */
+    void                        *m_bvh_buffer;
+
+    /** The bvh loaded from a cache file, or NULL. */
+    btOptimizedBvh              *m_cached_bvh;
+
     /** The three normals for each triangle. */
     AlignedArray<btVector3>      m_normals;
 
@@ -57,6 +66,12 @@ private:
      *  to the current transform of the body. */
     bool m_can_be_transformed;
 
+    uint64_t        getMeshKey() const;
+    btOptimizedBvh *loadBVH(const std::string &filename, uint64_t mesh_key);
+    void            saveBVH(const std::string &filename, uint64_t mesh_key,
+                            const btOptimizedBvh *bvh) const;
+    void            freeCachedBVH();
+
 public:
     class RigidBodyTriangleMesh : public btRigidBody
     {
@@ -76,11 +91,12 @@ public:
                      const btVector3 &t3, const btVector3 &n1,
                      const btVector3 &n2, const btVector3 &n3,
                      const Material* m);
-    void createCollisionShape(bool create_collision_object=true, const char* serialized_bhv=NULL);
+    void createCollisionShape(bool create_collision_object=true,
+                              const std::string &bvh_cache_file="");
     void createPhysicalBody(float friction,
                             btCollisionObject::CollisionFlags flags=
                                (btCollisionObject::CollisionFlags)0,
-                            const char* serializedBhv = NULL);
+                            const std::string &bvh_cache_file="");
     void removeAll();
     void removeCollisionObject();
     btVector3 getInterpolatedNormal(unsigned int index,
@@ -113,6 +129,8 @@ public:
                  btVector3 *xyz, const Material **material,
                  btVector3 *normal=NULL, bool interpolate_normal=false) const;
     // ------------------------------------------------------------------------
+    bool getWorldAabb(btVector3 *min, btVector3 *max) const;
+    // ------------------------------------------------------------------------
     /** Returns the points of the 'indx' triangle.
      *  \param indx Index of the triangle to get.
      *  \param p1,p2,p3 On return the three points of the triangle. */
@@ -19,17 +19,22 @@
 #include "race/history.hpp"
 
 #include <stdio.h>
+#include <time.h>
 
 #include "io/file_manager.hpp"
+#include "items/powerup_manager.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
 #include "network/network_config.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/stk_host.hpp"
 #include "physics/physics.hpp"
+#include "race/history_log.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
+#include "utils/string_utils.hpp"
 
 History* history = 0;
 bool History::m_online_history_replay = false;
@@ -41,6 +46,12 @@ History::History()
     m_replay_history = false;
 }   // History
 
+//-----------------------------------------------------------------------------
+History::~History()
+{
+    stopServerRecording();
+}   // ~History
+
 //-----------------------------------------------------------------------------
 /** Initialise the history for a new recording. It especially allocates memory
  *  to store the history.
@@ -86,6 +97,88 @@ void History::addEvent(int kart_id, PlayerAction pa, int value)
     m_all_input_events.emplace_back(ie);
 }   // addEvent
 
+//-----------------------------------------------------------------------------
+/** Starts recording the current network race on the server. All actions
+ *  of the players and all states are written into a compressed log file
+ *  called server-history-<port>-<date>.dat in the user config directory,
+ *  which can be used to simulate the race again offline. This must be
+ *  called after the race has started (so the powerup seed is known).
+ *  \param item_seed The seed used for the items of this race.
+ */
+void History::startServerRecording(uint32_t item_seed)
+{
+    stopServerRecording();
+    World *world = World::getWorld();
+
+    HistoryLog::Header header;
+    header.m_stk_version  = STK_VERSION;
+    header.m_track_ident  = Track::getCurrentTrack()->getIdent();
+    header.m_minor_mode   =
+                  RaceManager::getIdentOf(race_manager->getMinorMode());
+    header.m_reverse      = race_manager->getReverseTrack();
+    header.m_difficulty   = race_manager->getDifficulty();
+    header.m_num_laps     = race_manager->getNumLaps();
+    header.m_item_seed    = item_seed;
+    header.m_powerup_seed = powerup_manager->getRandomSeed();
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        const AbstractKart *kart = world->getKart(i);
+        header.m_kart_idents.push_back(kart->getIdent());
+        header.m_kart_handicaps.push_back(
+                                      (uint8_t)kart->getPerPlayerDifficulty());
+    }
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+    std::string fn = file_manager->getUserConfigFile(
+        StringUtils::insertValues("server-history-%d-%s.dat",
+                                  STKHost::get()->getPrivatePort(), date));
+
+    m_server_log.reset(new HistoryLog());
+    if (m_server_log->create(fn, header))
+        Log::info("History", "Recording race in '%s'.", fn.c_str());
+    else
+        m_server_log.reset();
+}   // startServerRecording
+
+//-----------------------------------------------------------------------------
+/** Finishes the log of the current race (if any). */
+void History::stopServerRecording()
+{
+    if (!m_server_log)
+        return;
+    m_server_log->close();
+    m_server_log.reset();
+    Log::info("History", "Finished recording race.");
+}   // stopServerRecording
+
+//-----------------------------------------------------------------------------
+/** Adds a player action executed by the server to the race log.
+ *  \param ticks World time at which the action is executed.
+ *  \param data The action as stored in the RewindInfo of GameProtocol.
+ *  \param size Number of bytes of data.
+ */
+void History::addServerAction(int ticks, const uint8_t *data,
+                              unsigned int size)
+{
+    if (m_server_log)
+        m_server_log->addRecord(HistoryLog::RT_ACTION, ticks, data, size);
+}   // addServerAction
+
+//-----------------------------------------------------------------------------
+/** Adds a full state created by the server to the race log.
+ *  \param ticks World time of the state.
+ *  \param data The state, as sent in a GP_STATE message after the time.
+ *  \param size Number of bytes of data.
+ */
+void History::addServerState(int ticks, const uint8_t *data,
+                             unsigned int size)
+{
+    if (m_server_log)
+        m_server_log->addRecord(HistoryLog::RT_STATE, ticks, data, size);
+}   // addServerState
+
 //-----------------------------------------------------------------------------
 /** Sets the kart position and controls to the recorded history value.
  *  \param world_ticks WOrld time in ticks.
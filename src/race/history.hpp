@@ -23,9 +23,12 @@
 #include "input/input.hpp"
 #include "karts/controller/kart_control.hpp"
 
+#include <memory>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
+class HistoryLog;
 class Kart;
 
 /**
@@ -60,15 +63,27 @@ private:
     /** All input events. */
     std::vector<InputEvent> m_all_input_events;
 
+    /** The log of the current network race if this is a server which
+     *  records its races. */
+    std::unique_ptr<HistoryLog> m_server_log;
+
     void  allocateMemory(int size=-1);
 public:
     static bool m_online_history_replay;
           History        ();
+         ~History        ();
     void  initRecording  ();
     void  Save           ();
     void  Load           ();
     void  updateReplay(int world_ticks);
     void  addEvent(int kart_id, PlayerAction pa, int value);
+    void  startServerRecording(uint32_t item_seed);
+    void  stopServerRecording();
+    void  addServerAction(int ticks, const uint8_t *data, unsigned int size);
+    void  addServerState(int ticks, const uint8_t *data, unsigned int size);
+    // ------------------------------------------------------------------------
+    /** Returns true if the server currently records a race. */
+    bool  isRecordingServer() const { return m_server_log != NULL; }
 
     // -------------------I-----------------------------------------------------
     /** Returns the identifier of the n-th kart. */
@@ -0,0 +1,615 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "race/history_log.hpp"
+
+#include "io/file_manager.hpp"
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+#include <string.h>
+
+const unsigned int HistoryLog::VERSION    = 1;
+const unsigned int HistoryLog::CHUNK_SIZE = 32 * 1024;
+
+namespace
+{
+    /** Magic values at the start of the file, at the start of the index and
+     *  at the end of the file. */
+    const char MAGIC[4]       = { 'S', 'T', 'K', 'H' };
+    const char INDEX_MAGIC[4] = { 'S', 'T', 'K', 'X' };
+    const char END_MAGIC[4]   = { 'S', 'T', 'K', 'E' };
+
+    /** Size of magic value, version and header size. */
+    const unsigned int PREAMBLE_SIZE     = 9;
+
+    /** Raw size, compressed size, number of records, first and last ticks. */
+    const unsigned int CHUNK_HEADER_SIZE = 20;
+
+    /** Offset of the index and end magic value. */
+    const unsigned int FOOTER_SIZE       = 12;
+
+    /** Upper limits to reject corrupt files early. Records which would
+     *  make a chunk larger than this are dropped (which can only happen if
+     *  no state is added for a long time). */
+    const uint32_t MAX_HEADER_SIZE = 1024 * 1024;
+    const uint32_t MAX_CHUNK_SIZE  = 4 * 1024 * 1024;
+
+    // ------------------------------------------------------------------------
+    bool readBytes(FILE *fd, uint64_t offset, unsigned int size,
+                   std::vector<char> *data)
+    {
+        data->resize(size);
+        return fseek(fd, (long)offset, SEEK_SET) == 0 &&
+               (size == 0 || fread(data->data(), 1, size, fd) == size);
+    }   // readBytes
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+HistoryLog::HistoryLog()
+{
+    m_fd            = NULL;
+    m_writing       = false;
+    m_current_chunk = NULL;
+    m_num_records   = 0;
+    m_first_ticks   = 0;
+    m_last_ticks    = 0;
+    m_data_start    = 0;
+}   // HistoryLog
+
+// ----------------------------------------------------------------------------
+HistoryLog::~HistoryLog()
+{
+    close();
+}   // ~HistoryLog
+
+// ----------------------------------------------------------------------------
+void HistoryLog::encodeHeader(BareNetworkString *s) const
+{
+    s->encodeString(m_header.m_stk_version)
+      .encodeString(m_header.m_track_ident)
+      .encodeString(m_header.m_minor_mode)
+      .addUInt8(m_header.m_reverse ? 1 : 0)
+      .addUInt8(m_header.m_difficulty)
+      .addUInt32(m_header.m_num_laps)
+      .addUInt32(m_header.m_item_seed)
+      .addUInt64(m_header.m_powerup_seed)
+      .addUInt8((uint8_t)m_header.m_kart_idents.size());
+    for (unsigned int i = 0; i < m_header.m_kart_idents.size(); i++)
+    {
+        s->encodeString(m_header.m_kart_idents[i])
+          .addUInt8(m_header.m_kart_handicaps[i]);
+    }
+}   // encodeHeader
+
+// ----------------------------------------------------------------------------
+bool HistoryLog::decodeHeader(const BareNetworkString &s)
+{
+    try
+    {
+        s.decodeString(&m_header.m_stk_version);
+        s.decodeString(&m_header.m_track_ident);
+        s.decodeString(&m_header.m_minor_mode);
+        m_header.m_reverse      = s.getUInt8() != 0;
+        m_header.m_difficulty   = s.getUInt8();
+        m_header.m_num_laps     = s.getUInt32();
+        m_header.m_item_seed    = s.getUInt32();
+        m_header.m_powerup_seed = s.getUInt64();
+        unsigned int num_karts  = s.getUInt8();
+        m_header.m_kart_idents.resize(num_karts);
+        m_header.m_kart_handicaps.resize(num_karts);
+        for (unsigned int i = 0; i < num_karts; i++)
+        {
+            s.decodeString(&m_header.m_kart_idents[i]);
+            m_header.m_kart_handicaps[i] = s.getUInt8();
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+    return true;
+}   // decodeHeader
+
+// ----------------------------------------------------------------------------
+/** Creates a new log file and writes the header.
+ *  \param filename Full path of the file.
+ *  \param header Information about the race.
+ *  \return False if the file can't be written.
+ */
+bool HistoryLog::create(const std::string &filename, const Header &header)
+{
+    close();
+    assert(header.m_kart_idents.size() == header.m_kart_handicaps.size());
+    m_fd = fopen(filename.c_str(), "wb");
+    if (!m_fd)
+    {
+        Log::error("HistoryLog", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return false;
+    }
+    m_header  = header;
+    m_chunks.clear();
+
+    BareNetworkString h(256);
+    encodeHeader(&h);
+    BareNetworkString s(PREAMBLE_SIZE + h.getTotalSize());
+    for (unsigned int i = 0; i < sizeof(MAGIC); i++)
+        s.addChar(MAGIC[i]);
+    s.addUInt8(VERSION).addUInt32(h.getTotalSize());
+    std::vector<uint8_t> &buffer = s.getBuffer();
+    buffer.insert(buffer.end(), h.getBuffer().begin(), h.getBuffer().end());
+    m_data_start = buffer.size();
+    if (fwrite(buffer.data(), 1, buffer.size(), m_fd) != buffer.size())
+    {
+        Log::error("HistoryLog", "Can't write '%s'.", filename.c_str());
+        fclose(m_fd);
+        m_fd = NULL;
+        remove(filename.c_str());
+        return false;
+    }
+
+    m_writing       = true;
+    m_current_chunk = new BareNetworkString(CHUNK_SIZE + 1024);
+    m_num_records   = 0;
+    return true;
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Adds a record to the log. Records must be added in the order of their
+ *  time. A state record starts a new chunk if the current chunk is full.
+ *  Since each chunk must start with a state, actions added before the first
+ *  state are dropped.
+ *  \param type Type of the record.
+ *  \param ticks World time of the record.
+ *  \param data The data of the record.
+ *  \param size Number of bytes of data.
+ */
+void HistoryLog::addRecord(RecordType type, int ticks, const uint8_t *data,
+                           unsigned int size)
+{
+    if (!isWriting())
+        return;
+    assert(m_num_records == 0 || ticks >= m_last_ticks);
+
+    // Only states start a new chunk, so a simulation can start with any
+    // chunk
+    if (m_num_records == 0 && type != RT_STATE)
+        return;
+    if (type == RT_STATE && m_current_chunk->getTotalSize() >= CHUNK_SIZE)
+    {
+        writeChunk();
+    }
+    else if (m_current_chunk->getTotalSize() + size + 16 > MAX_CHUNK_SIZE)
+    {
+        Log::warn("HistoryLog", "No state for too long, dropping record "
+                  "at %d.", ticks);
+        return;
+    }
+
+    if (m_num_records == 0)
+    {
+        m_first_ticks = ticks;
+        m_last_ticks  = ticks;
+    }
+    // Unsigned arithmetic, so the difference is decoded correctly even if
+    // the time went backwards.
+    m_current_chunk->addUInt8(type)
+        .addVarUInt32((uint32_t)ticks - (uint32_t)m_last_ticks)
+        .addVarUInt32(size);
+    std::vector<uint8_t> &buffer = m_current_chunk->getBuffer();
+    buffer.insert(buffer.end(), data, data + size);
+    m_last_ticks = ticks;
+    m_num_records++;
+}   // addRecord
+
+// ----------------------------------------------------------------------------
+/** Compresses the current chunk and appends it to the file. */
+bool HistoryLog::writeChunk()
+{
+    if (m_num_records == 0)
+        return true;
+
+    const std::vector<uint8_t> &raw = m_current_chunk->getBuffer();
+    uLongf compressed_size = compressBound((uLong)raw.size());
+    std::vector<uint8_t> compressed(CHUNK_HEADER_SIZE + compressed_size);
+    bool ok = compress2(compressed.data() + CHUNK_HEADER_SIZE,
+                        &compressed_size, raw.data(), (uLong)raw.size(),
+                        Z_DEFAULT_COMPRESSION) == Z_OK;
+    ChunkInfo ci;
+    ci.m_offset          = (uint64_t)ftell(m_fd);
+    ci.m_raw_size        = (uint32_t)raw.size();
+    ci.m_compressed_size = (uint32_t)compressed_size;
+    ci.m_num_records     = m_num_records;
+    ci.m_first_ticks     = m_first_ticks;
+    ci.m_last_ticks      = m_last_ticks;
+
+    BareNetworkString header(CHUNK_HEADER_SIZE);
+    header.addUInt32(ci.m_raw_size).addUInt32(ci.m_compressed_size)
+          .addUInt32(ci.m_num_records).addUInt32(ci.m_first_ticks)
+          .addUInt32(ci.m_last_ticks);
+    memcpy(compressed.data(), header.getData(), CHUNK_HEADER_SIZE);
+    compressed.resize(CHUNK_HEADER_SIZE + compressed_size);
+
+    ok = ok &&
+        fwrite(compressed.data(), 1, compressed.size(), m_fd) ==
+                                                          compressed.size();
+    // Make sure that the data is in the file if the server stops
+    fflush(m_fd);
+    if (ok)
+        m_chunks.push_back(ci);
+    else
+        Log::error("HistoryLog", "Can't write chunk at %d.", m_first_ticks);
+
+    m_current_chunk->getBuffer().clear();
+    m_current_chunk->reset();
+    m_num_records = 0;
+    return ok;
+}   // writeChunk
+
+// ----------------------------------------------------------------------------
+/** Writes the last chunk and the index when writing, and closes the file.
+ */
+void HistoryLog::close()
+{
+    if (!m_fd)
+        return;
+
+    if (m_writing)
+    {
+        writeChunk();
+        BareNetworkString s(16 + (int)m_chunks.size() * 28);
+        for (unsigned int i = 0; i < sizeof(INDEX_MAGIC); i++)
+            s.addChar(INDEX_MAGIC[i]);
+        s.addUInt32((uint32_t)m_chunks.size());
+        for (const ChunkInfo &ci : m_chunks)
+        {
+            s.addUInt64(ci.m_offset).addUInt32(ci.m_raw_size)
+             .addUInt32(ci.m_compressed_size).addUInt32(ci.m_num_records)
+             .addUInt32(ci.m_first_ticks).addUInt32(ci.m_last_ticks);
+        }
+        s.addUInt64((uint64_t)ftell(m_fd));
+        for (unsigned int i = 0; i < sizeof(END_MAGIC); i++)
+            s.addChar(END_MAGIC[i]);
+        if (fwrite(s.getData(), 1, s.getTotalSize(), m_fd) !=
+            s.getTotalSize())
+            Log::error("HistoryLog", "Can't write index.");
+        delete m_current_chunk;
+        m_current_chunk = NULL;
+    }
+    fclose(m_fd);
+    m_fd = NULL;
+}   // close
+
+// ----------------------------------------------------------------------------
+/** Opens a log for reading. The index is read from the end of the file, or
+ *  rebuilt from the chunk headers if the log was not closed properly.
+ *  \param filename Full path of the file.
+ *  \return False if the file can't be read.
+ */
+bool HistoryLog::open(const std::string &filename)
+{
+    close();
+    m_fd = fopen(filename.c_str(), "rb");
+    if (!m_fd)
+        return false;
+    m_writing = false;
+    m_chunks.clear();
+
+    std::vector<char> data;
+    if (!readBytes(m_fd, 0, PREAMBLE_SIZE, &data) ||
+        memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+    {
+        Log::error("HistoryLog", "'%s' is not a history log.",
+                   filename.c_str());
+        close();
+        return false;
+    }
+    BareNetworkString p(data.data() + sizeof(MAGIC),
+                        PREAMBLE_SIZE - sizeof(MAGIC));
+    unsigned int version = p.getUInt8();
+    uint32_t header_size = p.getUInt32();
+    if (version != VERSION || header_size > MAX_HEADER_SIZE ||
+        !readBytes(m_fd, PREAMBLE_SIZE, header_size, &data) ||
+        !decodeHeader(BareNetworkString(data.data(), (int)header_size)))
+    {
+        Log::error("HistoryLog", "Unsupported or corrupt header in '%s'.",
+                   filename.c_str());
+        close();
+        return false;
+    }
+    m_data_start = PREAMBLE_SIZE + header_size;
+
+    fseek(m_fd, 0, SEEK_END);
+    const uint64_t file_size = (uint64_t)ftell(m_fd);
+    if (!readIndex(file_size))
+    {
+        Log::warn("HistoryLog", "No index in '%s', reading chunk headers.",
+                  filename.c_str());
+        scanChunks(file_size);
+    }
+    return true;
+}   // open
+
+// ----------------------------------------------------------------------------
+/** Reads the index at the end of the file.
+ *  \return False if there is no valid index.
+ */
+bool HistoryLog::readIndex(uint64_t file_size)
+{
+    std::vector<char> data;
+    if (file_size < m_data_start + FOOTER_SIZE ||
+        !readBytes(m_fd, file_size - FOOTER_SIZE, FOOTER_SIZE, &data) ||
+        memcmp(data.data() + 8, END_MAGIC, sizeof(END_MAGIC)) != 0)
+        return false;
+
+    const uint64_t index_start =
+        BareNetworkString(data.data(), FOOTER_SIZE).getUInt64();
+    if (index_start < m_data_start ||
+        index_start > file_size - FOOTER_SIZE ||
+        !readBytes(m_fd, index_start,
+                   (unsigned int)(file_size - FOOTER_SIZE - index_start),
+                   &data) ||
+        data.size() < 8 ||
+        memcmp(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        return false;
+
+    BareNetworkString s(data.data(), (int)data.size());
+    try
+    {
+        s.skip(sizeof(INDEX_MAGIC));
+        uint32_t num_chunks = s.getUInt32();
+        if (num_chunks > s.size())
+            return false;
+        m_chunks.resize(num_chunks);
+        for (ChunkInfo &ci : m_chunks)
+        {
+            ci.m_offset          = s.getUInt64();
+            ci.m_raw_size        = s.getUInt32();
+            ci.m_compressed_size = s.getUInt32();
+            ci.m_num_records     = s.getUInt32();
+            ci.m_first_ticks     = s.getUInt32();
+            ci.m_last_ticks      = s.getUInt32();
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        m_chunks.clear();
+        return false;
+    }
+    return true;
+}   // readIndex
+
+// ----------------------------------------------------------------------------
+/** Rebuilds the index by reading all chunk headers, up to the first
+ *  incomplete chunk.
+ */
+void HistoryLog::scanChunks(uint64_t file_size)
+{
+    uint64_t offset = m_data_start;
+    std::vector<char> data;
+    while (offset + CHUNK_HEADER_SIZE <= file_size &&
+           readBytes(m_fd, offset, CHUNK_HEADER_SIZE, &data) &&
+           memcmp(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+    {
+        BareNetworkString s(data.data(), CHUNK_HEADER_SIZE);
+        ChunkInfo ci;
+        ci.m_offset          = offset;
+        ci.m_raw_size        = s.getUInt32();
+        ci.m_compressed_size = s.getUInt32();
+        ci.m_num_records     = s.getUInt32();
+        ci.m_first_ticks     = s.getUInt32();
+        ci.m_last_ticks      = s.getUInt32();
+        offset += CHUNK_HEADER_SIZE + ci.m_compressed_size;
+        if (ci.m_raw_size > MAX_CHUNK_SIZE ||
+            ci.m_compressed_size > compressBound(ci.m_raw_size) ||
+            offset > file_size)
+            break;
+        m_chunks.push_back(ci);
+    }
+}   // scanChunks
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the last chunk starting at or before the given
+ *  time, or 0 if all chunks start later.
+ */
+unsigned int HistoryLog::findChunk(int ticks) const
+{
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), ticks,
+        [](int t, const ChunkInfo &ci) { return t < ci.m_first_ticks; });
+    return it == m_chunks.begin() ? 0
+                                  : (unsigned int)(it - m_chunks.begin()) - 1;
+}   // findChunk
+
+// ----------------------------------------------------------------------------
+/** Reads and decompresses one chunk, and appends its records.
+ *  \param n Index of the chunk.
+ *  \param records The records are appended here.
+ *  \return False if the chunk is corrupt.
+ */
+bool HistoryLog::readChunk(unsigned int n, std::vector<Record> *records) const
+{
+    if (!m_fd || m_writing || n >= m_chunks.size())
+        return false;
+    const ChunkInfo &ci = m_chunks[n];
+    if (ci.m_raw_size > MAX_CHUNK_SIZE ||
+        ci.m_compressed_size > compressBound(ci.m_raw_size))
+        return false;
+
+    std::vector<char> compressed;
+    std::vector<char> raw(ci.m_raw_size);
+    uLongf raw_size = ci.m_raw_size;
+    if (!readBytes(m_fd, ci.m_offset + CHUNK_HEADER_SIZE,
+                   ci.m_compressed_size, &compressed) ||
+        uncompress((Bytef*)raw.data(), &raw_size,
+                   (const Bytef*)compressed.data(),
+                   ci.m_compressed_size) != Z_OK ||
+        raw_size != ci.m_raw_size)
+        return false;
+
+    BareNetworkString s(raw.data(), (int)raw.size());
+    uint32_t ticks = ci.m_first_ticks;
+    try
+    {
+        for (unsigned int i = 0; i < ci.m_num_records; i++)
+        {
+            Record r;
+            r.m_type  = (RecordType)s.getUInt8();
+            ticks    += s.getVarUInt32();
+            r.m_ticks = (int)ticks;
+            uint32_t size = s.getVarUInt32();
+            if (size > s.size())
+                return false;
+            r.m_data.assign(s.getCurrentData(), s.getCurrentData() + size);
+            s.skip(size);
+            records->push_back(std::move(r));
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+    return true;
+}   // readChunk
+
+// ----------------------------------------------------------------------------
+void HistoryLog::unitTesting()
+{
+    const std::string filename =
+        file_manager->getTempFile("history-log-unit-test.dat");
+    HistoryLog::Header header;
+    header.m_stk_version  = "test";
+    header.m_track_ident  = "lighthouse";
+    header.m_minor_mode   = "normal-race";
+    header.m_reverse      = true;
+    header.m_difficulty   = 2;
+    header.m_num_laps     = 3;
+    header.m_item_seed    = 1234;
+    header.m_powerup_seed = 0x123456789aULL;
+    header.m_kart_idents    = { "tux", "nolok" };
+    header.m_kart_handicaps = { 0, 1 };
+
+    // A state every 10 ticks and some actions in between
+    const int num_ticks = 20000;
+    std::vector<uint8_t> state(500);
+    const uint8_t action[7] = { 1, 2, 3, 4, 5, 6, 7 };
+    HistoryLog writer;
+    bool ok = writer.create(filename, header);
+    assert(ok);
+    // An action before the first state is dropped
+    writer.addRecord(RT_ACTION, 0, action, sizeof(action));
+    assert(writer.m_num_records == 0);
+    for (int t = 0; t < num_ticks; t++)
+    {
+        if (t % 10 == 0)
+        {
+            for (unsigned int i = 0; i < state.size(); i++)
+                state[i] = (uint8_t)(t / 10 + i % 7);
+            writer.addRecord(RT_STATE, t, state.data(),
+                             (unsigned int)state.size());
+        }
+        if (t % 7 == 0)
+            writer.addRecord(RT_ACTION, t, action, sizeof(action));
+    }
+    // Simulate a server which stopped without closing the log
+    ok = writer.writeChunk();
+    fclose(writer.m_fd);
+    writer.m_fd = NULL;
+    delete writer.m_current_chunk;
+    writer.m_current_chunk = NULL;
+    const unsigned int num_chunks = (unsigned int)writer.m_chunks.size();
+    assert(num_chunks > 10);
+    (void)num_chunks;
+
+    for (int closed = 0; closed < 2; closed++)
+    {
+        if (closed)
+        {
+            // Write the same log again, this time with index
+            ok = writer.create(filename, header) && ok;
+            for (int t = 0; t < num_ticks; t++)
+            {
+                if (t % 10 == 0)
+                {
+                    for (unsigned int i = 0; i < state.size(); i++)
+                        state[i] = (uint8_t)(t / 10 + i % 7);
+                    writer.addRecord(RT_STATE, t, state.data(),
+                                     (unsigned int)state.size());
+                }
+                if (t % 7 == 0)
+                    writer.addRecord(RT_ACTION, t, action, sizeof(action));
+            }
+            writer.close();
+        }
+
+        HistoryLog reader;
+        ok = reader.open(filename) && ok;
+        assert(ok);
+        assert(reader.getHeader().m_track_ident == "lighthouse");
+        assert(reader.getHeader().m_powerup_seed == 0x123456789aULL);
+        assert(reader.getHeader().m_kart_idents[1] == "nolok");
+        assert(reader.getHeader().m_kart_handicaps[1] == 1);
+        assert(reader.getNumChunks() == num_chunks);
+
+        int num_states = 0, num_actions = 0, last_ticks = 0;
+        for (unsigned int c = 0; c < reader.getNumChunks(); c++)
+        {
+            std::vector<Record> records;
+            ok = reader.readChunk(c, &records) && ok;
+            assert(ok);
+            // Each chunk starts with a state
+            assert(records[0].m_type == RT_STATE);
+            assert(records[0].m_ticks == reader.getChunkInfo(c).m_first_ticks);
+            for (const Record &r : records)
+            {
+                assert(r.m_ticks >= last_ticks);
+                last_ticks = r.m_ticks;
+                if (r.m_type == RT_STATE)
+                {
+                    assert(r.m_ticks % 10 == 0);
+                    assert(r.m_data.size() == state.size());
+                    assert(r.m_data[3] == (uint8_t)(r.m_ticks / 10 + 3));
+                    num_states++;
+                }
+                else
+                {
+                    assert(r.m_ticks % 7 == 0);
+                    assert(memcmp(r.m_data.data(), action, 7) == 0);
+                    num_actions++;
+                }
+            }
+        }
+        assert(num_states  == (num_ticks + 9) / 10);
+        assert(num_actions == (num_ticks + 6) / 7);
+        (void)last_ticks;
+
+        // Seeking
+        unsigned int c = reader.findChunk(12345);
+        assert(reader.getChunkInfo(c).m_first_ticks <= 12345);
+        assert(reader.getChunkInfo(c).m_last_ticks >= 12345);
+        assert(reader.findChunk(-1) == 0);
+        (void)c;
+    }
+    remove(filename.c_str());
+}   // unitTesting
@@ -0,0 +1,162 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_HISTORY_LOG_HPP
+#define HEADER_HISTORY_LOG_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class BareNetworkString;
+
+/** \brief A compact binary log of a network race recorded by the server.
+ *  It contains all player actions as they were executed by the server, and
+ *  the full states the server created for its clients. The log is written
+ *  while the race is running: records are collected in a chunk, and once
+ *  the chunk is big enough it is compressed with zlib and appended to the
+ *  file, so only one chunk is kept in memory. A new chunk is always started
+ *  with a state, so a race can be simulated again starting at any chunk.
+ *  When the log is closed an index of all chunks is appended. If the server
+ *  stops before that (e.g. crash), the index is rebuilt by reading the
+ *  chunk headers when the log is opened.
+ *  File layout: magic value "STKH", version (1 byte), size of the header
+ *  (4 bytes), header, chunks, index, offset of the index (8 bytes), magic
+ *  value "STKE". Each chunk has a 20 byte uncompressed chunk header.
+ * \ingroup race
+ */
+class HistoryLog : public NoCopy
+{
+public:
+    /** Type of a record. */
+    enum RecordType : uint8_t
+    {
+        /** An action of a player, as used by GameProtocol::rewind. */
+        RT_ACTION = 0,
+        /** A full state of all rewinders, as sent by the server (without
+         *  message type and time). */
+        RT_STATE  = 1
+    };
+
+    // ------------------------------------------------------------------------
+    struct Record
+    {
+        RecordType           m_type;
+        /** World time of this record. */
+        int                  m_ticks;
+        std::vector<uint8_t> m_data;
+    };   // Record
+
+    // ------------------------------------------------------------------------
+    /** Information needed to set up the race again. */
+    struct Header
+    {
+        std::string              m_stk_version;
+        std::string              m_track_ident;
+        std::string              m_minor_mode;
+        bool                     m_reverse;
+        unsigned int             m_difficulty;
+        unsigned int             m_num_laps;
+        uint32_t                 m_item_seed;
+        uint64_t                 m_powerup_seed;
+        /** Identity of each kart, in world kart id order. */
+        std::vector<std::string> m_kart_idents;
+        /** PerPlayerDifficulty of each kart. */
+        std::vector<uint8_t>     m_kart_handicaps;
+    };   // Header
+
+    // ------------------------------------------------------------------------
+    /** Position of a chunk in the file. */
+    struct ChunkInfo
+    {
+        /** File offset of the chunk header. */
+        uint64_t m_offset;
+        uint32_t m_raw_size;
+        uint32_t m_compressed_size;
+        uint32_t m_num_records;
+        /** World time of the first and the last record of this chunk. */
+        int      m_first_ticks;
+        int      m_last_ticks;
+    };   // ChunkInfo
+
+private:
+    FILE                  *m_fd;
+
+    /** True if the log is written, false if it is read. */
+    bool                   m_writing;
+
+    Header                 m_header;
+
+    std::vector<ChunkInfo> m_chunks;
+
+    /** Records of the chunk which is not yet written (writing only). */
+    BareNetworkString     *m_current_chunk;
+
+    /** Number of records in m_current_chunk. */
+    uint32_t               m_num_records;
+
+    /** Time of the first and last record in m_current_chunk. */
+    int                    m_first_ticks;
+    int                    m_last_ticks;
+
+    /** File offset of the first chunk. */
+    uint64_t               m_data_start;
+
+    void encodeHeader(BareNetworkString *s) const;
+    bool decodeHeader(const BareNetworkString &s);
+    bool writeChunk();
+    bool readIndex(uint64_t file_size);
+    void scanChunks(uint64_t file_size);
+
+public:
+    /** Version of the file format. */
+    static const unsigned int VERSION;
+
+    /** A chunk is written once it contains at least this many bytes
+     *  (uncompressed) and a new state is added. */
+    static const unsigned int CHUNK_SIZE;
+
+          HistoryLog();
+         ~HistoryLog();
+    bool  create(const std::string &filename, const Header &header);
+    void  addRecord(RecordType type, int ticks, const uint8_t *data,
+                    unsigned int size);
+    void  close();
+    bool  open(const std::string &filename);
+    unsigned int findChunk(int ticks) const;
+    bool  readChunk(unsigned int n, std::vector<Record> *records) const;
+    // ------------------------------------------------------------------------
+    /** Returns the header of the race. */
+    const Header& getHeader() const { return m_header; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of chunks (reading only). */
+    unsigned int getNumChunks() const { return (unsigned int)m_chunks.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns information about a chunk (reading only). */
+    const ChunkInfo& getChunkInfo(unsigned int n) const { return m_chunks[n]; }
+    // ------------------------------------------------------------------------
+    /** Returns true if a log is currently written. */
+    bool  isWriting() const { return m_fd && m_writing; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // HistoryLog
+
+#endif
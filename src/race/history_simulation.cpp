@@ -0,0 +1,492 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "race/history_simulation.hpp"
+
+#include "io/file_manager.hpp"
+#include "items/item_manager.hpp"
+#include "items/network_item_manager.hpp"
+#include "items/powerup_manager.hpp"
+#include "items/projectile_manager.hpp"
+#include "karts/kart_properties_manager.hpp"
+#include "modes/profile_world.hpp"
+#include "modes/world.hpp"
+#include "network/network_config.hpp"
+#include "network/network_string.hpp"
+#include "network/protocols/game_protocol.hpp"
+#include "network/remote_kart_info.hpp"
+#include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
+#include "physics/physical_object.hpp"
+#include "race/race_manager.hpp"
+#include "states_screens/state_manager.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "tracks/track_object.hpp"
+#include "tracks/track_object_manager.hpp"
+#include "utils/constants.hpp"
+#include "utils/log.hpp"
+#include "utils/subsystem_timer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    /** Reads the names of the rewinders at the beginning of a state. */
+    std::vector<std::string> getRewinderNames(BareNetworkString *state)
+    {
+        std::vector<std::string> names(state->getUInt8());
+        for (std::string &name : names)
+            state->decodeString(&name);
+        return names;
+    }   // getRewinderNames
+
+    // ------------------------------------------------------------------------
+    /** The item state depends on the confirmations of the clients, which do
+     *  not exist in a simulation, so it is neither restored nor compared. */
+    bool isItemManager(const std::string &name)
+    {
+        std::shared_ptr<Rewinder> r = RewindManager::get()->getRewinder(name);
+        return r && dynamic_cast<NetworkItemManager*>(r.get()) != NULL;
+    }   // isItemManager
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+HistorySimulation::HistorySimulation()
+{
+    m_next_record     = 0;
+    m_next_chunk      = 0;
+    m_state_restored  = false;
+    m_states_compared = 0;
+    m_ticks           = 0;
+}   // HistorySimulation
+
+// ----------------------------------------------------------------------------
+/** Sets up the race manager like a server would do for the recorded race,
+ *  and loads the world.
+ *  \return False if the race can't be simulated.
+ */
+bool HistorySimulation::setupRace()
+{
+    const HistoryLog::Header &header = m_log.getHeader();
+    if (header.m_stk_version != STK_VERSION)
+    {
+        Log::warn("HistorySimulation", "Race was recorded with version %s, "
+                  "the simulation will likely differ.",
+                  header.m_stk_version.c_str());
+    }
+
+    if (header.m_minor_mode != RaceManager::getIdentOf(
+                                       RaceManager::MINOR_MODE_NORMAL_RACE) &&
+        header.m_minor_mode != RaceManager::getIdentOf(
+                                       RaceManager::MINOR_MODE_TIME_TRIAL) &&
+        header.m_minor_mode != RaceManager::getIdentOf(
+                                       RaceManager::MINOR_MODE_FOLLOW_LEADER))
+    {
+        Log::error("HistorySimulation", "Race mode '%s' is not supported.",
+                   header.m_minor_mode.c_str());
+        return false;
+    }
+    if (!track_manager->getTrack(header.m_track_ident))
+    {
+        Log::error("HistorySimulation", "Track '%s' not found.",
+                   header.m_track_ident.c_str());
+        return false;
+    }
+    if (header.m_kart_idents.empty() ||
+        header.m_kart_idents.size() != header.m_kart_handicaps.size() ||
+        header.m_difficulty >= RaceManager::DIFFICULTY_COUNT)
+    {
+        Log::error("HistorySimulation", "Invalid race setup.");
+        return false;
+    }
+    for (unsigned int i = 0; i < header.m_kart_idents.size(); i++)
+    {
+        if (!kart_properties_manager->getKart(header.m_kart_idents[i]) ||
+            header.m_kart_handicaps[i] >= PLAYER_DIFFICULTY_COUNT)
+        {
+            Log::error("HistorySimulation", "Kart '%s' not found.",
+                       header.m_kart_idents[i].c_str());
+            return false;
+        }
+    }
+
+    // Simulate the server, there is no host and no client
+    NetworkConfig::get()->setIsServer(true);
+    NetworkConfig::get()->setIsLAN();
+
+    StateManager::get()->resetActivePlayers();
+    race_manager->setMinorMode(
+               RaceManager::getModeIDFromInternalName(header.m_minor_mode));
+    race_manager->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+    race_manager->setDifficulty(
+                             (RaceManager::Difficulty)header.m_difficulty);
+    race_manager->setTimeTarget(0.0f);
+
+    // Same as LobbyProtocol::configRemoteKart on the server
+    const int num_karts = (int)header.m_kart_idents.size();
+    race_manager->setNumKarts(num_karts);
+    race_manager->setNumPlayers(num_karts, 0);
+    for (int i = 0; i < num_karts; i++)
+    {
+        RemoteKartInfo rki(StateManager::get()->createActivePlayer(NULL, NULL),
+                           header.m_kart_idents[i], "", i, true);
+        rki.setGlobalPlayerId(i);
+        rki.setPerPlayerDifficulty(
+                            (PerPlayerDifficulty)header.m_kart_handicaps[i]);
+        race_manager->setPlayerKart(i, rki);
+    }
+    race_manager->computeRandomKartList();
+
+    ItemManager::updateRandomSeed(header.m_item_seed);
+    race_manager->setReverseTrack(header.m_reverse);
+    race_manager->startSingleRace(header.m_track_ident, header.m_num_laps,
+                                  false/*from_overworld*/);
+    World::getWorld()->setNetworkWorld(true);
+    powerup_manager->setRandomSeed(header.m_powerup_seed);
+
+    if (!ProfileWorld::isNoGraphics())
+    {
+        Log::warn("HistorySimulation", "Use --no-graphics, graphical effects "
+                  "can change the simulation and slow it down.");
+    }
+    return true;
+}   // setupRace
+
+// ----------------------------------------------------------------------------
+/** Returns the next record of the log without using it, reading the next
+ *  chunk if necessary.
+ *  \return The record, or NULL at the end of the log.
+ */
+HistoryLog::Record* HistorySimulation::peekRecord()
+{
+    while (m_next_record >= m_records.size())
+    {
+        if (m_next_chunk >= m_log.getNumChunks())
+            return NULL;
+        m_records.clear();
+        m_next_record = 0;
+        if (!m_log.readChunk(m_next_chunk, &m_records))
+        {
+            Log::error("HistorySimulation", "Can't read chunk %d.",
+                       m_next_chunk);
+            m_records.clear();
+        }
+        m_next_chunk++;
+    }
+    return &m_records[m_next_record];
+}   // peekRecord
+
+// ----------------------------------------------------------------------------
+/** Executes a recorded player action, like GameProtocol::rewind does on the
+ *  server.
+ */
+void HistorySimulation::rewind(BareNetworkString *buffer)
+{
+    GameProtocol::applyAction(buffer);
+}   // rewind
+
+// ----------------------------------------------------------------------------
+/** Restores all rewinders from a recorded state, similar to
+ *  RewindInfoState::restore.
+ */
+void HistorySimulation::restoreState(BareNetworkString *state)
+{
+    // Physical objects are only saved if they moved since they were saved
+    // last. Objects not in the recorded state had not moved on the server,
+    // so their current state is used as the last saved state (otherwise
+    // they would be reported as only existing in the simulation).
+    for (TrackObject *object :
+         Track::getCurrentTrack()->getTrackObjectManager()->getObjects())
+    {
+        if (object->getPhysicalObject())
+            object->getPhysicalObject()->setLastStateToCurrent();
+    }
+
+    state->reset();
+    const std::vector<std::string> names = getRewinderNames(state);
+    for (const std::string &name : names)
+    {
+        const uint16_t size = state->getUInt16();
+        const int offset = state->getCurrentOffset();
+        std::shared_ptr<Rewinder> r = RewindManager::get()->getRewinder(name);
+        if (!r)
+            r = projectile_manager->addRewinderFromNetworkState(name);
+        if (!r)
+        {
+            Log::error("HistorySimulation", "Missing rewinder %s",
+                       name.c_str());
+        }
+        else if (!isItemManager(name))
+        {
+            try
+            {
+                r->restoreState(state, size);
+            }
+            catch (std::exception& e)
+            {
+                Log::error("HistorySimulation", "Restore state error: %s",
+                           e.what());
+            }
+        }
+        state->reset();
+        state->skip(offset + size);
+    }
+}   // restoreState
+
+// ----------------------------------------------------------------------------
+/** Stores the first divergence of a rewinder.
+ */
+void HistorySimulation::addDivergence(const std::string &name, int ticks,
+                                      int offset, int recorded_size,
+                                      int simulated_size)
+{
+    if (m_divergences.find(name) != m_divergences.end())
+        return;
+    Divergence &d = m_divergences[name];
+    d.m_ticks             = ticks;
+    d.m_offset            = offset;
+    d.m_recorded_size     = recorded_size;
+    d.m_simulated_size    = simulated_size;
+    d.m_significant_ticks = -1;
+}   // addDivergence
+
+// ----------------------------------------------------------------------------
+/** Compares a recorded state with the current state of the simulation.
+ *  \param ticks World time of the state.
+ *  \param state The recorded state.
+ */
+void HistorySimulation::compareState(int ticks, BareNetworkString *state)
+{
+    RewindManager::get()->saveAllStates(&m_simulated_states);
+    m_states_compared++;
+
+    state->reset();
+    const std::vector<std::string> names = getRewinderNames(state);
+    for (const std::string &name : names)
+    {
+        const uint16_t size = state->getUInt16();
+        const int offset = state->getCurrentOffset();
+        auto it = m_simulated_states.find(name);
+        if (it == m_simulated_states.end())
+        {
+            addDivergence(name, ticks, -1, size, 0);
+            state->skip(size);
+            continue;
+        }
+
+        std::vector<uint8_t> &simulated = it->second;
+        const uint8_t *recorded = (const uint8_t*)state->getCurrentData();
+        const size_t common = std::min<size_t>(size, simulated.size());
+        const size_t first =
+            std::mismatch(recorded, recorded + common, simulated.begin())
+                                                         .first - recorded;
+        if ((first < common || size != simulated.size()) &&
+            !isItemManager(name))
+        {
+            addDivergence(name, ticks, (int)first, size,
+                          (int)simulated.size());
+            Divergence &d = m_divergences[name];
+            std::shared_ptr<Rewinder> r =
+                RewindManager::get()->getRewinder(name);
+            if (r && d.m_significant_ticks == -1)
+            {
+                // The simulated state is swapped in and out to avoid a copy
+                BareNetworkString simulated_state(0);
+                std::swap(simulated_state.getBuffer(), simulated);
+                try
+                {
+                    if (r->hasDiverged(state, size, &simulated_state))
+                        d.m_significant_ticks = ticks;
+                }
+                catch (std::exception&)
+                {
+                    d.m_significant_ticks = ticks;
+                }
+                std::swap(simulated_state.getBuffer(), simulated);
+            }
+        }
+        m_simulated_states.erase(it);
+        state->reset();
+        state->skip(offset + size);
+    }
+
+    // Rewinders which only exist in the simulation
+    for (auto &p : m_simulated_states)
+    {
+        if (!isItemManager(p.first))
+        {
+            addDivergence(p.first, ticks, -1, 0,
+                          (int)p.second.size());
+        }
+    }
+}   // compareState
+
+// ----------------------------------------------------------------------------
+/** Writes the result and the timings of the simulation as JSON, using the
+ *  same format as the benchmark of ProfileWorld.
+ */
+void HistorySimulation::writeReport(double ticks_per_second) const
+{
+    std::string name =
+        file_manager->getUserConfigFile(file_manager->getStdoutName()) +
+        ".simulation.json";
+    std::ofstream json(name);
+    json << "{\n  \"track\": \"" << Track::getCurrentTrack()->getIdent()
+         << "\",\n  \"karts\": " << World::getWorld()->getNumKarts()
+         << ",\n  \"ticks\": " << m_ticks
+         << ",\n  \"ticks-per-second\": " << ticks_per_second
+         << ",\n  \"states-compared\": " << m_states_compared
+         << ",\n  \"diverged\": [";
+    bool first = true;
+    for (auto &p : m_divergences)
+    {
+        const Divergence &d = p.second;
+        json << (first ? "\n" : ",\n")
+             << "    { \"rewinder\": \"" << p.first
+             << "\", \"ticks\": " << d.m_ticks
+             << ", \"offset\": " << d.m_offset
+             << ", \"recorded-size\": " << d.m_recorded_size
+             << ", \"simulated-size\": " << d.m_simulated_size
+             << ", \"significant-ticks\": " << d.m_significant_ticks << " }";
+        first = false;
+    }
+    json << (first ? "],\n" : "\n  ],\n");
+    SubsystemTimer::writeJSON(json, m_ticks);
+    json << "\n}\n";
+    json.close();
+    Log::info("HistorySimulation", "Result written to '%s'.", name.c_str());
+}   // writeReport
+
+// ----------------------------------------------------------------------------
+/** Simulates a recorded race and compares it with the recorded states.
+ *  \param filename Full path of the log.
+ *  \return True if the simulation did not diverge from the recorded race.
+ */
+bool HistorySimulation::run(const std::string &filename)
+{
+    if (!m_log.open(filename))
+    {
+        Log::error("HistorySimulation", "Can't read '%s'.",
+                   filename.c_str());
+        return false;
+    }
+    if (m_log.getNumChunks() == 0)
+    {
+        Log::error("HistorySimulation", "'%s' contains no race.",
+                   filename.c_str());
+        return false;
+    }
+    if (!setupRace())
+        return false;
+
+    // There are no clients to wait for, so the race starts immediately
+    World *world = World::getWorld();
+    world->setPhase(WorldStatus::READY_PHASE);
+    while (world->getPhase() != WorldStatus::GO_PHASE)
+    {
+        world->updateWorld(1);
+        world->updateTime(1);
+    }
+
+    const int last_ticks =
+        m_log.getChunkInfo(m_log.getNumChunks() - 1).m_last_ticks;
+    SubsystemTimer::reset();
+    SubsystemTimer::setEnabled(true);
+    BareNetworkString state(0);
+    // The count up time is reset when a countdown race is over
+    while (world->getTicksSinceStart() <= last_ticks &&
+           world->getPhase() < WorldStatus::RESULT_DISPLAY_PHASE)
+    {
+        const int ticks = world->getTicksSinceStart();
+        bool has_state = false;
+        HistoryLog::Record *record;
+        while ((record = peekRecord()) != NULL && record->m_ticks <= ticks)
+        {
+            const std::vector<uint8_t> &data = record->m_data;
+            if (record->m_type == HistoryLog::RT_ACTION)
+            {
+                if (!data.empty() && data[0] < world->getNumKarts())
+                {
+                    RewindManager::get()->addNetworkEvent(this,
+                        new BareNetworkString((const char*)data.data(),
+                                              (int)data.size()), ticks);
+                }
+            }
+            else if (record->m_ticks == ticks)
+            {
+                std::swap(state.getBuffer(), record->m_data);
+                has_state = true;
+            }
+            m_next_record++;
+        }
+
+        // Same order as on the server: the actions are executed before
+        // the world update, which saves the state at its beginning.
+        int n = 1;
+        RewindManager::get()->playEventsTill(ticks, &n);
+        if (has_state)
+        {
+            try
+            {
+                if (m_state_restored)
+                    compareState(ticks, &state);
+                else
+                    restoreState(&state);
+            }
+            catch (std::out_of_range&)
+            {
+                Log::error("HistorySimulation", "Invalid state at %d.",
+                           ticks);
+            }
+            m_state_restored = true;
+        }
+        {
+            SUBSYSTEM_TIMER(WORLD_UPDATE);
+            world->updateWorld(n);
+        }
+        world->updateTime(1);
+        m_ticks++;
+    }
+    SubsystemTimer::setEnabled(false);
+
+    double update_time =
+        SubsystemTimer::getTime(SubsystemTimer::ST_WORLD_UPDATE);
+    double ticks_per_second = update_time > 0 ? m_ticks / update_time : 0;
+    Log::info("HistorySimulation", "%d ticks, %f ticks per second, %d states "
+              "compared, %d rewinders diverged.", m_ticks, ticks_per_second,
+              m_states_compared, (int)m_divergences.size());
+    for (auto &p : m_divergences)
+    {
+        const Divergence &d = p.second;
+        Log::warn("HistorySimulation", "%s diverged at %d (byte %d, size %d "
+                  "recorded, %d simulated), significantly at %d.",
+                  p.first.c_str(), d.m_ticks, d.m_offset, d.m_recorded_size,
+                  d.m_simulated_size, d.m_significant_ticks);
+    }
+    if (!m_state_restored)
+        Log::error("HistorySimulation", "No state found in the log.");
+    writeReport(ticks_per_second);
+
+    race_manager->exitRace();
+    return m_state_restored && m_divergences.empty();
+}   // run
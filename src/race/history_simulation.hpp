@@ -0,0 +1,113 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_HISTORY_SIMULATION_HPP
+#define HEADER_HISTORY_SIMULATION_HPP
+
+#include "network/event_rewinder.hpp"
+#include "race/history_log.hpp"
+#include "utils/cpp2011.hpp"
+#include "utils/no_copy.hpp"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class BareNetworkString;
+
+/** \brief Simulates a race recorded by a server (see HistoryLog) again.
+ *  The race is set up like on the server, but without a host or any
+ *  clients. All recorded player actions are executed at the time the
+ *  server executed them, and the world is updated as fast as possible
+ *  (i.e. without MainLoop, which would limit the frame rate). The first
+ *  recorded state is restored (the log does not tell how many ticks were
+ *  spent before the race started), all following states are compared with
+ *  the simulated state of the same time. For each rewinder the first
+ *  difference is reported, which allows to find out which object of the
+ *  simulation is not deterministic. Since the timings of the world update
+ *  are measured as well, this can also be used as a benchmark for the
+ *  simulation of a network race.
+ *  Only linear races (normal race, time trial and follow the leader) are
+ *  supported, the arena modes need a host to send their events.
+ * \ingroup race
+ */
+class HistorySimulation : public EventRewinder, public NoCopy
+{
+private:
+    /** The first difference of the states of a rewinder. */
+    struct Divergence
+    {
+        /** World time of the first different state. */
+        int m_ticks;
+        /** First different byte, or -1 if the rewinder exists only in the
+         *  recorded or only in the simulated state. */
+        int m_offset;
+        int m_recorded_size;
+        int m_simulated_size;
+        /** World time of the first state which differs enough to cause a
+         *  rewind on a client (see Rewinder::hasDiverged), or -1. */
+        int m_significant_ticks;
+    };   // Divergence
+
+    HistoryLog m_log;
+
+    /** The records of the current chunk of the log. */
+    std::vector<HistoryLog::Record> m_records;
+
+    /** Index of the next record in m_records to use. */
+    unsigned int m_next_record;
+
+    /** Index of the next chunk to read from the log. */
+    unsigned int m_next_chunk;
+
+    /** True once the first recorded state was restored. */
+    bool m_state_restored;
+
+    /** Number of recorded states compared with the simulation. */
+    unsigned int m_states_compared;
+
+    /** Number of ticks simulated after the start of the race. */
+    unsigned int m_ticks;
+
+    /** The first divergence of each rewinder, indexed by its identity. */
+    std::map<std::string, Divergence> m_divergences;
+
+    /** Simulated states of all rewinders, reused for each comparison. */
+    std::map<std::string, std::vector<uint8_t> > m_simulated_states;
+
+    bool setupRace();
+    HistoryLog::Record* peekRecord();
+    void restoreState(BareNetworkString *state);
+    void compareState(int ticks, BareNetworkString *state);
+    void addDivergence(const std::string &name, int ticks, int offset,
+                       int recorded_size, int simulated_size);
+    void writeReport(double ticks_per_second) const;
+
+public:
+         HistorySimulation();
+    bool run(const std::string &filename);
+    // ------------------------------------------------------------------------
+    /** Executes a recorded player action. */
+    virtual void rewind(BareNetworkString *buffer) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** Actions are never undone, since there is no rewind. */
+    virtual void undo(BareNetworkString *buffer) OVERRIDE {}
+};   // HistorySimulation
+
+#endif
@@ -33,7 +33,7 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
 {
     FILE *fd = fopen(full_path ? getReplayFilename(replay_file_number).c_str() :
         (file_manager->getReplayDir() + getReplayFilename(replay_file_number)).c_str(),
-        writeable ? "w" : "r");
+        writeable ? "wb" : "rb");
     if (!fd)
     {
         return NULL;
@@ -41,3 +41,106 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Parses one event line of a text replay file.
+ *  \param s The line to parse.
+ *  \param version Version of the replay file.
+ *  \return False if the line could not be parsed.
+ */
+bool ReplayBase::readTextEvent(const char *s, unsigned int version,
+                               TransformEvent *t, PhysicInfo *pi,
+                               BonusInfo *bi, KartReplayEvent *kre)
+{
+    float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4,
+          nitro_amount = 0.0f, distance = 0.0f;
+    int skidding_state = 0, attachment = 0, item_amount = 0, item_type = 0,
+        special_value = 0, nitro, zipper, skidding, red_skidding, jumping;
+
+    // Up to STK 0.9.3 replays
+    if (version == 3)
+    {
+        if (sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
+            &time,
+            &x, &y, &z,
+            &rx, &ry, &rz, &rw,
+            &speed, &steer, &w1, &w2, &w3, &w4,
+            &nitro, &zipper, &skidding, &red_skidding, &jumping
+            ) != 19)
+            return false;
+    }
+    //version 4 replays (STK 0.9.4 and higher)
+    else
+    {
+        if (sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
+            &time,
+            &x, &y, &z,
+            &rx, &ry, &rz, &rw,
+            &speed, &steer, &w1, &w2, &w3, &w4, &skidding_state,
+            &attachment, &nitro_amount, &item_amount, &item_type, &special_value,
+            &distance, &nitro, &zipper, &skidding, &red_skidding, &jumping
+            ) != 26)
+            return false;
+    }
+
+    t->m_time                  = time;
+    t->m_transform             = btTransform(btQuaternion(rx, ry, rz, rw),
+                                             btVector3(x, y, z));
+    pi->m_speed                = speed;
+    pi->m_steer                = steer;
+    pi->m_suspension_length[0] = w1;
+    pi->m_suspension_length[1] = w2;
+    pi->m_suspension_length[2] = w3;
+    pi->m_suspension_length[3] = w4;
+    // Skidding state, bonus info and distance are not saved in version 3
+    pi->m_skidding_state       = skidding_state;
+    bi->m_attachment           = attachment;
+    bi->m_nitro_amount         = nitro_amount;
+    bi->m_item_amount          = item_amount;
+    bi->m_item_type            = item_type;
+    bi->m_special_value        = special_value;
+    kre->m_distance            = distance;
+    kre->m_nitro_usage         = nitro;
+    kre->m_zipper_usage        = zipper!=0;
+    kre->m_skidding_effect     = skidding;
+    kre->m_red_skidding        = red_skidding!=0;
+    kre->m_jumping             = jumping != 0;
+    return true;
+}   // readTextEvent
+
+// -----------------------------------------------------------------------------
+/** Writes one event as a line of a text replay file (version 4).
+ */
+void ReplayBase::writeTextEvent(FILE *fd, const TransformEvent &t,
+                                const PhysicInfo &pi, const BonusInfo &bi,
+                                const KartReplayEvent &kre)
+{
+    fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
+            t.m_time,
+            t.m_transform.getOrigin().getX(),
+            t.m_transform.getOrigin().getY(),
+            t.m_transform.getOrigin().getZ(),
+            t.m_transform.getRotation().getX(),
+            t.m_transform.getRotation().getY(),
+            t.m_transform.getRotation().getZ(),
+            t.m_transform.getRotation().getW(),
+            pi.m_speed,
+            pi.m_steer,
+            pi.m_suspension_length[0],
+            pi.m_suspension_length[1],
+            pi.m_suspension_length[2],
+            pi.m_suspension_length[3],
+            pi.m_skidding_state,
+            bi.m_attachment,
+            bi.m_nitro_amount,
+            bi.m_item_amount,
+            bi.m_item_type,
+            bi.m_special_value,
+            kre.m_distance,
+            kre.m_nitro_usage,
+            (int)kre.m_zipper_usage,
+            kre.m_skidding_effect,
+            (int)kre.m_red_skidding,
+            (int)kre.m_jumping
+        );
+}   // writeTextEvent
@@ -33,6 +33,10 @@ class ReplayBase : public NoCopy
 {
     // Needs access to KartReplayEvent
     friend class GhostKart;
+    // Encodes and decodes all event types
+    friend class ReplayBinary;
+    // Keeps the events of a ghost kart
+    friend class ReplayStream;
 
 protected:
     /** Stores a transform event, i.e. a position and rotation of a kart
@@ -100,12 +104,26 @@ protected:
     // ------------------------------------------------------------------------
     FILE *openReplayFile(bool writeable, bool full_path = false, int replay_file_number=1);
     // ------------------------------------------------------------------------
+    static bool readTextEvent(const char *s, unsigned int version,
+                              TransformEvent *t, PhysicInfo *pi,
+                              BonusInfo *bi, KartReplayEvent *kre);
+    // ------------------------------------------------------------------------
+    static void writeTextEvent(FILE *fd, const TransformEvent &t,
+                               const PhysicInfo &pi, const BonusInfo &bi,
+                               const KartReplayEvent &kre);
+    // ------------------------------------------------------------------------
     /** Returns the filename that was opened. */
     virtual const std::string& getReplayFilename(int replay_file_number = 1) const = 0;
     // ------------------------------------------------------------------------
     /** Returns the version number of the replay file recorderd by this executable.
-     *  This is also used as a maximum supported version by this exexcutable. */
-    unsigned int getCurrentReplayVersion() const { return 4; }
+     *  This is also used as a maximum supported version by this exexcutable.
+     *  Starting with version 5 replays are binary files (see ReplayBinary). */
+    unsigned int getCurrentReplayVersion() const { return 5; }
+
+    // ------------------------------------------------------------------------
+    /** Returns the highest version of text replay files, which is written
+     *  when converting a binary replay to text. */
+    unsigned int getCurrentTextReplayVersion() const { return 4; }
 
     // ------------------------------------------------------------------------
     /** This is used to check that a loaded replay file can still
@@ -0,0 +1,584 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/replay_binary.hpp"
+
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+#include "utils/mini_glm.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <stdexcept>
+#include <string.h>
+
+const unsigned int ReplayBinary::EVENTS_PER_CHUNK = 256;
+const unsigned int ReplayBinary::VERSION          = 5;
+
+namespace
+{
+    /** Magic value at the start of each binary replay file. A text replay
+     *  always starts with "version:". */
+    const char MAGIC[4] = { 'S', 'T', 'K', 'R' };
+
+    /** Size of magic value, version and header size. */
+    const unsigned int PREAMBLE_SIZE = 9;
+
+    /** Upper limit for the header size, to reject corrupt files early. */
+    const uint32_t MAX_HEADER_SIZE = 16 * 1024 * 1024;
+
+    /** Quantization factors for time (milliseconds), position (millimeters)
+     *  and distance along the track (centimeters). */
+    const float TIME_SCALE     = 1000.0f;
+    const float POSITION_SCALE = 1000.0f;
+    const float DISTANCE_SCALE = 100.0f;
+
+    // ------------------------------------------------------------------------
+    int32_t quantize(float f, float scale)
+    {
+        return (int32_t)lroundf(f * scale);
+    }   // quantize
+
+    // ------------------------------------------------------------------------
+    /** Adds the difference between value and previous, mapped to an
+     *  unsigned value so that small negative differences use few bytes. */
+    void addDelta(BareNetworkString *s, int32_t value, int32_t previous)
+    {
+        int32_t d = (int32_t)((uint32_t)value - (uint32_t)previous);
+        s->addVarUInt32(((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+    }   // addDelta
+
+    // ------------------------------------------------------------------------
+    int32_t getDelta(const BareNetworkString &s, int32_t previous)
+    {
+        uint32_t z = s.getVarUInt32();
+        int32_t d = (int32_t)((z >> 1) ^ (~(z & 1) + 1));
+        return (int32_t)((uint32_t)previous + (uint32_t)d);
+    }   // getDelta
+
+    // ------------------------------------------------------------------------
+    /** Number of quantized values of an event which are stored as
+     *  differences to the previous event. */
+    const unsigned int NUM_DELTA_VALUES = 12;
+
+    /** The quantized values of one event that are stored as differences to
+     *  the previous event. */
+    struct DeltaState
+    {
+        int32_t m_values[NUM_DELTA_VALUES];
+        DeltaState() { memset(m_values, 0, sizeof(m_values)); }
+    };   // DeltaState
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+ReplayBinary::ReplayBinary()
+{
+    m_data_start = 0;
+    m_data_size  = 0;
+    m_header.m_reverse    = false;
+    m_header.m_difficulty = 0;
+    m_header.m_laps       = 0;
+    m_header.m_min_time   = 0.0f;
+    m_header.m_replay_uid = 0;
+}   // ReplayBinary
+
+// ----------------------------------------------------------------------------
+/** Returns true if the given file is a binary replay file. The file position
+ *  is reset to the start of the file.
+ *  \param fd The replay file.
+ */
+bool ReplayBinary::isBinaryReplay(FILE *fd)
+{
+    char magic[sizeof(MAGIC)];
+    fseek(fd, 0, SEEK_SET);
+    bool is_binary = fread(magic, 1, sizeof(MAGIC), fd) == sizeof(MAGIC) &&
+                     memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    fseek(fd, 0, SEEK_SET);
+    return is_binary;
+}   // isBinaryReplay
+
+// ----------------------------------------------------------------------------
+void ReplayBinary::encodeHeader(BareNetworkString *s) const
+{
+    s->encodeString(m_header.m_stk_version)
+      .addUInt8(m_header.m_reverse ? 1 : 0)
+      .addUInt8(m_header.m_difficulty)
+      .encodeString(m_header.m_minor_mode)
+      .encodeString(m_header.m_track_name)
+      .addUInt32(m_header.m_laps)
+      .addFloat(m_header.m_min_time)
+      .addUInt64(m_header.m_replay_uid)
+      .addUInt8((uint8_t)m_header.m_karts.size());
+    for (const KartInfo &kart : m_header.m_karts)
+    {
+        s->encodeString(kart.m_ident).encodeString(kart.m_name)
+          .addFloat(kart.m_color).addUInt32(kart.m_num_events)
+          .addUInt32((uint32_t)kart.m_chunks.size());
+        for (const ChunkInfo &chunk : kart.m_chunks)
+        {
+            s->addFloat(chunk.m_start_time).addUInt32(chunk.m_first_event)
+              .addUInt32(chunk.m_num_events).addUInt32(chunk.m_offset)
+              .addUInt32(chunk.m_compressed_size).addUInt32(chunk.m_raw_size);
+        }
+    }
+}   // encodeHeader
+
+// ----------------------------------------------------------------------------
+bool ReplayBinary::decodeHeader(const BareNetworkString &s)
+{
+    try
+    {
+        s.decodeString(&m_header.m_stk_version);
+        m_header.m_reverse    = s.getUInt8() != 0;
+        m_header.m_difficulty = s.getUInt8();
+        s.decodeString(&m_header.m_minor_mode);
+        s.decodeString(&m_header.m_track_name);
+        m_header.m_laps       = s.getUInt32();
+        m_header.m_min_time   = s.getFloat();
+        m_header.m_replay_uid = s.getUInt64();
+        m_header.m_karts.resize(s.getUInt8());
+        for (KartInfo &kart : m_header.m_karts)
+        {
+            s.decodeString(&kart.m_ident);
+            s.decodeStringW(&kart.m_name);
+            kart.m_color      = s.getFloat();
+            kart.m_num_events = s.getUInt32();
+            uint32_t num_chunks = s.getUInt32();
+            if (num_chunks > s.size())
+                return false;
+            kart.m_chunks.resize(num_chunks);
+            for (ChunkInfo &chunk : kart.m_chunks)
+            {
+                chunk.m_start_time      = s.getFloat();
+                chunk.m_first_event     = s.getUInt32();
+                chunk.m_num_events      = s.getUInt32();
+                chunk.m_offset          = s.getUInt32();
+                chunk.m_compressed_size = s.getUInt32();
+                chunk.m_raw_size        = s.getUInt32();
+            }
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+    return true;
+}   // decodeHeader
+
+// ----------------------------------------------------------------------------
+/** Reads the header of a binary replay file, including the chunk index.
+ *  \param fd The replay file.
+ *  \return False if the file is not a valid binary replay.
+ */
+bool ReplayBinary::readHeader(FILE *fd)
+{
+    uint8_t preamble[PREAMBLE_SIZE];
+    fseek(fd, 0, SEEK_SET);
+    if (fread(preamble, 1, PREAMBLE_SIZE, fd) != PREAMBLE_SIZE ||
+        memcmp(preamble, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+
+    BareNetworkString p((const char*)preamble + sizeof(MAGIC),
+                        PREAMBLE_SIZE - sizeof(MAGIC));
+    unsigned int version = p.getUInt8();
+    if (version != VERSION)
+    {
+        Log::warn("ReplayBinary", "Unsupported binary replay version %d.",
+                  version);
+        return false;
+    }
+    uint32_t header_size = p.getUInt32();
+    if (header_size > MAX_HEADER_SIZE)
+        return false;
+
+    std::vector<char> data(header_size);
+    if (header_size > 0 &&
+        fread(data.data(), 1, header_size, fd) != header_size)
+        return false;
+    m_data_start = PREAMBLE_SIZE + header_size;
+    return decodeHeader(BareNetworkString(data.data(), (int)header_size));
+}   // readHeader
+
+// ----------------------------------------------------------------------------
+/** Decodes one chunk of events of a kart and appends them to the given
+ *  vectors. Only this chunk is read from the file.
+ *  \param fd The replay file.
+ *  \param kart Index of the kart.
+ *  \param chunk Index of the chunk.
+ */
+bool ReplayBinary::readChunk(FILE *fd, unsigned int kart, unsigned int chunk,
+                     std::vector<ReplayBase::TransformEvent> *transforms,
+                     std::vector<ReplayBase::PhysicInfo> *physic_info,
+                     std::vector<ReplayBase::BonusInfo> *bonus_info,
+                     std::vector<ReplayBase::KartReplayEvent> *events) const
+{
+    const ChunkInfo &ci = m_header.m_karts.at(kart).m_chunks.at(chunk);
+    // An encoded event never needs more than 128 bytes, so larger sizes
+    // can only come from a corrupt file.
+    if (ci.m_num_events > EVENTS_PER_CHUNK ||
+        ci.m_raw_size > EVENTS_PER_CHUNK * 128 ||
+        ci.m_compressed_size > compressBound(ci.m_raw_size))
+        return false;
+    std::vector<uint8_t> compressed(ci.m_compressed_size);
+    std::vector<char> raw(ci.m_raw_size);
+    if (fseek(fd, m_data_start + (long)ci.m_offset, SEEK_SET) != 0 ||
+        fread(compressed.data(), 1, compressed.size(), fd) !=
+                                                        compressed.size())
+        return false;
+
+    uLongf raw_size = ci.m_raw_size;
+    if (uncompress((Bytef*)raw.data(), &raw_size, compressed.data(),
+                   ci.m_compressed_size) != Z_OK ||
+        raw_size != ci.m_raw_size)
+        return false;
+
+    BareNetworkString s(raw.data(), (int)raw.size());
+    DeltaState prev;
+    try
+    {
+        for (unsigned int i = 0; i < ci.m_num_events; i++)
+        {
+            DeltaState cur;
+            for (unsigned int j = 0; j < NUM_DELTA_VALUES; j++)
+                cur.m_values[j] = getDelta(s, prev.m_values[j]);
+            prev = cur;
+
+            ReplayBase::TransformEvent t;
+            ReplayBase::PhysicInfo     pi;
+            ReplayBase::BonusInfo      bi;
+            ReplayBase::KartReplayEvent kre;
+            t.m_time = cur.m_values[0] / TIME_SCALE;
+            t.m_transform.setOrigin(btVector3(
+                cur.m_values[1] / POSITION_SCALE,
+                cur.m_values[2] / POSITION_SCALE,
+                cur.m_values[3] / POSITION_SCALE));
+            t.m_transform.setRotation(
+                MiniGLM::decompressbtQuaternion(s.getUInt32()));
+            kre.m_distance        = cur.m_values[4] / DISTANCE_SCALE;
+            pi.m_skidding_state   = cur.m_values[5];
+            bi.m_attachment       = cur.m_values[6];
+            bi.m_item_amount      = cur.m_values[7];
+            bi.m_item_type        = cur.m_values[8];
+            bi.m_special_value    = cur.m_values[9];
+            kre.m_nitro_usage     = cur.m_values[10];
+            kre.m_skidding_effect = cur.m_values[11];
+
+            pi.m_speed = MiniGLM::toFloat32(s.getUInt16());
+            pi.m_steer = MiniGLM::toFloat32(s.getUInt16());
+            for (unsigned int j = 0; j < 4; j++)
+            {
+                pi.m_suspension_length[j] =
+                    MiniGLM::toFloat32(s.getUInt16());
+            }
+            bi.m_nitro_amount = MiniGLM::toFloat32(s.getUInt16());
+
+            uint8_t flags = s.getUInt8();
+            kre.m_zipper_usage = (flags & 1) != 0;
+            kre.m_red_skidding = (flags & 2) != 0;
+            kre.m_jumping      = (flags & 4) != 0;
+
+            transforms->push_back(t);
+            physic_info->push_back(pi);
+            bonus_info->push_back(bi);
+            events->push_back(kre);
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+    return true;
+}   // readChunk
+
+// ----------------------------------------------------------------------------
+/** Decodes all events of a kart and appends them to the given vectors.
+ */
+bool ReplayBinary::readKart(FILE *fd, unsigned int kart,
+                     std::vector<ReplayBase::TransformEvent> *transforms,
+                     std::vector<ReplayBase::PhysicInfo> *physic_info,
+                     std::vector<ReplayBase::BonusInfo> *bonus_info,
+                     std::vector<ReplayBase::KartReplayEvent> *events) const
+{
+    const KartInfo &ki = m_header.m_karts.at(kart);
+    // The number of events is only used to reserve memory, so it must
+    // match the chunks (a corrupt file could cause a huge allocation).
+    uint64_t num_events = 0;
+    for (const ChunkInfo &ci : ki.m_chunks)
+    {
+        if (ci.m_num_events > EVENTS_PER_CHUNK)
+            return false;
+        num_events += ci.m_num_events;
+    }
+    if (num_events != ki.m_num_events)
+        return false;
+    transforms->reserve(transforms->size() + ki.m_num_events);
+    physic_info->reserve(physic_info->size() + ki.m_num_events);
+    bonus_info->reserve(bonus_info->size() + ki.m_num_events);
+    events->reserve(events->size() + ki.m_num_events);
+    for (unsigned int i = 0; i < ki.m_chunks.size(); i++)
+    {
+        if (!readChunk(fd, kart, i, transforms, physic_info, bonus_info,
+                       events))
+            return false;
+    }
+    return true;
+}   // readKart
+
+// ----------------------------------------------------------------------------
+/** Sets the race information and the list of karts for writing a replay.
+ *  Any existing event data is discarded.
+ */
+void ReplayBinary::setHeader(const Header &header)
+{
+    m_header = header;
+    for (KartInfo &kart : m_header.m_karts)
+    {
+        kart.m_num_events = 0;
+        kart.m_chunks.clear();
+    }
+    m_compressed_chunks.clear();
+    m_data_size = 0;
+}   // setHeader
+
+// ----------------------------------------------------------------------------
+/** Encodes and compresses the events of a kart. This must be called at most
+ *  once for each kart, after setHeader.
+ *  \param kart Index of the kart in the header.
+ *  \param num_events Number of entries in each of the arrays.
+ */
+void ReplayBinary::addKartEvents(unsigned int kart, unsigned int num_events,
+                                 const ReplayBase::TransformEvent *transforms,
+                                 const ReplayBase::PhysicInfo *physic_info,
+                                 const ReplayBase::BonusInfo *bonus_info,
+                                 const ReplayBase::KartReplayEvent *events)
+{
+    KartInfo &ki = m_header.m_karts.at(kart);
+    assert(ki.m_chunks.empty());
+    ki.m_num_events = num_events;
+
+    for (unsigned int first = 0; first < num_events;
+         first += EVENTS_PER_CHUNK)
+    {
+        unsigned int last = std::min(first + EVENTS_PER_CHUNK, num_events);
+        BareNetworkString s((last - first) * 32);
+        DeltaState prev;
+        for (unsigned int i = first; i < last; i++)
+        {
+            const ReplayBase::TransformEvent  &t   = transforms[i];
+            const ReplayBase::PhysicInfo      &pi  = physic_info[i];
+            const ReplayBase::BonusInfo       &bi  = bonus_info[i];
+            const ReplayBase::KartReplayEvent &kre = events[i];
+            DeltaState cur;
+            cur.m_values[0]  = quantize(t.m_time, TIME_SCALE);
+            cur.m_values[1]  = quantize(t.m_transform.getOrigin().getX(),
+                                        POSITION_SCALE);
+            cur.m_values[2]  = quantize(t.m_transform.getOrigin().getY(),
+                                        POSITION_SCALE);
+            cur.m_values[3]  = quantize(t.m_transform.getOrigin().getZ(),
+                                        POSITION_SCALE);
+            cur.m_values[4]  = quantize(kre.m_distance, DISTANCE_SCALE);
+            cur.m_values[5]  = pi.m_skidding_state;
+            cur.m_values[6]  = bi.m_attachment;
+            cur.m_values[7]  = bi.m_item_amount;
+            cur.m_values[8]  = bi.m_item_type;
+            cur.m_values[9]  = bi.m_special_value;
+            cur.m_values[10] = kre.m_nitro_usage;
+            cur.m_values[11] = kre.m_skidding_effect;
+            for (unsigned int j = 0; j < NUM_DELTA_VALUES; j++)
+                addDelta(&s, cur.m_values[j], prev.m_values[j]);
+            prev = cur;
+
+            s.addUInt32(MiniGLM::compressQuaternion(
+                                            t.m_transform.getRotation()));
+            s.addUInt16(MiniGLM::toFloat16(pi.m_speed));
+            s.addUInt16(MiniGLM::toFloat16(pi.m_steer));
+            for (unsigned int j = 0; j < 4; j++)
+                s.addUInt16(MiniGLM::toFloat16(pi.m_suspension_length[j]));
+            s.addUInt16(MiniGLM::toFloat16(bi.m_nitro_amount));
+            s.addUInt8((kre.m_zipper_usage ? 1 : 0) |
+                       (kre.m_red_skidding ? 2 : 0) |
+                       (kre.m_jumping      ? 4 : 0));
+        }
+
+        uLongf compressed_size = compressBound(s.getTotalSize());
+        std::vector<uint8_t> compressed(compressed_size);
+        int ret = compress2(compressed.data(), &compressed_size,
+                            (const Bytef*)s.getData(), s.getTotalSize(),
+                            Z_BEST_COMPRESSION);
+        if (ret != Z_OK)
+            Log::fatal("ReplayBinary", "Compressing replay failed: %d.", ret);
+        compressed.resize(compressed_size);
+
+        ChunkInfo ci;
+        ci.m_start_time      = transforms[first].m_time;
+        ci.m_first_event     = first;
+        ci.m_num_events      = last - first;
+        ci.m_offset          = m_data_size;
+        ci.m_compressed_size = (uint32_t)compressed_size;
+        ci.m_raw_size        = s.getTotalSize();
+        ki.m_chunks.push_back(ci);
+        m_data_size += (uint32_t)compressed_size;
+        m_compressed_chunks.push_back(std::move(compressed));
+    }
+}   // addKartEvents
+
+// ----------------------------------------------------------------------------
+/** Writes the header and all chunks added with addKartEvents to a file.
+ *  \param fd The file to write to, opened in binary mode.
+ *  \return False if writing failed.
+ */
+bool ReplayBinary::write(FILE *fd) const
+{
+    BareNetworkString header(1024);
+    encodeHeader(&header);
+
+    BareNetworkString preamble(PREAMBLE_SIZE);
+    for (unsigned int i = 0; i < sizeof(MAGIC); i++)
+        preamble.addChar(MAGIC[i]);
+    preamble.addUInt8(VERSION).addUInt32(header.getTotalSize());
+
+    bool ok = fwrite(preamble.getData(), 1, preamble.getTotalSize(), fd) ==
+                                                  preamble.getTotalSize() &&
+              fwrite(header.getData(), 1, header.getTotalSize(), fd) ==
+                                                  header.getTotalSize();
+    // The chunks are stored in the order in which they were added, which
+    // matches the offsets in the index.
+    for (unsigned int i = 0; ok && i < m_compressed_chunks.size(); i++)
+    {
+        const std::vector<uint8_t> &c = m_compressed_chunks[i];
+        ok = fwrite(c.data(), 1, c.size(), fd) == c.size();
+    }
+    return ok;
+}   // write
+
+// ----------------------------------------------------------------------------
+void ReplayBinary::unitTesting()
+{
+    ReplayBinary::Header header;
+    header.m_stk_version = "git";
+    header.m_reverse     = true;
+    header.m_difficulty  = 2;
+    header.m_minor_mode  = "time-trial";
+    header.m_track_name  = "lighthouse";
+    header.m_laps        = 3;
+    header.m_min_time    = 75.5f;
+    header.m_replay_uid  = 1234567890123ULL;
+    header.m_karts.resize(2);
+    header.m_karts[0].m_ident = "tux";
+    header.m_karts[0].m_name  = L"Player";
+    header.m_karts[0].m_color = 0.5f;
+    header.m_karts[1].m_ident = "nolok";
+    header.m_karts[1].m_name  = L"";
+    header.m_karts[1].m_color = 0.0f;
+
+    // More events than fit into one chunk
+    const unsigned int num_events = EVENTS_PER_CHUNK * 2 + 10;
+    std::vector<ReplayBase::TransformEvent>  t(num_events);
+    std::vector<ReplayBase::PhysicInfo>      pi(num_events);
+    std::vector<ReplayBase::BonusInfo>       bi(num_events);
+    std::vector<ReplayBase::KartReplayEvent> kre(num_events);
+    for (unsigned int i = 0; i < num_events; i++)
+    {
+        t[i].m_time = i / 60.0f;
+        t[i].m_transform.setOrigin(btVector3(i * 0.3f, -2.5f, 100.0f - i));
+        t[i].m_transform.setRotation(btQuaternion(btVector3(0, 1, 0),
+                                                  i * 0.01f));
+        pi[i].m_speed   = 20.0f + (i % 7);
+        pi[i].m_steer   = -0.5f;
+        for (unsigned int j = 0; j < 4; j++)
+            pi[i].m_suspension_length[j] = 0.25f;
+        pi[i].m_skidding_state  = i % 3;
+        bi[i].m_attachment      = 0;
+        bi[i].m_nitro_amount    = 1.5f;
+        bi[i].m_item_amount     = i % 4;
+        bi[i].m_item_type       = 2;
+        bi[i].m_special_value   = -1;
+        kre[i].m_distance       = i * 0.5f;
+        kre[i].m_nitro_usage    = 0;
+        kre[i].m_zipper_usage   = i % 5 == 0;
+        kre[i].m_skidding_effect= 1;
+        kre[i].m_red_skidding   = false;
+        kre[i].m_jumping        = i % 2 == 1;
+    }
+
+    ReplayBinary writer;
+    writer.setHeader(header);
+    writer.addKartEvents(0, num_events, t.data(), pi.data(), bi.data(),
+                         kre.data());
+    writer.addKartEvents(1, 0, NULL, NULL, NULL, NULL);
+
+    FILE *fd = tmpfile();
+    assert(fd);
+    bool ok = writer.write(fd);
+    assert(ok);
+    ok = isBinaryReplay(fd);
+    assert(ok);
+
+    ReplayBinary reader;
+    ok = reader.readHeader(fd);
+    assert(ok);
+    const Header &h = reader.getHeader();
+    assert(h.m_track_name == "lighthouse" && h.m_minor_mode == "time-trial");
+    assert(h.m_reverse && h.m_difficulty == 2 && h.m_laps == 3);
+    assert(h.m_replay_uid == 1234567890123ULL && h.m_min_time == 75.5f);
+    assert(h.m_karts.size() == 2 && h.m_karts[0].m_name == L"Player");
+    assert(h.m_karts[0].m_chunks.size() == 3);
+    assert(h.m_karts[0].m_num_events == num_events);
+    assert(h.m_karts[1].m_chunks.empty());
+    (void)h;
+
+    // Decode only the last chunk
+    std::vector<ReplayBase::TransformEvent>  t2;
+    std::vector<ReplayBase::PhysicInfo>      pi2;
+    std::vector<ReplayBase::BonusInfo>       bi2;
+    std::vector<ReplayBase::KartReplayEvent> kre2;
+    ok = reader.readChunk(fd, 0, 2, &t2, &pi2, &bi2, &kre2);
+    assert(ok);
+    assert(t2.size() == 10);
+    t2.clear(); pi2.clear(); bi2.clear(); kre2.clear();
+
+    ok = reader.readKart(fd, 0, &t2, &pi2, &bi2, &kre2);
+    assert(ok);
+    assert(t2.size() == num_events);
+    for (unsigned int i = 0; i < num_events; i++)
+    {
+        assert(fabsf(t2[i].m_time - t[i].m_time) <= 0.0005f);
+        assert((t2[i].m_transform.getOrigin() -
+                t[i].m_transform.getOrigin()).length() < 0.001f);
+        assert(fabsf(t2[i].m_transform.getRotation()
+                     .dot(t[i].m_transform.getRotation())) > 0.9999f);
+        assert(fabsf(pi2[i].m_speed - pi[i].m_speed) < 0.02f);
+        assert(pi2[i].m_skidding_state == pi[i].m_skidding_state);
+        assert(bi2[i].m_item_amount == bi[i].m_item_amount);
+        assert(bi2[i].m_special_value == -1);
+        assert(fabsf(kre2[i].m_distance - kre[i].m_distance) <= 0.005f);
+        assert(kre2[i].m_zipper_usage == kre[i].m_zipper_usage);
+        assert(kre2[i].m_jumping == kre[i].m_jumping);
+    }
+
+    // A number of events that doesn't match the chunks is rejected
+    reader.m_header.m_karts[0].m_num_events = 0xffffffff;
+    ok = reader.readKart(fd, 0, &t2, &pi2, &bi2, &kre2);
+    assert(!ok);
+    (void)ok;
+    fclose(fd);
+}   // unitTesting
@@ -0,0 +1,157 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REPLAY_BINARY_HPP
+#define HEADER_REPLAY_BINARY_HPP
+
+#include "replay/replay_base.hpp"
+#include "utils/no_copy.hpp"
+
+#include "irrString.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class BareNetworkString;
+
+/** \brief Reads and writes the binary replay format (replay version 5).
+ *  A binary replay file starts with a 4 byte magic value, followed by the
+ *  replay version (1 byte) and the size of the header (4 bytes). The header
+ *  contains all race information that is displayed in the ghost replay
+ *  selection screen, and for each kart an index of the chunks of recorded
+ *  events. The header is not compressed, so it can be read without touching
+ *  the rest of the file.
+ *  The events of a kart are stored in chunks of at most EVENTS_PER_CHUNK
+ *  events. Each chunk is compressed with zlib independently, and its offset
+ *  is stored in the index, so a chunk can be decoded without reading any
+ *  other part of the file. Inside a chunk positions, time and distance are
+ *  quantized to integers and stored as the zigzag varint encoded difference
+ *  to the previous event, rotations use MiniGLM::compressQuaternion and the
+ *  other float values are stored as 16 bit floats.
+ *  All values are stored in network byte order (see BareNetworkString).
+ * \ingroup replay
+ */
+class ReplayBinary : public NoCopy
+{
+public:
+    /** Position of one chunk of events in a binary replay file. */
+    struct ChunkInfo
+    {
+        /** Time of the first event in this chunk. */
+        float    m_start_time;
+        /** Index of the first event of this chunk. */
+        uint32_t m_first_event;
+        /** Number of events in this chunk. */
+        uint32_t m_num_events;
+        /** Offset of the compressed data, relative to the end of the
+         *  header. */
+        uint32_t m_offset;
+        /** Size of the compressed data. */
+        uint32_t m_compressed_size;
+        /** Size of the uncompressed data. */
+        uint32_t m_raw_size;
+    };   // ChunkInfo
+
+    // ------------------------------------------------------------------------
+    /** Information about one recorded kart. */
+    struct KartInfo
+    {
+        std::string            m_ident;
+        irr::core::stringw     m_name;
+        float                  m_color;
+        /** Total number of events recorded for this kart. */
+        uint32_t               m_num_events;
+        std::vector<ChunkInfo> m_chunks;
+    };   // KartInfo
+
+    // ------------------------------------------------------------------------
+    /** The header of a binary replay. */
+    struct Header
+    {
+        std::string           m_stk_version;
+        std::vector<KartInfo> m_karts;
+        bool                  m_reverse;
+        unsigned int          m_difficulty;
+        std::string           m_minor_mode;
+        std::string           m_track_name;
+        unsigned int          m_laps;
+        float                 m_min_time;
+        uint64_t              m_replay_uid;
+    };   // Header
+
+private:
+    /** The header, including the chunk index. */
+    Header m_header;
+
+    /** File offset of the first byte after the header (reading only). */
+    long m_data_start;
+
+    /** The compressed chunks of all karts in the order they are stored in
+     *  the file (writing only). */
+    std::vector<std::vector<uint8_t> > m_compressed_chunks;
+
+    /** Number of bytes of compressed data added so far (writing only). */
+    uint32_t m_data_size;
+
+    void encodeHeader(BareNetworkString *s) const;
+    bool decodeHeader(const BareNetworkString &s);
+
+public:
+    /** Number of events stored in one chunk. */
+    static const unsigned int EVENTS_PER_CHUNK;
+
+    /** Version number of the binary replay format. */
+    static const unsigned int VERSION;
+
+         ReplayBinary();
+    // ------------------------------------------------------------------------
+    static bool isBinaryReplay(FILE *fd);
+    // ------------------------------------------------------------------------
+    bool readHeader(FILE *fd);
+    // ------------------------------------------------------------------------
+    bool readChunk(FILE *fd, unsigned int kart, unsigned int chunk,
+                   std::vector<ReplayBase::TransformEvent> *transforms,
+                   std::vector<ReplayBase::PhysicInfo> *physic_info,
+                   std::vector<ReplayBase::BonusInfo> *bonus_info,
+                   std::vector<ReplayBase::KartReplayEvent> *events) const;
+    // ------------------------------------------------------------------------
+    bool readKart(FILE *fd, unsigned int kart,
+                  std::vector<ReplayBase::TransformEvent> *transforms,
+                  std::vector<ReplayBase::PhysicInfo> *physic_info,
+                  std::vector<ReplayBase::BonusInfo> *bonus_info,
+                  std::vector<ReplayBase::KartReplayEvent> *events) const;
+    // ------------------------------------------------------------------------
+    void setHeader(const Header &header);
+    // ------------------------------------------------------------------------
+    void addKartEvents(unsigned int kart, unsigned int num_events,
+                       const ReplayBase::TransformEvent *transforms,
+                       const ReplayBase::PhysicInfo *physic_info,
+                       const ReplayBase::BonusInfo *bonus_info,
+                       const ReplayBase::KartReplayEvent *events);
+    // ------------------------------------------------------------------------
+    bool write(FILE *fd) const;
+    // ------------------------------------------------------------------------
+    /** Returns the header of this replay. */
+    const Header& getHeader() const { return m_header; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // ReplayBinary
+
+#endif
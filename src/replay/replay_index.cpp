@@ -0,0 +1,266 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/replay_index.hpp"
+
+#include "io/file_manager.hpp"
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+const unsigned int ReplayIndex::VERSION = 1;
+
+namespace
+{
+    /** Magic value at the start of the index file. */
+    const char MAGIC[4] = { 'S', 'T', 'K', 'I' };
+
+    // ------------------------------------------------------------------------
+    /** Adds a string of up to 65535 bytes (paths can be longer than the 255
+     *  bytes supported by BareNetworkString::encodeString). */
+    void addLongString(BareNetworkString *s, const std::string &value)
+    {
+        uint16_t len = (uint16_t)std::min<size_t>(value.size(), 65535);
+        s->addUInt16(len);
+        for (unsigned int i = 0; i < len; i++)
+            s->addChar(value[i]);
+    }   // addLongString
+
+    // ------------------------------------------------------------------------
+    std::string getLongString(BareNetworkString &s)
+    {
+        uint16_t len = s.getUInt16();
+        if (len > s.size())
+            throw std::out_of_range("getLongString out of range.");
+        std::string result(s.getCurrentData(), len);
+        s.skip(len);
+        return result;
+    }   // getLongString
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+ReplayIndex::ReplayIndex(const std::string &filename)
+{
+    m_filename = filename;
+    m_modified = false;
+}   // ReplayIndex
+
+// ----------------------------------------------------------------------------
+/** Returns the modification time and size of a file.
+ *  \return False if the file does not exist.
+ */
+bool ReplayIndex::getFileInfo(const std::string &path, uint64_t *mtime,
+                              uint64_t *size)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) != 0)
+        return false;
+    *mtime = (uint64_t)buf.st_mtime;
+    *size  = (uint64_t)buf.st_size;
+    return true;
+}   // getFileInfo
+
+// ----------------------------------------------------------------------------
+/** Loads the index file. A missing, outdated or corrupt index is ignored,
+ *  which means that all replay files will be parsed again.
+ */
+void ReplayIndex::load()
+{
+    m_entries.clear();
+    m_modified = false;
+
+    FILE *fd = fopen(m_filename.c_str(), "rb");
+    if (!fd)
+        return;
+    std::vector<char> data;
+    char buffer[16384];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fd);
+
+    if (data.size() < sizeof(MAGIC) + 1 ||
+        memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+    {
+        Log::warn("ReplayIndex", "Ignoring invalid index '%s'.",
+                  m_filename.c_str());
+        return;
+    }
+
+    BareNetworkString s(data.data(), (int)data.size());
+    s.skip(sizeof(MAGIC));
+    if (s.getUInt8() != VERSION)
+        return;
+
+    try
+    {
+        uint32_t count = s.getUInt32();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string path = getLongString(s);
+            Entry &e = m_entries[path];
+            e.m_mtime = s.getUInt64();
+            e.m_size  = s.getUInt64();
+            ReplayPlay::ReplayData &rd = e.m_data;
+            rd.m_filename           = getLongString(s);
+            rd.m_custom_replay_file = s.getUInt8() != 0;
+            rd.m_replay_version     = s.getUInt8();
+            rd.m_track              = NULL;
+            if (rd.m_replay_version == 0)
+                continue;
+            s.decodeStringW(&rd.m_stk_version);
+            s.decodeStringW(&rd.m_user_name);
+            unsigned int num_karts = s.getUInt8();
+            for (unsigned int k = 0; k < num_karts; k++)
+            {
+                std::string ident;
+                core::stringw name;
+                s.decodeString(&ident);
+                s.decodeStringW(&name);
+                rd.m_kart_list.push_back(ident);
+                rd.m_name_list.push_back(name);
+                rd.m_kart_color.push_back(s.getFloat());
+            }
+            rd.m_reverse    = s.getUInt8() != 0;
+            rd.m_difficulty = s.getUInt8();
+            s.decodeString(&rd.m_minor_mode);
+            s.decodeString(&rd.m_track_name);
+            rd.m_laps       = s.getUInt32();
+            rd.m_min_time   = s.getFloat();
+            rd.m_replay_uid = s.getUInt64();
+        }
+    }
+    catch (std::out_of_range&)
+    {
+        Log::warn("ReplayIndex", "Ignoring corrupt index '%s'.",
+                  m_filename.c_str());
+        m_entries.clear();
+    }
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Writes the index file.
+ *  \return False if the file could not be written.
+ */
+bool ReplayIndex::save()
+{
+    BareNetworkString s(1024);
+    for (unsigned int i = 0; i < sizeof(MAGIC); i++)
+        s.addChar(MAGIC[i]);
+    s.addUInt8(VERSION).addUInt32((uint32_t)m_entries.size());
+    for (auto &p : m_entries)
+    {
+        const Entry &e = p.second;
+        const ReplayPlay::ReplayData &rd = e.m_data;
+        addLongString(&s, p.first);
+        s.addUInt64(e.m_mtime).addUInt64(e.m_size);
+        addLongString(&s, rd.m_filename);
+        s.addUInt8(rd.m_custom_replay_file ? 1 : 0)
+         .addUInt8(rd.m_replay_version);
+        if (rd.m_replay_version == 0)
+            continue;
+        s.encodeString(rd.m_stk_version).encodeString(rd.m_user_name)
+         .addUInt8((uint8_t)rd.m_kart_list.size());
+        for (unsigned int k = 0; k < rd.m_kart_list.size(); k++)
+        {
+            s.encodeString(rd.m_kart_list[k]).encodeString(rd.m_name_list[k])
+             .addFloat(rd.m_kart_color[k]);
+        }
+        s.addUInt8(rd.m_reverse ? 1 : 0).addUInt8(rd.m_difficulty)
+         .encodeString(rd.m_minor_mode).encodeString(rd.m_track_name)
+         .addUInt32(rd.m_laps).addFloat(rd.m_min_time)
+         .addUInt64(rd.m_replay_uid);
+    }
+
+    // Write to a temporary file first, so that an interrupted write does
+    // not leave a truncated index behind.
+    std::string tmp = FileManager::getTempName(m_filename);
+    FILE *fd = fopen(tmp.c_str(), "wb");
+    if (!fd)
+    {
+        Log::warn("ReplayIndex", "Can't write '%s'.", tmp.c_str());
+        return false;
+    }
+    bool ok = fwrite(s.getData(), 1, s.getTotalSize(), fd) ==
+                                                           s.getTotalSize();
+    ok = fclose(fd) == 0 && ok;
+    if (!ok || !FileManager::replaceFile(tmp, m_filename))
+    {
+        Log::warn("ReplayIndex", "Can't write '%s'.", m_filename.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+    m_modified = false;
+    return true;
+}   // save
+
+// ----------------------------------------------------------------------------
+/** Returns the cached header of a replay file, or NULL if the file is not
+ *  in the index or was modified since it was added.
+ *  \param path Full path of the replay file.
+ *  \param mtime Current modification time of the file.
+ *  \param size Current size of the file.
+ */
+const ReplayPlay::ReplayData* ReplayIndex::get(const std::string &path,
+                                               uint64_t mtime,
+                                               uint64_t size) const
+{
+    auto it = m_entries.find(path);
+    if (it == m_entries.end() || it->second.m_mtime != mtime ||
+        it->second.m_size != size)
+        return NULL;
+    return &it->second.m_data;
+}   // get
+
+// ----------------------------------------------------------------------------
+/** Adds or replaces the header of a replay file.
+ */
+void ReplayIndex::set(const std::string &path, uint64_t mtime, uint64_t size,
+                      const ReplayPlay::ReplayData &data)
+{
+    Entry &e = m_entries[path];
+    e.m_mtime = mtime;
+    e.m_size  = size;
+    e.m_data  = data;
+    e.m_data.m_track = NULL;
+    m_modified = true;
+}   // set
+
+// ----------------------------------------------------------------------------
+/** Removes all entries of replay files which are not in the given set,
+ *  i.e. of replay files that were deleted.
+ */
+void ReplayIndex::removeOtherEntries(const std::set<std::string> &paths)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (paths.find(it->first) == paths.end())
+        {
+            it = m_entries.erase(it);
+            m_modified = true;
+        }
+        else
+            it++;
+    }
+}   // removeOtherEntries
@@ -0,0 +1,80 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REPLAY_INDEX_HPP
+#define HEADER_REPLAY_INDEX_HPP
+
+#include "replay/replay_play.hpp"
+#include "utils/no_copy.hpp"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+/** \brief A persistent cache of the headers of all replay files.
+ *  Reading the header of every replay file each time the ghost replay
+ *  selection screen is opened is slow if there are many replays. This
+ *  index stores the parsed header of each replay file together with the
+ *  modification time and size of the file, so only new or changed files
+ *  need to be parsed again. Files which could not be parsed are stored
+ *  as well (with a replay version of 0), so they are not parsed again
+ *  either. The index is stored in the user's replay directory.
+ * \ingroup replay
+ */
+class ReplayIndex : public NoCopy
+{
+private:
+    struct Entry
+    {
+        uint64_t               m_mtime;
+        uint64_t               m_size;
+        ReplayPlay::ReplayData m_data;
+    };   // Entry
+
+    /** All entries, indexed by the full path of the replay file. */
+    std::map<std::string, Entry> m_entries;
+
+    /** Full path of the index file. */
+    std::string m_filename;
+
+    /** True if entries were added or removed since the index was loaded. */
+    bool m_modified;
+
+public:
+    /** Version of the index file format. Increase this if the format or
+     *  the way replay headers are parsed changes. */
+    static const unsigned int VERSION;
+
+         ReplayIndex(const std::string &filename);
+    void load();
+    bool save();
+    const ReplayPlay::ReplayData* get(const std::string &path,
+                                      uint64_t mtime, uint64_t size) const;
+    void set(const std::string &path, uint64_t mtime, uint64_t size,
+             const ReplayPlay::ReplayData &data);
+    void removeOtherEntries(const std::set<std::string> &paths);
+    // ------------------------------------------------------------------------
+    static bool getFileInfo(const std::string &path, uint64_t *mtime,
+                            uint64_t *size);
+    // ------------------------------------------------------------------------
+    /** Returns true if entries were added or removed. */
+    bool isModified() const { return m_modified; }
+};   // ReplayIndex
+
+#endif
@@ -24,6 +24,9 @@
 #include "karts/controller/ghost_controller.hpp"
 #include "modes/world.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_binary.hpp"
+#include "replay/replay_index.hpp"
+#include "replay/replay_stream.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 
@@ -31,6 +34,7 @@
 #include <stdio.h>
 #include <string>
 #include <cinttypes>
+#include <functional>
 
 ReplayPlay::SortOrder ReplayPlay::m_sort_order = ReplayPlay::SO_DEFAULT;
 ReplayPlay *ReplayPlay::m_replay_play = NULL;
@@ -43,12 +47,15 @@ ReplayPlay::ReplayPlay()
     m_current_replay_file   = 0;
     m_second_replay_file    = 0;
     m_second_replay_enabled = false;
+    m_scan_done.store(false);
 }   // ReplayPlay
 
 //-----------------------------------------------------------------------------
 /** Frees all stored data. */
 ReplayPlay::~ReplayPlay()
 {
+    if (m_scan_thread.joinable())
+        m_scan_thread.join();
 }   // ~Replay
 
 //-----------------------------------------------------------------------------
@@ -63,79 +70,251 @@ void ReplayPlay::reset()
 }   // reset
 
 //-----------------------------------------------------------------------------
+/** Loads the headers of all stock and user replay files, and waits until
+ *  this is done. Use startLoadingReplayFiles to load them in the background.
+ */
 void ReplayPlay::loadAllReplayFile()
 {
-    m_replay_file_list.clear();
+    startLoadingReplayFiles();
+    m_scan_thread.join();
+    finishLoadingReplayFiles();
+}   // loadAllReplayFile
 
-    // Load stock replay first
-    std::set<std::string> pre_record;
-    file_manager->listFiles(pre_record, file_manager
+//-----------------------------------------------------------------------------
+/** Starts a background thread which scans the stock and user replay
+ *  directories. Only headers of replay files that are not in the replay
+ *  index (or were changed) are parsed. Call finishLoadingReplayFiles to
+ *  check if the scan is done and to update the replay file list.
+ */
+void ReplayPlay::startLoadingReplayFiles()
+{
+    if (m_scan_thread.joinable())
+        return;
+    // The directories are listed with irrlicht's file system, which is not
+    // thread safe, so this is done here and the thread only reads files.
+    std::set<std::string> stock_files, user_files;
+    file_manager->listFiles(stock_files, file_manager
         ->getAssetDirectory(FileManager::REPLAY), /*is_full_path*/ true);
-    for (std::set<std::string>::iterator i  = pre_record.begin();
-                                         i != pre_record.end(); ++i)
+    file_manager->listFiles(user_files, file_manager->getReplayDir(),
+        /*is_full_path*/ false);
+    m_scan_done.store(false);
+    m_scan_thread = std::thread(std::bind(&ReplayPlay::scanReplayFiles,
+                                          this, stock_files, user_files,
+                                          file_manager->getReplayDir()));
+}   // startLoadingReplayFiles
+
+//-----------------------------------------------------------------------------
+/** Called from the main thread. If the background scan is done, replaces
+ *  the replay file list with the result of the scan.
+ *  \return True if the replay file list is up to date, false if the scan
+ *          is still running.
+ */
+bool ReplayPlay::finishLoadingReplayFiles()
+{
+    if (!m_scan_thread.joinable())
+        return true;
+    if (!m_scan_done.load())
+        return false;
+    m_scan_thread.join();
+
+    // The track manager must only be accessed from the main thread, so the
+    // tracks are looked up here and not in the scan thread.
+    m_replay_file_list.clear();
+    int j = 0;
+    for (ReplayData &rd : m_scanned_list)
     {
-        if (!addReplayFile(*i, /*custom_replay*/ true))
+        rd.m_track = track_manager->getTrack(rd.m_track_name);
+        if (rd.m_track == NULL)
         {
-            // Skip invalid replay file
+            Log::warn("Replay", "Track '%s' used in replay '%s' not found "
+                      "in STK!", rd.m_track_name.c_str(),
+                      rd.m_filename.c_str());
             continue;
         }
+        // No UID in old replay format, so use the index of the file
+        if (!rd.m_custom_replay_file)
+        {
+            if (rd.m_replay_version == 3)
+                rd.m_replay_uid = j;
+            j++;
+        }
+        m_replay_file_list.push_back(rd);
+        // Force to use custom replay file immediately
+        if (rd.m_custom_replay_file)
+            m_current_replay_file = (unsigned int)m_replay_file_list.size()-1;
     }
+    m_scanned_list.clear();
+    return true;
+}   // finishLoadingReplayFiles
+
+//-----------------------------------------------------------------------------
+/** Runs in a separate thread: reads the headers of all replay files, using
+ *  the replay index for unchanged files.
+ *  \param stock_files Full paths of the files in the stock replay directory.
+ *  \param user_files Names of the files in the user replay directory.
+ *  \param replay_dir The user replay directory.
+ */
+void ReplayPlay::scanReplayFiles(const std::set<std::string> &stock_files,
+                                 const std::set<std::string> &user_files,
+                                 const std::string &replay_dir)
+{
+    ReplayIndex index(replay_dir + "replay_index.dat");
+    index.load();
+
+    std::vector<ReplayData> result;
+    std::set<std::string> all_paths;
+
+    // Load stock replay first
+    for (const std::string &f : stock_files)
+        scanReplayFile(f, f, /*custom_replay*/true, &index, &result,
+                       &all_paths);
 
     // Now user recorded replay
-    std::set<std::string> files;
-    file_manager->listFiles(files, file_manager->getReplayDir(),
-        /*is_full_path*/ false);
+    for (const std::string &f : user_files)
+    {
+        scanReplayFile(f, replay_dir + f, /*custom_replay*/false, &index,
+                       &result, &all_paths);
+    }
+
+    index.removeOtherEntries(all_paths);
+    if (index.isModified())
+        index.save();
 
-    int j=0;
+    m_scanned_list.swap(result);
+    m_scan_done.store(true);
+}   // scanReplayFiles
 
-    for (std::set<std::string>::iterator i  = files.begin();
-                                         i != files.end(); ++i)
+//-----------------------------------------------------------------------------
+/** Adds the header of one replay file to the list of scanned replays,
+ *  either from the index, or by parsing the file and adding it to the
+ *  index.
+ *  \param fn Name of the file as stored in ReplayData.
+ *  \param path Full path of the file.
+ */
+void ReplayPlay::scanReplayFile(const std::string &fn,
+                                const std::string &path, bool custom_replay,
+                                ReplayIndex *index,
+                                std::vector<ReplayData> *result,
+                                std::set<std::string> *all_paths)
+{
+    uint64_t mtime, size;
+    if (StringUtils::getExtension(fn) != "replay" ||
+        !ReplayIndex::getFileInfo(path, &mtime, &size))
+        return;
+    all_paths->insert(path);
+
+    const ReplayData *cached = index->get(path, mtime, size);
+    if (cached)
     {
-        if (!addReplayFile(*i, false, j))
-        {
-            // Skip invalid replay file
-            continue;
-        }
-        j++;
+        if (cached->m_replay_version != 0)
+            result->push_back(*cached);
+        return;
     }
 
-}   // loadAllReplayFile
+    ReplayData rd;
+    rd.m_custom_replay_file = custom_replay;
+    rd.m_filename = fn;
+    if (readReplayHeader(path, &rd, 0))
+    {
+        index->set(path, mtime, size, rd);
+        result->push_back(rd);
+    }
+    else
+    {
+        // Remember invalid files, so they are not parsed each time
+        ReplayData invalid;
+        invalid.m_custom_replay_file = custom_replay;
+        invalid.m_filename           = fn;
+        invalid.m_replay_version     = 0;
+        index->set(path, mtime, size, invalid);
+    }
+}   // scanReplayFile
 
 //-----------------------------------------------------------------------------
-bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int call_index)
+/** Reads the header of a text or binary replay file.
+ *  \param path Full path of the replay file.
+ *  \param rd The replay data to fill in.
+ *  \param call_index Used as UID of old replays which do not store one.
+ *  \return False if the file can not be read.
+ */
+bool ReplayPlay::readReplayHeader(const std::string &path, ReplayData *rd,
+                                  int call_index)
 {
+    FILE *fd = fopen(path.c_str(), "rb");
+    if (fd == NULL) return false;
 
-    char s[1024], s1[1024];
+    bool success = ReplayBinary::isBinaryReplay(fd)
+                 ? readBinaryHeader(fd, rd)
+                 : readTextHeader(fd, rd, call_index);
+    fclose(fd);
+    if (!success)
+        Log::warn("Replay", "Skipped '%s'", path.c_str());
+    return success;
+}   // readReplayHeader
+
+//-----------------------------------------------------------------------------
+bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int call_index)
+{
     if (StringUtils::getExtension(fn) != "replay") return false;
-    FILE *fd = fopen(custom_replay ? fn.c_str() :
-        (file_manager->getReplayDir() + fn).c_str(), "r");
-    if (fd == NULL) return false;
     ReplayData rd;
 
     // custom_replay is true when full path of filename is given
     rd.m_custom_replay_file = custom_replay;
     rd.m_filename = fn;
 
+    if (!readReplayHeader(custom_replay ? fn
+                                        : file_manager->getReplayDir() + fn,
+                          &rd, call_index))
+        return false;
+
+    Track* t = track_manager->getTrack(rd.m_track_name);
+    if (t == NULL)
+    {
+        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
+        rd.m_track_name.c_str());
+        return false;
+    }
+    rd.m_track = t;
+
+    m_replay_file_list.push_back(rd);
+
+    assert(m_replay_file_list.size() > 0);
+    // Force to use custom replay file immediately
+    if (custom_replay)
+        m_current_replay_file = (unsigned int)m_replay_file_list.size() - 1;
+
+    return true;
+
+}   // addReplayFile
+
+//-----------------------------------------------------------------------------
+/** Reads the header of a text replay file (version 3 and 4).
+ *  \param fd The replay file.
+ *  \param rd The replay data to fill in.
+ *  \param call_index Used as UID of old replays which do not store one.
+ *  \return False if the header could not be read.
+ */
+bool ReplayPlay::readTextHeader(FILE *fd, ReplayData *rd, int call_index)
+{
+    char s[1024], s1[1024];
+
     fgets(s, 1023, fd);
     unsigned int version;
     if (sscanf(s,"version: %u", &version) != 1)
     {
         Log::warn("Replay", "No Version information "
                   "found in replay file (bogus replay file).");
-        fclose(fd);
         return false;
     }
-    if (version > getCurrentReplayVersion() ||
+    if (version > getCurrentTextReplayVersion() ||
         version < getMinSupportedReplayVersion() )
     {
         Log::warn("Replay", "Replay is version '%d'", version);
-        Log::warn("Replay", "STK replay version is '%d'", getCurrentReplayVersion());
+        Log::warn("Replay", "STK replay version is '%d'", getCurrentTextReplayVersion());
         Log::warn("Replay", "Minimum supported replay version is '%d'", getMinSupportedReplayVersion());
-        Log::warn("Replay", "Skipped '%s'", fn.c_str());
-        fclose(fd);
         return false;
     }
-        rd.m_replay_version = version;
+    rd->m_replay_version = version;
 
     if (version >= 4)
     {
@@ -143,13 +322,12 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
         if(sscanf(s, "stk_version: %s", s1) != 1)
         {
             Log::warn("Replay", "No STK release version found in replay file.");
-            fclose(fd);
             return false;
         }
-        rd.m_stk_version = s1;
+        rd->m_stk_version = s1;
     }
     else
-        rd.m_stk_version = "";
+        rd->m_stk_version = "";
 
     while(true)
     {
@@ -167,21 +345,21 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
             break;
         }
 
-        rd.m_kart_list.push_back(std::string(s1));
+        rd->m_kart_list.push_back(std::string(s1));
         if (scanned == 2)
         {
             // If username of kart is present, use it
-            rd.m_name_list.push_back(StringUtils::xmlDecode(std::string(display_name_encoded)));
-            if (rd.m_name_list.size() == 1)
+            rd->m_name_list.push_back(StringUtils::xmlDecode(std::string(display_name_encoded)));
+            if (rd->m_name_list.size() == 1)
             {
                 // First user is the game master and the "owner" of this replay file
-                rd.m_user_name = rd.m_name_list[0];
+                rd->m_user_name = rd->m_name_list[0];
             }
         } else
         { // scanned == 1
             // If username is not present, kart display name will default to kart name
             // (see GhostController::getName)
-            rd.m_name_list.push_back("");
+            rd->m_name_list.push_back("");
         }
 
         // Read kart color data
@@ -192,13 +370,12 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
             if(sscanf(s, "kart_color: %f", &f) != 1)
             {
                 Log::warn("Replay", "Kart color missing in replay file.");
-                fclose(fd);
                 return false;
             }
-            rd.m_kart_color.push_back(f);
+            rd->m_kart_color.push_back(f);
         }
         else
-            rd.m_kart_color.push_back(0.0f); // Use default kart color
+            rd->m_kart_color.push_back(0.0f); // Use default kart color
     }
 
     int reverse = 0;
@@ -206,16 +383,14 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
     if(sscanf(s, "reverse: %d", &reverse) != 1)
     {
         Log::warn("Replay", "No reverse info found in replay file.");
-        fclose(fd);
         return false;
     }
-    rd.m_reverse = reverse != 0;
+    rd->m_reverse = reverse != 0;
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "difficulty: %u", &rd.m_difficulty) != 1)
+    if (sscanf(s, "difficulty: %u", &rd->m_difficulty) != 1)
     {
         Log::warn("Replay", " No difficulty found in replay file.");
-        fclose(fd);
         return false;
     }
 
@@ -225,76 +400,89 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
         if (sscanf(s, "mode: %s", s1) != 1)
         {
             Log::warn("Replay", "Replay mode not found in replay file.");
-            fclose(fd);
             return false;
         }
-        rd.m_minor_mode = s1;
+        rd->m_minor_mode = s1;
     }
     // Assume time-trial mode for old replays
     else
-        rd.m_minor_mode = "time-trial";
+        rd->m_minor_mode = "time-trial";
 
 
     fgets(s, 1023, fd);
     if (sscanf(s, "track: %s", s1) != 1)
     {
         Log::warn("Replay", "Track info not found in replay file.");
-        fclose(fd);
-        return false;
-    }
-    rd.m_track_name = std::string(s1);
-    Track* t = track_manager->getTrack(rd.m_track_name);
-    if (t == NULL)
-    {
-        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
-        rd.m_track_name.c_str());
-        fclose(fd);
         return false;
     }
-
-    rd.m_track = t;
+    rd->m_track_name = std::string(s1);
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "laps: %u", &rd.m_laps) != 1)
+    if (sscanf(s, "laps: %u", &rd->m_laps) != 1)
     {
         Log::warn("Replay", "No number of laps found in replay file.");
-        fclose(fd);
         return false;
     }
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "min_time: %f", &rd.m_min_time) != 1)
+    if (sscanf(s, "min_time: %f", &rd->m_min_time) != 1)
     {
         Log::warn("Replay", "Finish time not found in replay file.");
-        fclose(fd);
         return false;
     }
 
     if (version >= 4)
     {
         fgets(s, 1023, fd);
-        if (sscanf(s, "replay_uid: %" PRIu64, &rd.m_replay_uid) != 1)
+        if (sscanf(s, "replay_uid: %" PRIu64, &rd->m_replay_uid) != 1)
         {
             Log::warn("Replay", "Replay UID not found in replay file.");
-            fclose(fd);
             return false;
         }
     }
     // No UID in old replay format
     else
-        rd.m_replay_uid = call_index;
+        rd->m_replay_uid = call_index;
 
-    fclose(fd);
-    m_replay_file_list.push_back(rd);
+    return true;
+}   // readTextHeader
 
-    assert(m_replay_file_list.size() > 0);
-    // Force to use custom replay file immediately
-    if (custom_replay)
-        m_current_replay_file = (unsigned int)m_replay_file_list.size() - 1;
+//-----------------------------------------------------------------------------
+/** Reads the header of a binary replay file.
+ *  \param fd The replay file.
+ *  \param rd The replay data to fill in.
+ *  \return False if the header could not be read.
+ */
+bool ReplayPlay::readBinaryHeader(FILE *fd, ReplayData *rd)
+{
+    ReplayBinary replay;
+    if (!replay.readHeader(fd))
+    {
+        Log::warn("Replay", "Invalid binary replay file.");
+        return false;
+    }
 
+    const ReplayBinary::Header &header = replay.getHeader();
+    rd->m_replay_version = ReplayBinary::VERSION;
+    rd->m_stk_version    = StringUtils::utf8ToWide(header.m_stk_version);
+    for (const ReplayBinary::KartInfo &kart : header.m_karts)
+    {
+        rd->m_kart_list.push_back(kart.m_ident);
+        rd->m_name_list.push_back(kart.m_name);
+        rd->m_kart_color.push_back(kart.m_color);
+    }
+    // First user is the game master and the "owner" of this replay file
+    if (!rd->m_name_list.empty())
+        rd->m_user_name = rd->m_name_list[0];
+    rd->m_reverse        = header.m_reverse;
+    rd->m_difficulty     = header.m_difficulty;
+    rd->m_minor_mode     = header.m_minor_mode;
+    rd->m_track_name     = header.m_track_name;
+    rd->m_laps           = header.m_laps;
+    rd->m_min_time       = header.m_min_time;
+    rd->m_replay_uid     = header.m_replay_uid;
     return true;
-
-}   // addReplayFile
+}   // readBinaryHeader
 
 //-----------------------------------------------------------------------------
 void ReplayPlay::load()
@@ -332,6 +520,13 @@ void ReplayPlay::loadFile(bool second_replay)
                getReplayFilename(replay_file_number).c_str());
 
     ReplayData &rd = m_replay_file_list[replay_index];
+    if (rd.m_replay_version >= ReplayBinary::VERSION)
+    {
+        // The file stays open while the replay is played
+        readBinaryKartData(fd, second_replay);
+        return;
+    }
+
     unsigned int num_kart = (unsigned int)m_replay_file_list.at(replay_index)
                                                             .m_kart_list.size();
     unsigned int lines_to_skip = (rd.m_replay_version == 3) ? 7 : 10;
@@ -353,13 +548,12 @@ void ReplayPlay::loadFile(bool second_replay)
 }   // loadFile
 
 //-----------------------------------------------------------------------------
-/** Reads all data from a replay file for a specific kart.
- *  \param fd The file descriptor from which to read.
+/** Creates the ghost kart for the next kart of a replay file.
+ *  \param second_replay True if the kart belongs to the second replay.
+ *  \return The index of the new ghost kart.
  */
-void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
+unsigned int ReplayPlay::addGhostKart(bool second_replay)
 {
-    char s[1024];
-
     int replay_index = second_replay ? m_second_replay_file
                                      : m_current_replay_file;
 
@@ -378,6 +572,21 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
     Controller* controller = new GhostController(getGhostKart(kart_num).get(),
                                                  rd.m_name_list[kart_num-first_loaded_f_num]);
     getGhostKart(kart_num)->setController(controller);
+    return kart_num;
+}   // addGhostKart
+
+//-----------------------------------------------------------------------------
+/** Reads all data from a replay file for a specific kart.
+ *  \param fd The file descriptor from which to read.
+ */
+void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
+{
+    char s[1024];
+
+    int replay_index = second_replay ? m_second_replay_file
+                                     : m_current_replay_file;
+    const ReplayData &rd = m_replay_file_list[replay_index];
+    const unsigned int kart_num = addGhostKart(second_replay);
 
     unsigned int size;
     if(sscanf(next_line,"size: %u",&size)!=1)
@@ -387,112 +596,222 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
     for(unsigned int i=0; i<size; i++)
     {
         fgets(s, 1023, fd);
-        float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4, nitro_amount, distance;
-        int skidding_state, attachment, item_amount, item_type, special_value,
-            nitro, zipper, skidding, red_skidding, jumping;
+        TransformEvent  t;
+        PhysicInfo      pi  = {0};
+        BonusInfo       bi  = {0};
+        KartReplayEvent kre = {0};
+        if (readTextEvent(s, rd.m_replay_version, &t, &pi, &bi, &kre))
+        {
+            m_ghost_karts[kart_num]->addReplayEvent(t.m_time,
+                t.m_transform, pi, bi, kre);
+        }
+        else
+        {
+            // Invalid record found
+            // ---------------------
+            Log::warn("Replay", "Can't read replay data line %d:", i);
+            Log::warn("Replay", "%s", s);
+            Log::warn("Replay", "Ignored.");
+        }
+    }   // for i
+
+}   // readKartData
+
+//-----------------------------------------------------------------------------
+/** Creates the ghost karts of a binary replay file. The events are not
+ *  read here: each ghost kart decodes them from the file while the race is
+ *  running (see ReplayStream). The file is closed once all ghost karts of
+ *  this replay are deleted.
+ *  \param fd The file descriptor from which to read.
+ *  \param second_replay True if this is the second replay.
+ */
+void ReplayPlay::readBinaryKartData(FILE *fd, bool second_replay)
+{
+    std::shared_ptr<ReplayStream::File> file =
+        std::make_shared<ReplayStream::File>(fd);
+    if (!file->readHeader())
+    {
+        Log::error("Replay", "Can't read replay header.");
+        return;
+    }
+
+    const ReplayBinary::Header &header = file->getReplay().getHeader();
+    for (unsigned int k = 0; k < header.m_karts.size(); k++)
+    {
+        const unsigned int kart_num = addGhostKart(second_replay);
+        m_ghost_karts[kart_num]->setReplayFile(file, k);
+    }
+}   // readBinaryKartData
+
+//-----------------------------------------------------------------------------
+/** Converts a text replay file into a binary one, or a binary replay file
+ *  into a text file (version 4), depending on the format of the input file.
+ *  This does not need the track of the replay to be installed.
+ *  \param in Full path of the replay file to convert.
+ *  \param out Full path of the file to write.
+ *  \return True if the conversion was successful.
+ */
+bool ReplayPlay::convertReplayFile(const std::string &in,
+                                   const std::string &out)
+{
+    FILE *fd = fopen(in.c_str(), "rb");
+    if (!fd)
+    {
+        Log::error("Replay", "Can't open '%s'.", in.c_str());
+        return false;
+    }
 
-        // Check for EV_TRANSFORM event:
-        // -----------------------------
+    ReplayBinary replay;
+    std::vector<std::vector<TransformEvent> >  transforms;
+    std::vector<std::vector<PhysicInfo> >      physic_info;
+    std::vector<std::vector<BonusInfo> >       bonus_info;
+    std::vector<std::vector<KartReplayEvent> > events;
+    bool to_text = ReplayBinary::isBinaryReplay(fd);
+    bool success = true;
+    if (to_text)
+    {
+        success = replay.readHeader(fd);
+        unsigned int num_karts = success
+                       ? (unsigned int)replay.getHeader().m_karts.size() : 0;
+        transforms.resize(num_karts);
+        physic_info.resize(num_karts);
+        bonus_info.resize(num_karts);
+        events.resize(num_karts);
+        for (unsigned int k = 0; success && k < num_karts; k++)
+        {
+            success = replay.readKart(fd, k, &transforms[k], &physic_info[k],
+                                      &bonus_info[k], &events[k]);
+        }
+    }
+    else
+    {
+        ReplayData rd;
+        success = readTextHeader(fd, &rd, 0);
+        ReplayBinary::Header header;
+        header.m_stk_version = StringUtils::wideToUtf8(rd.m_stk_version);
+        header.m_reverse     = rd.m_reverse;
+        header.m_difficulty  = rd.m_difficulty;
+        header.m_minor_mode  = rd.m_minor_mode;
+        header.m_track_name  = rd.m_track_name;
+        header.m_laps        = rd.m_laps;
+        header.m_min_time    = rd.m_min_time;
+        header.m_replay_uid  = rd.m_replay_uid;
+        for (unsigned int k = 0; success && k < rd.m_kart_list.size(); k++)
+        {
+            ReplayBinary::KartInfo ki;
+            ki.m_ident = rd.m_kart_list[k];
+            ki.m_name  = rd.m_name_list[k];
+            ki.m_color = rd.m_kart_color[k];
+            header.m_karts.push_back(ki);
+        }
+        replay.setHeader(header);
 
-        // Up to STK 0.9.3 replays
-        if (rd.m_replay_version == 3)
+        char s[1024];
+        unsigned int size;
+        while (success && fgets(s, 1023, fd) != NULL &&
+               transforms.size() < header.m_karts.size())
         {
-            if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
-                &time,
-                &x, &y, &z,
-                &rx, &ry, &rz, &rw,
-                &speed, &steer, &w1, &w2, &w3, &w4,
-                &nitro, &zipper, &skidding, &red_skidding, &jumping
-                )==19)
+            if (sscanf(s, "size: %u", &size) != 1)
             {
-                btQuaternion q(rx, ry, rz, rw);
-                btVector3 xyz(x, y, z);
-                PhysicInfo pi             = {0};
-                BonusInfo bi              = {0};
-                KartReplayEvent kre       = {0};
-
-                pi.m_speed                = speed;
-                pi.m_steer                = steer;
-                pi.m_suspension_length[0] = w1;
-                pi.m_suspension_length[1] = w2;
-                pi.m_suspension_length[2] = w3;
-                pi.m_suspension_length[3] = w4;
-                pi.m_skidding_state       = 0;    //not saved in version 3 replays
-                bi.m_attachment           = 0;    //not saved in version 3 replays
-                bi.m_nitro_amount         = 0;    //not saved in version 3 replays
-                bi.m_item_amount          = 0;    //not saved in version 3 replays
-                bi.m_item_type            = 0;    //not saved in version 3 replays
-                bi.m_special_value        = 0;    //not saved in version 3 replays
-                kre.m_distance            = 0.0f; //not saved in version 3 replays
-                kre.m_nitro_usage         = nitro;
-                kre.m_zipper_usage        = zipper!=0;
-                kre.m_skidding_effect     = skidding;
-                kre.m_red_skidding        = red_skidding!=0;
-                kre.m_jumping             = jumping != 0;
-                m_ghost_karts[kart_num]->addReplayEvent(time,
-                    btTransform(q, xyz), pi, bi, kre);
+                success = false;
+                break;
             }
-            else
+            transforms.emplace_back();
+            physic_info.emplace_back();
+            bonus_info.emplace_back();
+            events.emplace_back();
+            for (unsigned int i = 0; i < size; i++)
             {
-                // Invalid record found
-                // ---------------------
-                Log::warn("Replay", "Can't read replay data line %d:", i);
-                Log::warn("Replay", "%s", s);
-                Log::warn("Replay", "Ignored.");
+                TransformEvent  t;
+                PhysicInfo      pi  = {0};
+                BonusInfo       bi  = {0};
+                KartReplayEvent kre = {0};
+                if (fgets(s, 1023, fd) == NULL ||
+                    !readTextEvent(s, rd.m_replay_version, &t, &pi, &bi,
+                                   &kre))
+                {
+                    success = false;
+                    break;
+                }
+                transforms.back().push_back(t);
+                physic_info.back().push_back(pi);
+                bonus_info.back().push_back(bi);
+                events.back().push_back(kre);
             }
         }
+        if (transforms.size() != header.m_karts.size())
+            success = false;
+        for (unsigned int k = 0; success && k < transforms.size(); k++)
+        {
+            replay.addKartEvents(k, (unsigned int)transforms[k].size(),
+                                 transforms[k].data(), physic_info[k].data(),
+                                 bonus_info[k].data(), events[k].data());
+        }
+    }
+    fclose(fd);
 
-        //version 4 replays (STK 0.9.4 and higher)
-        else
+    if (!success)
+    {
+        Log::error("Replay", "Can't read replay file '%s'.", in.c_str());
+        return false;
+    }
+
+    fd = fopen(out.c_str(), "wb");
+    if (!fd)
+    {
+        Log::error("Replay", "Can't open '%s' for writing.", out.c_str());
+        return false;
+    }
+
+    if (to_text)
+    {
+        const ReplayBinary::Header &header = replay.getHeader();
+        fprintf(fd, "version: %d\n", getCurrentTextReplayVersion());
+        fprintf(fd, "stk_version: %s\n", header.m_stk_version.c_str());
+        for (const ReplayBinary::KartInfo &kart : header.m_karts)
         {
-            if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
-                &time,
-                &x, &y, &z,
-                &rx, &ry, &rz, &rw,
-                &speed, &steer, &w1, &w2, &w3, &w4, &skidding_state,
-                &attachment, &nitro_amount, &item_amount, &item_type, &special_value,
-                &distance, &nitro, &zipper, &skidding, &red_skidding, &jumping
-                )==26)
+            if (kart.m_name.empty())
+                fprintf(fd, "kart: %s\n", kart.m_ident.c_str());
+            else
             {
-                btQuaternion q(rx, ry, rz, rw);
-                btVector3 xyz(x, y, z);
-                PhysicInfo pi             = {0};
-                BonusInfo bi              = {0};
-                KartReplayEvent kre       = {0};
-
-                pi.m_speed                = speed;
-                pi.m_steer                = steer;
-                pi.m_suspension_length[0] = w1;
-                pi.m_suspension_length[1] = w2;
-                pi.m_suspension_length[2] = w3;
-                pi.m_suspension_length[3] = w4;
-                pi.m_skidding_state       = skidding_state;
-                bi.m_attachment           = attachment;
-                bi.m_nitro_amount         = nitro_amount;
-                bi.m_item_amount          = item_amount;
-                bi.m_item_type            = item_type;
-                bi.m_special_value        = special_value;
-                kre.m_distance            = distance;
-                kre.m_nitro_usage         = nitro;
-                kre.m_zipper_usage        = zipper!=0;
-                kre.m_skidding_effect     = skidding;
-                kre.m_red_skidding        = red_skidding!=0;
-                kre.m_jumping             = jumping != 0;
-                m_ghost_karts[kart_num]->addReplayEvent(time,
-                    btTransform(q, xyz), pi, bi, kre);
+                // XML encode the username to handle Unicode
+                fprintf(fd, "kart: %s %s\n", kart.m_ident.c_str(),
+                        StringUtils::xmlEncode(kart.m_name).c_str());
             }
-            else
+            fprintf(fd, "kart_color: %f\n", kart.m_color);
+        }
+        fprintf(fd, "kart_list_end\n");
+        fprintf(fd, "reverse: %d\n",    (int)header.m_reverse);
+        fprintf(fd, "difficulty: %d\n", header.m_difficulty);
+        fprintf(fd, "mode: %s\n",       header.m_minor_mode.c_str());
+        fprintf(fd, "track: %s\n",      header.m_track_name.c_str());
+        fprintf(fd, "laps: %d\n",       header.m_laps);
+        fprintf(fd, "min_time: %f\n",   header.m_min_time);
+        fprintf(fd, "replay_uid: %" PRIu64 "\n", header.m_replay_uid);
+        for (unsigned int k = 0; k < transforms.size(); k++)
+        {
+            fprintf(fd, "size:     %d\n", (int)transforms[k].size());
+            for (unsigned int i = 0; i < transforms[k].size(); i++)
             {
-                // Invalid record found
-                // ---------------------
-                Log::warn("Replay", "Can't read replay data line %d:", i);
-                Log::warn("Replay", "%s", s);
-                Log::warn("Replay", "Ignored.");
+                writeTextEvent(fd, transforms[k][i], physic_info[k][i],
+                               bonus_info[k][i], events[k][i]);
             }
         }
-    }   // for i
+        success = ferror(fd) == 0;
+    }
+    else
+        success = replay.write(fd);
+    fclose(fd);
 
-}   // readKartData
+    if (success)
+    {
+        Log::info("Replay", "Converted '%s' to %s replay '%s'.", in.c_str(),
+                  to_text ? "text" : "binary", out.c_str());
+    }
+    else
+        Log::error("Replay", "Error writing '%s'.", out.c_str());
+    return success;
+}   // convertReplayFile
 
 //-----------------------------------------------------------------------------
 /** call getReplayIdByUID and set the current replay file to the first one
@@ -24,13 +24,17 @@
 
 #include "irrString.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace irr;
 
 class GhostKart;
+class ReplayIndex;
 
 /**
   * \ingroup replay
@@ -122,14 +126,43 @@ private:
     /** All ghost karts. */
     std::vector<std::shared_ptr<GhostKart> > m_ghost_karts;
 
+    /** Thread which scans the replay directories in the background. */
+    std::thread              m_scan_thread;
+
+    /** Set by the scan thread once m_scanned_list is complete. */
+    std::atomic_bool         m_scan_done;
+
+    /** The replay headers found by the scan thread. */
+    std::vector<ReplayData>  m_scanned_list;
+
           ReplayPlay();
          ~ReplayPlay();
     void  readKartData(FILE *fd, char *next_line, bool second_replay);
+    void  readBinaryKartData(FILE *fd, bool second_replay);
+    unsigned int addGhostKart(bool second_replay);
+    bool  readTextHeader(FILE *fd, ReplayData *rd, int call_index);
+    bool  readBinaryHeader(FILE *fd, ReplayData *rd);
+    bool  readReplayHeader(const std::string &path, ReplayData *rd,
+                           int call_index);
+    void  scanReplayFiles(const std::set<std::string> &stock_files,
+                          const std::set<std::string> &user_files,
+                          const std::string &replay_dir);
+    void  scanReplayFile(const std::string &fn, const std::string &path,
+                         bool custom_replay, ReplayIndex *index,
+                         std::vector<ReplayData> *result,
+                         std::set<std::string> *all_paths);
 public:
     void  reset();
     void  load();
     void  loadFile(bool second_replay);
     void  loadAllReplayFile();
+    void  startLoadingReplayFiles();
+    bool  finishLoadingReplayFiles();
+    // ------------------------------------------------------------------------
+    /** Returns true if the replay directories are scanned in the
+     *  background. */
+    bool  isLoadingReplayFiles() const { return m_scan_thread.joinable(); }
+    bool  convertReplayFile(const std::string &in, const std::string &out);
     // ------------------------------------------------------------------------
     static void        setSortOrder(SortOrder so)       { m_sort_order = so; }
     // ------------------------------------------------------------------------
@@ -33,6 +33,7 @@
 #include "modes/world.hpp"
 #include "physics/btKart.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_binary.hpp"
 #include "tracks/track.hpp"
 
 #include <algorithm>
@@ -395,8 +396,8 @@ void ReplayRecorder::save()
         (file_manager->getReplayDir() + getReplayFilename()).c_str());
     MessageQueue::add(MessageQueue::MT_GENERIC, msg);
 
-    fprintf(fd, "version: %d\n", getCurrentReplayVersion());
-    fprintf(fd, "stk_version: %s\n", STK_VERSION);
+    ReplayBinary::Header header;
+    header.m_stk_version = STK_VERSION;
 
     unsigned int player_count = 0;
     for (unsigned int real_karts = 0; real_karts < num_karts; real_karts++)
@@ -404,17 +405,18 @@ void ReplayRecorder::save()
         const AbstractKart *kart = world->getKart(real_karts);
         if (kart->isGhostKart()) continue;
 
-        // XML encode the username to handle Unicode
-        fprintf(fd, "kart: %s %s\n", kart->getIdent().c_str(),
-                StringUtils::xmlEncode(kart->getController()->getName()).c_str());
-
+        ReplayBinary::KartInfo ki;
+        ki.m_ident = kart->getIdent();
+        ki.m_name  = kart->getController()->getName();
         if (kart->getController()->isPlayerController())
         {
-            fprintf(fd, "kart_color: %f\n", StateManager::get()->getActivePlayer(player_count)->getConstProfile()->getDefaultKartColor());
+            ki.m_color = StateManager::get()->getActivePlayer(player_count)
+                                   ->getConstProfile()->getDefaultKartColor();
             player_count++;
         }
         else
-            fprintf(fd, "kart_color: 0\n");
+            ki.m_color = 0.0f;
+        header.m_karts.push_back(ki);
     }
 
     m_last_uid = computeUID(min_time);
@@ -422,57 +424,31 @@ void ReplayRecorder::save()
     int num_laps = race_manager->getNumLaps();
     if (num_laps == 9999) num_laps = 0; // no lap in that race mode
 
-    fprintf(fd, "kart_list_end\n");
-    fprintf(fd, "reverse: %d\n",    (int)race_manager->getReverseTrack());
-    fprintf(fd, "difficulty: %d\n", race_manager->getDifficulty());
-    fprintf(fd, "mode: %s\n",       race_manager->getMinorModeName().c_str());
-    fprintf(fd, "track: %s\n",      Track::getCurrentTrack()->getIdent().c_str());
-    fprintf(fd, "laps: %d\n",       num_laps);
-    fprintf(fd, "min_time: %f\n",   min_time);
-    fprintf(fd, "replay_uid: %" PRIu64 "\n", m_last_uid);
-
+    header.m_reverse     = race_manager->getReverseTrack();
+    header.m_difficulty  = race_manager->getDifficulty();
+    header.m_minor_mode  = race_manager->getMinorModeName();
+    header.m_track_name  = Track::getCurrentTrack()->getIdent();
+    header.m_laps        = num_laps;
+    header.m_min_time    = min_time;
+    header.m_replay_uid  = m_last_uid;
+
+    ReplayBinary replay;
+    replay.setHeader(header);
+    unsigned int replay_kart = 0;
     for (unsigned int k = 0; k < num_karts; k++)
     {
         if (world->getKart(k)->isGhostKart()) continue;
-        fprintf(fd, "size:     %d\n", m_count_transforms[k]);
-
         unsigned int num_transforms = std::min(m_max_frames,
                                                m_count_transforms[k]);
-        for (unsigned int i = 0; i < num_transforms; i++)
-        {
-            const TransformEvent *p  = &(m_transform_events[k][i]);
-            const PhysicInfo *q      = &(m_physic_info[k][i]);
-            const BonusInfo *b      = &(m_bonus_info[k][i]);
-            const KartReplayEvent *r = &(m_kart_replay_event[k][i]);
-            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
-                    p->m_time,
-                    p->m_transform.getOrigin().getX(),
-                    p->m_transform.getOrigin().getY(),
-                    p->m_transform.getOrigin().getZ(),
-                    p->m_transform.getRotation().getX(),
-                    p->m_transform.getRotation().getY(),
-                    p->m_transform.getRotation().getZ(),
-                    p->m_transform.getRotation().getW(),
-                    q->m_speed,
-                    q->m_steer,
-                    q->m_suspension_length[0],
-                    q->m_suspension_length[1],
-                    q->m_suspension_length[2],
-                    q->m_suspension_length[3],
-                    q->m_skidding_state,
-                    b->m_attachment,
-                    b->m_nitro_amount,
-                    b->m_item_amount,
-                    b->m_item_type,
-                    b->m_special_value,
-                    r->m_distance,
-                    r->m_nitro_usage,
-                    (int)r->m_zipper_usage,
-                    r->m_skidding_effect,
-                    (int)r->m_red_skidding,
-                    (int)r->m_jumping
-                );
-        }   // for i
+        replay.addKartEvents(replay_kart++, num_transforms,
+                             m_transform_events[k].data(),
+                             m_physic_info[k].data(), m_bonus_info[k].data(),
+                             m_kart_replay_event[k].data());
+    }
+    if (!replay.write(fd))
+    {
+        Log::error("ReplayRecorder", "Error writing replay file '%s'.",
+                   getReplayFilename().c_str());
     }
     fclose(fd);
 }   // save
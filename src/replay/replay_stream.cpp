@@ -0,0 +1,433 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/replay_stream.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+const unsigned int ReplayStream::CHUNKS_AHEAD = 2;
+
+// ----------------------------------------------------------------------------
+void ReplayStream::Events::clear(unsigned int start)
+{
+    m_start = start;
+    m_transforms.clear();
+    m_physic_info.clear();
+    m_bonus_info.clear();
+    m_events.clear();
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** Removes the first n events. */
+void ReplayStream::Events::eraseFront(unsigned int n)
+{
+    n = std::min(n, size());
+    m_transforms.erase(m_transforms.begin(), m_transforms.begin() + n);
+    m_physic_info.erase(m_physic_info.begin(), m_physic_info.begin() + n);
+    m_bonus_info.erase(m_bonus_info.begin(), m_bonus_info.begin() + n);
+    m_events.erase(m_events.begin(), m_events.begin() + n);
+    m_start += n;
+}   // eraseFront
+
+// ============================================================================
+ReplayStream::ReplayStream()
+{
+    m_kart          = 0;
+    m_num_events    = 0;
+    m_num_chunks    = 0;
+    m_first_chunk   = 0;
+    m_end_chunk     = 0;
+    m_scratch_chunk = -1;
+}   // ReplayStream
+
+// ----------------------------------------------------------------------------
+/** Streams the events of a kart from a binary replay file. Only the
+ *  chunks around the first event are decoded.
+ *  \param file The replay file, its header must have been read.
+ *  \param kart Index of the kart in the replay file.
+ */
+void ReplayStream::init(std::shared_ptr<File> file, unsigned int kart)
+{
+    m_file = file;
+    m_kart = kart;
+    m_window.clear(0);
+    m_scratch.clear(0);
+    m_scratch_chunk = -1;
+    m_first_chunk   = 0;
+    m_end_chunk     = 0;
+
+    // Only use the chunks that are consistent with the events before them,
+    // so that each event index belongs to exactly one chunk.
+    const std::vector<ReplayBinary::ChunkInfo> &chunks =
+                                                      getKartInfo().m_chunks;
+    m_num_events = 0;
+    m_num_chunks = 0;
+    while (m_num_chunks < chunks.size())
+    {
+        const ReplayBinary::ChunkInfo &ci = chunks[m_num_chunks];
+        if (ci.m_first_event != m_num_events || ci.m_num_events == 0 ||
+            ci.m_num_events > ReplayBinary::EVENTS_PER_CHUNK)
+        {
+            Log::warn("ReplayStream", "Invalid chunk index of kart %d, "
+                      "using %d events.", kart, m_num_events);
+            break;
+        }
+        m_num_events += ci.m_num_events;
+        m_num_chunks++;
+    }
+    update(0);
+}   // init
+
+// ----------------------------------------------------------------------------
+/** Adds an event of a text replay file, which are all kept in memory.
+ *  Events with the same time as the previous one are ignored (to avoid a
+ *  division by zero when interpolating).
+ */
+void ReplayStream::addEvent(const ReplayBase::TransformEvent &t,
+                            const ReplayBase::PhysicInfo &pi,
+                            const ReplayBase::BonusInfo &bi,
+                            const ReplayBase::KartReplayEvent &kre)
+{
+    assert(!isStreaming());
+    if (m_num_events > 0 && m_window.m_transforms.back().m_time == t.m_time)
+        return;
+    m_window.m_transforms.push_back(t);
+    m_window.m_physic_info.push_back(pi);
+    m_window.m_bonus_info.push_back(bi);
+    m_window.m_events.push_back(kre);
+    m_num_events++;
+}   // addEvent
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the chunk that contains the given event. */
+unsigned int ReplayStream::getChunkOfEvent(unsigned int i) const
+{
+    const std::vector<ReplayBinary::ChunkInfo> &chunks =
+                                                      getKartInfo().m_chunks;
+    auto it = std::upper_bound(chunks.begin(), chunks.begin() + m_num_chunks,
+        i, [](unsigned int n, const ReplayBinary::ChunkInfo &ci)
+           { return n < ci.m_first_event; });
+    assert(it != chunks.begin());
+    return (unsigned int)(it - chunks.begin()) - 1;
+}   // getChunkOfEvent
+
+// ----------------------------------------------------------------------------
+/** Decodes a chunk and appends its events. If the chunk can't be decoded
+ *  (corrupt file), the events of this kart end before that chunk, in the
+ *  same way as init() ends them at an invalid chunk index.
+ *  \return True if the chunk was decoded.
+ */
+bool ReplayStream::readChunk(unsigned int chunk, Events *events) const
+{
+    const ReplayBinary::ChunkInfo &ci = getKartInfo().m_chunks[chunk];
+    const unsigned int old_size = events->size();
+    if (m_file->getReplay().readChunk(m_file->getFD(), m_kart, chunk,
+                                      &events->m_transforms,
+                                      &events->m_physic_info,
+                                      &events->m_bonus_info,
+                                      &events->m_events) &&
+        events->size() == old_size + ci.m_num_events)
+        return true;
+
+    Log::warn("ReplayStream", "Can't read chunk %d of kart %d, "
+              "using %d events.", chunk, m_kart, ci.m_first_event);
+    events->m_transforms.resize(old_size);
+    events->m_physic_info.resize(old_size);
+    events->m_bonus_info.resize(old_size);
+    events->m_events.resize(old_size);
+    m_num_chunks = chunk;
+    m_num_events = ci.m_first_event;
+    return false;
+}   // readChunk
+
+// ----------------------------------------------------------------------------
+/** Returns the decoded events that contain the given event. If the event
+ *  is not in the window, its chunk is decoded into m_scratch, which
+ *  invalidates all data previously returned from m_scratch. If that chunk
+ *  can't be decoded, the events end before it and i is changed to the
+ *  last remaining event.
+ *  \param i Index of the event, changed if the event was dropped.
+ */
+const ReplayStream::Events& ReplayStream::locate(unsigned int *i) const
+{
+    assert(*i < m_num_events);
+    if (m_window.contains(*i) || !isStreaming())
+        return m_window;
+    if (m_scratch.contains(*i))
+        return m_scratch;
+
+    const unsigned int chunk = getChunkOfEvent(*i);
+    m_scratch.clear(getKartInfo().m_chunks[chunk].m_first_event);
+    if (readChunk(chunk, &m_scratch))
+    {
+        m_scratch_chunk = chunk;
+        return m_scratch;
+    }
+    m_scratch_chunk = -1;
+    assert(m_num_events > 0);
+    *i = m_num_events - 1;
+    return locate(i);
+}   // locate
+
+// ----------------------------------------------------------------------------
+/** Moves the window of decoded events so that it contains the given event,
+ *  the chunk before it and CHUNKS_AHEAD chunks after it. Chunks behind the
+ *  window are discarded. This is called each time step, but usually only
+ *  decodes a new chunk every EVENTS_PER_CHUNK events.
+ *  \param current_event Index of the event that is currently used.
+ */
+void ReplayStream::update(unsigned int current_event)
+{
+    if (!isStreaming() || m_num_events == 0)
+        return;
+
+    const std::vector<ReplayBinary::ChunkInfo> &chunks =
+                                                      getKartInfo().m_chunks;
+    const unsigned int chunk =
+        getChunkOfEvent(std::min(current_event, m_num_events - 1));
+    const unsigned int first = chunk > 0 ? chunk - 1 : 0;
+    unsigned int end = std::min(chunk + 1 + CHUNKS_AHEAD, m_num_chunks);
+
+    if (first == m_first_chunk && end <= m_end_chunk &&
+        m_window.size() > 0)
+        return;
+
+    if (first >= m_first_chunk && first < m_end_chunk)
+    {
+        // Common case: the window moves forward, keep the chunks that are
+        // already decoded.
+        m_window.eraseFront(chunks[first].m_first_event - m_window.m_start);
+        for (unsigned int c = m_end_chunk; c < end; c++)
+        {
+            // The chunk might already be decoded for random access
+            if ((int)c == m_scratch_chunk)
+            {
+                Events &s = m_scratch;
+                m_window.m_transforms.insert(m_window.m_transforms.end(),
+                    s.m_transforms.begin(), s.m_transforms.end());
+                m_window.m_physic_info.insert(m_window.m_physic_info.end(),
+                    s.m_physic_info.begin(), s.m_physic_info.end());
+                m_window.m_bonus_info.insert(m_window.m_bonus_info.end(),
+                    s.m_bonus_info.begin(), s.m_bonus_info.end());
+                m_window.m_events.insert(m_window.m_events.end(),
+                    s.m_events.begin(), s.m_events.end());
+            }
+            else if (!readChunk(c, &m_window))
+                break;
+        }
+        end = std::max(end, m_end_chunk);
+    }
+    else
+    {
+        // Seek (e.g. after a restart of the race): decode all chunks again
+        m_window.clear(chunks[first].m_first_event);
+        for (unsigned int c = first; c < end; c++)
+        {
+            if (!readChunk(c, &m_window))
+                break;
+        }
+    }
+    // A chunk that can't be read ends the events
+    m_end_chunk   = std::min(end, m_num_chunks);
+    m_first_chunk = std::min(first, m_end_chunk);
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the last event at or before the given time, or 0
+ *  if the time is before the first event. For a binary replay, the chunk
+ *  is found using the start times in the chunk index, so at most one chunk
+ *  needs to be decoded.
+ */
+unsigned int ReplayStream::findEvent(float time) const
+{
+    if (m_num_events == 0)
+        return 0;
+
+    unsigned int lo = 0;
+    unsigned int hi = m_num_events;
+    if (isStreaming())
+    {
+        const std::vector<ReplayBinary::ChunkInfo> &chunks =
+                                                      getKartInfo().m_chunks;
+        auto it = std::upper_bound(chunks.begin(),
+            chunks.begin() + m_num_chunks, time,
+            [](float t, const ReplayBinary::ChunkInfo &ci)
+            { return t < ci.m_start_time; });
+        if (it == chunks.begin())
+            return 0;
+        --it;
+        lo = it->m_first_event;
+        hi = it->m_first_event + it->m_num_events;
+    }
+
+    // Note that getTime() reduces m_num_events if a chunk can't be decoded
+    if (getTime(lo) > time || lo >= m_num_events)
+        return std::min(lo, m_num_events > 0 ? m_num_events - 1 : 0);
+    // Invariant: getTime(lo) <= time, and time < getTime(hi) (if hi is
+    // a valid event).
+    while (hi - lo > 1)
+    {
+        const unsigned int mid = (lo + hi) / 2;
+        if (mid < m_num_events && getTime(mid) <= time)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}   // findEvent
+
+// ----------------------------------------------------------------------------
+/** Returns the number of events currently decoded, i.e. kept in memory. */
+unsigned int ReplayStream::getNumLoadedEvents() const
+{
+    return m_window.size() + m_scratch.size();
+}   // getNumLoadedEvents
+
+// ----------------------------------------------------------------------------
+void ReplayStream::unitTesting()
+{
+    const unsigned int num_events = ReplayBinary::EVENTS_PER_CHUNK * 10 + 7;
+    std::vector<ReplayBase::TransformEvent>  transforms(num_events);
+    std::vector<ReplayBase::PhysicInfo>      physic_info(num_events);
+    std::vector<ReplayBase::BonusInfo>       bonus_info(num_events);
+    std::vector<ReplayBase::KartReplayEvent> events(num_events);
+    for (unsigned int i = 0; i < num_events; i++)
+    {
+        transforms[i].m_time = i * 0.1f;
+        transforms[i].m_transform.setIdentity();
+        transforms[i].m_transform.setOrigin(btVector3(i * 1.0f, 0, 0));
+        physic_info[i] = {};
+        bonus_info[i]  = {};
+        events[i]      = {};
+        events[i].m_distance = i * 2.0f;
+    }
+
+    ReplayBinary writer;
+    ReplayBinary::Header header;
+    header.m_stk_version = "test";
+    header.m_karts.resize(1);
+    header.m_karts[0].m_ident = "tux";
+    header.m_karts[0].m_color = 0.0f;
+    header.m_reverse    = false;
+    header.m_difficulty = 0;
+    header.m_minor_mode = "time-trial";
+    header.m_track_name = "test";
+    header.m_laps       = 1;
+    header.m_min_time   = 0.0f;
+    header.m_replay_uid = 0;
+    writer.setHeader(header);
+    writer.addKartEvents(0, num_events, transforms.data(),
+                         physic_info.data(), bonus_info.data(),
+                         events.data());
+
+    FILE *fd = tmpfile();
+    assert(fd);
+    bool ok = writer.write(fd);
+    assert(ok);
+    rewind(fd);
+    std::shared_ptr<File> file = std::make_shared<File>(fd);
+    ok = file->readHeader();
+    assert(ok);
+    (void)ok;
+
+    ReplayStream stream;
+    stream.init(file, 0);
+    assert(stream.getNumEvents() == num_events);
+    const unsigned int max_loaded =
+        (CHUNKS_AHEAD + 3) * ReplayBinary::EVENTS_PER_CHUNK;
+    (void)max_loaded;
+    for (unsigned int i = 0; i < num_events; i++)
+    {
+        stream.update(i);
+        assert(stream.getNumLoadedEvents() <= max_loaded);
+        assert(fabsf(stream.getTransform(i).getOrigin().getX() - i) <
+               0.001f);
+        if (i + 1 < num_events)
+            assert(stream.m_window.contains(i + 1));
+        if (i > 0)
+            assert(stream.m_window.contains(i - 1));
+    }
+
+    // Random access outside of the window, and seeking by time
+    assert(fabsf(stream.getKartReplayEvent(3).m_distance - 6.0f) < 0.01f);
+    for (unsigned int i = 0; i < num_events; i += 97)
+    {
+        assert(stream.findEvent(i * 0.1f + 0.05f) == i);
+        stream.update(i);
+        assert(stream.m_window.contains(i));
+    }
+    assert(stream.findEvent(-1.0f) == 0);
+    assert(stream.findEvent(1e6f) == num_events - 1);
+
+    // A chunk that can't be read ends the events: cut the file in the
+    // middle of chunk 5
+    const ReplayBinary::ChunkInfo &last =
+        file->getReplay().getHeader().m_karts[0].m_chunks.back();
+    const ReplayBinary::ChunkInfo &cut =
+        file->getReplay().getHeader().m_karts[0].m_chunks[5];
+    fseek(fd, 0, SEEK_END);
+    const long data_start = ftell(fd) - (long)last.m_offset -
+                            (long)last.m_compressed_size;
+    std::vector<char> data(data_start + cut.m_offset + 1);
+    rewind(fd);
+    ok = fread(data.data(), 1, data.size(), fd) == data.size();
+    assert(ok);
+    FILE *cut_fd = tmpfile();
+    assert(cut_fd);
+    ok = fwrite(data.data(), 1, data.size(), cut_fd) == data.size();
+    assert(ok);
+    rewind(cut_fd);
+    std::shared_ptr<File> cut_file = std::make_shared<File>(cut_fd);
+    ok = cut_file->readHeader();
+    assert(ok);
+    ReplayStream cut_stream;
+    cut_stream.init(cut_file, 0);
+    assert(cut_stream.getNumEvents() == num_events);
+    for (unsigned int i = 0; i < cut_stream.getNumEvents(); i++)
+    {
+        cut_stream.update(i);
+        assert(fabsf(cut_stream.getTransform(i).getOrigin().getX() - i) <
+               0.001f);
+    }
+    assert(cut_stream.getNumEvents() == cut.m_first_event);
+    assert(cut_stream.findEvent(1e6f) == cut.m_first_event - 1);
+
+    // Random access to a chunk that can't be read returns the last event
+    ReplayStream cut_random;
+    cut_random.init(cut_file, 0);
+    const btTransform t = cut_random.getTransform(num_events - 1);
+    assert(fabsf(t.getOrigin().getX() - (cut.m_first_event - 1)) < 0.001f);
+    (void)t;
+    assert(cut_random.getNumEvents() == cut.m_first_event);
+
+    // Text replays keep all events in memory
+    ReplayStream text;
+    for (unsigned int i = 0; i < num_events; i++)
+    {
+        text.addEvent(transforms[i], physic_info[i], bonus_info[i],
+                      events[i]);
+    }
+    text.addEvent(transforms.back(), physic_info.back(), bonus_info.back(),
+                  events.back());
+    assert(text.getNumEvents() == num_events);
+    assert(text.findEvent(123.45f) == 1234);
+}   // unitTesting
@@ -0,0 +1,179 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2018 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REPLAY_STREAM_HPP
+#define HEADER_REPLAY_STREAM_HPP
+
+#include "replay/replay_base.hpp"
+#include "replay/replay_binary.hpp"
+#include "utils/no_copy.hpp"
+
+#include "LinearMath/btTransform.h"
+
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+/** \brief The recorded events of one ghost kart.
+ *  Events of a text replay are all kept in memory. Events of a binary
+ *  replay are decoded on demand: only a sliding window of chunks around
+ *  the current event is kept (the chunk before the current one, the
+ *  current one and CHUNKS_AHEAD chunks ahead of it), so the memory used
+ *  does not depend on the length of the race. Events outside of the window
+ *  can still be accessed (e.g. to compute the finish time of a ghost), in
+ *  which case the chunk containing them is decoded into a separate buffer.
+ *  The chunk index of the binary replay is used to find the event at a
+ *  certain time with a binary search.
+ *  Events are returned by value, since accessing an event outside of the
+ *  window can replace previously decoded data.
+ * \ingroup replay
+ */
+class ReplayStream : public NoCopy
+{
+public:
+    /** An opened binary replay file. It is shared by the streams of all
+     *  karts of that replay, and closed when the last stream is deleted. */
+    class File : public NoCopy
+    {
+    private:
+        FILE        *m_fd;
+        ReplayBinary m_replay;
+    public:
+                 File(FILE *fd) { m_fd = fd; }
+                ~File() { fclose(m_fd); }
+        // --------------------------------------------------------------------
+        /** Reads the header and chunk index of the replay file. */
+        bool     readHeader() { return m_replay.readHeader(m_fd); }
+        // --------------------------------------------------------------------
+        FILE    *getFD() const { return m_fd; }
+        // --------------------------------------------------------------------
+        const ReplayBinary& getReplay() const { return m_replay; }
+    };   // File
+
+private:
+    /** A consecutive range of decoded events. */
+    struct Events
+    {
+        /** Index of the first event stored. */
+        unsigned int                             m_start;
+        std::vector<ReplayBase::TransformEvent>  m_transforms;
+        std::vector<ReplayBase::PhysicInfo>      m_physic_info;
+        std::vector<ReplayBase::BonusInfo>       m_bonus_info;
+        std::vector<ReplayBase::KartReplayEvent> m_events;
+        // --------------------------------------------------------------------
+        Events() { m_start = 0; }
+        // --------------------------------------------------------------------
+        void clear(unsigned int start);
+        // --------------------------------------------------------------------
+        void eraseFront(unsigned int n);
+        // --------------------------------------------------------------------
+        unsigned int size() const
+                                { return (unsigned int)m_transforms.size(); }
+        // --------------------------------------------------------------------
+        bool contains(unsigned int i) const
+                               { return i >= m_start && i < m_start + size(); }
+    };   // Events
+
+    /** The replay file of a streamed kart, or NULL if all events are kept
+     *  in m_window (text replays). */
+    std::shared_ptr<File> m_file;
+
+    /** Index of this kart in the replay file. */
+    unsigned int m_kart;
+
+    /** Total number of events of this kart. Reduced if a chunk can't be
+     *  decoded. */
+    mutable unsigned int m_num_events;
+
+    /** Number of valid chunks in the chunk index of this kart. */
+    mutable unsigned int m_num_chunks;
+
+    /** The chunks currently in m_window are [m_first_chunk, m_end_chunk). */
+    unsigned int m_first_chunk;
+    unsigned int m_end_chunk;
+
+    /** The decoded events around the current event. */
+    Events m_window;
+
+    /** One decoded chunk outside of the window, for random access. */
+    mutable Events m_scratch;
+
+    /** Index of the chunk in m_scratch, or -1 if it is empty. */
+    mutable int m_scratch_chunk;
+
+    const ReplayBinary::KartInfo& getKartInfo() const
+             { return m_file->getReplay().getHeader().m_karts[m_kart]; }
+    unsigned int getChunkOfEvent(unsigned int i) const;
+    bool         readChunk(unsigned int chunk, Events *events) const;
+    const Events& locate(unsigned int *i) const;
+
+public:
+    /** Number of chunks decoded ahead of the chunk of the current event. */
+    static const unsigned int CHUNKS_AHEAD;
+
+                 ReplayStream();
+    void         init(std::shared_ptr<File> file, unsigned int kart);
+    void         addEvent(const ReplayBase::TransformEvent &t,
+                          const ReplayBase::PhysicInfo &pi,
+                          const ReplayBase::BonusInfo &bi,
+                          const ReplayBase::KartReplayEvent &kre);
+    void         update(unsigned int current_event);
+    unsigned int findEvent(float time) const;
+    unsigned int getNumLoadedEvents() const;
+    // ------------------------------------------------------------------------
+    /** Returns the total number of events of this kart. */
+    unsigned int getNumEvents() const { return m_num_events; }
+    // ------------------------------------------------------------------------
+    /** Returns true if the events are decoded from a binary replay file
+     *  on demand. */
+    bool         isStreaming() const { return m_file != NULL; }
+    // ------------------------------------------------------------------------
+    float        getTime(unsigned int i) const
+    {
+        const Events &e = locate(&i);
+        return e.m_transforms[i - e.m_start].m_time;
+    }   // getTime
+    // ------------------------------------------------------------------------
+    btTransform  getTransform(unsigned int i) const
+    {
+        const Events &e = locate(&i);
+        return e.m_transforms[i - e.m_start].m_transform;
+    }   // getTransform
+    // ------------------------------------------------------------------------
+    ReplayBase::PhysicInfo getPhysicInfo(unsigned int i) const
+    {
+        const Events &e = locate(&i);
+        return e.m_physic_info[i - e.m_start];
+    }   // getPhysicInfo
+    // ------------------------------------------------------------------------
+    ReplayBase::BonusInfo getBonusInfo(unsigned int i) const
+    {
+        const Events &e = locate(&i);
+        return e.m_bonus_info[i - e.m_start];
+    }   // getBonusInfo
+    // ------------------------------------------------------------------------
+    ReplayBase::KartReplayEvent getKartReplayEvent(unsigned int i) const
+    {
+        const Events &e = locate(&i);
+        return e.m_events[i - e.m_start];
+    }   // getKartReplayEvent
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // ReplayStream
+
+#endif
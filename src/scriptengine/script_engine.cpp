@@ -74,12 +74,18 @@ namespace Scripting
         // Configure the script engine with all the functions, 
         // and variables that the script should be able to use.
         configureEngine(m_engine);
+
+        for (unsigned int i = 0; i < CB_COUNT; i++)
+            m_callbacks[i] = NULL;
     }
 
     ScriptEngine::~ScriptEngine()
     {
         // Release the engine
         m_pending_timeouts.clearAndDeleteAll();
+        for (asIScriptContext *ctx : m_context_pool)
+            ctx->Release();
+        m_context_pool.clear();
         m_engine->DiscardModule(MODULE_ID_MAIN_SCRIPT_FILE);
         m_engine->Release();
     }
@@ -135,42 +141,12 @@ namespace Scripting
             return;
         }
 
-        asIScriptContext *ctx = m_engine->CreateContext();
-        if (ctx == NULL)
+        asIScriptContext *ctx = prepareContext(func);
+        if (ctx != NULL)
         {
-            Log::error("Scripting", "evalScript: Failed to create the context.");
-            //m_engine->Release();
-            return;
+            executeContext(ctx);
+            returnContext(ctx);
         }
-
-        r = ctx->Prepare(func);
-        if (r < 0)
-        {
-            Log::error("Scripting", "evalScript: Failed to prepare the context.");
-            ctx->Release();
-            return;
-        }
-
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-
-        ctx->Release();
         func->Release();
     }
 
@@ -178,45 +154,91 @@ namespace Scripting
 
     void ScriptEngine::runDelegate(asIScriptFunction* delegate)
     {
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = prepareContext(delegate);
         if (ctx == NULL)
-        {
-            Log::error("Scripting", "runMethod: Failed to create the context.");
-            //m_engine->Release();
             return;
+
+        executeContext(ctx);
+        returnContext(ctx);
+    }
+
+    //-----------------------------------------------------------------------------
+    /** Returns a context prepared to execute the specified function, or NULL
+     *  on error. The context is taken from the pool of unused contexts if
+     *  possible, and must be given back using returnContext.
+     *  \param func The function to execute.
+     */
+    asIScriptContext* ScriptEngine::prepareContext(asIScriptFunction *func)
+    {
+        asIScriptContext *ctx;
+        if (m_context_pool.empty())
+        {
+            // Create a context that will execute the script.
+            ctx = m_engine->CreateContext();
+            if (ctx == NULL)
+            {
+                Log::error("Scripting", "Failed to create the context.");
+                return NULL;
+            }
+        }
+        else
+        {
+            ctx = m_context_pool.back();
+            m_context_pool.pop_back();
         }
 
-        int r = ctx->Prepare(delegate);
+        // Prepare the script context with the function we wish to execute.
+        // Prepare() must be called on the context before each new script
+        // function that will be executed. Some initialisation is skipped if
+        // the context was prepared for the same function before.
+        int r = ctx->Prepare(func);
         if (r < 0)
         {
-            Log::error("Scripting", "runMethod: Failed to prepare the context.");
-            ctx->Release();
-            return;
+            Log::error("Scripting", "Failed to prepare the context.");
+            returnContext(ctx);
+            return NULL;
         }
+        return ctx;
+    }   // prepareContext
 
+    //-----------------------------------------------------------------------------
+    /** Executes the function a context was prepared for, and logs an error
+     *  if the execution did not finish.
+     *  \return True if the execution finished, i.e. a return value of the
+     *          function can be read from the context.
+     */
+    bool ScriptEngine::executeContext(asIScriptContext *ctx)
+    {
         // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
+        int r = ctx->Execute();
+        if (r == asEXECUTION_FINISHED)
+            return true;
+
+        // The execution didn't finish as we had planned. Determine why.
+        if (r == asEXECUTION_ABORTED)
         {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception : (line %i) %s",
-                    ctx->GetExceptionLineNumber(), 
-                    ctx->GetExceptionString());
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
+            Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
         }
+        else if (r == asEXECUTION_EXCEPTION)
+        {
+            Log::error("Scripting", "The script ended with an exception : (line %i) %s",
+                ctx->GetExceptionLineNumber(),
+                ctx->GetExceptionString());
+        }
+        else
+        {
+            Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
+        }
+        return false;
+    }   // executeContext
 
-        ctx->Release();
-    }
+    //-----------------------------------------------------------------------------
+    /** Puts a context which is not used anymore back into the pool.
+     */
+    void ScriptEngine::returnContext(asIScriptContext *ctx)
+    {
+        m_context_pool.push_back(ctx);
+    }   // returnContext
 
     //-----------------------------------------------------------------------------
     
@@ -290,20 +312,21 @@ namespace Scripting
 
     //-----------------------------------------------------------------------------
 
-    /** runs the specified script
-    *  \param string scriptName = name of script to run
+    /** Returns the script function with the specified declaration. The
+    *  result (also if the function does not exist) is cached, so that the
+    *  module is only searched once for each declaration.
+    *  \param declaration Declaration of the function, e.g. "void onStart()".
+    *  \param warn_if_not_found If the function does not exist, log a warning
+    *         (otherwise only a debug message is printed).
+    *  \return The function, or NULL if it does not exist.
     */
-    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
-        std::function<void(asIScriptContext*)> callback,
-        std::function<void(asIScriptContext*)> get_return_value)
+    asIScriptFunction* ScriptEngine::getFunction(const std::string &declaration,
+                                                 bool warn_if_not_found)
     {
-        int r; //int for error checking
-
         asIScriptFunction *func;
 
         // TODO: allow splitting in multiple files
-        std::string script_filename = "scripting.as";
-        auto cached_function = m_functions_cache.find(function_name);
+        auto cached_function = m_functions_cache.find(declaration);
         if (cached_function == m_functions_cache.end())
         {
             // Find the function for the function we want to execute.
@@ -314,63 +337,54 @@ namespace Scripting
             if (module == NULL)
             {
                 if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
+                    Log::warn("Scripting", "Scripting function was not found : %s (module not found)", declaration.c_str());
                 else
-                    Log::debug("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
+                    Log::debug("Scripting", "Scripting function was not found : %s (module not found)", declaration.c_str());
+                m_functions_cache[declaration] = NULL; // remember that this function is unavailable
+                return NULL;
             }
 
-            func = module->GetFunctionByDecl(function_name.c_str());
+            func = module->GetFunctionByDecl(declaration.c_str());
             
             if (func == NULL)
             {
                 if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
+                    Log::warn("Scripting", "Scripting function was not found : %s", declaration.c_str());
                 else
-                    Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
+                    Log::debug("Scripting", "Scripting function was not found : %s", declaration.c_str());
+                m_functions_cache[declaration] = NULL; // remember that this function is unavailable
+                return NULL;
             }
 
-            m_functions_cache[function_name] = func;
+            m_functions_cache[declaration] = func;
             func->AddRef();
         }
         else
         {
             // Script present in cache
             func = cached_function->second;
+            if (func == NULL && warn_if_not_found)
+                Log::warn("Scripting", "Scripting function was not found : %s", declaration.c_str());
         }
+        return func;
+    }   // getFunction
 
+    //-----------------------------------------------------------------------------
+
+    /** runs the specified script
+    *  \param string scriptName = name of script to run
+    */
+    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
+        std::function<void(asIScriptContext*)> callback,
+        std::function<void(asIScriptContext*)> get_return_value)
+    {
+        asIScriptFunction *func = getFunction(function_name, warn_if_not_found);
         if (func == NULL)
-        {
-            if (warn_if_not_found)
-                Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
             return; // function unavailable
-        }
 
-        // Create a context that will execute the script.
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = prepareContext(func);
         if (ctx == NULL)
-        {
-            Log::error("Scripting", "Failed to create the context.");
-            //m_engine->Release();
-            return;
-        }
-
-        // Prepare the script context with the function we wish to execute. Prepare()
-        // must be called on the context before each new script function that will be
-        // executed. Note, that if because we intend to execute the same function 
-        // several times, we will store the function returned by 
-        // GetFunctionByDecl(), so that this relatively slow call can be skipped.
-        r = ctx->Prepare(func);
-        if (r < 0)
-        {
-            Log::error("Scripting", "Failed to prepare the context.");
-            ctx->Release();
-            //m_engine->Release();
             return;
-        }
 
         // Here, we can pass parameters to the script functions. 
         //ctx->setArgType(index, value);
@@ -379,50 +393,27 @@ namespace Scripting
         if (callback)
             callback(ctx);
 
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-
-                // Write some information about the script exception
-                //asIScriptFunction *func = ctx->GetExceptionFunction();
-                //std::cout << "func: " << func->GetDeclaration() << std::endl;
-                //std::cout << "modl: " << func->GetModuleName() << std::endl;
-                //std::cout << "sect: " << func->GetScriptSectionName() << std::endl;
-                //std::cout << "line: " << ctx->GetExceptionLineNumber() << std::endl;
-                //std::cout << "desc: " << ctx->GetExceptionString() << std::endl;
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-        else
-        {
-            // Retrieve the return value from the context here (for scripts that return values)
-            // <type> returnValue = ctx->getReturnType(); for example
-            //float returnValue = ctx->GetReturnFloat();
-
-            if (get_return_value)
-                get_return_value(ctx);
-        }
+        // Retrieve the return value from the context here (for scripts that return values)
+        // <type> returnValue = ctx->getReturnType(); for example
+        //float returnValue = ctx->GetReturnFloat();
+        if (executeContext(ctx) && get_return_value)
+            get_return_value(ctx);
 
-        // We must release the contexts when no longer using them
-        ctx->Release();
+        returnContext(ctx);
     }
 
     //-----------------------------------------------------------------------------
 
     void ScriptEngine::cleanupCache()
     {
+        // The pending timeouts and the pooled contexts can reference
+        // functions of the module that is discarded.
+        m_pending_timeouts.clearAndDeleteAll();
+        for (asIScriptContext *ctx : m_context_pool)
+            ctx->Unprepare();
+        for (unsigned int i = 0; i < CB_COUNT; i++)
+            m_callbacks[i] = NULL;
+
         for (auto curr : m_functions_cache)
         {
             if (curr.second != NULL)
@@ -495,6 +486,9 @@ namespace Scripting
 
     bool ScriptEngine::compileLoadedScripts()
     {
+        for (unsigned int i = 0; i < CB_COUNT; i++)
+            m_callbacks[i] = NULL;
+
         int r;
         asIScriptModule *mod = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE, asGM_CREATE_IF_NOT_EXISTS);
 
@@ -519,14 +513,40 @@ namespace Scripting
         // scope, so function names, and global variables will not conflict with
         // each other.
 
+        // Look up the functions which are called very often only once. The
+        // order must match the Callback enum.
+        static const char* CALLBACK_DECLARATIONS[CB_COUNT] =
+        {
+            "void onKartKartCollision(int, int)"
+        };
+        for (unsigned int i = 0; i < CB_COUNT; i++)
+        {
+            m_callbacks[i] = getFunction(CALLBACK_DECLARATIONS[i],
+                                         /*warn_if_not_found*/false);
+        }
+
         return true;
     }
 
     //-----------------------------------------------------------------------------
 
+    /** Creates a timeout which calls the script function with the specified
+     *  name. The function is looked up now, not when the timeout expires.
+     */
+    PendingTimeout::PendingTimeout(double time, const std::string& callback_name)
+    {
+        m_time = time;
+        m_callback_delegate = NULL;
+        m_callback_function = ScriptEngine::getInstance()
+                            ->getFunction("void " + callback_name + "()", true);
+    }
+
+    //-----------------------------------------------------------------------------
+
     PendingTimeout::PendingTimeout(double time, asIScriptFunction* callback_delegate) 
     {
         m_time = time;
+        m_callback_function = NULL;
         m_callback_delegate = callback_delegate;
         
         #if ANGELSCRIPT_VERSION < 23300
@@ -575,9 +595,9 @@ namespace Scripting
                 {
                     runDelegate(curr.m_callback_delegate);
                 }
-                else
+                else if (curr.m_callback_function != NULL)
                 {
-                    runFunction(true, "void " + curr.m_callback_name + "()");
+                    runDelegate(curr.m_callback_function);
                 }
 
                 m_pending_timeouts.erase(i);
@@ -28,6 +28,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <vector>
 
 class TrackObjectPresentation;
 
@@ -38,18 +39,15 @@ namespace Scripting
     {
         double m_time;
 
-        /** We have two callback types: a string containing the name of the function
-          * to call (simple callback) or a "TimeoutBase" object (advanced callback)
+        /** We have two callback types: a function looked up by its name
+          * (simple callback) or a "TimeoutBase" object (advanced callback).
+          * The function of a simple callback is owned by the function cache
+          * of the script engine, the delegate by this object.
           */
-        std::string m_callback_name;
+        asIScriptFunction* m_callback_function;
         asIScriptFunction* m_callback_delegate;
 
-        PendingTimeout(double time, const std::string& callback_name)
-        {
-            m_callback_delegate = NULL;
-            m_time = time;
-            m_callback_name = callback_name;
-        }
+        PendingTimeout(double time, const std::string& callback_name);
 
         PendingTimeout(double time, asIScriptFunction* callback_delegate);
 
@@ -65,7 +63,14 @@ namespace Scripting
         friend class AbstractSingleton<ScriptEngine>;
 
     public:
-
+        /** Script functions which are called very often (e.g. for each
+         *  collision). They are looked up once after the scripts of a track
+         *  are compiled, see getCallback. */
+        enum Callback
+        {
+            CB_KART_KART_COLLISION,
+            CB_COUNT
+        };
 
         void runFunction(bool warn_if_not_found, std::string function_name);
         void runFunction(bool warn_if_not_found, std::string function_name,
@@ -74,6 +79,8 @@ namespace Scripting
             std::function<void(asIScriptContext*)> callback,
             std::function<void(asIScriptContext*)> get_return_value);
         void runDelegate(asIScriptFunction* delegate_fn);
+        asIScriptFunction* getFunction(const std::string &declaration,
+                                       bool warn_if_not_found);
         void evalScript(std::string script_fragment);
         void cleanupCache();
 
@@ -86,12 +93,51 @@ namespace Scripting
 
         asIScriptEngine* getEngine() { return m_engine; }
 
+        // --------------------------------------------------------------------
+        /** Returns the script function for the specified callback, or NULL
+         *  if the script of the current track does not define it. */
+        asIScriptFunction* getCallback(Callback callback) const
+        {
+            return m_callbacks[callback];
+        }   // getCallback
+
+        // --------------------------------------------------------------------
+        /** Runs the script function func, which can be NULL (e.g. if a
+         *  callback is not defined) in which case nothing is done. Unlike
+         *  runFunction this does not need to look up the function, and the
+         *  arguments are set without creating std::function objects.
+         *  \param set_args Called with the prepared context to set the
+         *         arguments of the function.
+         */
+        template<typename F>
+        void runCallback(asIScriptFunction *func, const F &set_args)
+        {
+            if (func == NULL)
+                return;
+            asIScriptContext *ctx = prepareContext(func);
+            if (ctx == NULL)
+                return;
+            set_args(ctx);
+            executeContext(ctx);
+            returnContext(ctx);
+        }   // runCallback
+
     private:
         asIScriptEngine *m_engine;
         std::map<std::string, asIScriptFunction*> m_functions_cache;
         PtrVector<PendingTimeout> m_pending_timeouts;
 
+        /** The functions of all callbacks, NULL if not defined. */
+        asIScriptFunction* m_callbacks[CB_COUNT];
+
+        /** Contexts which are not in use at the moment. Creating a context
+         *  is expensive, so they are reused for all function calls. */
+        std::vector<asIScriptContext*> m_context_pool;
+
         void configureEngine(asIScriptEngine *engine);
+        asIScriptContext* prepareContext(asIScriptFunction *func);
+        bool executeContext(asIScriptContext *ctx);
+        void returnContext(asIScriptContext *ctx);
     };   // class ScriptEngine
 
 }
@@ -68,8 +68,10 @@ void GhostReplaySelection::unloaded()
  */
 void GhostReplaySelection::refresh(bool forced_update, bool update_columns)
 {
+    // The replay directories are scanned in the background, the list is
+    // updated again in onUpdate once the scan is done.
     if (ReplayPlay::get()->getNumReplayFile() == 0 || forced_update)
-        ReplayPlay::get()->loadAllReplayFile();
+        ReplayPlay::get()->startLoadingReplayFiles();
     defaultSort();
     loadList();
 
@@ -85,6 +87,20 @@ void GhostReplaySelection::refresh(bool forced_update, bool update_columns)
     }
 }   // refresh
 
+// ----------------------------------------------------------------------------
+/** Updates the replay list when the background scan of the replay files
+ *  started in refresh is done.
+ */
+void GhostReplaySelection::onUpdate(float dt)
+{
+    if (ReplayPlay::get()->isLoadingReplayFiles() &&
+        ReplayPlay::get()->finishLoadingReplayFiles())
+    {
+        defaultSort();
+        loadList();
+    }
+}   // onUpdate
+
 // ----------------------------------------------------------------------------
 /** Set pointers to the various widgets.
  */
@@ -109,6 +109,8 @@ public:
     
     virtual void unloaded() OVERRIDE;
 
+    virtual void onUpdate(float dt) OVERRIDE;
+
     virtual bool onEscapePressed() OVERRIDE;
 
     /** \brief Implement IConfirmDialogListener callback */
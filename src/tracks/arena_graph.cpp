@@ -26,24 +26,42 @@
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <queue>
 
 // -----------------------------------------------------------------------------
-ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
+/** Loads the navmesh and computes (or loads) the shortest paths.
+ *  \param navmesh Name of the navmesh file.
+ *  \param node XML node of the track scene, used to load soccer goals.
+ *  \param cache Name of the file to cache the shortest paths in, by default
+ *         the navmesh name with the extension .cache.
+ */
+ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node,
+                       const std::string &cache)
           : Graph()
 {
     loadNavmesh(navmesh);
     buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+    // Compute shortest distance from all nodes, or load them from the cache
+    // (the cache is only used if the navmesh is the same)
+    const std::string cache_file = cache.empty()
+        ? StringUtils::removeExtension(navmesh) + ".cache" : cache;
+    if (!loadCache(cache_file))
+    {
+        computeAllShortestPaths();
+        saveCache(cache_file);
+    }
 
     setNearbyNodesOfAllNodes();
     if (node && race_manager->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
         loadGoalNodes(node);
 
+    buildSpatialIndex();
     loadBoundingBoxNodes();
 
 }   // ArenaGraph
@@ -179,36 +197,177 @@ void ArenaGraph::buildGraph()
 {
     const unsigned int n_nodes = getNumNodes();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
+    m_distance_matrix.assign(n_nodes * n_nodes, 9999.9f);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         ArenaNode* cur_node = getNode(i);
         for (const int& adjacent : cur_node->getAdjacentNodes())
-        {
-            Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
-            float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
-        }
-        m_distance_matrix[i][i] = 0.0f;
+            m_distance_matrix[getIndex(i, adjacent)] =
+                getAdjacentDistance(i, adjacent);
+        m_distance_matrix[getIndex(i, i)] = 0.0f;
     }
 
     // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
+    m_parent_node.assign(n_nodes * n_nodes, Graph::UNKNOWN_SECTOR);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            if (i == j || m_distance_matrix[getIndex(i, j)] >= 9899.9f)
+                m_parent_node[getIndex(i, j)] = -1;
             else
-                m_parent_node[i][j] = i;
+                m_parent_node[getIndex(i, j)] = i;
         }   // for j
     }   // for i
 
 }   // buildGraph
 
+// ----------------------------------------------------------------------------
+/** Returns the distance between the centers of two adjacent nodes. */
+float ArenaGraph::getAdjacentDistance(int from, int to) const
+{
+    Vec3 diff = getNode(to)->getCenter() - getNode(from)->getCenter();
+    return diff.length();
+}   // getAdjacentDistance
+
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths from all nodes with computeDijkstra. Each
+ *  source node only changes its own row of the matrices, so the nodes are
+ *  computed in parallel.
+ */
+void ArenaGraph::computeAllShortestPaths()
+{
+    WorkerPool workers(WorkerPool::getDefaultThreads(/*max_threads*/7),
+                       "ArenaGraph");
+    workers.parallelFor(getNumNodes(),
+                        [this](unsigned int i) { computeDijkstra(i); });
+}   // computeAllShortestPaths
+
+// ----------------------------------------------------------------------------
+/** Returns a hash of all data the shortest paths are computed from (the
+ *  number of nodes, their centers and adjacent nodes), used to check if a
+ *  cache file belongs to this navmesh.
+ */
+uint64_t ArenaGraph::getCacheKey() const
+{
+    // FNV-1a hash
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](const void *data, size_t size)
+    {
+        const uint8_t *bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    const uint32_t n = getNumNodes();
+    add(&n, sizeof(n));
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const Vec3 &center = getNode(i)->getCenter();
+        const float xyz[3] = { center.getX(), center.getY(), center.getZ() };
+        add(xyz, sizeof(xyz));
+        const std::vector<int> &adjacent = getNode(i)->getAdjacentNodes();
+        const uint32_t count = (uint32_t)adjacent.size();
+        add(&count, sizeof(count));
+        if (count > 0)
+            add(adjacent.data(), count * sizeof(int));
+    }
+    return hash;
+}   // getCacheKey
+
+// ----------------------------------------------------------------------------
+/** The header of a cache file. The matrices are stored after it in the
+ *  byte order of the machine which wrote it, so a cache with a different
+ *  byte order is ignored. */
+struct ArenaGraphCacheHeader
+{
+    char     m_magic[8];
+    uint32_t m_byte_order;
+    uint32_t m_num_nodes;
+    uint64_t m_key;
+};   // ArenaGraphCacheHeader
+
+static const char ARENA_GRAPH_CACHE_MAGIC[8] = "STKNAV2";
+
+// ----------------------------------------------------------------------------
+/** Loads the shortest paths from a cache file written by saveCache.
+ *  \return False if the file does not exist, is not for this navmesh or
+ *          contains invalid parent nodes.
+ */
+bool ArenaGraph::loadCache(const std::string &filename)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if (!fd)
+        return false;
+    const unsigned int n = getNumNodes();
+    ArenaGraphCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fd) == 1 &&
+              memcmp(header.m_magic, ARENA_GRAPH_CACHE_MAGIC, 8) == 0 &&
+              header.m_byte_order == 0x01020304 &&
+              header.m_num_nodes == n && header.m_key == getCacheKey();
+    if (ok)
+    {
+        std::vector<float> distance_matrix(n * n);
+        std::vector<int16_t> parent_node(n * n);
+        ok = fread(distance_matrix.data(), sizeof(float), n * n, fd) == n * n &&
+             fread(parent_node.data(), sizeof(int16_t), n * n, fd) == n * n;
+        // Parent nodes are used as indices, so a corrupt cache must not
+        // be used (-1 means there is no path)
+        for (unsigned int i = 0; ok && i < n * n; i++)
+            ok = parent_node[i] >= -1 && parent_node[i] < (int)n;
+        if (ok)
+        {
+            m_distance_matrix.swap(distance_matrix);
+            m_parent_node.swap(parent_node);
+        }
+    }
+    fclose(fd);
+    if (ok)
+        Log::info("ArenaGraph", "Loaded shortest paths from '%s'.",
+                  filename.c_str());
+    else
+        Log::warn("ArenaGraph", "Ignoring outdated or invalid cache '%s'.",
+                  filename.c_str());
+    return ok;
+}   // loadCache
+
+// ----------------------------------------------------------------------------
+/** Saves the shortest paths next to the navmesh, so they don't need to be
+ *  computed again next time. The file is first written under a temporary
+ *  name and then renamed, so that a concurrently loading process never sees
+ *  a partially written file. It is not an error if the file can't be
+ *  written (e.g. the track is installed in a read-only directory).
+ */
+void ArenaGraph::saveCache(const std::string &filename) const
+{
+    const std::string tmp_name = FileManager::getTempName(filename);
+    FILE *fd = fopen(tmp_name.c_str(), "wb");
+    if (!fd)
+    {
+        Log::debug("ArenaGraph", "Can't write cache '%s'.", filename.c_str());
+        return;
+    }
+    ArenaGraphCacheHeader header;
+    memcpy(header.m_magic, ARENA_GRAPH_CACHE_MAGIC, 8);
+    header.m_byte_order = 0x01020304;
+    header.m_num_nodes  = getNumNodes();
+    header.m_key        = getCacheKey();
+    bool ok = fwrite(&header, sizeof(header), 1, fd) == 1 &&
+              fwrite(m_distance_matrix.data(), sizeof(float),
+                     m_distance_matrix.size(), fd) ==
+                  m_distance_matrix.size() &&
+              fwrite(m_parent_node.data(), sizeof(int16_t),
+                     m_parent_node.size(), fd) == m_parent_node.size();
+    ok = fclose(fd) == 0 && ok;
+
+    if (ok && FileManager::replaceFile(tmp_name, filename))
+        return;
+    remove(tmp_name.c_str());
+    Log::warn("ArenaGraph", "Error writing cache '%s'.", filename.c_str());
+}   // saveCache
+
 // ----------------------------------------------------------------------------
 /** Dijkstra shortest path computation. It computes the shortest distance from
  *  the specified node 'source' to all other nodes. At the end of the
@@ -216,6 +375,12 @@ void ArenaGraph::buildGraph()
  *  source to j and m_parent_node[source][j] stores the last vertex visited on
  *  the shortest path from i to j before visiting j. Suppose the shortest path
  *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  Only the row of 'source' is accessed in the matrices, so this can be
+ *  called for different nodes at the same time. The length of an edge is
+ *  the distance between the centers of its nodes. (Previously it was read
+ *  from the row of the current node, which for nodes computed earlier held
+ *  the shortest distance instead. The distances are the same, but the
+ *  parent nodes and rounding can differ, so the cache version was changed.)
  */
 void ArenaGraph::computeDijkstra(int source)
 {
@@ -252,11 +417,11 @@ void ArenaGraph::computeDijkstra(int source)
             if (visited[adjacent]) continue;
 
             float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+                current.second + getAdjacentDistance(cur_index, adjacent);
+            if (new_dist < m_distance_matrix[getIndex(source, adjacent)])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                m_distance_matrix[getIndex(source, adjacent)] = new_dist;
+                m_parent_node[getIndex(source, adjacent)] = cur_index;
             }
             IndDistPair pair(adjacent, new_dist);
             queue.push(pair);
@@ -284,12 +449,13 @@ void ArenaGraph::computeFloydWarshall()
         {
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                float dist = m_distance_matrix[getIndex(i, k)] +
+                             m_distance_matrix[getIndex(k, j)];
+                if (dist < m_distance_matrix[getIndex(i, j)])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    m_distance_matrix[getIndex(i, j)] = dist;
+                    m_parent_node[getIndex(i, j)] =
+                        m_parent_node[getIndex(k, j)];
                 }
             }
         }
@@ -341,7 +507,8 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        std::vector<float> dist(m_distance_matrix.begin() + getIndex(i, 0),
+            m_distance_matrix.begin() + getIndex(i, 0) + getNumNodes());
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -363,13 +530,13 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
  *  std::vector (in reverse order). Used only for unit testing.
  */
 std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+                                  const std::vector<int16_t>& parent_node) const
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = parent_node[getIndex(from, to)];
         path.push_back(to);
     }
     return path;
@@ -387,14 +554,44 @@ void ArenaGraph::unitTesting()
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
+    // Use a temporary cache, the first graph computes and saves the
+    // results, the second one loads them
+    const std::string cache = file_manager->getTempFile("arena-graph.cache");
+    remove(cache.c_str());
+    delete new ArenaGraph(navmesh_file_name, NULL, cache);
+    ArenaGraph* ag = new ArenaGraph(navmesh_file_name, NULL, cache);
+    std::vector<float> cached_distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> cached_parent_node = ag->m_parent_node;
+    int error_count = 0;
+
+    // A cache with an invalid parent node must not be loaded
+    std::vector<int16_t> invalid_parent_node = cached_parent_node;
+    invalid_parent_node.back() = (int16_t)ag->getNumNodes();
+    ag->m_parent_node.swap(invalid_parent_node);
+    ag->saveCache(cache);
+    ag->m_parent_node.swap(invalid_parent_node);
+    if (ag->loadCache(cache))
+    {
+        Log::error("ArenaGraph", "Invalid cache was loaded.");
+        error_count++;
+    }
+    remove(cache.c_str());
+
+    ag->buildGraph();
     double s = StkTime::getRealTime();
-    ArenaGraph* ag = new ArenaGraph(navmesh_file_name);
+    ag->computeAllShortestPaths();
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
 
     // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
+    std::vector<float> distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> parent_node = ag->m_parent_node;
+    if (cached_distance_matrix != distance_matrix ||
+        cached_parent_node != parent_node)
+    {
+        Log::error("ArenaGraph", "Cached results are different.");
+        error_count++;
+    }
     ag->buildGraph();
 
     // Now compute results with Floyd-Warshall
@@ -403,16 +600,17 @@ void ArenaGraph::unitTesting()
     e = StkTime::getRealTime();
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
-    int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    const unsigned int n = ag->getNumNodes();
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            const unsigned int ij = ag->getIndex(i, j);
+            if(ag->m_distance_matrix[ij] - distance_matrix[ij] > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, distance_matrix[ij], ag->m_distance_matrix[ij]);
                 error_count++;
             }    // if distance is too different
 
@@ -424,16 +622,16 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(ag->m_parent_node[ij] != parent_node[ij])
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path = ag->getPathFromTo(i, j, parent_node);
+                std::vector<int16_t> floyd_path = ag->getPathFromTo(i, j, ag->m_parent_node);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, parent_node[ij], ag->m_parent_node[ij]);
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
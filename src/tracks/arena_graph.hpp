@@ -34,11 +34,13 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
+    /** The actual graph data structure, it is an adjacency matrix (which
+     *  then stores the shortest distance between all nodes). Both matrices
+     *  are stored row by row in one block, see getIndex(). */
+    std::vector<float> m_distance_matrix;
 
     /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    std::vector<int16_t> m_parent_node;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -56,10 +58,27 @@ private:
     // ------------------------------------------------------------------------
     void computeDijkstra(int n);
     // ------------------------------------------------------------------------
+    void computeAllShortestPaths();
+    // ------------------------------------------------------------------------
     void computeFloydWarshall();
     // ------------------------------------------------------------------------
-    static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+    uint64_t getCacheKey() const;
+    // ------------------------------------------------------------------------
+    bool loadCache(const std::string &filename);
+    // ------------------------------------------------------------------------
+    void saveCache(const std::string &filename) const;
+    // ------------------------------------------------------------------------
+    /** Returns the index of the entry for the path from 'from' to 'to' in
+     *  the distance and parent node matrix. */
+    unsigned int getIndex(int from, int to) const
+    {
+        return from * (unsigned int)m_all_nodes.size() + to;
+    }   // getIndex
+    // ------------------------------------------------------------------------
+    float getAdjacentDistance(int from, int to) const;
+    // ------------------------------------------------------------------------
+    std::vector<int16_t> getPathFromTo(int from, int to,
+                                  const std::vector<int16_t>& parent_node) const;
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
@@ -70,7 +89,8 @@ public:
     // ------------------------------------------------------------------------
     static void unitTesting();
     // ------------------------------------------------------------------------
-    ArenaGraph(const std::string &navmesh, const XMLNode *node = NULL);
+    ArenaGraph(const std::string &navmesh, const XMLNode *node = NULL,
+               const std::string &cache = "");
     // ------------------------------------------------------------------------
     virtual ~ArenaGraph() {}
     // ------------------------------------------------------------------------
@@ -84,7 +104,7 @@ public:
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return (int)(m_parent_node[getIndex(j, i)]);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -92,7 +112,7 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        return m_distance_matrix[getIndex(from, to)];
     }
 
 };   // ArenaGraph
@@ -40,6 +40,11 @@ public:
         return BoundingBox3D::pointInside(p);
     }
     // ------------------------------------------------------------------------
+    virtual void getBoundingBox(Vec3 *min, Vec3 *max) const OVERRIDE
+    {
+        BoundingBox3D::getBoundingBox(min, max);
+    }
+    // ------------------------------------------------------------------------
     virtual bool is3DQuad() const OVERRIDE                     { return true; }
 
 };
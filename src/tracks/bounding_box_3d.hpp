@@ -78,6 +78,19 @@ public:
         }
         return true;
     }
+    // ------------------------------------------------------------------------
+    /** Returns the axis aligned bounding box of this box. The faces 0 and 2
+     *  contain all 8 corners. */
+    void getBoundingBox(Vec3 *min, Vec3 *max) const
+    {
+        *min = m_box_faces[0][0];
+        *max = m_box_faces[0][0];
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            min->min(m_box_faces[0][i]); max->max(m_box_faces[0][i]);
+            min->min(m_box_faces[2][i]); max->max(m_box_faces[2][i]);
+        }
+    }   // getBoundingBox
 
 };
 
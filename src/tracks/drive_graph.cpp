@@ -259,6 +259,7 @@ void DriveGraph::load(const std::string &quad_file_name,
             m_lap_length = l;
     }
 
+    buildSpatialIndex();
     loadBoundingBoxNodes();
 
 }   // load
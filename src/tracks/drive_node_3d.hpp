@@ -48,6 +48,11 @@ public:
         return BoundingBox3D::pointInside(p);
     }
     // ------------------------------------------------------------------------
+    virtual void getBoundingBox(Vec3 *min, Vec3 *max) const OVERRIDE
+    {
+        BoundingBox3D::getBoundingBox(min, max);
+    }
+    // ------------------------------------------------------------------------
     virtual void getDistances(const Vec3 &xyz, Vec3 *result) const OVERRIDE;
     // ------------------------------------------------------------------------
     virtual float getDistance2FromPoint(const Vec3 &xyz) const OVERRIDE;
@@ -25,14 +25,21 @@
 #include "graphics/material_manager.hpp"
 #include "graphics/sp/sp_mesh.hpp"
 #include "graphics/sp/sp_mesh_buffer.hpp"
+#include "io/file_manager.hpp"
 #include "modes/profile_world.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/arena_graph.hpp"
 #include "tracks/arena_node_3d.hpp"
+#include "tracks/drive_graph.hpp"
 #include "tracks/drive_node_2d.hpp"
 #include "tracks/drive_node_3d.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
 
+#include <algorithm>
+#include <cstdio>
+
 const int Graph::UNKNOWN_SECTOR = -1;
 const float Graph::MIN_HEIGHT_TESTING = -1.0f;
 const float Graph::MAX_HEIGHT_TESTING = 5.0f;
@@ -48,6 +55,11 @@ Graph::Graph()
     m_bb_min      = Vec3( 99999,  99999,  99999);
     m_bb_max      = Vec3(-99999, -99999, -99999);
     memset(m_bb_nodes, 0, 4 * sizeof(int));
+    m_grid_min_x     = 0;
+    m_grid_min_z     = 0;
+    m_grid_cell_size = 1.0f;
+    m_grid_size_x    = 0;
+    m_grid_size_z    = 0;
 }  // Graph
 
 // -----------------------------------------------------------------------------
@@ -615,6 +627,14 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
         return;
     }   // if still on same quad
 
+    // Without a list of sectors only the quads close to xyz can contain it
+    if (!all_sectors && !m_grid_cells.empty())
+    {
+        int start = *sector + 1 < (int)m_all_nodes.size() ? *sector + 1 : 0;
+        *sector = findRoadSectorInGrid(xyz, start, ignore_vertical);
+        return;
+    }
+
     // Now we search through all quads, starting with
     // the current one
     int indx       = *sector;
@@ -681,6 +701,29 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
                                std::vector<int> *all_sectors,
                                bool ignore_vertical) const
 {
+    if (!all_sectors && !m_grid_cells.empty())
+    {
+        // Same order of quads as used below (which matters if two quads
+        // have the same distance): starting 9 quads before the current one,
+        // or with quad 1 if the current quad is not known.
+        const int n = (int)getNumNodes();
+        const int start = curr_sector != UNKNOWN_SECTOR
+                        ? ((curr_sector - 9) % n + n) % n
+                        : 1 % n;
+        int sector = findClosestSectorInGrid(xyz, start,
+                                             /*test_height*/true,
+                                             ignore_vertical);
+        if (sector == UNKNOWN_SECTOR)
+        {
+            sector = findClosestSectorInGrid(xyz, start,
+                                             /*test_height*/false,
+                                             ignore_vertical);
+        }
+        if (sector == UNKNOWN_SECTOR)
+            Log::info("Graph", "unknown sector found.");
+        return sector;
+    }
+
     int count = (all_sectors!=NULL) ? (int)all_sectors->size() : getNumNodes();
     int current_sector = 0;
     if(curr_sector != UNKNOWN_SECTOR && !all_sectors)
@@ -774,3 +817,355 @@ void Graph::loadBoundingBoxNodes()
     m_bb_nodes[3] = findOutOfRoadSector(Vec3(m_bb_max.x(), 0, m_bb_max.z()),
         -1/*curr_sector*/, NULL/*all_sectors*/, true/*ignore_vertical*/);
 }   // loadBoundingBoxNodes
+
+//-----------------------------------------------------------------------------
+/** Builds the uniform grid used by findRoadSector and findOutOfRoadSector to
+ *  test only the quads close to a point. Each quad is stored in all cells
+ *  which overlap its bounding box. Must be called after all quads are
+ *  created.
+ */
+void Graph::buildSpatialIndex()
+{
+    m_grid_cells.clear();
+    m_grid_quads.clear();
+    const unsigned int n = getNumNodes();
+    if (n == 0)
+        return;
+
+    // Enlarge the boxes a bit, so that rounding errors in pointInside can't
+    // accept a point outside of the box of a quad.
+    const float margin = 0.01f;
+    std::vector<Vec3> quad_min(n), quad_max(n);
+    Vec3 grid_min, grid_max;
+    float average_size = 0.0f;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        m_all_nodes[i]->getBoundingBox(&quad_min[i], &quad_max[i]);
+        quad_min[i] -= Vec3(margin, margin, margin);
+        quad_max[i] += Vec3(margin, margin, margin);
+        if (i == 0)
+        {
+            grid_min = quad_min[i];
+            grid_max = quad_max[i];
+        }
+        grid_min.min(quad_min[i]);
+        grid_max.max(quad_max[i]);
+        average_size += std::max(quad_max[i].getX() - quad_min[i].getX(),
+                                 quad_max[i].getZ() - quad_min[i].getZ());
+    }
+
+    // Use cells of about the size of a quad, but limit the number of cells
+    // for tracks with a few very distant quads.
+    m_grid_cell_size = std::max(average_size / n, 1.0f);
+    m_grid_min_x     = grid_min.getX();
+    m_grid_min_z     = grid_min.getZ();
+    while (true)
+    {
+        m_grid_size_x = getGridCell(grid_max.getX(), m_grid_min_x) + 1;
+        m_grid_size_z = getGridCell(grid_max.getZ(), m_grid_min_z) + 1;
+        if (m_grid_size_x * m_grid_size_z <= 16 * (int)n + 64)
+            break;
+        m_grid_cell_size *= 2.0f;
+    }
+
+    // First count the quads of each cell, then store the quads
+    const unsigned int num_cells = m_grid_size_x * m_grid_size_z;
+    m_grid_cells.resize(num_cells + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<unsigned int> next(m_grid_cells.begin(),
+                                       m_grid_cells.end() - 1);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const int x0 = getGridCell(quad_min[i].getX(), m_grid_min_x);
+            const int x1 = getGridCell(quad_max[i].getX(), m_grid_min_x);
+            const int z0 = getGridCell(quad_min[i].getZ(), m_grid_min_z);
+            const int z1 = getGridCell(quad_max[i].getZ(), m_grid_min_z);
+            for (int z = z0; z <= z1; z++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    const unsigned int cell = z * m_grid_size_x + x;
+                    if (pass == 0)
+                        m_grid_cells[cell + 1]++;
+                    else
+                        m_grid_quads[next[cell]++] = i;
+                }
+            }
+        }   // for i < n
+        if (pass == 0)
+        {
+            for (unsigned int cell = 0; cell < num_cells; cell++)
+                m_grid_cells[cell + 1] += m_grid_cells[cell];
+            m_grid_quads.resize(m_grid_cells[num_cells]);
+        }
+    }   // for pass
+
+    Log::debug("Graph", "Spatial index with %dx%d cells of size %f for "
+               "%d quads, %d entries.", m_grid_size_x, m_grid_size_z,
+               m_grid_cell_size, n, (int)m_grid_quads.size());
+}   // buildSpatialIndex
+
+//-----------------------------------------------------------------------------
+/** Returns the quad which contains xyz using the spatial index. If several
+ *  quads contain xyz, the same quad as in the linear search of
+ *  findRoadSector is returned, i.e. the first one starting with quad start.
+ *  \param xyz The point to test.
+ *  \param start Index of the quad the linear search would test first.
+ *  \param ignore_vertical If the height of xyz is ignored in 2d quads.
+ */
+int Graph::findRoadSectorInGrid(const Vec3& xyz, int start,
+                                bool ignore_vertical) const
+{
+    const int x = getGridCell(xyz.getX(), m_grid_min_x);
+    const int z = getGridCell(xyz.getZ(), m_grid_min_z);
+    if (x < 0 || x >= m_grid_size_x || z < 0 || z >= m_grid_size_z)
+        return UNKNOWN_SECTOR;
+
+    const int n = (int)m_all_nodes.size();
+    const unsigned int cell = z * m_grid_size_x + x;
+    int sector = UNKNOWN_SECTOR;
+    int sector_order = n;
+    for (unsigned int i = m_grid_cells[cell]; i < m_grid_cells[cell + 1]; i++)
+    {
+        const int indx = m_grid_quads[i];
+        // Position of this quad in the order of the linear search
+        const int order = indx >= start ? indx - start : indx - start + n;
+        if (order < sector_order &&
+            m_all_nodes[indx]->pointInside(xyz, ignore_vertical))
+        {
+            sector = indx;
+            sector_order = order;
+        }
+    }
+    return sector;
+}   // findRoadSectorInGrid
+
+//-----------------------------------------------------------------------------
+/** Returns the quad with the smallest distance to xyz using the spatial
+ *  index. This gives the same result as one phase of the linear search in
+ *  findOutOfRoadSector: the cells are searched in rings around the cell of
+ *  xyz, until all quads which are not tested yet are further away than the
+ *  closest quad found. Quads with the same distance are ordered as in the
+ *  linear search.
+ *  \param xyz The point to test.
+ *  \param start Index of the quad the linear search would test first.
+ *  \param test_height Only accept 2d quads if xyz is close to their height.
+ *  \param ignore_vertical Accept all quads independent of test_height.
+ */
+int Graph::findClosestSectorInGrid(const Vec3& xyz, int start,
+                                   bool test_height,
+                                   bool ignore_vertical) const
+{
+    const int n = (int)m_all_nodes.size();
+    // Avoid overflows for points extremely far away, they will still find
+    // the right quads (just more slowly).
+    const float limit = 1000000.0f * m_grid_cell_size;
+    const int cx = getGridCell(btClamped(xyz.getX(), -limit, limit),
+                               m_grid_min_x);
+    const int cz = getGridCell(btClamped(xyz.getZ(), -limit, limit),
+                               m_grid_min_z);
+    // The rings of cells which overlap the grid
+    const int min_ring = std::max(std::max(0, std::max(-cx, -cz)),
+                                  std::max(cx - m_grid_size_x + 1,
+                                           cz - m_grid_size_z + 1));
+    const int max_ring = std::max(std::max(cx, m_grid_size_x - 1 - cx),
+                                  std::max(cz, m_grid_size_z - 1 - cz));
+
+    int   min_sector = UNKNOWN_SECTOR;
+    int   min_order  = n;
+    float min_dist_2 = 999999.0f*999999.0f;
+
+    auto test_cell = [&](int x, int z)
+    {
+        if (x < 0 || x >= m_grid_size_x || z < 0 || z >= m_grid_size_z)
+            return;
+        const unsigned int cell = z * m_grid_size_x + x;
+        for (unsigned int i = m_grid_cells[cell];
+             i < m_grid_cells[cell + 1]; i++)
+        {
+            const int indx = m_grid_quads[i];
+            const Quad* q = m_all_nodes[indx];
+            if (q->isIgnored())
+                continue;
+            const float dist_2 = q->getDistance2FromPoint(xyz);
+            const int order = indx >= start ? indx - start : indx - start + n;
+            if (dist_2 < min_dist_2 ||
+                (dist_2 == min_dist_2 && min_sector != UNKNOWN_SECTOR &&
+                 order < min_order))
+            {
+                // See findOutOfRoadSector for the height test
+                float dist = xyz.getY() - q->getMinHeight();
+                if (test_height && !(dist < 5.0f && dist > -1.0f) &&
+                    !q->is3DQuad() && !ignore_vertical)
+                    continue;
+                min_dist_2 = dist_2;
+                min_sector = indx;
+                min_order  = order;
+            }
+        }
+    };   // test_cell
+
+    for (int ring = min_ring; ring <= max_ring; ring++)
+    {
+        // All quads not tested yet are in this or later rings, so at least
+        // (ring-1) cells away (a bit less to allow for rounding errors),
+        // since getDistance2FromPoint measures the distance to a line
+        // inside of the bounding box of a quad.
+        if (ring > 0 && min_sector != UNKNOWN_SECTOR)
+        {
+            const float min_dist = (ring - 1) * m_grid_cell_size * 0.99f;
+            if (min_dist * min_dist > min_dist_2)
+                break;
+        }
+        for (int z = cz - ring; z <= cz + ring; z++)
+        {
+            if (z < 0 || z >= m_grid_size_z)
+                continue;
+            if (z == cz - ring || z == cz + ring)
+            {
+                for (int x = cx - ring; x <= cx + ring; x++)
+                    test_cell(x, z);
+            }
+            else
+            {
+                test_cell(cx - ring, z);
+                test_cell(cx + ring, z);
+            }
+        }
+    }   // for ring
+
+    return min_sector;
+}   // findClosestSectorInGrid
+
+//-----------------------------------------------------------------------------
+/** Compares the results of findRoadSector and findOutOfRoadSector using the
+ *  spatial index with the linear search (which is used if a list of sectors
+ *  is given) for points on, near and far away from the quads.
+ *  \return The number of different results.
+ */
+int Graph::testSpatialIndex() const
+{
+    const int n = (int)getNumNodes();
+    if (n == 0)
+        return 0;
+
+    std::vector<Vec3> points;
+    for (int i = 0; i < n; i++)
+    {
+        const Quad* q = m_all_nodes[i];
+        points.push_back(q->getCenter());
+        points.push_back(q->getCenter() + Vec3(0, 3.0f, 0));
+        points.push_back(q->getCenter() + 3.0f * ((*q)[0] - q->getCenter()));
+        for (int j = 0; j < 4; j++)
+            points.push_back((*q)[j]);
+    }
+    const Vec3 size = m_bb_max - m_bb_min;
+    for (int x = -5; x <= 35; x++)
+    {
+        for (int z = -5; z <= 35; z++)
+        {
+            for (int y = -1; y <= 2; y++)
+            {
+                points.push_back(m_bb_min + Vec3(size.getX() * x / 30.0f,
+                                                 size.getY() * y * 0.45f
+                                                 + 0.1f,
+                                                 size.getZ() * z / 30.0f));
+            }
+        }
+    }
+
+    int error_count = 0;
+    std::vector<int> sectors(n);
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        const Vec3& xyz = points[i];
+        // Test without current sector and with an arbitrary sector
+        const int current[2] = { UNKNOWN_SECTOR, (int)((i * 7919) % n) };
+        for (int c = 0; c < 2; c++)
+        {
+            for (int vertical = 0; vertical < 2; vertical++)
+            {
+                const bool ignore_vertical = vertical == 1;
+                int sector = current[c];
+                findRoadSector(xyz, &sector, NULL, ignore_vertical);
+                // The linear search with all sectors in the same order
+                int start = current[c] + 1 < n ? current[c] + 1 : 0;
+                for (int j = 0; j < n; j++)
+                    sectors[j] = (start + j) % n;
+                int expected = current[c];
+                findRoadSector(xyz, &expected, &sectors, ignore_vertical);
+                if (sector != expected)
+                {
+                    Log::error("Graph", "findRoadSector %f %f %f: %d "
+                               "instead of %d.", xyz.getX(), xyz.getY(),
+                               xyz.getZ(), sector, expected);
+                    error_count++;
+                }
+
+                sector = findOutOfRoadSector(xyz, current[c], NULL,
+                                             ignore_vertical);
+                start = current[c] != UNKNOWN_SECTOR
+                      ? ((current[c] - 9) % n + n) % n : 1 % n;
+                for (int j = 0; j < n; j++)
+                    sectors[j] = (start + j) % n;
+                expected = findOutOfRoadSector(xyz, current[c], &sectors,
+                                               ignore_vertical);
+                if (sector != expected)
+                {
+                    Log::error("Graph", "findOutOfRoadSector %f %f %f: %d "
+                               "instead of %d.", xyz.getX(), xyz.getY(),
+                               xyz.getZ(), sector, expected);
+                    error_count++;
+                }
+            }   // for vertical
+        }   // for c
+    }   // for i < points.size()
+    return error_count;
+}   // testSpatialIndex
+
+//-----------------------------------------------------------------------------
+/** Tests the spatial index with the drive graphs and navmeshes of all
+ *  tracks.
+ */
+void Graph::unitTesting()
+{
+    int error_count = 0;
+    for (unsigned int i = 0; i < track_manager->getNumberOfTracks(); i++)
+    {
+        Track* track = track_manager->getTrack(i);
+        const std::string navmesh = track->getTrackFile("navmesh.xml");
+        const std::string quads = track->getTrackFile("quads.xml");
+        const std::string graph_file = track->getTrackFile("graph.xml");
+        Graph* graph = NULL;
+        if (file_manager->fileExists(navmesh))
+        {
+            // Don't leave a cache of the shortest paths in the data dir
+            const std::string cache =
+                file_manager->getTempFile("graph-unit-test.cache");
+            graph = new ArenaGraph(navmesh, NULL, cache);
+            remove(cache.c_str());
+        }
+        else if (file_manager->fileExists(quads) &&
+                 file_manager->fileExists(graph_file))
+        {
+            // The drive graph sets itself as the graph
+            graph = new DriveGraph(quads, graph_file, /*reverse*/false);
+        }
+        else
+            continue;
+
+        int errors = graph->testSpatialIndex();
+        if (errors > 0)
+        {
+            Log::error("Graph", "Spatial index of '%s': %d errors.",
+                       track->getIdent().c_str(), errors);
+        }
+        error_count += errors;
+        if (m_graph == graph)
+            destroy();
+        else
+            delete graph;
+    }   // for i < getNumberOfTracks
+    assert(error_count == 0);
+}   // unitTesting
@@ -66,6 +66,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void buildSpatialIndex();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -90,6 +92,19 @@ private:
     /** The render target used for drawing the minimap. */
     std::unique_ptr<RenderTarget> m_render_target;
 
+    /** A uniform grid over the x/z plane, so that findRoadSector and
+     *  findOutOfRoadSector only need to test the quads close to a point.
+     *  Cell c contains the quads m_grid_quads[m_grid_cells[c]] up to
+     *  m_grid_quads[m_grid_cells[c+1]-1]. Empty if there is no index. */
+    std::vector<unsigned int> m_grid_cells;
+    std::vector<int> m_grid_quads;
+
+    /** Minimum x and z coordinates and the size of a cell of the grid. */
+    float m_grid_min_x, m_grid_min_z, m_grid_cell_size;
+
+    /** Number of cells of the grid in x and z direction. */
+    int m_grid_size_x, m_grid_size_z;
+
     // ------------------------------------------------------------------------
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
@@ -106,6 +121,21 @@ private:
     virtual bool hasLapLine() const = 0;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const = 0;
+    // ------------------------------------------------------------------------
+    /** Returns the grid cell coordinate of a x or z coordinate (which can be
+     *  outside of the grid). */
+    int getGridCell(float v, float grid_min) const
+    {
+        return (int)floorf((v - grid_min) / m_grid_cell_size);
+    }   // getGridCell
+    // ------------------------------------------------------------------------
+    int findRoadSectorInGrid(const Vec3& xyz, int start,
+                             bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int findClosestSectorInGrid(const Vec3& xyz, int start, bool test_height,
+                                bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int testSpatialIndex() const;
 
 public:
     static const int UNKNOWN_SECTOR;
@@ -172,6 +202,8 @@ public:
     const Vec3& getBBMax() const                           { return m_bb_max; }
     // ------------------------------------------------------------------------
     const int* getBBNodes() const                        { return m_bb_nodes; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
 
 };   // Graph
 
@@ -141,3 +141,15 @@ bool Quad::pointInside(const Vec3& p, bool ignore_vertical) const
                p.sideOfLine2D(m_p[3], m_p[0]) >= 0.0;
     }
 }   // pointInside
+
+// ----------------------------------------------------------------------------
+void Quad::getBoundingBox(Vec3 *min, Vec3 *max) const
+{
+    *min = m_p[0];
+    *max = m_p[0];
+    for (unsigned int i = 1; i < 4; i++)
+    {
+        min->min(m_p[i]);
+        max->max(m_p[i]);
+    }
+}   // getBoundingBox
@@ -117,6 +117,10 @@ public:
     virtual bool pointInside(const Vec3& p,
                              bool ignore_vertical = false) const;
     // ------------------------------------------------------------------------
+    /** Returns the axis aligned bounding box which contains all points for
+     *  which pointInside can be true (ignoring the height for 2d quads). */
+    virtual void getBoundingBox(Vec3 *min, Vec3 *max) const;
+    // ------------------------------------------------------------------------
     /** Returns true if this quad is 3D, which additional 3D testing is used in
      *  pointInside. */
     virtual bool is3DQuad() const                             { return false; }
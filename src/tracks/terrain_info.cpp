@@ -18,6 +18,7 @@
 
 #include "tracks/terrain_info.hpp"
 
+#include "modes/world.hpp"
 #include "physics/triangle_mesh.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
@@ -33,6 +34,7 @@ TerrainInfo::TerrainInfo()
 {
     m_last_material = NULL;
     m_material      = NULL;
+    m_prefetched.m_ticks = -1;
 }   // TerrainInfo
 
 //-----------------------------------------------------------------------------
@@ -44,6 +46,7 @@ TerrainInfo::TerrainInfo(const Vec3 &pos)
     // initialise HoT
     m_last_material = NULL;
     m_material = NULL;
+    m_prefetched.m_ticks = -1;
     update(pos);
 }   // TerrainInfo
 
@@ -77,21 +80,65 @@ void TerrainInfo::update(const btMatrix3x3 &rotation, const Vec3 &from)
     // Save the origin for debug drawing
     m_origin_ray    = from;
 
+    World *world = World::getWorld();
+    if (world && m_prefetched.m_ticks == world->getTicksSinceStart() &&
+        m_prefetched.m_rotation      == rotation                     &&
+        m_prefetched.m_from          == from                         &&
+        m_prefetched.m_old_hit_point == m_hit_point                    )
+    {
+        m_hit_point = m_prefetched.m_hit_point;
+        m_material  = m_prefetched.m_material;
+        m_normal    = m_prefetched.m_normal;
+    }
+    else
+        castRay(rotation, from, &m_hit_point, &m_material, &m_normal);
+    m_prefetched.m_ticks = -1;
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Does the raycast of update(rotation, from) in advance, without changing
+ *  the current terrain information. If update is then called in the same
+ *  world tick with the same values, it uses this result. This only reads
+ *  the (static) track data, so it can be called for different objects in
+ *  parallel.
+ *  \param rotation The rotation of the object.
+ *  \param from World coordinates from which to start the raycast.
+ */
+void TerrainInfo::prefetch(const btMatrix3x3 &rotation, const Vec3 &from)
+{
+    m_prefetched.m_ticks         = World::getWorld()->getTicksSinceStart();
+    m_prefetched.m_rotation      = rotation;
+    m_prefetched.m_from          = from;
+    m_prefetched.m_old_hit_point = m_hit_point;
+    m_prefetched.m_hit_point     = m_hit_point;
+    castRay(rotation, from, &m_prefetched.m_hit_point,
+            &m_prefetched.m_material, &m_prefetched.m_normal);
+}   // prefetch
+
+//-----------------------------------------------------------------------------
+/** Casts a ray downwards (relative to the rotation) against the track and all
+ *  driveable track objects. If nothing is hit, the hit point is not changed.
+ */
+void TerrainInfo::castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                          Vec3 *hit_point, const Material **material,
+                          Vec3 *normal) const
+{
     // Compute the 'to' vector by rotating a long 'down' vectory by the
     // kart rotation, and adding the start point to it.
     btVector3 to(0, -10000.0f, 0);
     to = from + rotation*to;
 
     const TriangleMesh &tm = Track::getCurrentTrack()->getTriangleMesh();
-    tm.castRay(from, to, &m_hit_point, &m_material, &m_normal,
+    tm.castRay(from, to, hit_point, material, normal,
                /*interpolate*/true);
     // Now also raycast against all track objects (that are driveable). If
     // there should be a closer result (than the one against the main track 
     // mesh), its data will be returned.
     Track::getCurrentTrack()->getTrackObjectManager()
-                            ->castRay(from, to, &m_hit_point, &m_material,
-                                      &m_normal, /*interpolate*/true);
-}   // update
+                            ->castRay(from, to, hit_point, material,
+                                      normal, /*interpolate*/true);
+}   // castRay
+
 //-----------------------------------------------------------------------------
 /** Update the terrain information based on the latest position.
 *  \param Position from which to start the rayast from.
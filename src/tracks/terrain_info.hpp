@@ -43,6 +43,28 @@ private:
     /** DEBUG only: origin of raycast. */
     Vec3 m_origin_ray;
 
+    /** The result of a raycast done in advance by prefetch(), which is used
+     *  by update() if it is called for the same ray. */
+    struct Prefetched
+    {
+        /** The world ticks when the raycast was done, the result is only
+         *  used in the same tick (track objects move between ticks). */
+        int             m_ticks;
+        btMatrix3x3     m_rotation;
+        Vec3            m_from;
+        /** The hit point before the raycast, which is kept if nothing is
+         *  hit. */
+        Vec3            m_old_hit_point;
+        Vec3            m_hit_point;
+        Vec3            m_normal;
+        const Material *m_material;
+    };
+    Prefetched m_prefetched;
+
+    void castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                 Vec3 *hit_point, const Material **material,
+                 Vec3 *normal) const;
+
 public:
              TerrainInfo();
              TerrainInfo(const Vec3 &pos);
@@ -51,6 +73,7 @@ public:
     bool     getSurfaceInfo(const Vec3 &from, Vec3 *position,
                             const Material **m);
     virtual void update(const btMatrix3x3 &rotation, const Vec3 &from);
+    void     prefetch(const btMatrix3x3 &rotation, const Vec3 &from);
     virtual void update(const Vec3 &from);
     virtual void update(const Vec3 &from, const Vec3 &towards);
 
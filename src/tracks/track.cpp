@@ -78,6 +78,7 @@
 #include "utils/log.hpp"
 #include "utils/mini_glm.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/subsystem_timer.hpp"
 #include "utils/translation.hpp"
 
 #include <IBillboardTextSceneNode.h>
@@ -520,6 +521,7 @@ void Track::loadTrackInfo()
     m_gravity               = 9.80665f;
     m_friction              = stk_config->m_default_track_friction;
     m_smooth_normals        = false;
+    m_physics_broadphase    = stk_config->m_physics_broadphase;
     m_godrays               = false;
     m_godrays_opacity       = 1.0f;
     m_godrays_color         = video::SColor(255, 255, 255, 255);
@@ -582,6 +584,7 @@ void Track::loadTrackInfo()
         m_enable_auto_rescue = false;
     root->get("auto-rescue",           &m_enable_auto_rescue);
     root->get("smooth-normals",        &m_smooth_normals);
+    root->get("physics-broadphase",    &m_physics_broadphase);
     // Reverse is meaningless in arena
     if(m_is_arena || m_is_soccer)
         m_reverse_available = false;
@@ -908,7 +911,11 @@ void Track::createPhysicsModel(unsigned int main_track_count)
         uploadNodeVertexBuffer(m_all_nodes[i]);
     }
     main_loop->renderGUI(5580);
-    m_track_mesh->createPhysicalBody(m_friction);
+    // Computing the bvh of a big track takes a noticeable time, so it is
+    // cached (the cache is only used if the track mesh didn't change).
+    m_track_mesh->createPhysicalBody(m_friction,
+        (btCollisionObject::CollisionFlags)0,
+        file_manager->getCachedBVHDir() + m_ident + ".bvh");
     main_loop->renderGUI(5585);
     m_gfx_effect_mesh->createCollisionShape();
     main_loop->renderGUI(5590);
@@ -1611,8 +1618,14 @@ void Track::update(int ticks)
         m_startup_run = true;
     }
     float dt = stk_config->ticks2Time(ticks);
-    CheckManager::get()->update(dt);
-    ItemManager::get()->update(ticks);
+    {
+        SUBSYSTEM_TIMER(CHECKS);
+        CheckManager::get()->update(dt);
+    }
+    {
+        SUBSYSTEM_TIMER(ITEMS);
+        ItemManager::get()->update(ticks);
+    }
 
     // TODO: enable onUpdate scripts if we ever find a compelling use for them
     //Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
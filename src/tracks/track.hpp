@@ -334,6 +334,9 @@ private:
     /** True if this track supports using smoothed normals. */
     bool                m_smooth_normals;
 
+    /** The broadphase the physics uses for this track. */
+    std::string         m_physics_broadphase;
+
     bool                m_is_addon;
 
     float               m_fog_max;
@@ -624,6 +627,11 @@ public:
     /** Returns true if the normals of this track can be smoothed. */
     bool smoothNormals() const { return m_smooth_normals; }
     // ------------------------------------------------------------------------
+    /** Returns the name of the broadphase the physics should use for this
+     *  track, see Physics::init. */
+    const std::string& getPhysicsBroadphase() const
+                                              { return m_physics_broadphase; }
+    // ------------------------------------------------------------------------
     /** Returns the track object manager. */
     TrackObjectManager* getTrackObjectManager() const
     {
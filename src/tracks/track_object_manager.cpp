@@ -32,6 +32,10 @@
 #include <IMeshSceneNode.h>
 #include <ISceneManager.h>
 
+#include <algorithm>
+
+const float TrackObjectManager::DRIVEABLE_TREE_MARGIN = 0.5f;
+
 TrackObjectManager::TrackObjectManager()
 {
 }   // TrackObjectManager
@@ -100,6 +104,7 @@ void TrackObjectManager::init()
             moveable_objects++;
         }
     }
+    updateDriveableTree();
 }   // init
 
 // ----------------------------------------------------------------------------
@@ -112,6 +117,7 @@ void TrackObjectManager::reset()
         curr->reset();
         curr->resetEnabled();
     }
+    updateDriveableTree();
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -193,16 +199,67 @@ void TrackObjectManager::update(float dt)
     {
         curr->update(dt);
     }
+    updateDriveableTree();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Updates the bounding box tree over the driveable objects used by castRay.
+ *  This must be called whenever a driveable object might have moved, and
+ *  not while castRay is being called from another thread. Only the leaves
+ *  of objects that moved out of their (slightly enlarged) box are changed.
+ *  If the list of driveable objects has changed, the tree is rebuilt.
+ */
+void TrackObjectManager::updateDriveableTree()
+{
+    const unsigned int count = m_driveable_objects.size();
+    if (m_driveable_leaves.size() != count)
+    {
+        m_driveable_tree.clear();
+        m_driveable_leaves.assign(count, NULL);
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const PhysicalObject *po =
+            m_driveable_objects.get(i)->getPhysicalObject();
+        btVector3 min, max;
+        if (!po || !po->getRaycastAabb(&min, &max))
+        {
+            // Without a box the object is tested by each raycast.
+            if (m_driveable_leaves[i])
+            {
+                m_driveable_tree.remove(m_driveable_leaves[i]);
+                m_driveable_leaves[i] = NULL;
+            }
+            continue;
+        }
+
+        btDbvtVolume volume = btDbvtVolume::FromMM(min, max);
+        if (!m_driveable_leaves[i])
+        {
+            volume.Expand(btVector3(DRIVEABLE_TREE_MARGIN,
+                                    DRIVEABLE_TREE_MARGIN,
+                                    DRIVEABLE_TREE_MARGIN));
+            m_driveable_leaves[i] = m_driveable_tree.insert(volume, NULL);
+            m_driveable_leaves[i]->dataAsInt = i;
+        }
+        else
+        {
+            m_driveable_tree.update(m_driveable_leaves[i], volume,
+                                    DRIVEABLE_TREE_MARGIN);
+        }
+    }   // for i < count
+}   // updateDriveableTree
+
 // ----------------------------------------------------------------------------
 /** Does a raycast against all driveable objects. This way part of the track
  *  can be a physical object, and can e.g. be animated. A separate list of all
  *  driveable objects is maintained (in one case there were over 2000 bodies,
- *  but only one is driveable). The result of the raycast against the track
- *  mesh are the input parameter. It is then tested if the raycast against 
- *  a track object gives a 'closer' result. If so, the parameters hit_point,
- *  normal, and material will be updated.
+ *  but only one is driveable), and only the objects whose bounding box is
+ *  crossed by the ray (see updateDriveableTree) are tested. The result of
+ *  the raycast against the track mesh are the input parameter. It is then
+ *  tested if the raycast against a track object gives a 'closer' result.
+ *  If so, the parameters hit_point, normal, and material will be updated.
  *  \param from/to The from and to position for the raycast.
  *  \param xyz The position in world where the ray hit.
  *  \param material The material of the mesh that was hit.
@@ -227,8 +284,41 @@ void TrackObjectManager::castRay(const btVector3 &from,
     {
         distance = hit_point->distance(from);
     }
-    for (const TrackObject* curr : m_driveable_objects)
+
+    /** Collects the index of all objects whose box is crossed by the ray. */
+    struct DriveableCollector : public btDbvt::ICollide
     {
+        std::vector<int> m_indices;
+        virtual void Process(const btDbvtNode *leaf)
+        {
+            m_indices.push_back(leaf->dataAsInt);
+        }   // Process
+    };   // DriveableCollector
+
+    DriveableCollector collector;
+    const int count = (int)m_driveable_objects.size();
+    if ((int)m_driveable_leaves.size() != count)
+    {
+        // The tree is out of date, test all objects
+        for (int i = 0; i < count; i++)
+            collector.m_indices.push_back(i);
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (!m_driveable_leaves[i])
+                collector.m_indices.push_back(i);
+        }
+        btDbvt::rayTest(m_driveable_tree.m_root, from, to, collector);
+        // Test the objects in the same order as they are stored, so that
+        // the same object is used if two hits have the same distance.
+        std::sort(collector.m_indices.begin(), collector.m_indices.end());
+    }
+
+    for (int i : collector.m_indices)
+    {
+        const TrackObject *curr = m_driveable_objects.get(i);
         if (!curr->isEnabled())
         {
             // For example jumping pad in cocoa temple
@@ -268,5 +358,13 @@ void TrackObjectManager::insertObject(TrackObject* object)
 void TrackObjectManager::removeObject(TrackObject* obj)
 {
     m_all_objects.remove(obj);
+    if (m_driveable_objects.contains(obj))
+    {
+        m_driveable_objects.remove(obj);
+        // The tree uses indices into m_driveable_objects, so it is rebuilt
+        // in the next updateDriveableTree call.
+        m_driveable_tree.clear();
+        m_driveable_leaves.clear();
+    }
     delete obj;
 }   // removeObject
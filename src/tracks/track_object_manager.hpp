@@ -23,6 +23,8 @@
 #include "tracks/track_object.hpp"
 #include "utils/ptr_vector.hpp"
 
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+
 class Track;
 class Vec3;
 class XMLNode;
@@ -51,6 +53,21 @@ protected:
     /** A second list which holds all objects that karts can drive on. */
     PtrVector<TrackObject, REF> m_driveable_objects;
 
+    /** A bounding box tree over all driveable objects, so that a raycast
+     *  only needs to test the objects whose bounding box it crosses. The
+     *  tree is refitted in updateDriveableTree when objects move. */
+    btDbvt m_driveable_tree;
+
+    /** For each entry of m_driveable_objects the leaf in m_driveable_tree.
+     *  NULL if no bounding box is available for the object, in which case
+     *  it is tested by every raycast. If the size does not match
+     *  m_driveable_objects, the tree is out of date and not used. */
+    std::vector<btDbvtNode*> m_driveable_leaves;
+
+    /** Amount by which the box of a moving object is enlarged in the tree,
+     *  so that small movements don't need to change the tree. */
+    static const float DRIVEABLE_TREE_MARGIN;
+
 public:
          TrackObjectManager();
         ~TrackObjectManager();
@@ -68,6 +85,7 @@ public:
                  const Material **material, btVector3 *normal = NULL,
                  bool interpolate_normal = false) const;
 
+    void updateDriveableTree();
     void insertObject(TrackObject* object);
 
     void removeObject(TrackObject* who);
@@ -70,6 +70,22 @@ bool CommandLine::has(const std::string &option)
     return false;
 }   // has
 
+// ----------------------------------------------------------------------------
+/** Returns true if the option is given, either on its own or with a value
+ *  ('option=XX'). Unlike has, the option is not removed.
+ *  \param option The option (must include '-' or '--' as required).
+ */
+bool CommandLine::contains(const std::string &option)
+{
+    const std::string equal = option + "=";
+    for (const std::string &arg : m_argv)
+    {
+        if (arg == option || arg.compare(0, equal.size(), equal) == 0)
+            return true;
+    }
+    return false;
+}   // contains
+
 // ----------------------------------------------------------------------------
 /** Reports any parameters that have not been handled yet to be an error.
  */
@@ -82,6 +82,7 @@ public:
     static void addArgsFromUserConfig();
     static void reportInvalidParameters();
     static bool has(const std::string &option);
+    static bool contains(const std::string &option);
     // ------------------------------------------------------------------------
     /** Searches for an option 'option=XX'. If found, *value will contain 'XX'.
      *  If the value was found and the type of XX and value matches each other,
@@ -0,0 +1,177 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/histogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+// ----------------------------------------------------------------------------
+Histogram::Histogram()
+{
+    reset();
+}   // Histogram
+
+// ----------------------------------------------------------------------------
+/** Removes all values. This must not be called while other threads add
+ *  values.
+ */
+void Histogram::reset()
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+        m_buckets[i].store(0);
+    m_count.store(0);
+    m_sum.store(0);
+    m_max.store(0);
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Returns the bucket which counts the given value, i.e. the number of
+ *  significant bits of the value.
+ */
+unsigned Histogram::getBucket(uint32_t value)
+{
+    unsigned bucket = 0;
+    while (value != 0)
+    {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}   // getBucket
+
+// ----------------------------------------------------------------------------
+/** Adds a value. This can be called from several threads at the same time.
+ *  \param value The value to add.
+ */
+void Histogram::add(uint32_t value)
+{
+    m_buckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    uint32_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max &&
+           !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Returns an upper bound for the given percentile, i.e. the end of the
+ *  bucket that contains it (but at most the largest value added).
+ *  \param percent The percentile, between 0 and 100.
+ */
+uint32_t Histogram::getPercentile(float percent) const
+{
+    uint64_t count = getCount();
+    if (count == 0)
+        return 0;
+    uint64_t target = (uint64_t)(count * percent / 100.0f);
+    if (target == 0)
+        target = 1;
+    uint64_t sum = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        sum += getBucketCount(i);
+        if (sum >= target)
+            return std::min(getBucketEnd(i), getMax());
+    }
+    return getMax();
+}   // getPercentile
+
+// ----------------------------------------------------------------------------
+/** Writes all non-empty buckets as lines of 'name,start,end,count'.
+ *  \param out The stream to write to.
+ *  \param name Name written at the start of each line.
+ */
+void Histogram::writeCSV(std::ostream& out, const std::string& name) const
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        uint32_t count = getBucketCount(i);
+        if (count == 0)
+            continue;
+        out << name << "," << getBucketStart(i) << "," << getBucketEnd(i)
+            << "," << count << "\n";
+    }
+}   // writeCSV
+
+// ----------------------------------------------------------------------------
+/** Writes the histogram as a JSON object with a summary and all non-empty
+ *  buckets as [start, end, count] arrays.
+ *  \param out The stream to write to.
+ */
+void Histogram::writeJSON(std::ostream& out) const
+{
+    out << "{\"count\": " << getCount() << ", \"sum\": " << getSum()
+        << ", \"max\": " << getMax() << ", \"average\": " << getAverage()
+        << ", \"p50\": " << getPercentile(50.0f)
+        << ", \"p90\": " << getPercentile(90.0f)
+        << ", \"p99\": " << getPercentile(99.0f) << ", \"buckets\": [";
+    bool first = true;
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        uint32_t count = getBucketCount(i);
+        if (count == 0)
+            continue;
+        out << (first ? "" : ", ") << "[" << getBucketStart(i) << ", "
+            << getBucketEnd(i) << ", " << count << "]";
+        first = false;
+    }
+    out << "]}";
+}   // writeJSON
+
+// ----------------------------------------------------------------------------
+void Histogram::unitTesting()
+{
+    assert(getBucket(0) == 0);
+    assert(getBucket(1) == 1);
+    assert(getBucket(2) == 2);
+    assert(getBucket(3) == 2);
+    assert(getBucket(4) == 3);
+    assert(getBucket(0xffffffff) == NUM_BUCKETS - 1);
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        assert(getBucket(getBucketStart(i)) == i);
+        assert(getBucket(getBucketEnd(i)) == i);
+    }
+
+    Histogram h;
+    assert(h.getCount() == 0);
+    assert(h.getPercentile(50.0f) == 0);
+    for (uint32_t i = 1; i <= 100; i++)
+        h.add(i);
+    assert(h.getCount() == 100);
+    assert(h.getSum() == 5050);
+    assert(h.getMax() == 100);
+    assert(h.getBucketCount(0) == 0);
+    assert(h.getBucketCount(1) == 1);
+    assert(h.getBucketCount(7) == 37);
+    // The median 50 is in the bucket [32, 63]
+    assert(h.getPercentile(50.0f) == 63);
+    // The largest bucket is limited by the maximum
+    assert(h.getPercentile(100.0f) == 100);
+
+    std::ostringstream csv;
+    h.writeCSV(csv, "test");
+    assert(csv.str().find("test,64,127,37\n") != std::string::npos);
+
+    h.reset();
+    assert(h.getCount() == 0 && h.getMax() == 0);
+}   // unitTesting
@@ -0,0 +1,92 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_HISTOGRAM_HPP
+#define HEADER_HISTOGRAM_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/** \ingroup utils
+ *  A histogram of unsigned values with buckets of exponentially growing size:
+ *  bucket 0 counts the value 0, bucket i>0 counts values in [2^(i-1), 2^i).
+ *  Values can be added from any thread without locking, so it can be used
+ *  for statistics in time critical code.
+ */
+class Histogram : public NoCopy
+{
+public:
+    /** One bucket for 0 and one for each bit of a 32-bit value. */
+    static const unsigned NUM_BUCKETS = 33;
+
+private:
+    std::atomic<uint32_t> m_buckets[NUM_BUCKETS];
+
+    /** Number of values added. */
+    std::atomic<uint64_t> m_count;
+
+    /** Sum of all values added. */
+    std::atomic<uint64_t> m_sum;
+
+    /** The largest value added. */
+    std::atomic<uint32_t> m_max;
+
+public:
+             Histogram();
+    void     reset();
+    void     add(uint32_t value);
+    uint32_t getPercentile(float percent) const;
+    void     writeCSV(std::ostream& out, const std::string& name) const;
+    void     writeJSON(std::ostream& out) const;
+    static unsigned getBucket(uint32_t value);
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Returns the smallest value counted in the given bucket. */
+    static uint32_t getBucketStart(unsigned bucket)
+    {
+        return bucket == 0 ? 0 : (uint32_t)1 << (bucket - 1);
+    }   // getBucketStart
+    // ------------------------------------------------------------------------
+    /** Returns the largest value counted in the given bucket. */
+    static uint32_t getBucketEnd(unsigned bucket)
+    {
+        return bucket == 0 ? 0 : (uint32_t)((((uint64_t)1) << bucket) - 1);
+    }   // getBucketEnd
+    // ------------------------------------------------------------------------
+    uint32_t getBucketCount(unsigned bucket) const
+                                         { return m_buckets[bucket].load(); }
+    // ------------------------------------------------------------------------
+    uint64_t getCount() const                    { return m_count.load(); }
+    // ------------------------------------------------------------------------
+    uint64_t getSum() const                        { return m_sum.load(); }
+    // ------------------------------------------------------------------------
+    uint32_t getMax() const                        { return m_max.load(); }
+    // ------------------------------------------------------------------------
+    /** Returns the average of all values, or 0 if none were added. */
+    float getAverage() const
+    {
+        uint64_t count = getCount();
+        return count == 0 ? 0.0f : (float)((double)getSum() / count);
+    }   // getAverage
+};   // class Histogram
+
+#endif
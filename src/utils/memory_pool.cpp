@@ -0,0 +1,149 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/memory_pool.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+// ----------------------------------------------------------------------------
+/** Creates a pool.
+ *  \param granularity Sizes are rounded up to a multiple of this.
+ *  \param num_size_classes Number of size classes, i.e. blocks larger than
+ *         num_size_classes * granularity are not pooled.
+ *  \param max_free_blocks Maximum number of free blocks kept for each size
+ *         class.
+ */
+MemoryPool::MemoryPool(size_t granularity, size_t num_size_classes,
+                       size_t max_free_blocks)
+          : m_granularity(granularity), m_num_size_classes(num_size_classes),
+            m_max_free_blocks(max_free_blocks)
+{
+    m_free_blocks.resize(m_num_size_classes);
+    m_allocations.store(0);
+    m_reuses.store(0);
+}   // MemoryPool
+
+// ----------------------------------------------------------------------------
+MemoryPool::~MemoryPool()
+{
+    for (std::vector<void*>& free_blocks : m_free_blocks)
+    {
+        for (void* p : free_blocks)
+            free(p);
+    }
+}   // ~MemoryPool
+
+// ----------------------------------------------------------------------------
+/** Returns a block of memory of at least the given size, either from the
+ *  free list of its size class or newly allocated.
+ *  \param size Size of the block in bytes.
+ */
+void* MemoryPool::allocate(size_t size)
+{
+    size_t size_class = (size + m_granularity - 1) / m_granularity;
+    if (size_class > 0 && size_class <= m_num_size_classes)
+    {
+        std::vector<void*>& free_blocks = m_free_blocks[size_class - 1];
+        std::unique_lock<std::mutex> ul(m_mutex);
+        if (!free_blocks.empty())
+        {
+            void* p = free_blocks.back();
+            free_blocks.pop_back();
+            ul.unlock();
+            m_reuses.fetch_add(1, std::memory_order_relaxed);
+            return p;
+        }
+        ul.unlock();
+        // Allocate the full size class so the block can be reused for
+        // all objects of that class
+        size = size_class * m_granularity;
+    }
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}   // allocate
+
+// ----------------------------------------------------------------------------
+/** Returns a block to the pool.
+ *  \param p The block, which must have been allocated by this pool.
+ *  \param size The size the block was allocated with.
+ */
+void MemoryPool::deallocate(void* p, size_t size)
+{
+    if (!p)
+        return;
+    size_t size_class = (size + m_granularity - 1) / m_granularity;
+    if (size_class > 0 && size_class <= m_num_size_classes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<void*>& free_blocks = m_free_blocks[size_class - 1];
+        if (free_blocks.size() < m_max_free_blocks)
+        {
+            free_blocks.push_back(p);
+            return;
+        }
+    }
+    free(p);
+}   // deallocate
+
+// ----------------------------------------------------------------------------
+void MemoryPool::unitTesting()
+{
+    MemoryPool pool;
+    void* a = pool.allocate(20);
+    void* b = pool.allocate(20);
+    assert(a != b);
+    assert(pool.getAndResetAllocations() == 2);
+
+    // A freed block is reused for another object of the same size class
+    pool.deallocate(a, 20);
+    void* c = pool.allocate(30);
+    assert(c == a);
+    assert(pool.getAndResetAllocations() == 0);
+    assert(pool.getAndResetReuses() == 1);
+
+    // But not for a different size class
+    pool.deallocate(b, 20);
+    void* d = pool.allocate(40);
+    assert(d != b);
+    assert(pool.getAndResetAllocations() == 1);
+
+    // Large blocks are never pooled
+    void* e = pool.allocate(1000);
+    pool.deallocate(e, 1000);
+    void* f = pool.allocate(1000);
+    assert(pool.getAndResetAllocations() == 2);
+    assert(pool.getAndResetReuses() == 0);
+
+    pool.deallocate(c, 30);
+    pool.deallocate(d, 40);
+    pool.deallocate(f, 1000);
+
+    // Pool with larger size classes
+    MemoryPool large(256, 16);
+    void* g = large.allocate(1000);
+    large.deallocate(g, 1000);
+    void* h = large.allocate(800);
+    assert(h == g);
+    assert(large.getAndResetReuses() == 1);
+    large.deallocate(h, 800);
+}   // unitTesting
@@ -0,0 +1,78 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MEMORY_POOL_HPP
+#define HEADER_MEMORY_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/** \ingroup utils
+ *  A thread-safe pool for small objects which are created and deleted very
+ *  often (e.g. network strings and rewind infos). Deleted objects are not
+ *  returned to the system, instead their memory is kept in a free list for
+ *  each size class and reused for the next object of that size class.
+ *  Objects can be freed in a different thread than they were created in.
+ *  A class uses the pool by defining its own operator new and delete.
+ */
+class MemoryPool : public NoCopy
+{
+private:
+    /** Sizes are rounded up to a multiple of this. */
+    const size_t m_granularity;
+
+    /** Number of size classes, larger objects are not pooled. */
+    const size_t m_num_size_classes;
+
+    /** Maximum number of free blocks kept for each size class, so memory
+     *  is eventually freed after a peak. */
+    const size_t m_max_free_blocks;
+
+    std::mutex m_mutex;
+
+    /** The free blocks for each size class. */
+    std::vector<std::vector<void*> > m_free_blocks;
+
+    /** Number of blocks allocated from the system. */
+    std::atomic<int> m_allocations;
+
+    /** Number of blocks that were taken from the free lists. */
+    std::atomic<int> m_reuses;
+
+public:
+             MemoryPool(size_t granularity = 16, size_t num_size_classes = 16,
+                        size_t max_free_blocks = 4096);
+            ~MemoryPool();
+    void*    allocate(size_t size);
+    void     deallocate(void* p, size_t size);
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Returns the number of blocks allocated from the system since the last
+     *  call, and resets this number. */
+    int getAndResetAllocations()          { return m_allocations.exchange(0); }
+    // ------------------------------------------------------------------------
+    /** Returns the number of reused blocks since the last call, and resets
+     *  this number. */
+    int getAndResetReuses()                   { return m_reuses.exchange(0); }
+};   // class MemoryPool
+
+#endif
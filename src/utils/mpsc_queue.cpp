@@ -0,0 +1,179 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/mpsc_queue.hpp"
+
+#include "utils/log.hpp"
+#include "utils/synchronised.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace MPSCQueueTest
+{
+// ----------------------------------------------------------------------------
+/** Returns the time in seconds since an arbitrary start. */
+double getTime()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}   // getTime
+
+// ----------------------------------------------------------------------------
+/** Starts the producer threads, each pushing count values of the form
+ *  (producer << 24) | n, and returns the threads.
+ */
+template<typename PUSH>
+std::vector<std::thread> startProducers(unsigned producers, uint32_t count,
+                                        PUSH push)
+{
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++)
+    {
+        threads.emplace_back([p, count, push]()
+            {
+                for (uint32_t n = 0; n < count; n++)
+                    push((p << 24) | n);
+            });
+    }
+    return threads;
+}   // startProducers
+
+// ----------------------------------------------------------------------------
+void unitTesting()
+{
+    MPSCQueue<int> queue(5);
+    assert(queue.getCapacity() == 8);
+    int value;
+    assert(!queue.pop(&value));
+
+    // Fill and empty the queue several times, so the positions wrap around
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            bool pushed = queue.push(round * 10 + i);
+            assert(pushed);
+            (void)pushed;
+        }
+        bool pushed = queue.push(99);
+        assert(!pushed);
+        (void)pushed;
+        for (int i = 0; i < 8; i++)
+        {
+            bool popped = queue.pop(&value);
+            assert(popped && value == round * 10 + i);
+            (void)popped;
+        }
+        assert(!queue.pop(&value));
+    }
+
+    // Several producers: nothing is lost, and the values of each producer
+    // arrive in order
+    const unsigned producers = 4;
+    const uint32_t count = 20000;
+    MPSCQueue<uint32_t> mt_queue(64);
+    std::vector<std::thread> threads = startProducers(producers, count,
+        [&mt_queue](uint32_t v)
+        {
+            while (!mt_queue.push(v))
+                std::this_thread::yield();
+        });
+    std::vector<uint32_t> next(producers, 0);
+    uint32_t v;
+    for (uint32_t received = 0; received < producers * count;)
+    {
+        if (!mt_queue.pop(&v))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        assert((v & 0xffffff) == next[v >> 24]);
+        next[v >> 24]++;
+        received++;
+    }
+    for (std::thread& t : threads)
+        t.join();
+    assert(!mt_queue.pop(&v));
+}   // unitTesting
+
+// ----------------------------------------------------------------------------
+/** Compares the time to hand over values from several producer threads to
+ *  one consumer with an MPSCQueue and with a mutex protected vector (which
+ *  the consumer swaps out), and prints the results.
+ */
+void benchmark()
+{
+    const uint32_t count = 500000;
+    for (unsigned producers = 1; producers <= 4; producers *= 2)
+    {
+        const uint32_t total = producers * count;
+        uint32_t v;
+
+        MPSCQueue<uint32_t> queue(1024);
+        double start = getTime();
+        std::vector<std::thread> threads = startProducers(producers, count,
+            [&queue](uint32_t v)
+            {
+                while (!queue.push(v))
+                    std::this_thread::yield();
+            });
+        for (uint32_t received = 0; received < total;)
+        {
+            if (queue.pop(&v))
+                received++;
+            else
+                std::this_thread::yield();
+        }
+        for (std::thread& t : threads)
+            t.join();
+        double queue_time = getTime() - start;
+
+        Synchronised<std::vector<uint32_t> > locked;
+        start = getTime();
+        threads = startProducers(producers, count,
+            [&locked](uint32_t v)
+            {
+                locked.lock();
+                locked.getData().push_back(v);
+                locked.unlock();
+            });
+        std::vector<uint32_t> local;
+        for (uint32_t received = 0; received < total;)
+        {
+            locked.lock();
+            local.swap(locked.getData());
+            locked.unlock();
+            if (local.empty())
+                std::this_thread::yield();
+            received += (uint32_t)local.size();
+            local.clear();
+        }
+        for (std::thread& t : threads)
+            t.join();
+        double locked_time = getTime() - start;
+
+        Log::info("MPSCQueue", "%u producers: queue %.1f ns/value, "
+                  "mutex %.1f ns/value", producers,
+                  queue_time * 1.0e9 / total, locked_time * 1.0e9 / total);
+    }
+}   // benchmark
+
+}   // namespace MPSCQueueTest
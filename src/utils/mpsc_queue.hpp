@@ -0,0 +1,147 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MPSC_QUEUE_HPP
+#define HEADER_MPSC_QUEUE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/** \ingroup utils
+ *  A bounded lock-free queue for any number of producer threads and one
+ *  consumer thread, e.g. to hand over data from the network thread to the
+ *  main thread without the threads waiting for each other. Each slot has a
+ *  sequence number which tells producers and the consumer if the slot is
+ *  free or filled, so only the producers compete (for the write position).
+ *  If the queue is full push() fails and the caller has to decide what to
+ *  do with the data.
+ */
+template<typename T>
+class MPSCQueue : public NoCopy
+{
+private:
+    struct Slot
+    {
+        std::atomic<size_t> m_sequence;
+        T m_data;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+
+    /** Capacity - 1, the capacity is a power of 2. */
+    size_t m_mask;
+
+    /** Padding to keep the push position in its own cache line, since all
+     *  producers write it. Padding instead of alignas, because objects
+     *  containing a queue are created with new, which doesn't support
+     *  extended alignment before C++17. */
+    char m_padding_1[64];
+
+    /** Position for the next push. */
+    std::atomic<size_t> m_push_position;
+
+    char m_padding_2[64];
+
+    /** Position for the next pop, only used by the consumer. */
+    size_t m_pop_position;
+
+public:
+    /** Creates a queue.
+     *  \param capacity Minimum number of elements the queue can hold, it is
+     *         rounded up to a power of 2. */
+    MPSCQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++)
+            m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+        m_mask = size - 1;
+        m_push_position.store(0, std::memory_order_relaxed);
+        m_pop_position = 0;
+    }   // MPSCQueue
+    // ------------------------------------------------------------------------
+    /** Adds an element to the queue, can be called from any thread.
+     *  \return False if the queue is full (the element is not added). */
+    template<typename U>
+    bool push(U&& data)
+    {
+        size_t position = m_push_position.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[position & m_mask];
+            size_t sequence = slot->m_sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+            if (diff == 0)
+            {
+                // The slot is free, try to claim it
+                if (m_push_position.compare_exchange_weak(position,
+                    position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // The slot still holds an element from the previous round
+                return false;
+            }
+            else
+            {
+                // Another producer claimed the slot
+                position = m_push_position.load(std::memory_order_relaxed);
+            }
+        }
+        slot->m_data = std::forward<U>(data);
+        slot->m_sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Removes the oldest element from the queue. Must only be called from
+     *  the consumer thread.
+     *  \return False if the queue is empty. */
+    bool pop(T* data)
+    {
+        Slot* slot = &m_slots[m_pop_position & m_mask];
+        size_t sequence = slot->m_sequence.load(std::memory_order_acquire);
+        if (sequence != m_pop_position + 1)
+            return false;
+        *data = std::move(slot->m_data);
+        slot->m_data = T();
+        slot->m_sequence.store(m_pop_position + m_mask + 1,
+                               std::memory_order_release);
+        m_pop_position++;
+        return true;
+    }   // pop
+    // ------------------------------------------------------------------------
+    /** Returns the number of elements the queue can hold. */
+    size_t getCapacity() const                           { return m_mask + 1; }
+};   // class MPSCQueue
+
+namespace MPSCQueueTest
+{
+    void unitTesting();
+    void benchmark();
+}   // namespace MPSCQueueTest
+
+#endif
@@ -44,6 +44,7 @@ Profiler profiler;
 
 #define MARKERS_NAMES_POS      core::rect<s32>(50,100,150,200)
 #define GPU_MARKERS_NAMES_POS      core::rect<s32>(50,165,150,250)
+#define COUNTERS_NAMES_POS     core::rect<s32>(50,250,150,350)
 
 // The width of the profiler corresponds to TIME_DRAWN_MS milliseconds
 #define TIME_DRAWN_MS 30.0f 
@@ -206,6 +207,28 @@ void Profiler::popCPUMarker()
     m_lock.unlock();
 }   // popCPUMarker
 
+//-----------------------------------------------------------------------------
+/** Adds a value to a counter in the current frame, e.g. the number of
+ *  memory allocations done. Counters are shown below the markers and
+ *  written to a separate file.
+ *  \param name Name of the counter.
+ *  \param value The value to add.
+ */
+void Profiler::addToCounter(const char* name, int value)
+{
+    // Don't do anything when disabled or frozen
+    if (!UserConfigParams::m_profiler_enabled ||
+         m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE )
+        return;
+
+    m_lock.lock();
+    std::vector<int>& counter = m_all_counters[name];
+    if (counter.empty())
+        counter.resize(m_max_frames, 0);
+    counter[m_current_frame] += value;
+    m_lock.unlock();
+}   // addToCounter
+
 //-----------------------------------------------------------------------------
 /** Switches the profiler either on or off.
  */
@@ -274,6 +297,9 @@ void Profiler::synchronizeFrame()
             for (k = aed.begin(); k != aed.end(); ++k)
                 k->second.getMarker(next_frame).clear();
         }
+        std::map<std::string, std::vector<int> >::iterator c;
+        for (c = m_all_counters.begin(); c != m_all_counters.end(); ++c)
+            c->second[next_frame] = 0;
     }   // is has wrapped around
 
     m_current_frame = next_frame;
@@ -473,6 +499,15 @@ void Profiler::draw()
             font->draw(oss.str().c_str(), GPU_MARKERS_NAMES_POS,
                        video::SColor(0xFF, 0xFF, 0x00, 0x00));
         }
+
+        std::ostringstream counters;
+        m_lock.lock();
+        std::map<std::string, std::vector<int> >::const_iterator c;
+        for (c = m_all_counters.begin(); c != m_all_counters.end(); ++c)
+            counters << c->first << " : " << c->second[indx] << std::endl;
+        m_lock.unlock();
+        font->draw(counters.str().c_str(), COUNTERS_NAMES_POS,
+                   video::SColor(0xFF, 0xFF, 0x00, 0x00));
     }
 
     PROFILER_POP_CPU_MARKER();
@@ -588,6 +623,26 @@ void Profiler::writeToFile()
         start = (start + 1) % m_max_frames;
     }
     f_gpu.close();
+
+    // Then all counters, one column per counter
+    std::ofstream f_counters(base_name + ".profile-counters");
+    f_counters << "# ";
+    std::map<std::string, std::vector<int> >::const_iterator c;
+    int n = 1;
+    for (c = m_all_counters.begin(); c != m_all_counters.end(); ++c, ++n)
+        f_counters << "\"" << c->first << "(" << n << ")\"   ";
+    f_counters << std::endl;
+
+    start = m_has_wrapped_around ? m_current_frame + 1 : 0;
+    if (start > m_max_frames) start -= m_max_frames;
+    while (start != m_current_frame)
+    {
+        for (c = m_all_counters.begin(); c != m_all_counters.end(); ++c)
+            f_counters << c->second[start] << "   ";
+        f_counters << std::endl;
+        start = (start + 1) % m_max_frames;
+    }
+    f_counters.close();
     m_lock.unlock();
 
 }   // writeFile
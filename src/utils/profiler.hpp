@@ -80,11 +80,15 @@ double getTimeMilliseconds();
 
     #define PROFILER_DRAW() \
         profiler.draw()
+
+    #define PROFILER_ADD_TO_COUNTER(name, value) \
+        profiler.addToCounter(name, value)
 #else
     #define PROFILER_PUSH_CPU_MARKER(name, r, g, b)
     #define PROFILER_POP_CPU_MARKER()
     #define PROFILER_SYNC_FRAME()
     #define PROFILER_DRAW()
+    #define PROFILER_ADD_TO_COUNTER(name, value)
 #endif
 
 using namespace irr;
@@ -230,6 +234,10 @@ private:
     /** Buffer for the GPU times (in ms). */
     std::vector<int> m_gpu_times;
 
+    /** Per frame values of all counters (e.g. number of memory allocations),
+     *  indexed by the counter name. Each vector has m_max_frames entries. */
+    std::map<std::string, std::vector<int> > m_all_counters;
+
     /** Counts the threads used, i.e. registered in m_thread_mapping. */
     int m_threads_used;
 
@@ -283,6 +291,7 @@ public:
     void     pushCPUMarker(const char* name="N/A",
                            const video::SColor& color=video::SColor());
     void     popCPUMarker();
+    void     addToCounter(const char* name, int value);
     void     toggleStatus(); 
     void     synchronizeFrame();
     void     draw();
@@ -0,0 +1,119 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/subsystem_timer.hpp"
+
+#include <cstdlib>
+#include <new>
+
+bool                  SubsystemTimer::m_enabled = false;
+uint64_t              SubsystemTimer::m_time[ST_COUNT];
+uint64_t              SubsystemTimer::m_calls[ST_COUNT];
+#ifdef COUNT_ALLOCATIONS
+thread_local bool     SubsystemTimer::m_count_allocations = false;
+uint64_t              SubsystemTimer::m_allocations = 0;
+
+// ----------------------------------------------------------------------------
+/** Counts the allocations of the thread which enabled the timing. The array
+ *  and nothrow versions of the operator call this one.
+ */
+void* operator new(size_t size)
+{
+    SubsystemTimer::countAllocation();
+    if (size == 0)
+        size = 1;
+    while (true)
+    {
+        void* p = malloc(size);
+        if (p)
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}   // operator new
+
+// ----------------------------------------------------------------------------
+void operator delete(void* p) noexcept
+{
+    free(p);
+}   // operator delete
+#endif
+
+// ----------------------------------------------------------------------------
+/** Sets all times and counters to 0. */
+void SubsystemTimer::reset()
+{
+    for (unsigned i = 0; i < ST_COUNT; i++)
+    {
+        m_time[i] = 0;
+        m_calls[i] = 0;
+    }
+#ifdef COUNT_ALLOCATIONS
+    m_allocations = 0;
+#endif
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Returns the name of a subsystem as used in the JSON output. */
+const char* SubsystemTimer::getName(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case ST_WORLD_UPDATE:  return "world-update";
+    case ST_KART_UPDATE:   return "kart-update";
+    case ST_AI:            return "ai";
+    case ST_PHYSICS_STEP:  return "physics-step";
+    case ST_COLLISIONS:    return "collisions";
+    case ST_PROJECTILES:   return "projectiles";
+    case ST_ITEMS:         return "items";
+    case ST_CHECKS:        return "checks";
+    case ST_TRACK_OBJECTS: return "track-objects";
+    default:               return "unknown";
+    }
+}   // getName
+
+// ----------------------------------------------------------------------------
+/** Writes the times of all subsystems and the number of allocations (if
+ *  they are counted) as JSON values (without the enclosing braces, so more
+ *  values can be added).
+ *  \param out The stream to write to.
+ *  \param ticks Number of ticks simulated, to write averages per tick.
+ */
+void SubsystemTimer::writeJSON(std::ostream& out, unsigned ticks)
+{
+    if (ticks == 0)
+        ticks = 1;
+    if (countsAllocations())
+    {
+        out << "  \"allocations\": " << getAllocations()
+            << ",\n  \"allocations-per-tick\": "
+            << (double)getAllocations() / ticks << ",\n";
+    }
+    out << "  \"subsystems\": {";
+    for (unsigned i = 0; i < ST_COUNT; i++)
+    {
+        Subsystem s = (Subsystem)i;
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << getName(s)
+            << "\": {\"time-ms\": " << getTime(s) * 1000.0
+            << ", \"calls\": " << getCalls(s)
+            << ", \"us-per-tick\": " << getTime(s) * 1.0e6 / ticks << "}";
+    }
+    out << "\n  }";
+}   // writeJSON
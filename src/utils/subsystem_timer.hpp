@@ -0,0 +1,155 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SUBSYSTEM_TIMER_HPP
+#define HEADER_SUBSYSTEM_TIMER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/** Measures the time of the enclosing scope for the given subsystem (one of
+ *  the SubsystemTimer::Subsystem values without the ST_ prefix). */
+#define SUBSYSTEM_TIMER(name) \
+    SubsystemTimer subsystem_timer(SubsystemTimer::ST_##name)
+
+/** \ingroup utils
+ *  Accumulates the time spent in the subsystems of the simulation, e.g. for
+ *  the headless benchmark (see ProfileWorld::setProfileModeTicks). Timers
+ *  are scoped objects, and do nothing unless timing is enabled. Subsystems
+ *  can be nested, e.g. the AI time is also part of the kart update time.
+ *  The timers must only be used in the main thread.
+ *  If STK is compiled with COUNT_ALLOCATIONS (a cmake option, since it
+ *  replaces the global operator new), the number of memory allocations of
+ *  the thread which enabled the timing is counted as well, while timing is
+ *  enabled. Allocations of other threads are not counted.
+ */
+class SubsystemTimer : public NoCopy
+{
+public:
+    enum Subsystem
+    {
+        ST_WORLD_UPDATE,
+        ST_KART_UPDATE,
+        ST_AI,
+        ST_PHYSICS_STEP,
+        ST_COLLISIONS,
+        ST_PROJECTILES,
+        ST_ITEMS,
+        ST_CHECKS,
+        ST_TRACK_OBJECTS,
+        ST_COUNT
+    };
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    /** True if the time is measured. */
+    static bool m_enabled;
+
+    /** Accumulated time in nanoseconds for each subsystem. */
+    static uint64_t m_time[ST_COUNT];
+
+    /** Number of timed calls for each subsystem. */
+    static uint64_t m_calls[ST_COUNT];
+
+#ifdef COUNT_ALLOCATIONS
+    /** True in the thread which enabled the timing while it is enabled,
+     *  i.e. only allocations of this thread are counted. */
+    static thread_local bool m_count_allocations;
+
+    /** Number of allocations since the last reset. */
+    static uint64_t m_allocations;
+#endif
+
+    /** The subsystem timed by this object. */
+    Subsystem m_subsystem;
+
+    Clock::time_point m_start;
+
+public:
+    // ------------------------------------------------------------------------
+    SubsystemTimer(Subsystem subsystem) : m_subsystem(subsystem)
+    {
+        if (m_enabled)
+            m_start = Clock::now();
+    }   // SubsystemTimer
+    // ------------------------------------------------------------------------
+    ~SubsystemTimer()
+    {
+        if (!m_enabled)
+            return;
+        m_time[m_subsystem] += std::chrono::duration_cast<
+            std::chrono::nanoseconds>(Clock::now() - m_start).count();
+        m_calls[m_subsystem]++;
+    }   // ~SubsystemTimer
+    // ------------------------------------------------------------------------
+    static void reset();
+    static const char* getName(Subsystem subsystem);
+    static void writeJSON(std::ostream& out, unsigned ticks);
+    // ------------------------------------------------------------------------
+    /** Enables or disables the timing. Must be called from the main
+     *  thread, whose allocations are then counted. */
+    static void setEnabled(bool enabled)
+    {
+        m_enabled = enabled;
+#ifdef COUNT_ALLOCATIONS
+        m_count_allocations = enabled;
+#endif
+    }   // setEnabled
+    // ------------------------------------------------------------------------
+    /** Returns if the timing is enabled. */
+    static bool isEnabled()                                 { return m_enabled; }
+    // ------------------------------------------------------------------------
+    /** Returns the accumulated time of a subsystem in seconds. */
+    static double getTime(Subsystem subsystem)
+                                      { return m_time[subsystem] * 1.0e-9; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of timed calls of a subsystem. */
+    static uint64_t getCalls(Subsystem subsystem)
+                                                { return m_calls[subsystem]; }
+    // ------------------------------------------------------------------------
+    /** Returns true if allocations are counted, i.e. if STK was compiled
+     *  with COUNT_ALLOCATIONS. */
+    static bool countsAllocations()
+    {
+#ifdef COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }   // countsAllocations
+    // ------------------------------------------------------------------------
+#ifdef COUNT_ALLOCATIONS
+    /** Returns the number of allocations since the last reset. */
+    static uint64_t getAllocations()                 { return m_allocations; }
+    // ------------------------------------------------------------------------
+    /** Called for each allocation. */
+    static void countAllocation()
+    {
+        if (m_count_allocations)
+            m_allocations++;
+    }   // countAllocation
+#else
+    static uint64_t getAllocations()                           { return 0; }
+#endif
+};   // class SubsystemTimer
+
+#endif
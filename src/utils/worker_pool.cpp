@@ -0,0 +1,154 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/worker_pool.hpp"
+
+#include "utils/vs.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+/** Starts the worker threads.
+ *  \param num_threads Number of worker threads (in addition to the thread
+ *         calling parallelFor). With 0 all loops run in the calling thread.
+ *  \param name Name of the worker threads (for debugging).
+ */
+WorkerPool::WorkerPool(unsigned num_threads, const std::string& name)
+{
+    m_job = NULL;
+    m_count = 0;
+    m_next.store(0);
+    m_busy = 0;
+    m_generation = 0;
+    m_exit = false;
+    for (unsigned i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&WorkerPool::run, this, name);
+}   // WorkerPool
+
+// ----------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    std::unique_lock<std::mutex> ul(m_mutex);
+    m_exit = true;
+    ul.unlock();
+    m_start.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}   // ~WorkerPool
+
+// ----------------------------------------------------------------------------
+/** Returns the number of worker threads to use by default: one less than the
+ *  number of cores (the calling thread is busy as well).
+ *  \param max_threads Upper limit for the number of worker threads.
+ */
+unsigned WorkerPool::getDefaultThreads(unsigned max_threads)
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? std::min(cores - 1, max_threads) : 0;
+}   // getDefaultThreads
+
+// ----------------------------------------------------------------------------
+/** The main loop of a worker thread. */
+void WorkerPool::run(const std::string& name)
+{
+    VS::setThreadName(name.c_str());
+    unsigned generation = 0;
+    std::unique_lock<std::mutex> ul(m_mutex);
+    while (true)
+    {
+        m_start.wait(ul, [this, generation]()
+            {
+                return m_exit || m_generation != generation;
+            });
+        if (m_exit)
+            return;
+        generation = m_generation;
+        ul.unlock();
+        work();
+        ul.lock();
+        if (--m_busy == 0)
+            m_done.notify_one();
+    }
+}   // run
+
+// ----------------------------------------------------------------------------
+/** Executes iterations of the current loop until all are taken. */
+void WorkerPool::work()
+{
+    unsigned i;
+    while ((i = m_next.fetch_add(1, std::memory_order_relaxed)) < m_count)
+        (*m_job)(i);
+}   // work
+
+// ----------------------------------------------------------------------------
+/** Calls job(i) for all i in [0, count), distributed over all threads, and
+ *  returns when all calls are done. The order of the calls is undefined.
+ *  \param count Number of iterations.
+ *  \param job The loop body, which must be safe to call in parallel for
+ *         different i.
+ */
+void WorkerPool::parallelFor(unsigned count,
+                             const std::function<void(unsigned)>& job)
+{
+    if (m_threads.empty() || count < 2)
+    {
+        for (unsigned i = 0; i < count; i++)
+            job(i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> ul(m_mutex);
+    assert(m_busy == 0);
+    m_job = &job;
+    m_count = count;
+    m_next.store(0);
+    m_busy = (unsigned)m_threads.size();
+    m_generation++;
+    ul.unlock();
+    m_start.notify_all();
+
+    work();
+
+    ul.lock();
+    m_done.wait(ul, [this]() { return m_busy == 0; });
+    m_job = NULL;
+}   // parallelFor
+
+// ----------------------------------------------------------------------------
+void WorkerPool::unitTesting()
+{
+    for (unsigned threads = 0; threads < 4; threads++)
+    {
+        WorkerPool pool(threads, "UnitTest");
+        assert(pool.getNumThreads() == threads + 1);
+        // Several loops in a row, each iteration must be done exactly once
+        for (unsigned count = 0; count < 100; count += 7)
+        {
+            std::vector<std::atomic<int> > done(count);
+            for (auto& d : done)
+                d.store(0);
+            pool.parallelFor(count, [&done](unsigned i)
+                {
+                    done[i].fetch_add(1);
+                });
+            for (unsigned i = 0; i < count; i++)
+                assert(done[i].load() == 1);
+        }
+    }
+}   // unitTesting
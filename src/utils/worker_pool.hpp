@@ -0,0 +1,86 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_WORKER_POOL_HPP
+#define HEADER_WORKER_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** \ingroup utils
+ *  A fixed number of worker threads which execute the iterations of a loop
+ *  in parallel (see parallelFor). The calling thread works on the loop as
+ *  well, and the call only returns once all iterations are done. The
+ *  threads are kept between calls, so it can be used every frame.
+ *  A pool must only be used by one thread at a time.
+ */
+class WorkerPool : public NoCopy
+{
+private:
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+
+    /** Signals the workers that a new loop was started or that they should
+     *  exit. */
+    std::condition_variable m_start;
+
+    /** Signals the calling thread that all workers are done. */
+    std::condition_variable m_done;
+
+    /** The loop body of the current loop. */
+    const std::function<void(unsigned)>* m_job;
+
+    /** Number of iterations of the current loop. */
+    unsigned m_count;
+
+    /** The next iteration to be executed. */
+    std::atomic<unsigned> m_next;
+
+    /** Number of workers still working on the current loop. */
+    unsigned m_busy;
+
+    /** Increased for each loop, so workers know that a new loop started. */
+    unsigned m_generation;
+
+    bool m_exit;
+
+    void run(const std::string& name);
+    void work();
+
+public:
+             WorkerPool(unsigned num_threads, const std::string& name);
+            ~WorkerPool();
+    void     parallelFor(unsigned count,
+                         const std::function<void(unsigned)>& job);
+    static unsigned getDefaultThreads(unsigned max_threads);
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Returns the number of threads working on a loop, including the
+     *  calling thread. */
+    unsigned getNumThreads() const { return (unsigned)m_threads.size() + 1; }
+};   // class WorkerPool
+
+#endif
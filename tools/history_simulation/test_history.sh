@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Records a network race of AI karts on a server (record-history in the
+# server config), then simulates the recorded race with --simulate-history.
+# The simulation fails if any rewinder diverges from the recorded states.
+#
+# Usage: test_history.sh path/to/supertuxkart [number of AI karts]
+
+STK=$1
+KARTS=${2:-4}
+PORT=2759
+
+if [ -z "$STK" ]; then
+    echo "Usage: $0 path/to/supertuxkart [number of AI karts]"
+    exit 1
+fi
+
+# Use a separate config directory, so the user config is not changed
+TMP=$(mktemp -d)
+export XDG_CONFIG_HOME=$TMP
+trap 'kill $SERVER $CLIENT 2>/dev/null; rm -rf "$TMP"' EXIT
+
+cat > $TMP/history-test.xml <<END
+<?xml version="1.0"?>
+<server-config version="7" >
+    <server-port value="$PORT" />
+    <server-mode value="3" />
+    <owner-less value="true" />
+    <min-start-game-players value="1" />
+    <voting-timeout value="1" />
+    <validating-player value="false" />
+    <record-history value="true" />
+</server-config>
+END
+
+$STK --server-config=$TMP/history-test.xml --lan-server=history-test \
+     --no-graphics --stdout=server.log > /dev/null 2>&1 &
+SERVER=$!
+sleep 5
+$STK --connect-now=127.0.0.1:$PORT --network-ai=$KARTS --no-graphics \
+     --stdout=client.log > /dev/null 2>&1 &
+CLIENT=$!
+
+# Wait until the server has finished recording the race
+for i in $(seq 600); do
+    LOG=$(find $TMP -name server.log | head -n 1)
+    if [ -n "$LOG" ] && grep -q "Finished recording race" "$LOG"; then
+        break
+    fi
+    sleep 1
+done
+kill $SERVER $CLIENT 2>/dev/null
+wait
+
+HISTORY=$(find $TMP -name "server-history-*.dat" | head -n 1)
+if [ -z "$HISTORY" ]; then
+    echo "No race was recorded, see the log below."
+    [ -n "$LOG" ] && tail -n 20 "$LOG"
+    exit 1
+fi
+
+# Graphical effects change the simulation (see HistorySimulation::setupRace)
+$STK --simulate-history=$HISTORY --no-graphics --stdout=simulation.log \
+     > /dev/null 2>&1
+RESULT=$?
+grep "HistorySimulation" $(find $TMP -name simulation.log | head -n 1)
+if [ $RESULT -ne 0 ]; then
+    echo "The simulation diverged from the recorded race."
+    exit 1
+fi
+echo "The simulation matches the recorded race."